@@ -0,0 +1,460 @@
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "initialization/creasefile.h"
+#include "initialization/creasepresets.h"
+#include "initialization/meshinitializer.h"
+#include "initialization/meshstreamwriter.h"
+#include "initialization/objfile.h"
+#include "initialization/objwriter.h"
+#include "mesh/meshpool.h"
+#include "subdivision/catmullclarksubdivider.h"
+#include "subdivision/streamingsubdivider.h"
+
+#define DEFAULT_LEVEL 2
+
+namespace {
+
+/**
+ * @brief The OutputFormat enum is the file format the subdivided models are
+ * written in.
+ */
+enum OutputFormat {
+  // An .obj file, see OBJWriter. The whole level is built in memory.
+  OBJ_FORMAT,
+  // A .cmstream file, see MeshStreamWriter. The level is built and written
+  // batch by batch by StreamingSubdivider, so it need not fit in memory.
+  STREAM_FORMAT
+};
+
+/**
+ * @brief The BatchOptions struct holds the settings shared by all files.
+ */
+struct BatchOptions {
+  int level = DEFAULT_LEVEL;
+  OutputFormat format = OBJ_FORMAT;
+  // Directories of the output files and the crease sidecars; next to the
+  // model if empty
+  QString outputDir;
+  QString creaseDir;
+  bool limitPositions = false;
+  bool normals = false;
+  // OpenMP threads of the subdivision steps of every file
+  int threadsPerJob = 1;
+};
+
+/**
+ * @brief The FileResult struct holds the outcome and the timings of one file.
+ * The times are wall times in nanoseconds.
+ */
+struct FileResult {
+  QString input;
+  QString output;
+  bool success = false;
+  QString error;
+  // Where the crease edges came from: sidecar, preset or none
+  QString creaseSource;
+  int creases = 0;
+  qint64 faces = 0;
+  qint64 vertices = 0;
+  qint64 loadTime = 0;
+  qint64 constructTime = 0;
+  qint64 subdivideTime = 0;
+  qint64 writeTime = 0;
+  qint64 totalTime = 0;
+};
+
+/**
+ * @brief outputFileName Gives the path a model is written to: its base name
+ * with the level and the extension of the format.
+ * @param path Path of the .obj file.
+ * @param options The batch settings.
+ * @return Path of the output file.
+ */
+QString outputFileName(const QString& path, const BatchOptions& options) {
+  QFileInfo info(path);
+  const QString dir = options.outputDir.isEmpty() ? info.path()
+                                                  : options.outputDir;
+  const QString extension =
+      options.format == STREAM_FORMAT ? ".cmstream" : ".obj";
+  return QDir(dir).filePath(info.completeBaseName() + ".level" +
+                            QString::number(options.level) + extension);
+}
+
+/**
+ * @brief applyCreases Sets the crease edges of a model from its sidecar file
+ * or, without one, from the preset of the bundled models, see
+ * applyCreasePreset.
+ * @param path Path of the .obj file.
+ * @param options The batch settings.
+ * @param mesh The control mesh, with the vertex indices of the .obj file.
+ * @param result The result of the file, which records the creases.
+ * @return False if the sidecar file exists but could not be read.
+ */
+bool applyCreases(const QString& path, const BatchOptions& options,
+                  Mesh& mesh, FileResult& result) {
+  QString sidecar = CreaseFile::sidecarFileName(path);
+  if (!options.creaseDir.isEmpty()) {
+    sidecar = QDir(options.creaseDir).filePath(QFileInfo(sidecar).fileName());
+  }
+  if (QFileInfo::exists(sidecar)) {
+    CreaseFile creaseFile(sidecar);
+    if (!creaseFile.loadedSuccessfully()) {
+      result.error = "could not read " + sidecar;
+      return false;
+    }
+    result.creaseSource = "sidecar";
+    result.creases = creaseFile.apply(mesh);
+  } else if (applyCreasePreset(path, mesh)) {
+    result.creaseSource = "preset";
+  } else {
+    result.creaseSource = "none";
+  }
+  return true;
+}
+
+/**
+ * @brief processFile Loads a model, applies its creases, subdivides it to the
+ * target level and writes it, timing every step. Runs on a thread of the
+ * pool; every file uses its own meshes and subdividers.
+ * @param path Path of the .obj file.
+ * @param options The batch settings.
+ * @param result Receives the outcome of the file.
+ */
+void processFile(const QString& path, const BatchOptions& options,
+                 FileResult& result) {
+#ifdef _OPENMP
+  // The number of threads is a setting of the calling thread
+  omp_set_num_threads(options.threadsPerJob);
+#endif
+  QElapsedTimer total;
+  total.start();
+  QElapsedTimer timer;
+  timer.start();
+  result.input = path;
+  result.output = outputFileName(path, options);
+  OBJFile objFile(path, options.threadsPerJob > 1);
+  result.loadTime = timer.nsecsElapsed();
+  if (!objFile.loadedSuccessfully()) {
+    result.error = "could not load " + path;
+    result.totalTime = total.nsecsElapsed();
+    qWarning() << ":: Failed" << path << "-" << result.error;
+    return;
+  }
+
+  timer.restart();
+  MeshInitializer meshInitializer;
+  Mesh* mesh = new Mesh(meshInitializer.constructHalfEdgeMesh(objFile));
+  const bool creased = applyCreases(path, options, *mesh, result);
+  result.constructTime = timer.nsecsElapsed();
+
+  if (creased && options.format == STREAM_FORMAT) {
+    // Subdivision and writing are interleaved, so both count as subdividing
+    timer.restart();
+    MeshStreamWriter writer(result.output);
+    StreamingSubdivider streamingSubdivider(options.level);
+    result.success = streamingSubdivider.subdivide(
+        *mesh, writer, options.limitPositions, options.normals);
+    result.subdivideTime = timer.nsecsElapsed();
+    result.faces = writer.numFacesWritten();
+    result.vertices = writer.numVertsWritten();
+    if (!result.success) {
+      result.error = "could not write " + result.output;
+    }
+  } else if (creased) {
+    timer.restart();
+    // From the second level on, every level reuses the storage of the level
+    // two below it
+    CatmullClarkSubdivider subdivider;
+    MeshPool pool;
+    for (int k = 1; k <= options.level; k++) {
+      Mesh* subdivided =
+          pool.acquire(MeshPool::Sizes::of(*mesh).subdivided());
+      subdivider.subdivide(*mesh, *subdivided);
+      pool.release(mesh);
+      mesh = subdivided;
+    }
+    result.subdivideTime = timer.nsecsElapsed();
+    result.faces = mesh->numFaces();
+    result.vertices = mesh->numVerts();
+
+    timer.restart();
+    OBJWriter writer(result.output);
+    result.success =
+        writer.write(*mesh, options.limitPositions, options.normals);
+    result.writeTime = timer.nsecsElapsed();
+    if (!result.success) {
+      result.error = "could not write " + result.output;
+    }
+    pool.release(mesh);
+    mesh = nullptr;
+  }
+  delete mesh;
+  result.totalTime = total.nsecsElapsed();
+
+  if (result.success) {
+    qDebug() << ":: Wrote" << result.output << "in"
+             << QString::number(result.totalTime / 1e6, 'f', 1) << "ms";
+  } else {
+    qWarning() << ":: Failed" << path << "-" << result.error;
+  }
+}
+
+/**
+ * @brief readFileList Reads the paths of models from a text file, one per
+ * line. Empty lines and lines starting with # are skipped.
+ * @param fileName Path of the list.
+ * @param paths The paths are appended to this list.
+ * @return False if the list could not be read.
+ */
+bool readFileList(const QString& fileName, QStringList& paths) {
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+  const QList<QByteArray> lines = file.readAll().split('\n');
+  for (const QByteArray& line : lines) {
+    const QByteArray trimmed = line.trimmed();
+    if (!trimmed.isEmpty() && !trimmed.startsWith('#')) {
+      paths.append(QString::fromUtf8(trimmed));
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief jsonString Quotes and escapes a string for a JSON document. Control
+ * characters, which may come from file names or error messages, are escaped
+ * as well, since JSON does not allow them in a string literal.
+ * @param string The string.
+ * @return The JSON string literal.
+ */
+QString jsonString(const QString& string) {
+  QString quoted = "\"";
+  for (QChar c : string) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+      quoted += c;
+    } else if (c == '\n') {
+      quoted += "\\n";
+    } else if (c == '\t') {
+      quoted += "\\t";
+    } else if (c == '\r') {
+      quoted += "\\r";
+    } else if (c.unicode() < 0x20) {
+      quoted += QString("\\u%1").arg(int(c.unicode()), 4, 16, QChar('0'));
+    } else {
+      quoted += c;
+    }
+  }
+  return quoted + "\"";
+}
+
+/**
+ * @brief milliseconds Formats a time for the log.
+ * @param time The time in nanoseconds.
+ * @return The time in milliseconds.
+ */
+QString milliseconds(qint64 time) {
+  return QString::number(time / 1e6, 'f', 3);
+}
+
+/**
+ * @brief writeLog Writes the settings and the result of every file as a JSON
+ * document, in the order the files were given.
+ * @param out The stream to write to.
+ * @param results The results.
+ * @param options The batch settings.
+ * @param jobs Number of files processed concurrently.
+ * @param wallTime Wall time of the whole batch in nanoseconds.
+ */
+void writeLog(QTextStream& out, const QVector<FileResult>& results,
+              const BatchOptions& options, int jobs, qint64 wallTime) {
+  out << "{\n";
+  out << "  \"batch\": \"CatMarkBatch\",\n";
+  out << "  \"level\": " << options.level << ",\n";
+  out << "  \"format\": "
+      << (options.format == STREAM_FORMAT ? "\"cmstream\"" : "\"obj\"")
+      << ",\n";
+  out << "  \"limit\": " << (options.limitPositions ? "true" : "false")
+      << ",\n";
+  out << "  \"normals\": " << (options.normals ? "true" : "false") << ",\n";
+  out << "  \"jobs\": " << jobs << ",\n";
+  out << "  \"threads_per_job\": " << options.threadsPerJob << ",\n";
+  out << "  \"wall_ms\": " << milliseconds(wallTime) << ",\n";
+  out << "  \"files\": [";
+  for (int i = 0; i < results.size(); i++) {
+    const FileResult& result = results[i];
+    out << (i == 0 ? "\n" : ",\n");
+    out << "    {\"input\": " << jsonString(result.input)
+        << ", \"output\": " << jsonString(result.output)
+        << ", \"status\": " << (result.success ? "\"ok\"" : "\"failed\"");
+    if (!result.success) {
+      out << ", \"error\": " << jsonString(result.error);
+    }
+    out << ", \"creases\": " << jsonString(result.creaseSource)
+        << ", \"crease_edges\": " << result.creases
+        << ", \"faces\": " << result.faces
+        << ", \"vertices\": " << result.vertices
+        << ", \"load_ms\": " << milliseconds(result.loadTime)
+        << ", \"construct_ms\": " << milliseconds(result.constructTime)
+        << ", \"subdivide_ms\": " << milliseconds(result.subdivideTime)
+        << ", \"write_ms\": " << milliseconds(result.writeTime)
+        << ", \"total_ms\": " << milliseconds(result.totalTime) << "}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+/**
+ * @brief printUsage Prints the command line options.
+ * @param program Name of the executable.
+ */
+void printUsage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [options] [model.obj...]\n"
+          "Subdivides every given model to a level and writes the results,\n"
+          "processing several models at a time. The crease edges of\n"
+          "model.obj are read from model.crease if it exists, see\n"
+          "CreaseFile. A log with the timings of every model is written as\n"
+          "JSON.\n\n"
+          "  --list <file>      Also process the models listed in <file>,\n"
+          "                     one path per line\n"
+          "  --level <n>        Subdivision level (default %d)\n"
+          "  --format <format>  obj, or cmstream for models too large for\n"
+          "                     memory (default obj)\n"
+          "  --output <dir>     Output directory (default next to every\n"
+          "                     model)\n"
+          "  --creases <dir>    Directory of the crease files (default next\n"
+          "                     to every model)\n"
+          "  --limit            Write the limit positions of the vertices\n"
+          "  --normals          Also write vertex normals; cmstream only\n"
+          "                     writes them with --limit\n"
+          "  --jobs <n>         Models processed at a time (default the\n"
+          "                     number of cores)\n"
+          "  --log <file>       Log file (default standard output)\n",
+          program, DEFAULT_LEVEL);
+}
+
+}  // namespace
+
+/**
+ * @brief main Runs the batch. See printUsage for the options.
+ * @param argc Argument count.
+ * @param argv Arguments.
+ * @return Exit code; failure if any model failed.
+ */
+int main(int argc, char* argv[]) {
+  BatchOptions options;
+  QString logFile;
+  int jobs = QThread::idealThreadCount();
+  QStringList paths;
+  for (int i = 1; i < argc; i++) {
+    const bool hasValue = i + 1 < argc;
+    if (strcmp(argv[i], "--list") == 0 && hasValue) {
+      if (!readFileList(argv[++i], paths)) {
+        qWarning() << ":: Could not read" << argv[i];
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--level") == 0 && hasValue) {
+      options.level = qMax(0, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--format") == 0 && hasValue) {
+      ++i;
+      if (strcmp(argv[i], "obj") == 0) {
+        options.format = OBJ_FORMAT;
+      } else if (strcmp(argv[i], "cmstream") == 0) {
+        options.format = STREAM_FORMAT;
+      } else {
+        qWarning() << ":: Unknown format" << argv[i];
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--output") == 0 && hasValue) {
+      options.outputDir = argv[++i];
+    } else if (strcmp(argv[i], "--creases") == 0 && hasValue) {
+      options.creaseDir = argv[++i];
+    } else if (strcmp(argv[i], "--limit") == 0) {
+      options.limitPositions = true;
+    } else if (strcmp(argv[i], "--normals") == 0) {
+      options.normals = true;
+    } else if (strcmp(argv[i], "--jobs") == 0 && hasValue) {
+      jobs = qMax(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--log") == 0 && hasValue) {
+      logFile = argv[++i];
+    } else if (argv[i][0] == '-') {
+      printUsage(argv[0]);
+      return strcmp(argv[i], "--help") == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    } else {
+      paths.append(argv[i]);
+    }
+  }
+  if (paths.isEmpty()) {
+    printUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (options.format == STREAM_FORMAT && options.level < 1) {
+    // The stream format only holds quads
+    qWarning() << ":: The cmstream format needs a level of at least 1";
+    return EXIT_FAILURE;
+  }
+  if (!options.outputDir.isEmpty() && !QDir().mkpath(options.outputDir)) {
+    qWarning() << ":: Could not create" << options.outputDir;
+    return EXIT_FAILURE;
+  }
+
+  // Files run side by side and share the cores among their subdivision
+  // steps, instead of every file starting a thread per core
+  jobs = qMin(jobs, int(paths.size()));
+  options.threadsPerJob = qMax(1, QThread::idealThreadCount() / jobs);
+
+  QElapsedTimer timer;
+  timer.start();
+  QVector<FileResult> results(paths.size());
+  QThreadPool pool;
+  pool.setMaxThreadCount(jobs);
+  for (int i = 0; i < paths.size(); i++) {
+    // Every job writes only its own result, which is never reallocated
+    FileResult* result = &results[i];
+    const QString path = paths[i];
+    pool.start([path, &options, result]() {
+      processFile(path, options, *result);
+    });
+  }
+  pool.waitForDone();
+  const qint64 wallTime = timer.nsecsElapsed();
+
+  bool success = true;
+  for (const FileResult& result : results) {
+    success &= result.success;
+  }
+
+  QString text;
+  QTextStream out(&text);
+  writeLog(out, results, options, jobs, wallTime);
+  out.flush();
+  if (logFile.isEmpty()) {
+    fputs(text.toUtf8().constData(), stdout);
+  } else {
+    QFile file(logFile);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+      qWarning() << ":: Could not write" << logFile;
+      return EXIT_FAILURE;
+    }
+    file.write(text.toUtf8());
+    file.close();
+  }
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
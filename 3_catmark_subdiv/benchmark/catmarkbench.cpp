@@ -0,0 +1,766 @@
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QVector>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "initialization/creasepresets.h"
+#include "initialization/meshinitializer.h"
+#include "initialization/meshreorderer.h"
+#include "initialization/meshstreamwriter.h"
+#include "initialization/objfile.h"
+#include "mesh/compactmesh.h"
+#include "mesh/meshpool.h"
+#include "subdivision/catmullclarksubdivider.h"
+#include "subdivision/compactsubdivider.h"
+#include "subdivision/streamingsubdivider.h"
+#include "util/simd.h"
+
+#define DEFAULT_LEVELS 4
+#define DEFAULT_REPEATS 3
+// Pooled ladders per model in --verify; the storage must settle after two
+#define VERIFY_POOL_LADDERS 3
+
+#ifndef CATMARK_MODELS_DIR
+#define CATMARK_MODELS_DIR "models"
+#endif
+
+namespace {
+
+/**
+ * @brief The StepResult struct holds the measurements of one step of the
+ * pipeline of one model over all repetitions.
+ */
+struct StepResult {
+  QString model;
+  QString step;
+  int level = 0;
+  qint64 faces = 0;
+  qint64 vertices = 0;
+  // Wall time of every repetition in nanoseconds
+  QVector<qint64> times;
+  qint64 peakMemory = 0;
+};
+
+/**
+ * @brief resetPeakMemory Resets the peak resident memory of the process to its
+ * current resident memory, so peakMemory reports the peak of the next step.
+ * Only supported on Linux; elsewhere the peak covers the whole run so far.
+ */
+void resetPeakMemory() {
+#if defined(Q_OS_LINUX)
+  QFile clearRefs("/proc/self/clear_refs");
+  if (clearRefs.open(QIODevice::WriteOnly)) {
+    clearRefs.write("5", 1);
+    clearRefs.close();
+  }
+#endif
+}
+
+/**
+ * @brief peakMemory Gives the peak resident memory of the process.
+ * @return The peak resident memory in bytes, see resetPeakMemory.
+ */
+qint64 peakMemory() {
+#if defined(Q_OS_WIN)
+  PROCESS_MEMORY_COUNTERS counters;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+    return qint64(counters.PeakWorkingSetSize);
+  }
+  return 0;
+#else
+#if defined(Q_OS_LINUX)
+  // Unlike getrusage, VmHWM follows resetPeakMemory
+  QFile status("/proc/self/status");
+  if (status.open(QIODevice::ReadOnly)) {
+    const QList<QByteArray> lines = status.readAll().split('\n');
+    for (const QByteArray& line : lines) {
+      if (line.startsWith("VmHWM:")) {
+        return line.mid(6).trimmed().split(' ').first().toLongLong() * 1024;
+      }
+    }
+  }
+#endif
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#if defined(Q_OS_MACOS)
+  return qint64(usage.ru_maxrss);
+#else
+  return qint64(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+/**
+ * @brief stepResult Gives the result of a step, appending it on the first
+ * repetition.
+ * @param results All results so far.
+ * @param index Index of the step in the results.
+ * @return The result of the step.
+ */
+StepResult& stepResult(QVector<StepResult>& results, int index) {
+  if (index == results.size()) {
+    results.append(StepResult());
+  }
+  return results[index];
+}
+
+/**
+ * @brief recordStep Records one repetition of a step.
+ * @param result The result of the step.
+ * @param model Name of the model.
+ * @param step Name of the step.
+ * @param level Subdivision level produced by the step.
+ * @param mesh The mesh produced by the step.
+ * @param time Wall time of the step in nanoseconds.
+ */
+void recordStep(StepResult& result, const QString& model, const QString& step,
+                int level, Mesh& mesh, qint64 time) {
+  result.model = model;
+  result.step = step;
+  result.level = level;
+  result.faces = mesh.numFaces();
+  result.vertices = mesh.numVerts();
+  result.times.append(time);
+  result.peakMemory = qMax(result.peakMemory, peakMemory());
+}
+
+/**
+ * @brief benchmarkModel Loads a model, constructs its half-edge mesh and
+ * subdivides it, timing every step. The crease presets of the bundled models
+ * are applied before subdividing, outside of the timed steps.
+ * @param path Path of the .obj file.
+ * @param model Name of the model in the results.
+ * @param levels Number of subdivision steps.
+ * @param repeats Number of times the whole pipeline is run.
+ * @param pool If not nullptr, the levels are written into meshes from this
+ * pool and returned to it, so later repetitions reuse the storage of earlier
+ * ones. Otherwise, every level is allocated anew.
+ * @param reorder Whether the constructed mesh is reordered for locality with
+ * MeshReorderer, timed as the reorder step.
+ * @param streamDir If not empty, the control mesh is additionally subdivided
+ * to the last level by StreamingSubdivider and written to this directory,
+ * timed as the stream step.
+ * @param results The results, to which the steps of this model are appended.
+ * @return False if the model could not be loaded.
+ */
+bool benchmarkModel(const QString& path, const QString& model, int levels,
+                    int repeats, MeshPool* pool, bool reorder,
+                    const QString& streamDir, QVector<StepResult>& results) {
+  const int first = results.size();
+  CatmullClarkSubdivider subdivider;
+  StreamingSubdivider streamingSubdivider(levels);
+  for (int r = 0; r < repeats; r++) {
+    QElapsedTimer timer;
+    resetPeakMemory();
+    timer.start();
+    OBJFile objFile(path);
+    const qint64 loadTime = timer.nsecsElapsed();
+    if (!objFile.loadedSuccessfully()) {
+      qWarning() << ":: Could not load" << path;
+      results.resize(first);
+      return false;
+    }
+    const qint64 loadPeak = peakMemory();
+
+    resetPeakMemory();
+    timer.restart();
+    MeshInitializer meshInitializer;
+    Mesh* mesh = new Mesh(meshInitializer.constructHalfEdgeMesh(objFile));
+    const qint64 constructTime = timer.nsecsElapsed();
+    // The load step is reported with the counts of the constructed mesh
+    StepResult& load = stepResult(results, first);
+    recordStep(load, model, "load", 0, *mesh, loadTime);
+    load.peakMemory = qMax(load.peakMemory, loadPeak);
+    recordStep(stepResult(results, first + 1), model, "construct", 0, *mesh,
+               constructTime);
+    applyCreasePreset(path, *mesh);
+
+    int next = first + 2;
+    if (reorder) {
+      resetPeakMemory();
+      timer.restart();
+      MeshReorderer().reorder(*mesh);
+      recordStep(stepResult(results, next++), model, "reorder", 0, *mesh,
+                 timer.nsecsElapsed());
+    }
+    if (!streamDir.isEmpty()) {
+      MeshStreamWriter writer(QDir(streamDir).filePath(
+          QFileInfo(path).completeBaseName() + ".cmstream"));
+      resetPeakMemory();
+      timer.restart();
+      const bool streamed =
+          streamingSubdivider.subdivide(*mesh, writer, false);
+      const qint64 streamTime = timer.nsecsElapsed();
+      if (!streamed) {
+        qWarning() << ":: Could not stream" << path << "to" << streamDir;
+        delete mesh;
+        results.resize(first);
+        return false;
+      }
+      StepResult& stream = stepResult(results, next++);
+      recordStep(stream, model, "stream", streamingSubdivider.getLevel(),
+                 *mesh, streamTime);
+      stream.faces = writer.numFacesWritten();
+      stream.vertices = writer.numVertsWritten();
+    }
+
+    for (int k = 1; k <= levels; k++) {
+      resetPeakMemory();
+      timer.restart();
+      Mesh* subdivided;
+      if (pool != nullptr) {
+        subdivided = pool->acquire(MeshPool::Sizes::of(*mesh).subdivided());
+        subdivider.subdivide(*mesh, *subdivided);
+      } else {
+        subdivided = new Mesh(subdivider.subdivide(*mesh));
+      }
+      const qint64 subdivideTime = timer.nsecsElapsed();
+      if (pool != nullptr) {
+        pool->release(mesh);
+      } else {
+        delete mesh;
+      }
+      mesh = subdivided;
+      recordStep(stepResult(results, next++), model, "subdivide", k, *mesh,
+                 subdivideTime);
+    }
+    if (pool != nullptr) {
+      pool->release(mesh);
+    } else {
+      delete mesh;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief indexIn Gives the index of an element of a mesh array.
+ * @param element Pointer to the element, or nullptr.
+ * @param array The array the element should be part of.
+ * @return The index, -1 for nullptr or -2 if the pointer is outside the array.
+ */
+template <typename T>
+int indexIn(const T* element, const QVector<T>& array) {
+  if (element == nullptr) {
+    return -1;
+  }
+  const quintptr offset = quintptr(element) - quintptr(array.constData());
+  if (offset >= quintptr(array.size()) * sizeof(T)) {
+    return -2;
+  }
+  return int(offset / sizeof(T));
+}
+
+/**
+ * @brief sameBits Checks whether two arrays of floats are bit-identical, so
+ * unlike operator== it tells 0 and -0 apart and accepts equal NaNs.
+ * @param a The first array.
+ * @param b The second array.
+ * @return True if both arrays hold the same bits.
+ */
+template <typename T>
+bool sameBits(const QVector<T>& a, const QVector<T>& b) {
+  return a.size() == b.size() &&
+         memcmp(a.constData(), b.constData(), a.size() * sizeof(T)) == 0;
+}
+
+/**
+ * @brief sameBits Checks whether two points are bit-identical.
+ * @param a The first point.
+ * @param b The second point.
+ * @return True if the coordinates hold the same bits.
+ */
+bool sameBits(const QVector3D& a, const QVector3D& b) {
+  const float x[3] = {a.x(), a.y(), a.z()};
+  const float y[3] = {b.x(), b.y(), b.z()};
+  return memcmp(x, y, sizeof(x)) == 0;
+}
+
+/**
+ * @brief meshDifference Compares two half-edge meshes: the element counts, the
+ * links of every element as indices, the sharpness of the half-edges, the bits
+ * of the vertex positions and the vertex classification.
+ * @param expected The expected mesh.
+ * @param actual The mesh to check.
+ * @return A description of the first difference, or an empty string if the
+ * meshes are identical.
+ */
+QString meshDifference(Mesh& expected, Mesh& actual) {
+  if (expected.numVerts() != actual.numVerts() ||
+      expected.numHalfEdges() != actual.numHalfEdges() ||
+      expected.numFaces() != actual.numFaces() ||
+      expected.numEdges() != actual.numEdges()) {
+    return "element counts";
+  }
+  if (expected.isQuadMesh() != actual.isQuadMesh() ||
+      expected.isClassified() != actual.isClassified()) {
+    return "mesh flags";
+  }
+  const QVector<Vertex>& expectedVerts = expected.getVertices();
+  const QVector<Vertex>& actualVerts = actual.getVertices();
+  const QVector<HalfEdge>& expectedEdges = expected.getHalfEdges();
+  const QVector<HalfEdge>& actualEdges = actual.getHalfEdges();
+  const QVector<Face>& expectedFaces = expected.getFaces();
+  const QVector<Face>& actualFaces = actual.getFaces();
+
+  for (int v = 0; v < expectedVerts.size(); v++) {
+    const Vertex& a = expectedVerts[v];
+    const Vertex& b = actualVerts[v];
+    if (!sameBits(a.coords, b.coords)) {
+      return QString("position of vertex %1").arg(v);
+    }
+    if (b.index != v || a.valence != b.valence ||
+        indexIn(a.out, expectedEdges) != indexIn(b.out, actualEdges)) {
+      return QString("links of vertex %1").arg(v);
+    }
+    if (expected.isClassified() &&
+        (expected.vertexRule(v) != actual.vertexRule(v) ||
+         expected.numCreaseEdges(v) != actual.numCreaseEdges(v) ||
+         expected.creaseHalfEdge(v, 0) != actual.creaseHalfEdge(v, 0) ||
+         expected.creaseHalfEdge(v, 1) != actual.creaseHalfEdge(v, 1) ||
+         expected.creaseBlend(v) != actual.creaseBlend(v))) {
+      return QString("classification of vertex %1").arg(v);
+    }
+  }
+  for (int h = 0; h < expectedEdges.size(); h++) {
+    const HalfEdge& a = expectedEdges[h];
+    const HalfEdge& b = actualEdges[h];
+    if (b.index != h ||
+        indexIn(a.origin, expectedVerts) != indexIn(b.origin, actualVerts) ||
+        indexIn(a.next, expectedEdges) != indexIn(b.next, actualEdges) ||
+        indexIn(a.prev, expectedEdges) != indexIn(b.prev, actualEdges) ||
+        indexIn(a.twin, expectedEdges) != indexIn(b.twin, actualEdges) ||
+        indexIn(a.face, expectedFaces) != indexIn(b.face, actualFaces) ||
+        a.edgeIndex != b.edgeIndex) {
+      return QString("links of half-edge %1").arg(h);
+    }
+    if (memcmp(&a.sharpness, &b.sharpness, sizeof(float)) != 0) {
+      return QString("sharpness of half-edge %1").arg(h);
+    }
+  }
+  for (int f = 0; f < expectedFaces.size(); f++) {
+    const Face& a = expectedFaces[f];
+    const Face& b = actualFaces[f];
+    if (b.index != f || a.valence != b.valence ||
+        indexIn(a.side, expectedEdges) != indexIn(b.side, actualEdges)) {
+      return QString("links of face %1").arg(f);
+    }
+  }
+  return QString();
+}
+
+/**
+ * @brief compactDifference Compares two compact meshes: all index arrays and
+ * the bits of the positions and sharpnesses.
+ * @param expected The expected mesh.
+ * @param actual The mesh to check.
+ * @return A description of the first difference, or an empty string if the
+ * meshes are identical.
+ */
+QString compactDifference(CompactMesh& expected, CompactMesh& actual) {
+  if (expected.numFaces() != actual.numFaces() ||
+      expected.getOrigins() != actual.getOrigins() ||
+      expected.getTwins() != actual.getTwins() ||
+      expected.getEdges() != actual.getEdges() ||
+      expected.getFaceOffsets() != actual.getFaceOffsets() ||
+      expected.getHalfEdgeFaces() != actual.getHalfEdgeFaces() ||
+      expected.getVertexOut() != actual.getVertexOut()) {
+    return "topology";
+  }
+  if (!sameBits(expected.getPosX(), actual.getPosX()) ||
+      !sameBits(expected.getPosY(), actual.getPosY()) ||
+      !sameBits(expected.getPosZ(), actual.getPosZ())) {
+    return "positions";
+  }
+  if (!sameBits(expected.getSharpness(), actual.getSharpness())) {
+    return "sharpness";
+  }
+  return QString();
+}
+
+/**
+ * @brief subdivideLadder Subdivides a mesh step by step.
+ * @param mesh The control mesh, which is not part of the ladder.
+ * @param subdivider The subdivider.
+ * @param levels Number of subdivision steps.
+ * @param pool If not nullptr, the levels are written into meshes from this
+ * pool. Otherwise, every level is allocated anew.
+ * @return Levels 1 to levels. The caller takes ownership of them, see
+ * releaseLadder.
+ */
+QVector<Mesh*> subdivideLadder(Mesh& mesh,
+                               const CatmullClarkSubdivider& subdivider,
+                               int levels, MeshPool* pool) {
+  QVector<Mesh*> ladder;
+  Mesh* parent = &mesh;
+  for (int k = 1; k <= levels; k++) {
+    Mesh* subdivided;
+    if (pool != nullptr) {
+      subdivided = pool->acquire(MeshPool::Sizes::of(*parent).subdivided());
+      subdivider.subdivide(*parent, *subdivided);
+    } else {
+      subdivided = new Mesh(subdivider.subdivide(*parent));
+    }
+    ladder.append(subdivided);
+    parent = subdivided;
+  }
+  return ladder;
+}
+
+/**
+ * @brief releaseLadder Disposes of the levels made by subdivideLadder.
+ * @param ladder The levels.
+ * @param pool The pool they are returned to, or nullptr to delete them.
+ */
+void releaseLadder(QVector<Mesh*>& ladder, MeshPool* pool) {
+  for (Mesh* mesh : ladder) {
+    if (pool != nullptr) {
+      pool->release(mesh);
+    } else {
+      delete mesh;
+    }
+  }
+  ladder.clear();
+}
+
+/**
+ * @brief ladderStorage Gives the storage of a ladder of levels: the address of
+ * the vertex, half-edge and face arrays and the allocated size of every level.
+ * If a ladder is produced again with the same storage, nothing was
+ * reallocated or grown.
+ * @param ladder The levels.
+ * @return The addresses and sizes.
+ */
+QVector<qint64> ladderStorage(const QVector<Mesh*>& ladder) {
+  QVector<qint64> storage;
+  for (Mesh* mesh : ladder) {
+    storage.append(qint64(quintptr(mesh->getVertices().constData())));
+    storage.append(qint64(quintptr(mesh->getHalfEdges().constData())));
+    storage.append(qint64(quintptr(mesh->getFaces().constData())));
+    storage.append(mesh->capacityFootprint());
+  }
+  return storage;
+}
+
+/**
+ * @brief reportDifference Warns about a difference between two versions of a
+ * level.
+ * @param difference The difference, see meshDifference and compactDifference.
+ * @param model Name of the model.
+ * @param level The subdivision level.
+ * @param versions The versions that were compared.
+ * @return True if there is no difference.
+ */
+bool reportDifference(const QString& difference, const QString& model,
+                      int level, const QString& versions) {
+  if (difference.isEmpty()) {
+    return true;
+  }
+  qWarning() << ":: Level" << level << "of" << model << "differs between"
+             << qPrintable(versions) << "in" << qPrintable(difference);
+  return false;
+}
+
+/**
+ * @brief verifyModel Checks that the optimized subdivision paths give the same
+ * results as the reference ones on a model, after applying its crease preset:
+ * - The PARALLEL refinement, which takes the quad path from level 2 on, gives
+ *   the same topology and bit-identical positions as REFERENCE at every level.
+ * - Levels written into pooled storage are identical to fresh ones. The pool
+ *   is shared by all models, so the storage may come from another model.
+ *   After a warm-up ladder, subdividing again reuses the same storage for
+ *   every level without growing it, and the pool does not grow either.
+ * - Every SIMD level of CompactCatmullClarkSubdivider that is supported
+ *   gives bit-identical results to the scalar kernels.
+ * @param path Path of the .obj file.
+ * @param model Name of the model in the messages.
+ * @param levels Number of subdivision steps.
+ * @param pool The pool for the pooled ladders.
+ * @return False if the model could not be loaded or any check failed.
+ */
+bool verifyModel(const QString& path, const QString& model, int levels,
+                 MeshPool& pool) {
+  OBJFile objFile(path);
+  if (!objFile.loadedSuccessfully()) {
+    qWarning() << ":: Could not load" << path;
+    return false;
+  }
+  MeshInitializer meshInitializer;
+  Mesh mesh = meshInitializer.constructHalfEdgeMesh(objFile);
+  applyCreasePreset(path, mesh);
+
+  bool success = true;
+
+  CatmullClarkSubdivider reference(CatmullClarkSubdivider::REFERENCE);
+  CatmullClarkSubdivider parallel(CatmullClarkSubdivider::PARALLEL);
+  QVector<Mesh*> expected = subdivideLadder(mesh, reference, levels, nullptr);
+  QVector<Mesh*> ladder = subdivideLadder(mesh, parallel, levels, nullptr);
+  for (int k = 0; k < levels; k++) {
+    success &= reportDifference(meshDifference(*expected[k], *ladder[k]),
+                                model, k + 1, "REFERENCE and PARALLEL");
+  }
+  releaseLadder(ladder, nullptr);
+
+  QVector<qint64> storage;
+  qint64 pooled = 0;
+  for (int r = 0; r < VERIFY_POOL_LADDERS; r++) {
+    ladder = subdivideLadder(mesh, parallel, levels, &pool);
+    for (int k = 0; k < levels; k++) {
+      success &= reportDifference(meshDifference(*expected[k], *ladder[k]),
+                                  model, k + 1, "fresh and pooled");
+    }
+    // The first ladder may still allocate, the second settles the storage
+    if (r > 1 && (ladderStorage(ladder) != storage ||
+                  pool.memoryFootprint() != pooled)) {
+      qWarning() << ":: Pooled storage of" << model << "changed on ladder"
+                 << r + 1;
+      success = false;
+    }
+    storage = ladderStorage(ladder);
+    pooled = pool.memoryFootprint();
+    releaseLadder(ladder, &pool);
+  }
+  releaseLadder(expected, nullptr);
+
+  const SimdLevel active = simdLevel();
+  const CompactCatmullClarkSubdivider compactSubdivider;
+  QVector<CompactMesh> scalar;
+  for (int l = SIMD_SCALAR; l <= SIMD_AVX2; l++) {
+    if (!setSimdLevel(SimdLevel(l))) {
+      continue;
+    }
+    CompactMesh compact = CompactMesh::fromMesh(mesh);
+    for (int k = 0; k < levels; k++) {
+      compact = compactSubdivider.subdivide(compact);
+      if (l == SIMD_SCALAR) {
+        scalar.append(compact);
+      } else {
+        success &= reportDifference(
+            compactDifference(scalar[k], compact), model, k + 1,
+            QString("scalar and ") + simdLevelName(SimdLevel(l)));
+      }
+    }
+  }
+  setSimdLevel(active);
+
+  if (success) {
+    qDebug() << ":: Verified" << model;
+  }
+  return success;
+}
+
+/**
+ * @brief jsonString Quotes and escapes a string for a JSON document. Control
+ * characters, which may come from file names, are escaped as well, since JSON
+ * does not allow them in a string literal.
+ * @param string The string.
+ * @return The JSON string literal.
+ */
+QString jsonString(const QString& string) {
+  QString quoted = "\"";
+  for (QChar c : string) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+      quoted += c;
+    } else if (c == '\n') {
+      quoted += "\\n";
+    } else if (c == '\t') {
+      quoted += "\\t";
+    } else if (c == '\r') {
+      quoted += "\\r";
+    } else if (c.unicode() < 0x20) {
+      quoted += QString("\\u%1").arg(int(c.unicode()), 4, 16, QChar('0'));
+    } else {
+      quoted += c;
+    }
+  }
+  return quoted + "\"";
+}
+
+/**
+ * @brief writeResults Writes the results as a JSON document. Per step, the
+ * minimum and median wall time over the repetitions are given; the throughput
+ * is the number of faces produced by the step per second of the minimum time.
+ * @param out The stream to write to.
+ * @param results The results.
+ * @param levels Number of subdivision steps.
+ * @param repeats Number of repetitions.
+ * @param reuse Whether the levels reused pooled storage.
+ * @param reorder Whether the meshes were reordered for locality.
+ */
+void writeResults(QTextStream& out, const QVector<StepResult>& results,
+                  int levels, int repeats, bool reuse, bool reorder) {
+  int threads = 1;
+#ifdef _OPENMP
+  threads = omp_get_max_threads();
+#endif
+  out << "{\n";
+  out << "  \"benchmark\": \"CatMarkBench\",\n";
+  out << "  \"threads\": " << threads << ",\n";
+  out << "  \"simd\": " << jsonString(simdLevelName(simdLevel())) << ",\n";
+  out << "  \"levels\": " << levels << ",\n";
+  out << "  \"repeats\": " << repeats << ",\n";
+  out << "  \"reuse\": " << (reuse ? "true" : "false") << ",\n";
+  out << "  \"reorder\": " << (reorder ? "true" : "false") << ",\n";
+  out << "  \"results\": [";
+  for (int i = 0; i < results.size(); i++) {
+    const StepResult& result = results[i];
+    QVector<qint64> times = result.times;
+    std::sort(times.begin(), times.end());
+    const qint64 minimum = times.first();
+    const qint64 median = times[times.size() / 2];
+    const double facesPerSecond =
+        minimum > 0 ? result.faces / (minimum / 1e9) : 0.0;
+    out << (i == 0 ? "\n" : ",\n");
+    out << "    {\"model\": " << jsonString(result.model)
+        << ", \"step\": " << jsonString(result.step)
+        << ", \"level\": " << result.level << ", \"faces\": " << result.faces
+        << ", \"vertices\": " << result.vertices
+        << ", \"min_ms\": " << QString::number(minimum / 1e6, 'f', 3)
+        << ", \"median_ms\": " << QString::number(median / 1e6, 'f', 3)
+        << ", \"faces_per_second\": "
+        << QString::number(facesPerSecond, 'f', 0)
+        << ", \"peak_memory_bytes\": " << result.peakMemory << "}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+/**
+ * @brief printUsage Prints the command line options.
+ * @param program Name of the executable.
+ */
+void printUsage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [options] [model...]\n"
+          "Loads, constructs and subdivides every .obj file in the model\n"
+          "directory, or only the given models, and writes the timings as\n"
+          "JSON.\n\n"
+          "  --models <dir>    Model directory (default %s)\n"
+          "  --levels <n>      Subdivision steps (default %d)\n"
+          "  --repeats <n>     Repetitions per model (default %d)\n"
+          "  --output <file>   Output file (default standard output)\n"
+          "  --simd <level>    Point kernels: scalar, sse2, neon or avx2\n"
+          "                    (default the widest supported)\n"
+          "  --reuse           Write the levels into the storage of earlier\n"
+          "                    repetitions instead of allocating them\n"
+          "  --reorder         Reorder the constructed meshes for locality\n"
+          "  --stream <dir>    Also subdivide to the last level in batches,\n"
+          "                    writing the result to <dir>\n"
+          "  --verify          Instead of timing, check that the PARALLEL,\n"
+          "                    pooled and SIMD paths give the same levels\n"
+          "                    as the reference paths\n",
+          program, CATMARK_MODELS_DIR, DEFAULT_LEVELS, DEFAULT_REPEATS);
+}
+
+}  // namespace
+
+/**
+ * @brief main Runs the benchmark. See printUsage for the options.
+ * @param argc Argument count.
+ * @param argv Arguments.
+ * @return Exit code.
+ */
+int main(int argc, char* argv[]) {
+  QString modelDir = CATMARK_MODELS_DIR;
+  QString outputFile;
+  int levels = DEFAULT_LEVELS;
+  int repeats = DEFAULT_REPEATS;
+  bool reuse = false;
+  bool reorder = false;
+  QString streamDir;
+  bool verify = false;
+  QStringList models;
+  for (int i = 1; i < argc; i++) {
+    const bool hasValue = i + 1 < argc;
+    if (strcmp(argv[i], "--models") == 0 && hasValue) {
+      modelDir = argv[++i];
+    } else if (strcmp(argv[i], "--levels") == 0 && hasValue) {
+      levels = qMax(0, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--repeats") == 0 && hasValue) {
+      repeats = qMax(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--output") == 0 && hasValue) {
+      outputFile = argv[++i];
+    } else if (strcmp(argv[i], "--simd") == 0 && hasValue) {
+      SimdLevel level;
+      if (!parseSimdLevel(argv[++i], level) || !setSimdLevel(level)) {
+        qWarning() << ":: SIMD level" << argv[i] << "is not supported";
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--reuse") == 0) {
+      reuse = true;
+    } else if (strcmp(argv[i], "--reorder") == 0) {
+      reorder = true;
+    } else if (strcmp(argv[i], "--stream") == 0 && hasValue) {
+      streamDir = argv[++i];
+    } else if (strcmp(argv[i], "--verify") == 0) {
+      verify = true;
+    } else if (argv[i][0] == '-') {
+      printUsage(argv[0]);
+      return strcmp(argv[i], "--help") == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    } else {
+      models.append(QString(argv[i]) + ".obj");
+    }
+  }
+
+  QDir dir(modelDir);
+  if (models.isEmpty()) {
+    models = dir.entryList(QStringList() << "*.obj", QDir::Files, QDir::Name);
+  }
+  if (models.isEmpty()) {
+    qWarning() << ":: No models found in" << modelDir;
+    return EXIT_FAILURE;
+  }
+
+  QVector<StepResult> results;
+  bool success = true;
+  MeshPool pool;
+  if (verify) {
+    for (const QString& model : models) {
+      success &= verifyModel(dir.filePath(model), model, levels, pool);
+    }
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  for (const QString& model : models) {
+    qDebug() << ":: Benchmarking" << model;
+    success &= benchmarkModel(dir.filePath(model), model, levels, repeats,
+                              reuse ? &pool : nullptr, reorder, streamDir,
+                              results);
+  }
+
+  QString text;
+  QTextStream out(&text);
+  writeResults(out, results, levels, repeats, reuse, reorder);
+  out.flush();
+  if (outputFile.isEmpty()) {
+    fputs(text.toUtf8().constData(), stdout);
+  } else {
+    QFile file(outputFile);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+      qWarning() << ":: Could not write" << outputFile;
+      return EXIT_FAILURE;
+    }
+    file.write(text.toUtf8());
+    file.close();
+  }
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,121 @@
+#include "creasefile.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+
+/**
+ * @brief CreaseFile::CreaseFile Reads the crease edges from a sidecar file. A
+ * file with a malformed line is rejected as a whole.
+ * @param fileName Path of the sidecar file.
+ */
+CreaseFile::CreaseFile(const QString& fileName) : loadSuccess(false) {
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return;
+  }
+  const QList<QByteArray> lines = file.readAll().split('\n');
+  file.close();
+
+  for (int l = 0; l < lines.size(); l++) {
+    const QByteArray line = lines[l].simplified();
+    if (line.isEmpty() || line.startsWith('#')) {
+      continue;
+    }
+    const QList<QByteArray> fields = line.split(' ');
+    bool valid = fields.size() == 4 && fields[0] == "e";
+    Crease crease;
+    if (valid) {
+      bool ok1, ok2, ok3 = true;
+      crease.vertex1 = fields[1].toInt(&ok1) - 1;
+      crease.vertex2 = fields[2].toInt(&ok2) - 1;
+      if (fields[3] == "inf") {
+        crease.sharpness = -1.0f;
+      } else {
+        crease.sharpness = fields[3].toFloat(&ok3);
+      }
+      valid = ok1 && ok2 && ok3 && crease.vertex1 >= 0 &&
+              crease.vertex2 >= 0 && crease.vertex1 != crease.vertex2 &&
+              (crease.sharpness >= 0.0f || crease.sharpness == -1.0f);
+    }
+    if (!valid) {
+      qWarning() << ":: Malformed crease in" << fileName << "on line"
+                 << l + 1;
+      creases.clear();
+      return;
+    }
+    creases.append(crease);
+  }
+  loadSuccess = true;
+}
+
+/**
+ * @brief CreaseFile::sidecarFileName Gives the path of the sidecar file of a
+ * model: the same path with the extension .crease.
+ * @param objFileName Path of the .obj file.
+ * @return Path of the sidecar file, which need not exist.
+ */
+QString CreaseFile::sidecarFileName(const QString& objFileName) {
+  QFileInfo info(objFileName);
+  return info.path() + "/" + info.completeBaseName() + ".crease";
+}
+
+/**
+ * @brief CreaseFile::loadedSuccessfully Whether the file was read without
+ * errors.
+ * @return True if the file was read.
+ */
+bool CreaseFile::loadedSuccessfully() const { return loadSuccess; }
+
+/**
+ * @brief CreaseFile::apply Sets the sharpness of the crease edges on a mesh
+ * constructed from the .obj file, in one sweep over its half-edges. The
+ * vertex classification is discarded.
+ * @param mesh The control mesh, with the vertex indices of the .obj file.
+ * @return Number of creases that were found in the mesh. The others are
+ * reported and skipped.
+ */
+int CreaseFile::apply(Mesh& mesh) const {
+  // The last crease of every edge, by its vertices in increasing order
+  QHash<QPair<int, int>, int> edgeCreases;
+  edgeCreases.reserve(creases.size());
+  for (int c = 0; c < creases.size(); c++) {
+    const Crease& crease = creases[c];
+    edgeCreases.insert(qMakePair(qMin(crease.vertex1, crease.vertex2),
+                                 qMax(crease.vertex1, crease.vertex2)),
+                       c);
+  }
+
+  QVector<bool> found(creases.size(), false);
+  QVector<HalfEdge>& halfEdges = mesh.getHalfEdges();
+  for (HalfEdge& edge : halfEdges) {
+    const int origin = edge.origin->index;
+    const int target = edge.next->origin->index;
+    const int c = edgeCreases.value(
+        qMakePair(qMin(origin, target), qMax(origin, target)), -1);
+    if (c >= 0) {
+      edge.sharpness = creases[c].sharpness;
+      found[c] = true;
+    }
+  }
+  mesh.clearClassification();
+
+  int numApplied = 0;
+  for (int c = 0; c < creases.size(); c++) {
+    const Crease& crease = creases[c];
+    const int last = edgeCreases.value(
+        qMakePair(qMin(crease.vertex1, crease.vertex2),
+                  qMax(crease.vertex1, crease.vertex2)));
+    if (last != c) {
+      continue;
+    }
+    if (found[c]) {
+      numApplied++;
+    } else {
+      qWarning() << ":: No edge between vertices" << crease.vertex1 + 1
+                 << "and" << crease.vertex2 + 1;
+    }
+  }
+  return numApplied;
+}
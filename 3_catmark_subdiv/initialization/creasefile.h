@@ -0,0 +1,48 @@
+#ifndef CREASE_FILE_H
+#define CREASE_FILE_H
+
+#include <QString>
+#include <QVector>
+
+#include "mesh/mesh.h"
+
+/**
+ * @brief The CreaseFile class reads the crease edges of a model from a sidecar
+ * file next to its .obj file, so sharpness can be authored per asset instead
+ * of by the hard-coded presets. The sidecar of model.obj is model.crease.
+ *
+ * Every line is empty, a comment starting with #, or a crease
+ *
+ *   e <vertex> <vertex> <sharpness>
+ *
+ * with the 1-based vertex indices of the .obj file, as in its face lines. The
+ * sharpness is a non-negative number or inf (or -1) for an infinitely sharp
+ * edge. A later line for the same edge overrides an earlier one.
+ */
+class CreaseFile {
+ public:
+  CreaseFile(const QString& fileName);
+
+  static QString sidecarFileName(const QString& objFileName);
+
+  bool loadedSuccessfully() const;
+  int apply(Mesh& mesh) const;
+
+  inline int numCreases() const { return creases.size(); }
+
+ private:
+  /**
+   * @brief The Crease struct is one edge line of the file, with 0-based
+   * vertex indices.
+   */
+  struct Crease {
+    int vertex1;
+    int vertex2;
+    float sharpness;
+  };
+
+  QVector<Crease> creases;
+  bool loadSuccess;
+};
+
+#endif  // CREASE_FILE_H
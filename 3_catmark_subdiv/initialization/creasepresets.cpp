@@ -0,0 +1,91 @@
+#include "creasepresets.h"
+
+/**
+ * @brief applyCreasePreset Sets the crease edges of the bundled models that
+ * demonstrate the crease rules. The model is recognized by its file name.
+ * @param fileName Path of the .obj file the mesh was loaded from.
+ * @param mesh The control mesh to set crease edges on.
+ * @return True if the file name matched a preset.
+ */
+bool applyCreasePreset(const QString& fileName, Mesh& mesh) {
+  if (fileName.contains("CreaseCube", Qt::CaseInsensitive)) {
+    setupCreaseCube(mesh);
+  } else if (fileName.contains("CreaseSquare", Qt::CaseInsensitive)) {
+    setupCreaseSquare(mesh);
+  } else if (fileName.contains("CreaseOctahedron", Qt::CaseInsensitive)) {
+    setupCreaseOctahedron(mesh);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief setupCreaseCube Sets up crease edges on a cube model.
+ * Sets the top face edges (around z=0.5) as creases with different sharpness values
+ * to demonstrate semi-sharp creases. This matches the example from Figure 7 in the paper.
+ * @param mesh The cube mesh to set crease edges on.
+ */
+void setupCreaseCube(Mesh &mesh) {
+  // Cube vertex layout (0-indexed after OBJ 1-based to 0-based conversion):
+  // 0: (-0.5, -0.5, -0.5) bottom-left-back
+  // 1: (-0.5, -0.5,  0.5) bottom-left-front
+  // 2: (-0.5,  0.5, -0.5) top-left-back
+  // 3: (-0.5,  0.5,  0.5) top-left-front
+  // 4: ( 0.5, -0.5, -0.5) bottom-right-back
+  // 5: ( 0.5, -0.5,  0.5) bottom-right-front
+  // 6: ( 0.5,  0.5, -0.5) top-right-back
+  // 7: ( 0.5,  0.5,  0.5) top-right-front
+  
+  // Set top face edges as creases (edges connecting vertices 2, 3, 6, 7)
+  // Top face edges form a square: 2-3-7-6
+  // (top-left-back, top-left-front, top-right-front, top-right-back)
+  
+  // Top front edge (3-7): sharpness 2
+  float sharpness = 3.0f;
+  mesh.setCreaseEdge(3, 2, sharpness);
+  mesh.setCreaseEdge(2, 6, sharpness);
+  mesh.setCreaseEdge(6, 7, sharpness);
+  mesh.setCreaseEdge(7, 3, sharpness);
+
+  mesh.setCreaseEdge(0, 1, sharpness);
+  mesh.setCreaseEdge(1, 5, sharpness);
+  mesh.setCreaseEdge(5, 4, sharpness);
+  mesh.setCreaseEdge(4, 0, sharpness);
+
+}
+
+/**
+ * @brief setupCreaseSquare Sets up crease edges on a 2D square model
+ * for easy visualization of crease rules. The square is flat (z=0) making it easy
+ * to see the subdivision behavior.
+ * @param mesh The square mesh to set crease edges on.
+ */
+void setupCreaseSquare(Mesh &mesh) {
+  // Set top edge (2-3) as crease with sharpness 2
+  // This edge will use sharp rules for 2 subdivision steps, then become smooth
+  mesh.setCreaseEdge(1, 2, -1);
+  mesh.setCreaseEdge(2, 3, -1);
+  mesh.setCreaseEdge(3, 0, -1);
+  mesh.setCreaseEdge(0, 1, -1);
+}
+
+
+/**
+ * @brief setupCreaseOctahedron Sets up crease edges on a 3D octahedron model
+ * for visualization of crossing crease rules.
+ * @param mesh The octahedron mesh to set crease edges on.
+ */
+void setupCreaseOctahedron(Mesh &mesh) {
+    // Set top edge (2-3) as crease with sharpness 2
+    // This edge will use sharp rules for 2 subdivision steps, then become smooth
+    mesh.setCreaseEdge(1, 2, 4);
+    mesh.setCreaseEdge(3, 0, 4);
+    mesh.setCreaseEdge(3, 1, 4);
+    mesh.setCreaseEdge(2, 0, 4);
+
+    mesh.setCreaseEdge(0, 4, 2);
+    mesh.setCreaseEdge(4, 1, 2);
+    mesh.setCreaseEdge(1, 5, 2);
+    mesh.setCreaseEdge(5, 0, 2);
+}
@@ -0,0 +1,13 @@
+#ifndef CREASE_PRESETS_H
+#define CREASE_PRESETS_H
+
+#include <QString>
+
+#include "mesh/mesh.h"
+
+bool applyCreasePreset(const QString& fileName, Mesh& mesh);
+void setupCreaseCube(Mesh& mesh);
+void setupCreaseSquare(Mesh& mesh);
+void setupCreaseOctahedron(Mesh& mesh);
+
+#endif  // CREASE_PRESETS_H
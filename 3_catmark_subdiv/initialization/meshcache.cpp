@@ -0,0 +1,346 @@
+#include "meshcache.h"
+
+#include <string.h>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#define MESH_CACHE_MAGIC "CMSUBDIV"
+// Version 2: control meshes of version 1 may miss lines after empty lines of
+// the source file
+#define MESH_CACHE_VERSION 2
+#define MESH_CACHE_BYTE_ORDER 0x01020304u
+#define MESH_CACHE_KEY_SIZE 32
+
+/**
+ * @brief The MeshCacheHeader struct is the fixed-size header at the start of a
+ * cache file. It is followed by the arrays of the mesh, in the order origins,
+ * twins, edges, vertex out, x, y and z positions and edge sharpness, and for
+ * meshes that are not pure quad meshes the face offsets and half-edge faces.
+ */
+struct MeshCacheHeader {
+  char magic[8];
+  quint32 version;
+  quint32 byteOrder;
+  char key[MESH_CACHE_KEY_SIZE];
+  qint32 numVerts;
+  qint32 numHalfEdges;
+  qint32 numFaces;
+  qint32 numEdges;
+  quint32 quadMesh;
+  quint32 reserved;
+  qint64 dataSize;
+};
+
+/**
+ * @brief dataSize Calculates the number of bytes of array data following the
+ * header.
+ * @param header The header.
+ * @return The size of the array data.
+ */
+static qint64 dataSize(const MeshCacheHeader& header) {
+  qint64 halfEdgeInts = 3 * qint64(header.numHalfEdges);
+  if (!header.quadMesh) {
+    halfEdgeInts += qint64(header.numFaces) + 1 + header.numHalfEdges;
+  }
+  qint64 floats = 3 * qint64(header.numVerts) + header.numEdges;
+  return (halfEdgeInts + header.numVerts) * qint64(sizeof(int)) +
+         floats * qint64(sizeof(float));
+}
+
+/**
+ * @brief MeshCache::MeshCache Creates a mesh cache in the default directory.
+ */
+MeshCache::MeshCache()
+    : directory(defaultDirectory()), diskBudget(MESH_CACHE_DEFAULT_BUDGET) {}
+
+/**
+ * @brief MeshCache::MeshCache Creates a mesh cache in the given directory.
+ * @param directory The directory to store the cache files in. It is created
+ * when the first file is stored.
+ */
+MeshCache::MeshCache(const QString& directory)
+    : directory(directory), diskBudget(MESH_CACHE_DEFAULT_BUDGET) {}
+
+/**
+ * @brief MeshCache::defaultDirectory Gives the default cache directory, which
+ * is a subdirectory of the application cache location.
+ * @return The path of the directory.
+ */
+QString MeshCache::defaultDirectory() {
+  return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation))
+      .filePath("meshes");
+}
+
+/**
+ * @brief MeshCache::sourceKey Calculates the key of a control mesh from the
+ * contents of its source file.
+ * @param fileName Path of the source file.
+ * @return The key, or an empty array if the file could not be read.
+ */
+QByteArray MeshCache::sourceKey(const QString& fileName) {
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return QByteArray();
+  }
+  QCryptographicHash hash(QCryptographicHash::Sha256);
+  qint64 size = file.size();
+  uchar* mapped = size > 0 ? file.map(0, size) : nullptr;
+  if (mapped != nullptr) {
+    hash.addData(reinterpret_cast<const char*>(mapped), size);
+    file.unmap(mapped);
+  } else {
+    hash.addData(file.readAll());
+  }
+  file.close();
+  return hash.result();
+}
+
+/**
+ * @brief MeshCache::nextLevelKey Calculates the key of the mesh that results
+ * from subdividing the given mesh once.
+ * @param key The key of the given mesh.
+ * @param mesh The mesh, with its current sharpness values.
+ * @return The key of the subdivided mesh, or an empty array if the given key is
+ * empty.
+ */
+QByteArray MeshCache::nextLevelKey(const QByteArray& key, Mesh& mesh) {
+  if (key.isEmpty()) {
+    return QByteArray();
+  }
+  QVector<float> sharpness(mesh.numEdges(), 0.0f);
+  for (const HalfEdge& edge : mesh.getHalfEdges()) {
+    sharpness[edge.edgeIndex] = edge.sharpness;
+  }
+  QCryptographicHash hash(QCryptographicHash::Sha256);
+  hash.addData(key);
+  hash.addData(reinterpret_cast<const char*>(sharpness.constData()),
+               sharpness.size() * qsizetype(sizeof(float)));
+  return hash.result();
+}
+
+/**
+ * @brief MeshCache::variantKey Calculates the key of a mesh that was derived
+ * from the mesh of the given key without subdividing it, for instance by
+ * reordering its elements.
+ * @param key The key of the given mesh.
+ * @param variant Name of the derivation.
+ * @return The key of the derived mesh, or an empty array if the given key is
+ * empty.
+ */
+QByteArray MeshCache::variantKey(const QByteArray& key,
+                                 const QByteArray& variant) {
+  if (key.isEmpty()) {
+    return QByteArray();
+  }
+  QCryptographicHash hash(QCryptographicHash::Sha256);
+  hash.addData(key);
+  hash.addData(variant);
+  return hash.result();
+}
+
+/**
+ * @brief MeshCache::filePath Gives the path of the cache file of a key.
+ * @param key The key.
+ * @return The path of the cache file.
+ */
+QString MeshCache::filePath(const QByteArray& key) const {
+  return QDir(directory).filePath(QString::fromLatin1(key.toHex()) + ".cms");
+}
+
+/**
+ * @brief MeshCache::load Loads the mesh with the given key from the cache.
+ * @param key The key of the mesh.
+ * @param mesh The mesh to load into.
+ * @return True if a valid cache file was found; false otherwise, in which case
+ * the mesh is left untouched.
+ */
+bool MeshCache::load(const QByteArray& key, Mesh& mesh) const {
+  CompactMesh compact;
+  if (!load(key, compact)) {
+    return false;
+  }
+  compact.toMesh(mesh);
+  return true;
+}
+
+/**
+ * @brief MeshCache::load Loads the mesh with the given key from the cache. The
+ * file is memory-mapped and its header checked against the key, the format
+ * version and the file size before the arrays are copied. The arrays are then
+ * checked with CompactMesh::isConsistent, so a damaged file is a cache miss.
+ * @param key The key of the mesh.
+ * @param mesh The mesh to load into.
+ * @return True if a valid cache file was found; false otherwise.
+ */
+bool MeshCache::load(const QByteArray& key, CompactMesh& mesh) const {
+  if (key.isEmpty()) {
+    return false;
+  }
+  QFile file(filePath(key));
+  if (!file.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+  qint64 size = file.size();
+  if (size < qint64(sizeof(MeshCacheHeader))) {
+    return false;
+  }
+  const uchar* data = file.map(0, size);
+  if (data == nullptr) {
+    return false;
+  }
+
+  MeshCacheHeader header;
+  memcpy(&header, data, sizeof(header));
+  char expectedKey[MESH_CACHE_KEY_SIZE] = {};
+  memcpy(expectedKey, key.constData(),
+         qMin<qsizetype>(key.size(), MESH_CACHE_KEY_SIZE));
+  bool valid = memcmp(header.magic, MESH_CACHE_MAGIC, 8) == 0 &&
+               header.version == MESH_CACHE_VERSION &&
+               header.byteOrder == MESH_CACHE_BYTE_ORDER &&
+               memcmp(header.key, expectedKey, MESH_CACHE_KEY_SIZE) == 0 &&
+               header.numVerts >= 0 && header.numHalfEdges >= 0 &&
+               header.numFaces >= 0 && header.numEdges >= 0 &&
+               (!header.quadMesh ||
+                qint64(header.numHalfEdges) == 4 * qint64(header.numFaces)) &&
+               header.dataSize == dataSize(header) &&
+               size == qint64(sizeof(header)) + header.dataSize;
+  if (!valid) {
+    qWarning() << ":: Ignoring invalid cache file" << file.fileName();
+    file.unmap(const_cast<uchar*>(data));
+    return false;
+  }
+
+  mesh.resize(header.numVerts, header.numHalfEdges, header.numFaces,
+              header.numEdges, header.quadMesh != 0);
+  const uchar* p = data + sizeof(header);
+  auto read = [&p](auto& array) {
+    qsizetype bytes = array.size() * qsizetype(sizeof(array[0]));
+    memcpy(array.data(), p, bytes);
+    p += bytes;
+  };
+  read(mesh.origins);
+  read(mesh.twins);
+  read(mesh.edges);
+  read(mesh.vertexOut);
+  read(mesh.posX);
+  read(mesh.posY);
+  read(mesh.posZ);
+  read(mesh.sharpness);
+  if (!header.quadMesh) {
+    read(mesh.faceOffsets);
+    read(mesh.halfEdgeFaces);
+  }
+  file.unmap(const_cast<uchar*>(data));
+  if (!mesh.isConsistent()) {
+    qWarning() << ":: Ignoring invalid cache file" << file.fileName();
+    mesh = CompactMesh();
+    return false;
+  }
+  // The modification time orders the files for trim
+  file.setFileTime(QDateTime::currentDateTime(),
+                   QFileDevice::FileModificationTime);
+  qDebug() << ":: Loaded" << file.fileName() << "from the mesh cache";
+  return true;
+}
+
+/**
+ * @brief MeshCache::store Stores a mesh in the cache.
+ * @param key The key of the mesh.
+ * @param mesh The mesh to store.
+ * @return True if the file was written successfully; false otherwise.
+ */
+bool MeshCache::store(const QByteArray& key, Mesh& mesh) const {
+  return store(key, CompactMesh::fromMesh(mesh));
+}
+
+/**
+ * @brief MeshCache::store Stores a mesh in the cache. The file is written to a
+ * temporary file first, so an interrupted write never leaves a truncated cache
+ * file behind. Afterwards the cache is trimmed to the disk budget.
+ * @param key The key of the mesh.
+ * @param mesh The mesh to store.
+ * @return True if the file was written successfully; false otherwise.
+ */
+bool MeshCache::store(const QByteArray& key, const CompactMesh& mesh) const {
+  if (key.isEmpty() || !QDir().mkpath(directory)) {
+    return false;
+  }
+  MeshCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MESH_CACHE_MAGIC, 8);
+  header.version = MESH_CACHE_VERSION;
+  header.byteOrder = MESH_CACHE_BYTE_ORDER;
+  memcpy(header.key, key.constData(),
+         qMin<qsizetype>(key.size(), MESH_CACHE_KEY_SIZE));
+  header.numVerts = mesh.numVerts();
+  header.numHalfEdges = mesh.numHalfEdges();
+  header.numFaces = mesh.numFaces();
+  header.numEdges = mesh.numEdges();
+  header.quadMesh = mesh.isQuadMesh() ? 1 : 0;
+  header.dataSize = dataSize(header);
+
+  QSaveFile file(filePath(key));
+  if (!file.open(QIODevice::WriteOnly)) {
+    return false;
+  }
+  bool ok = file.write(reinterpret_cast<const char*>(&header),
+                       sizeof(header)) == qint64(sizeof(header));
+  auto write = [&file, &ok](const auto& array) {
+    qint64 bytes = qint64(array.size()) * qint64(sizeof(array[0]));
+    ok = ok && file.write(reinterpret_cast<const char*>(array.constData()),
+                          bytes) == bytes;
+  };
+  write(mesh.origins);
+  write(mesh.twins);
+  write(mesh.edges);
+  write(mesh.vertexOut);
+  write(mesh.posX);
+  write(mesh.posY);
+  write(mesh.posZ);
+  write(mesh.sharpness);
+  if (!mesh.isQuadMesh()) {
+    write(mesh.faceOffsets);
+    write(mesh.halfEdgeFaces);
+  }
+  if (!ok || !file.commit()) {
+    return false;
+  }
+  trim(filePath(key));
+  return true;
+}
+
+/**
+ * @brief MeshCache::trim Removes the least recently used cache files until the
+ * total size of the cache files is within the disk budget.
+ * @param keep Path of a file that is never removed, such as the file that was
+ * just stored.
+ */
+void MeshCache::trim(const QString& keep) const {
+  // Least recently used first
+  const QFileInfoList files =
+      QDir(directory).entryInfoList(QStringList() << "*.cms", QDir::Files,
+                                    QDir::Time | QDir::Reversed);
+  qint64 total = 0;
+  for (const QFileInfo& info : files) {
+    total += info.size();
+  }
+  int removed = 0;
+  for (int i = 0; i < files.size() && total > diskBudget; i++) {
+    const qint64 size = files[i].size();
+    if (files[i].filePath() != keep && QFile::remove(files[i].filePath())) {
+      total -= size;
+      removed++;
+    }
+  }
+  if (removed > 0) {
+    qDebug() << ":: Removed" << removed
+             << "files from the mesh cache to stay within its budget";
+  }
+}
@@ -0,0 +1,66 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <QByteArray>
+#include <QString>
+
+#include "mesh/compactmesh.h"
+#include "mesh/mesh.h"
+
+// Total size of the cache files, beyond which the least recently used ones
+// are removed
+#define MESH_CACHE_DEFAULT_BUDGET (qint64(2) << 30)
+// Minimum time a mesh took to compute for it to be stored, in milliseconds
+#define MESH_CACHE_MIN_COMPUTE_TIME 250
+
+/**
+ * @brief The MeshCache class stores meshes in a versioned binary format, so
+ * that a control mesh or any of its subdivision levels can be loaded without
+ * parsing, normalizing or half-edge construction. A cache file holds the
+ * arrays of a CompactMesh behind a fixed-size header; reading memory-maps the
+ * file and copies the arrays as is.
+ *
+ * Files are named after a key. The key of the control mesh is a hash of the
+ * source file. The key of level k + 1 hashes the key of level k together with
+ * the sharpness of level k, so sharpness edits on any level automatically lead
+ * to different keys for all finer levels and stale files are never used.
+ *
+ * Since every edit leads to new keys, the directory is kept within a disk
+ * budget: after storing a file, the least recently used files are removed
+ * until the total size fits. Loading a file marks it as used. Callers only
+ * store meshes that took at least MESH_CACHE_MIN_COMPUTE_TIME to compute, see
+ * isWorthStoring, since loading anything faster gains little and every file
+ * costs a write and disk space.
+ */
+class MeshCache {
+ public:
+  MeshCache();
+  MeshCache(const QString& directory);
+
+  static QString defaultDirectory();
+  static QByteArray sourceKey(const QString& fileName);
+  static QByteArray nextLevelKey(const QByteArray& key, Mesh& mesh);
+  static QByteArray variantKey(const QByteArray& key,
+                               const QByteArray& variant);
+  static inline bool isWorthStoring(qint64 milliseconds) {
+    return milliseconds >= MESH_CACHE_MIN_COMPUTE_TIME;
+  }
+
+  bool load(const QByteArray& key, Mesh& mesh) const;
+  bool load(const QByteArray& key, CompactMesh& mesh) const;
+  bool store(const QByteArray& key, Mesh& mesh) const;
+  bool store(const QByteArray& key, const CompactMesh& mesh) const;
+
+  QString filePath(const QByteArray& key) const;
+  inline const QString& getDirectory() const { return directory; }
+  inline void setDiskBudget(qint64 budget) { diskBudget = budget; }
+  inline qint64 getDiskBudget() const { return diskBudget; }
+
+ private:
+  void trim(const QString& keep) const;
+
+  QString directory;
+  qint64 diskBudget;
+};
+
+#endif  // MESH_CACHE_H
@@ -2,11 +2,17 @@
 
 #include <QDebug>
 
+#include <utility>
+
+#include "util/profiler.h"
+
 /**
  * @brief MeshInitializer::MeshInitializer Initializes an empty mesh
  * initializer.
+ * @param mode How twins and edge indices are resolved during construction.
  */
-MeshInitializer::MeshInitializer() {}
+MeshInitializer::MeshInitializer(ConstructionMode mode)
+    : constructionMode(mode), numEdges(0) {}
 
 /**
  * @brief MeshInitializer::constructHalfEdgeMesh Constructs a half-edge mesh
@@ -19,11 +25,19 @@ MeshInitializer::MeshInitializer() {}
  * @return A half-edge representation of the provided mesh.
  */
 Mesh MeshInitializer::constructHalfEdgeMesh(const OBJFile& loadedOBJFile) {
+  ProfileScope scope("MeshInitializer::constructHalfEdgeMesh");
   int numVertices = loadedOBJFile.vertexCoords.size();
   int numFaces = loadedOBJFile.faceValences.size();
-  int numHalfEdges = 0;
-  for (int f = 0; f < numFaces; f++) {
-    numHalfEdges += loadedOBJFile.faceValences[f];
+  int numHalfEdges = loadedOBJFile.faceCoordInd.size();
+
+  edgeTable.clear();
+  edgeList.clear();
+  edgeIndices.clear();
+  nonManifoldHalfEdges.clear();
+  numEdges = 0;
+  if (constructionMode == HASHED) {
+    // Every interior edge is shared by two half-edges.
+    edgeTable.reserve(numHalfEdges / 2 + 1);
   }
 
   Mesh mesh;
@@ -32,8 +46,21 @@ Mesh MeshInitializer::constructHalfEdgeMesh(const OBJFile& loadedOBJFile) {
   mesh.halfEdges.resize(numHalfEdges);
   mesh.halfEdges.reserve(2 * numHalfEdges);
 
-  initGeometry(mesh, numVertices, loadedOBJFile.vertexCoords);
-  initTopology(mesh, numFaces, loadedOBJFile.faceCoordInd);
+  {
+    ProfileScope geometryScope("MeshInitializer::initGeometry");
+    initGeometry(mesh, numVertices, loadedOBJFile.vertexCoords);
+  }
+  {
+    ProfileScope topologyScope("MeshInitializer::initTopology");
+    initTopology(mesh, numFaces, loadedOBJFile.faceOffsets,
+                 loadedOBJFile.faceCoordInd);
+  }
+
+  if (!nonManifoldHalfEdges.isEmpty()) {
+    qWarning() << ":: Found" << nonManifoldHalfEdges.size()
+               << "half-edges on non-manifold or inconsistently oriented edges;"
+               << "they are treated as boundary edges";
+  }
   return mesh;
 }
 
@@ -58,29 +85,31 @@ void MeshInitializer::initGeometry(Mesh& mesh, int numVertices,
  * data. Makes sure that all the connections are set up correctly.
  * @param mesh The mesh to initialize.
  * @param numFaces The number of faces the mesh will have.
- * @param faceCoordInd A vector containing, for each face, the indices of the
- * vertices.
+ * @param faceOffsets For each face, the position of its first vertex index in
+ * faceCoordInd, followed by the total number of indices.
+ * @param faceCoordInd The vertex indices of all faces, concatenated.
  */
 void MeshInitializer::initTopology(Mesh& mesh, int numFaces,
-                                   const QVector<QVector<int>>& faceCoordInd) {
+                                   const QVector<int>& faceOffsets,
+                                   const QVector<int>& faceCoordInd) {
   int h = 0;
   for (int f = 0; f < numFaces; ++f) {
-    QVector<int> faceIndices = faceCoordInd[f];
+    const int* faceIndices = faceCoordInd.constData() + faceOffsets[f];
     // Each face ends up with a number of half edges equal to its number of
     // vertices.
     Face* face = &mesh.faces[f];
     face->index = f;
-    face->valence = faceIndices.size();
+    face->valence = faceOffsets[f + 1] - faceOffsets[f];
     face->side = &mesh.halfEdges[h];
     for (int i = 0; i < face->valence; ++i) {
-      addHalfEdge(mesh, h, face, faceIndices, i);
+      addHalfEdge(mesh, h, face, faceIndices, face->valence, i);
       // The valence of a vertex is equal to the number of faces it belongs to,
       // so for every face, increment the valence of all its vertices by 1.
       mesh.vertices[faceIndices[i]].valence++;
       h++;
     }
   }
-  mesh.edgeCount = edgeList.size();
+  mesh.edgeCount = constructionMode == HASHED ? numEdges : edgeList.size();
 }
 
 /**
@@ -91,11 +120,12 @@ void MeshInitializer::initTopology(Mesh& mesh, int numFaces,
  * @param face Face that the half-edge belongs to.
  * @param vertIndices Indices of the vertices that belong to the face this
  * half-edge belongs to.
- * @param i Index within vertIndices vector.
+ * @param faceValence Number of vertices of the face.
+ * @param i Index within vertIndices.
  */
 void MeshInitializer::addHalfEdge(Mesh& mesh, int h, Face* face,
-                                  const QVector<int>& vertIndices, int i) {
-  int faceValence = vertIndices.size();
+                                  const int* vertIndices, int faceValence,
+                                  int i) {
   int vertIdx = vertIndices[i];
   int nextVertIdx = vertIndices[(i + 1) % faceValence];
   // prev and next
@@ -135,6 +165,21 @@ QPair<int, int> createUndirectedEdge(int v1, int v2) {
   return QPair<int, int>(v1, v2);
 }
 
+/**
+ * @brief undirectedEdgeKey Packs two vertex indices into a single key that
+ * identifies the undirected edge between them.
+ * @param v1 First vertex index.
+ * @param v2 Second vertex index.
+ * @return The key of edge v1-v2. Two indices always produce the same key,
+ * regardless of their ordering.
+ */
+static inline quint64 undirectedEdgeKey(int v1, int v2) {
+  if (v1 > v2) {
+    std::swap(v1, v2);
+  }
+  return (quint64(quint32(v1)) << 32) | quint32(v2);
+}
+
 /**
  * @brief MeshInitializer::setTwins Set the twin properties of the half-edge.
  * Simultaneously updates the edge indices by keeping track of all the edges
@@ -147,6 +192,61 @@ QPair<int, int> createUndirectedEdge(int v1, int v2) {
  * to.
  */
 void MeshInitializer::setTwins(Mesh& mesh, int h, int vertIdx1, int vertIdx2) {
+  if (constructionMode == HASHED) {
+    setTwinsHashed(mesh, h, vertIdx1, vertIdx2);
+  } else {
+    setTwinsLinearScan(mesh, h, vertIdx1, vertIdx2);
+  }
+}
+
+/**
+ * @brief MeshInitializer::setTwinsHashed Resolves the twin and edge index of
+ * the half-edge with a single lookup in the undirected edge table. The first
+ * half-edge on an edge creates the edge; the second one, running in the
+ * opposite direction, becomes its twin. Any further half-edge on the same edge,
+ * or one running in the same direction, is recorded as non-manifold and gets an
+ * edge of its own so that existing twins are never overwritten.
+ * @param mesh The mesh the half-edge belongs to.
+ * @param h Index of the half-edge.
+ * @param vertIdx1 Index of the origin of the half-edge.
+ * @param vertIdx2 Index of the vertex the half-edge points to.
+ */
+void MeshInitializer::setTwinsHashed(Mesh& mesh, int h, int vertIdx1,
+                                     int vertIdx2) {
+  HalfEdge* halfEdge = &mesh.halfEdges[h];
+  quint64 key = undirectedEdgeKey(vertIdx1, vertIdx2);
+
+  int firstHalfEdge = edgeTable.value(key, -1);
+  if (firstHalfEdge == -1) {
+    edgeTable.insert(key, h);
+    halfEdge->edgeIndex = numEdges++;
+    return;
+  }
+
+  HalfEdge* twinEdge = &mesh.halfEdges[firstHalfEdge];
+  if (twinEdge->twin == nullptr && twinEdge->origin->index == vertIdx2) {
+    halfEdge->edgeIndex = twinEdge->edgeIndex;
+    halfEdge->twin = twinEdge;
+    twinEdge->twin = halfEdge;
+  } else {
+    nonManifoldHalfEdges.append(h);
+    halfEdge->edgeIndex = numEdges++;
+  }
+}
+
+/**
+ * @brief MeshInitializer::setTwinsLinearScan Resolves the twin and edge index
+ * of the half-edge by searching the list of all edges covered so far. This is
+ * quadratic in the number of half-edges.
+ * @param mesh The mesh the half-edge belongs to.
+ * @param h Index of the half-edge.
+ * @param vertIdx1 Index of the first vertex of the edge the half-edge belongs
+ * to.
+ * @param vertIdx2 Index of the second vertex of the edge the half-edge belongs
+ * to.
+ */
+void MeshInitializer::setTwinsLinearScan(Mesh& mesh, int h, int vertIdx1,
+                                         int vertIdx2) {
   QPair<int, int> currentEdge = createUndirectedEdge(vertIdx1, vertIdx2);
 
   int edgeIdx = edgeList.indexOf(currentEdge);
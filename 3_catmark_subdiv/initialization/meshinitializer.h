@@ -1,6 +1,8 @@
 #ifndef MESH_INITIALIZER_H
 #define MESH_INITIALIZER_H
 
+#include <QHash>
+
 #include "../mesh/mesh.h"
 #include "objfile.h"
 
@@ -9,18 +11,47 @@
  */
 class MeshInitializer {
  public:
-  MeshInitializer();
+  /**
+   * @brief The ConstructionMode enum selects how twins and edge indices are
+   * resolved. HASHED uses an undirected-edge hash table and runs in linear
+   * time; LINEAR_SCAN is the original quadratic search, kept for comparison.
+   */
+  enum ConstructionMode { HASHED, LINEAR_SCAN };
+
+  MeshInitializer(ConstructionMode mode = HASHED);
   Mesh constructHalfEdgeMesh(const OBJFile& loadedOBJFile);
 
+  inline void setConstructionMode(ConstructionMode mode) {
+    constructionMode = mode;
+  }
+  inline ConstructionMode getConstructionMode() const {
+    return constructionMode;
+  }
+  // Half-edges that could not be paired because their edge is non-manifold or
+  // inconsistently oriented. They are kept as boundary half-edges.
+  inline const QVector<int>& getNonManifoldHalfEdges() const {
+    return nonManifoldHalfEdges;
+  }
+
  private:
   void initGeometry(Mesh& mesh, int numVertices,
                     const QVector<QVector3D>& vertexCoords);
-  void initTopology(Mesh& mesh, int numFaces,
-                     const QVector<QVector<int>>& faceCoordInd);
-  void addHalfEdge(Mesh& mesh, int h, Face* face,
-                   const QVector<int>& faceIndices, int i);
+  void initTopology(Mesh& mesh, int numFaces, const QVector<int>& faceOffsets,
+                    const QVector<int>& faceCoordInd);
+  void addHalfEdge(Mesh& mesh, int h, Face* face, const int* faceIndices,
+                   int faceValence, int i);
   void setTwins(Mesh& mesh, int h, int vertIdx1, int vertIdx2);
+  void setTwinsHashed(Mesh& mesh, int h, int vertIdx1, int vertIdx2);
+  void setTwinsLinearScan(Mesh& mesh, int h, int vertIdx1, int vertIdx2);
+
+  ConstructionMode constructionMode;
+
+  // HASHED: maps an undirected edge key to the first half-edge on that edge.
+  QHash<quint64, int> edgeTable;
+  int numEdges;
+  QVector<int> nonManifoldHalfEdges;
 
+  // LINEAR_SCAN
   QList<QPair<int, int>> edgeList;
   QVector<int> edgeIndices;
 };
@@ -0,0 +1,214 @@
+#include "meshreorderer.h"
+
+#include <QDebug>
+
+#include <algorithm>
+
+#include "util/profiler.h"
+
+// Bits per coordinate of the Morton code, so three fit in 64 bits
+#define MORTON_BITS 21
+
+/**
+ * @brief spreadBits Spreads the lower 21 bits of a value so that there are two
+ * zero bits between every two of them.
+ * @param value The value.
+ * @return The spread value.
+ */
+static inline quint64 spreadBits(quint64 value) {
+  value &= 0x1fffff;
+  value = (value | value << 32) & 0x1f00000000ffffull;
+  value = (value | value << 16) & 0x1f0000ff0000ffull;
+  value = (value | value << 8) & 0x100f00f00f00f00full;
+  value = (value | value << 4) & 0x10c30c30c30c30c3ull;
+  value = (value | value << 2) & 0x1249249249249249ull;
+  return value;
+}
+
+/**
+ * @brief mortonCode Gives the position of a point on the Morton curve through
+ * a bounding box.
+ * @param point The point.
+ * @param minimum The minimum corner of the bounding box.
+ * @param scale The number of steps of the curve per unit of length.
+ * @return The Morton code of the point.
+ */
+static inline quint64 mortonCode(const QVector3D& point,
+                                 const QVector3D& minimum, float scale) {
+  const float maxStep = float((1 << MORTON_BITS) - 1);
+  quint64 code = 0;
+  for (int axis = 0; axis < 3; axis++) {
+    float step = qBound(0.0f, (point[axis] - minimum[axis]) * scale, maxStep);
+    code |= spreadBits(quint64(step)) << axis;
+  }
+  return code;
+}
+
+/**
+ * @brief MeshReorderer::MeshReorderer Creates a new mesh reorderer.
+ */
+MeshReorderer::MeshReorderer() {}
+
+/**
+ * @brief MeshReorderer::reorder Renumbers the vertices, half-edges, edges and
+ * faces of a mesh for locality. The display buffers and the vertex
+ * classification are recomputed on their next use.
+ * @param mesh The mesh. Its half-edges must be stored face by face, as the
+ * MeshInitializer and the subdividers do.
+ */
+void MeshReorderer::reorder(Mesh& mesh) {
+  ProfileScope scope("MeshReorderer::reorder");
+  orderFaces(mesh);
+  orderVertices(mesh);
+  rebuild(mesh);
+  qDebug() << ":: Reordered" << mesh.numFaces() << "faces and"
+           << mesh.numVerts() << "vertices";
+}
+
+/**
+ * @brief MeshReorderer::orderFaces Sorts the faces along the Morton curve
+ * through their centroids. Faces with the same code keep their order.
+ * @param mesh The mesh.
+ */
+void MeshReorderer::orderFaces(Mesh& mesh) {
+  const QVector<Face>& faces = mesh.faces;
+  QVector<QVector3D> centroids(faces.size());
+  QVector3D minimum;
+  QVector3D maximum;
+  for (int f = 0; f < faces.size(); f++) {
+    QVector3D centroid;
+    HalfEdge* currentEdge = faces[f].side;
+    for (int m = 0; m < faces[f].valence; m++) {
+      centroid += currentEdge->origin->coords;
+      currentEdge = currentEdge->next;
+    }
+    centroid /= faces[f].valence;
+    centroids[f] = centroid;
+    for (int axis = 0; axis < 3; axis++) {
+      minimum[axis] = f == 0 ? centroid[axis]
+                             : qMin(minimum[axis], centroid[axis]);
+      maximum[axis] = f == 0 ? centroid[axis]
+                             : qMax(maximum[axis], centroid[axis]);
+    }
+  }
+
+  // The same scale on every axis, so the cells of the curve are cubes
+  QVector3D extent = maximum - minimum;
+  float size = qMax(extent.x(), qMax(extent.y(), extent.z()));
+  float scale = size > 0.0f ? float((1 << MORTON_BITS) - 1) / size : 0.0f;
+  QVector<QPair<quint64, int>> codes(faces.size());
+  for (int f = 0; f < faces.size(); f++) {
+    codes[f] =
+        QPair<quint64, int>(mortonCode(centroids[f], minimum, scale), f);
+  }
+  std::sort(codes.begin(), codes.end());
+
+  faceOrder.resize(faces.size());
+  for (int i = 0; i < faces.size(); i++) {
+    faceOrder[i] = codes[i].second;
+  }
+}
+
+/**
+ * @brief MeshReorderer::orderVertices Numbers the vertices, half-edges and
+ * edges in order of first use when walking the faces in their new order.
+ * Vertices that belong to no face keep their relative order at the end.
+ * @param mesh The mesh.
+ */
+void MeshReorderer::orderVertices(Mesh& mesh) {
+  vertexMap.fill(-1, mesh.numVerts());
+  halfEdgeMap.fill(-1, mesh.numHalfEdges());
+  edgeMap.fill(-1, mesh.numEdges());
+  vertexOrder.clear();
+  vertexOrder.reserve(mesh.numVerts());
+  int h = 0;
+  int numEdges = 0;
+  for (int f : faceOrder) {
+    HalfEdge* currentEdge = mesh.faces[f].side;
+    for (int m = 0; m < mesh.faces[f].valence; m++) {
+      halfEdgeMap[currentEdge->index] = h++;
+      int v = currentEdge->origin->index;
+      if (vertexMap[v] < 0) {
+        vertexMap[v] = vertexOrder.size();
+        vertexOrder.append(v);
+      }
+      if (edgeMap[currentEdge->edgeIndex] < 0) {
+        edgeMap[currentEdge->edgeIndex] = numEdges++;
+      }
+      currentEdge = currentEdge->next;
+    }
+  }
+  for (int v = 0; v < mesh.numVerts(); v++) {
+    if (vertexMap[v] < 0) {
+      vertexMap[v] = vertexOrder.size();
+      vertexOrder.append(v);
+    }
+  }
+}
+
+/**
+ * @brief MeshReorderer::rebuild Moves the elements of the mesh to their new
+ * indices and redirects all pointers between them.
+ * @param mesh The mesh.
+ */
+void MeshReorderer::rebuild(Mesh& mesh) {
+  QVector<Vertex> oldVertices = std::move(mesh.vertices);
+  QVector<HalfEdge> oldHalfEdges = std::move(mesh.halfEdges);
+  QVector<Face> oldFaces = std::move(mesh.faces);
+  QVector<Vertex>& vertices = mesh.vertices;
+  QVector<HalfEdge>& halfEdges = mesh.halfEdges;
+  QVector<Face>& faces = mesh.faces;
+  vertices.reserve(oldVertices.capacity());
+  halfEdges.reserve(oldHalfEdges.capacity());
+  faces.reserve(oldFaces.capacity());
+  vertices.resize(oldVertices.size());
+  halfEdges.resize(oldHalfEdges.size());
+  faces.resize(oldFaces.size());
+
+  for (int v = 0; v < vertices.size(); v++) {
+    const Vertex& oldVertex = oldVertices[vertexOrder[v]];
+    Vertex& vertex = vertices[v];
+    vertex.coords = oldVertex.coords;
+    vertex.out = oldVertex.out == nullptr
+                     ? nullptr
+                     : &halfEdges[halfEdgeMap[oldVertex.out->index]];
+    vertex.valence = oldVertex.valence;
+    vertex.index = v;
+  }
+
+  QVector<int> faceMap(faces.size());
+  for (int f = 0; f < faces.size(); f++) {
+    faceMap[faceOrder[f]] = f;
+    const Face& oldFace = oldFaces[faceOrder[f]];
+    Face& face = faces[f];
+    face.side = &halfEdges[halfEdgeMap[oldFace.side->index]];
+    face.valence = oldFace.valence;
+    face.index = f;
+    face.normal = oldFace.normal;
+  }
+
+  for (int oldH = 0; oldH < oldHalfEdges.size(); oldH++) {
+    const HalfEdge& oldEdge = oldHalfEdges[oldH];
+    HalfEdge& edge = halfEdges[halfEdgeMap[oldH]];
+    edge.origin = &vertices[vertexMap[oldEdge.origin->index]];
+    edge.next = &halfEdges[halfEdgeMap[oldEdge.next->index]];
+    edge.prev = &halfEdges[halfEdgeMap[oldEdge.prev->index]];
+    edge.twin = oldEdge.twin == nullptr
+                    ? nullptr
+                    : &halfEdges[halfEdgeMap[oldEdge.twin->index]];
+    edge.face = &faces[faceMap[oldEdge.face->index]];
+    edge.index = halfEdgeMap[oldH];
+    edge.edgeIndex = edgeMap[oldEdge.edgeIndex];
+    edge.sharpness = oldEdge.sharpness;
+  }
+
+  // Everything indexed by the old numbering is recomputed on demand
+  const bool classified = mesh.isClassified();
+  mesh.clearClassification();
+  if (classified) {
+    mesh.classifyVertices();
+  }
+  mesh.releaseDisplayData();
+  mesh.edgeDisplaySlots.clear();
+  mesh.edgeSlotHalfEdges.clear();
+}
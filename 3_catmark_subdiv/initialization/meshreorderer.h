@@ -0,0 +1,51 @@
+#ifndef MESH_REORDERER_H
+#define MESH_REORDERER_H
+
+#include <QVector>
+
+#include "mesh/mesh.h"
+
+/**
+ * @brief The MeshReorderer class renumbers the elements of a constructed mesh
+ * so that neighbouring elements are close in memory. The vertex and face order
+ * of an OBJ file is arbitrary, so without reordering the one-ring walks of the
+ * subdivider and the gathers of the normal and limit passes jump through the
+ * whole mesh.
+ *
+ * Faces are sorted along a Morton curve through their centroids. Half-edges
+ * are stored face by face in that order, and vertices and edges are numbered
+ * in order of first use by the half-edges. CatmullClarkSubdivider numbers the
+ * children of every element after their parent, so the locality carries over
+ * to all finer levels, and the index buffers of extractAttributes reference
+ * vertices in nearly increasing order.
+ *
+ * Reordering keeps every sharpness value and the outgoing half-edge of every
+ * vertex, so subdividing the reordered mesh gives the same surface. Vertex
+ * indices change, so crease presets and other data in terms of the indices of
+ * the OBJ file have to be applied before reordering, or mapped through
+ * getVertexOrder.
+ */
+class MeshReorderer {
+ public:
+  MeshReorderer();
+
+  void reorder(Mesh& mesh);
+
+  // The former index of every vertex and face, by new index
+  inline const QVector<int>& getVertexOrder() const { return vertexOrder; }
+  inline const QVector<int>& getFaceOrder() const { return faceOrder; }
+
+ private:
+  void orderFaces(Mesh& mesh);
+  void orderVertices(Mesh& mesh);
+  void rebuild(Mesh& mesh);
+
+  QVector<int> faceOrder;
+  QVector<int> vertexOrder;
+  // The new index of every vertex, half-edge and edge, by former index
+  QVector<int> vertexMap;
+  QVector<int> halfEdgeMap;
+  QVector<int> edgeMap;
+};
+
+#endif  // MESH_REORDERER_H
@@ -0,0 +1,137 @@
+#include "meshstreamwriter.h"
+
+#include <string.h>
+
+#define MESH_STREAM_MAGIC "CMSTREAM"
+#define MESH_STREAM_VERSION 1
+#define MESH_STREAM_BYTE_ORDER 0x01020304u
+#define MESH_STREAM_LIMIT_POSITIONS 0x1u
+#define MESH_STREAM_NORMALS 0x2u
+
+/**
+ * @brief The MeshStreamHeader struct is the fixed-size header at the start of
+ * a stream file.
+ */
+struct MeshStreamHeader {
+  char magic[8];
+  quint32 version;
+  quint32 byteOrder;
+  quint32 level;
+  quint32 flags;
+  qint64 numVerts;
+  qint64 numFaces;
+};
+
+/**
+ * @brief The MeshStreamChunkHeader struct precedes the data of every chunk.
+ */
+struct MeshStreamChunkHeader {
+  quint32 numVerts;
+  quint32 numFaces;
+};
+
+/**
+ * @brief MeshStreamWriter::MeshStreamWriter Creates a writer for a file.
+ * Nothing is written until open is called, and a file that is not closed is
+ * discarded.
+ * @param fileName Path of the output file.
+ */
+MeshStreamWriter::MeshStreamWriter(const QString& fileName)
+    : file(fileName),
+      ok(false),
+      normals(false),
+      numVerts(0),
+      numFaces(0),
+      vertsWritten(0),
+      facesWritten(0) {}
+
+/**
+ * @brief MeshStreamWriter::open Opens the file and writes the header.
+ * @param level The subdivision level of the mesh, for the reader.
+ * @param numVerts Number of vertices of the whole mesh. Vertex indices are
+ * stored as 32 bits, so it may be at most 2^32 - 1.
+ * @param numFaces Number of quads of the whole mesh.
+ * @param limitPositions Whether the positions are limit positions.
+ * @param normals Whether every vertex is written with a normal.
+ * @return False if the file could not be opened or the mesh is too large.
+ */
+bool MeshStreamWriter::open(int level, qint64 numVerts, qint64 numFaces,
+                            bool limitPositions, bool normals) {
+  if (numVerts > qint64(0xffffffffu) || !file.open(QIODevice::WriteOnly)) {
+    return false;
+  }
+  this->normals = normals;
+  this->numVerts = numVerts;
+  this->numFaces = numFaces;
+  MeshStreamHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MESH_STREAM_MAGIC, 8);
+  header.version = MESH_STREAM_VERSION;
+  header.byteOrder = MESH_STREAM_BYTE_ORDER;
+  header.level = quint32(level);
+  header.flags = (limitPositions ? MESH_STREAM_LIMIT_POSITIONS : 0u) |
+                 (normals ? MESH_STREAM_NORMALS : 0u);
+  header.numVerts = numVerts;
+  header.numFaces = numFaces;
+  ok = true;
+  return write(&header, sizeof(header));
+}
+
+/**
+ * @brief MeshStreamWriter::writeChunk Appends a chunk of vertices and quads.
+ * @param indices Indices of the vertices in the whole mesh.
+ * @param positions Positions of the vertices, in the order of the indices.
+ * @param normals Normals of the vertices if the file has normals; ignored
+ * otherwise.
+ * @param quads Four vertex indices per quad, indexing the whole mesh.
+ * @return False if writing failed, now or before.
+ */
+bool MeshStreamWriter::writeChunk(const QVector<quint32>& indices,
+                                  const QVector<QVector3D>& positions,
+                                  const QVector<QVector3D>& normals,
+                                  const QVector<quint32>& quads) {
+  MeshStreamChunkHeader header;
+  header.numVerts = quint32(indices.size());
+  header.numFaces = quint32(quads.size() / 4);
+  write(&header, sizeof(header));
+  write(indices.constData(), qint64(indices.size()) * qint64(sizeof(quint32)));
+  write(positions.constData(),
+        qint64(positions.size()) * qint64(sizeof(QVector3D)));
+  if (this->normals) {
+    write(normals.constData(),
+          qint64(normals.size()) * qint64(sizeof(QVector3D)));
+  }
+  write(quads.constData(), qint64(quads.size()) * qint64(sizeof(quint32)));
+  vertsWritten += header.numVerts;
+  facesWritten += header.numFaces;
+  return ok;
+}
+
+/**
+ * @brief MeshStreamWriter::close Finishes the file.
+ * @return False if writing failed or the chunks did not add up to the vertex
+ * and face counts of the header, in which case the file is discarded.
+ */
+bool MeshStreamWriter::close() {
+  if (!file.isOpen()) {
+    return false;
+  }
+  if (!ok || vertsWritten != numVerts || facesWritten != numFaces) {
+    file.cancelWriting();
+    file.commit();
+    return false;
+  }
+  return file.commit();
+}
+
+/**
+ * @brief MeshStreamWriter::write Writes raw bytes, unless a previous write
+ * failed.
+ * @param data The bytes.
+ * @param bytes Number of bytes.
+ * @return False if this or a previous write failed.
+ */
+bool MeshStreamWriter::write(const void* data, qint64 bytes) {
+  ok = ok && file.write(static_cast<const char*>(data), bytes) == bytes;
+  return ok;
+}
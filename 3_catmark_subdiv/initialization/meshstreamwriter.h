@@ -0,0 +1,51 @@
+#ifndef MESH_STREAM_WRITER_H
+#define MESH_STREAM_WRITER_H
+
+#include <QSaveFile>
+#include <QString>
+#include <QVector3D>
+#include <QVector>
+
+/**
+ * @brief The MeshStreamWriter class writes a quad mesh to a compact binary
+ * file in chunks, so a mesh that does not fit in memory can be written while
+ * it is generated, see StreamingSubdivider. Vertices carry their index in the
+ * whole mesh, so chunks may come in any order and a reader can place every
+ * vertex without seeing the other chunks. Each vertex is written exactly once.
+ *
+ * The file starts with a MeshStreamHeader, followed by chunks until all
+ * vertices and faces of the header are written. A chunk is a
+ * MeshStreamChunkHeader followed by its vertex indices (uint32), positions
+ * (three floats per vertex), normals if the header has the normals flag, and
+ * four uint32 vertex indices per quad. Everything is in native byte order, as
+ * recorded by the header. The file only appears once close succeeds.
+ */
+class MeshStreamWriter {
+ public:
+  MeshStreamWriter(const QString& fileName);
+
+  bool open(int level, qint64 numVerts, qint64 numFaces, bool limitPositions,
+            bool normals);
+  bool writeChunk(const QVector<quint32>& indices,
+                  const QVector<QVector3D>& positions,
+                  const QVector<QVector3D>& normals,
+                  const QVector<quint32>& quads);
+  bool close();
+
+  inline bool hasNormals() const { return normals; }
+  inline qint64 numVertsWritten() const { return vertsWritten; }
+  inline qint64 numFacesWritten() const { return facesWritten; }
+
+ private:
+  bool write(const void* data, qint64 bytes);
+
+  QSaveFile file;
+  bool ok;
+  bool normals;
+  qint64 numVerts;
+  qint64 numFaces;
+  qint64 vertsWritten;
+  qint64 facesWritten;
+};
+
+#endif  // MESH_STREAM_WRITER_H
@@ -2,42 +2,343 @@
 
 #include <QDebug>
 #include <QFile>
-#include <QMatrix4x4>
 
+#include <cmath>
+
+#include "util/profiler.h"
 #include "util/util.h"
 
 #define DESIRED_SCALE 2.0
+// Files larger than this are split into chunks that are parsed in parallel
+#define CHUNK_SIZE (8 << 20)
+
+/**
+ * @brief The OBJChunk struct holds the data parsed from a contiguous range of
+ * lines. Relative (negative) indices can only be resolved once the number of
+ * elements in the preceding chunks is known, so they are stored relative to the
+ * start of the chunk and their positions are recorded.
+ */
+struct OBJChunk {
+  QVector<QVector3D> vertexCoords;
+  QVector<QVector2D> textureCoords;
+  QVector<QVector3D> vertexNormals;
+  QVector<int> faceValences;
+  QVector<int> faceCoordInd;
+  QVector<int> faceTexInd;
+  QVector<int> faceNormalInd;
+  QVector<int> coordFixups;
+  QVector<int> texFixups;
+  QVector<int> normalFixups;
+  int ignoredLines = 0;
+};
+
+static inline bool isBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+static inline const char* skipBlanks(const char* p, const char* end) {
+  while (p < end && isBlank(*p)) {
+    p++;
+  }
+  return p;
+}
+
+static inline const char* skipLine(const char* p, const char* end) {
+  while (p < end && *p != '\n') {
+    p++;
+  }
+  return p < end ? p + 1 : p;
+}
+
+/**
+ * @brief parseFloat Parses a decimal floating point number, optionally with an
+ * exponent. Up to 19 significant digits are accumulated in an integer, which is
+ * scaled by an exactly representable power of ten whenever possible.
+ * @param p Start of the number. Leading blanks are skipped.
+ * @param end End of the buffer.
+ * @param value Is set to the parsed value, or 0 if there is no number.
+ * @return Pointer past the parsed number.
+ */
+static const char* parseFloat(const char* p, const char* end, float& value) {
+  static const double powersOfTen[] = {
+      1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  p = skipBlanks(p, end);
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  quint64 mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  while (p < end && isDigit(*p)) {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + quint64(*p - '0');
+      if (mantissa != 0) digits++;
+    } else {
+      exponent++;
+    }
+    p++;
+  }
+  if (p < end && *p == '.') {
+    p++;
+    while (p < end && isDigit(*p)) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + quint64(*p - '0');
+        if (mantissa != 0) digits++;
+        exponent--;
+      }
+      p++;
+    }
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const char* q = p + 1;
+    bool negativeExponent = false;
+    if (q < end && (*q == '-' || *q == '+')) {
+      negativeExponent = *q == '-';
+      q++;
+    }
+    if (q < end && isDigit(*q)) {
+      int e = 0;
+      while (q < end && isDigit(*q)) {
+        if (e < 10000) e = e * 10 + (*q - '0');
+        q++;
+      }
+      exponent += negativeExponent ? -e : e;
+      p = q;
+    }
+  }
+  double result = double(mantissa);
+  if (exponent >= 0 && exponent <= 22) {
+    result *= powersOfTen[exponent];
+  } else if (exponent < 0 && exponent >= -22) {
+    result /= powersOfTen[-exponent];
+  } else {
+    result *= std::pow(10.0, exponent);
+  }
+  value = float(negative ? -result : result);
+  return p;
+}
+
+/**
+ * @brief parseInt Parses a signed integer.
+ * @param p Start of the number.
+ * @param end End of the buffer.
+ * @param value Is set to the parsed value, or 0 if there is no number.
+ * @return Pointer past the parsed number.
+ */
+static const char* parseInt(const char* p, const char* end, int& value) {
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  int result = 0;
+  while (p < end && isDigit(*p)) {
+    result = result * 10 + (*p - '0');
+    p++;
+  }
+  value = negative ? -result : result;
+  return p;
+}
+
+/**
+ * @brief resolveIndex Converts a 1-based OBJ index into a 0-based index.
+ * Negative indices are relative to the number of elements read so far; they are
+ * resolved against the chunk and their position is recorded so the chunk
+ * offset can be added later.
+ * @param index The index as read from the file.
+ * @param count The number of elements read so far in this chunk.
+ * @param fixups Positions of indices that still need the chunk offset.
+ * @param position Position of the index in the index array.
+ * @return The 0-based index.
+ */
+static inline int resolveIndex(int index, int count, QVector<int>& fixups,
+                               int position) {
+  if (index > 0) {
+    return index - 1;
+  }
+  fixups.append(position);
+  return count + index;
+}
+
+/**
+ * @brief appendCornerIndex Appends the texture or normal index of a face
+ * corner. The array is only allocated once the first such index shows up, after
+ * which it stays aligned with the face corners.
+ * @param indices The texture or normal indices.
+ * @param corner The index of the corner.
+ * @param index The index as read from the file, 0 if the corner has none.
+ * @param count The number of elements read so far in this chunk.
+ * @param fixups Positions of relative indices.
+ */
+static inline void appendCornerIndex(QVector<int>& indices, int corner,
+                                     int index, int count,
+                                     QVector<int>& fixups) {
+  if (index == 0) {
+    if (!indices.isEmpty()) {
+      indices.append(-1);
+    }
+    return;
+  }
+  if (indices.isEmpty() && corner > 0) {
+    indices.fill(-1, corner);
+  }
+  indices.append(resolveIndex(index, count, fixups, corner));
+}
+
+/**
+ * @brief parseFace Parses the corners of a face line, "v", "v/vt", "v//vn" or
+ * "v/vt/vn".
+ * @param p Start of the first corner.
+ * @param end End of the buffer.
+ * @param chunk The chunk to add the face to.
+ * @return Pointer to the end of the line.
+ */
+static const char* parseFace(const char* p, const char* end, OBJChunk& chunk) {
+  int valence = 0;
+  p = skipBlanks(p, end);
+  while (p < end && *p != '\n' && *p != '#') {
+    int v = 0, vt = 0, vn = 0;
+    p = parseInt(p, end, v);
+    if (p < end && *p == '/') {
+      p = parseInt(p + 1, end, vt);
+      if (p < end && *p == '/') {
+        p = parseInt(p + 1, end, vn);
+      }
+    }
+    // Skip anything else up to the next corner
+    while (p < end && !isBlank(*p) && *p != '\n') {
+      p++;
+    }
+    p = skipBlanks(p, end);
+    if (v == 0) {
+      continue;
+    }
+    int corner = chunk.faceCoordInd.size();
+    chunk.faceCoordInd.append(resolveIndex(v, chunk.vertexCoords.size(),
+                                           chunk.coordFixups, corner));
+    appendCornerIndex(chunk.faceTexInd, corner, vt, chunk.textureCoords.size(),
+                      chunk.texFixups);
+    appendCornerIndex(chunk.faceNormalInd, corner, vn,
+                      chunk.vertexNormals.size(), chunk.normalFixups);
+    valence++;
+  }
+  if (valence > 0) {
+    chunk.faceValences.append(valence);
+  } else {
+    chunk.ignoredLines++;
+  }
+  return p;
+}
+
+/**
+ * @brief parseChunk Parses all lines in the given range. Vertex positions,
+ * texture coordinates, normals and faces are read; all other non-empty lines
+ * are counted as ignored.
+ * @param p Start of the first line.
+ * @param end End of the range, which is the start of a line or the end of the
+ * file.
+ * @param chunk The chunk to store the data in.
+ */
+static void parseChunk(const char* p, const char* end, OBJChunk& chunk) {
+  while (p < end) {
+    p = skipBlanks(p, end);
+    if (p == end) {
+      break;
+    }
+    if (*p == '\n') {
+      // An empty line; p + 1 is already the start of the next one
+      p++;
+      continue;
+    }
+    const char* q = p + 1;
+    if (*p == 'v' && q < end && isBlank(*q)) {
+      float x, y, z;
+      q = parseFloat(q, end, x);
+      q = parseFloat(q, end, y);
+      q = parseFloat(q, end, z);
+      // If there's a w value (homogenous coordinates), ignore it.
+      chunk.vertexCoords.append(QVector3D(x, y, z));
+    } else if (*p == 'v' && q + 1 < end && *q == 't' && isBlank(q[1])) {
+      float u, v;
+      q = parseFloat(q + 1, end, u);
+      q = parseFloat(q, end, v);
+      // If there's a w value (barycentric coordinates), ignore it.
+      chunk.textureCoords.append(QVector2D(u, v));
+    } else if (*p == 'v' && q + 1 < end && *q == 'n' && isBlank(q[1])) {
+      float x, y, z;
+      q = parseFloat(q + 1, end, x);
+      q = parseFloat(q, end, y);
+      q = parseFloat(q, end, z);
+      chunk.vertexNormals.append(QVector3D(x, y, z));
+    } else if (*p == 'f' && q < end && isBlank(*q)) {
+      q = parseFace(q, end, chunk);
+    } else {
+      chunk.ignoredLines++;
+    }
+    p = skipLine(q < end ? q : end, end);
+  }
+}
+
+/**
+ * @brief appendCornerIndices Appends the texture or normal indices of a chunk,
+ * padding with -1 where either side has no such indices at all.
+ * @param indices The indices of the file so far.
+ * @param corners The number of face corners of the file so far.
+ * @param chunkIndices The indices of the chunk.
+ * @param chunkCorners The number of face corners in the chunk.
+ * @param fixups Positions in chunkIndices of relative indices.
+ * @param offset Number of elements in the file before the chunk.
+ */
+static void appendCornerIndices(QVector<int>& indices, int corners,
+                                const QVector<int>& chunkIndices,
+                                int chunkCorners, const QVector<int>& fixups,
+                                int offset) {
+  if (chunkIndices.isEmpty()) {
+    if (!indices.isEmpty()) {
+      indices.resize(corners + chunkCorners);
+      std::fill(indices.begin() + corners, indices.end(), -1);
+    }
+    return;
+  }
+  if (indices.isEmpty() && corners > 0) {
+    indices.fill(-1, corners);
+  }
+  indices.append(chunkIndices);
+  for (int position : fixups) {
+    indices[corners + position] += offset;
+  }
+}
 
 /**
  * @brief OBJFile::OBJFile Reads information from the provided .obj file and
- * stores it in this class.
+ * stores it in this class. The file is memory-mapped when possible and read
+ * into memory otherwise.
  * @param fileName The path of the .obj file
+ * @param parallel Whether large files may be parsed in parallel chunks.
  */
-OBJFile::OBJFile(const QString& fileName) {
+OBJFile::OBJFile(const QString& fileName, bool parallel) : ignoredLines(0) {
   qDebug() << ":: Loading" << fileName;
   QFile newModel(fileName);
 
   if (newModel.open(QIODevice::ReadOnly)) {
-    QTextStream fileContents(&newModel);
-
-    while (!fileContents.atEnd()) {
-      QString currentLine = fileContents.readLine();
-      QStringList values = currentLine.split(" ");
-
-      const QString descriptor = values[0];
-      if (descriptor == "v") {
-        handleVertex(values);
-      } else if (descriptor == "vt") {
-        handleVertexTexCoords(values);
-      } else if (descriptor == "vn") {
-        handleVertexNormal(values);
-      } else if (descriptor == "f") {
-        handleFace(values);
-      } else {
-        qDebug() << " * Line contents ignored," << currentLine;
-      }
+    qint64 size = newModel.size();
+    uchar* mapped = size > 0 ? newModel.map(0, size) : nullptr;
+    if (mapped != nullptr) {
+      parse(reinterpret_cast<const char*>(mapped), size, parallel);
+      newModel.unmap(mapped);
+    } else {
+      QByteArray contents = newModel.readAll();
+      parse(contents.constData(), contents.size(), parallel);
     }
     newModel.close();
+    if (ignoredLines > 0) {
+      qDebug() << " * Ignored" << ignoredLines << "unsupported lines";
+    }
     normalizeMesh(DESIRED_SCALE);
     loadSuccess = true;
   } else {
@@ -51,69 +352,80 @@ OBJFile::OBJFile(const QString& fileName) {
 OBJFile::~OBJFile() {}
 
 /**
- * @brief OBJFile::handleVertex Handles vertex coordinate data. Invoked when the
- * line starts with "v".
- * @param values Line contents split by whitespace.
+ * @brief OBJFile::parse Parses the contents of an .obj file. The contents are
+ * split into chunks at line boundaries, which are parsed independently and
+ * then concatenated in order.
+ * @param data The file contents.
+ * @param size Size of the contents in bytes.
+ * @param parallel Whether to split large files into multiple chunks.
  */
-void OBJFile::handleVertex(const QStringList& values) {
-  // Only x, y and z. If there's a w value (homogenous coordinates),
-  // ignore it.
-  vertexCoords.append(
-      QVector3D(values[1].toFloat(), values[2].toFloat(), values[3].toFloat()));
-}
+void OBJFile::parse(const char* data, qint64 size, bool parallel) {
+  ProfileScope scope("OBJFile::parse");
+  const char* end = data + size;
+  int numChunks = parallel ? int(qMax<qint64>(1, size / CHUNK_SIZE)) : 1;
+  QVector<const char*> bounds(numChunks + 1);
+  bounds[0] = data;
+  for (int i = 1; i < numChunks; i++) {
+    const char* p = qMax(data + size * i / numChunks, bounds[i - 1]);
+    // Start the chunk at the beginning of a line
+    if (p > data && p[-1] != '\n') {
+      p = skipLine(p, end);
+    }
+    bounds[i] = p;
+  }
+  bounds[numChunks] = end;
 
-/**
- * @brief OBJFile::handleVertexTexCoords Handles vertex texture data. Invoked
- * when the line starts with "vt".
- * @param values Line contents split by whitespace.
- */
-void OBJFile::handleVertexTexCoords(const QStringList& values) {
-  // Only u and v. If there's a w value (barycentric coordinates), ignore
-  // it, it can be retrieved from 1-u-v.
-  textureCoords.append(QVector2D(values[1].toFloat(), values[2].toFloat()));
-}
+  QVector<OBJChunk> chunks(numChunks);
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int i = 0; i < numChunks; i++) {
+    parseChunk(bounds[i], bounds[i + 1], chunks[i]);
+  }
 
-/**
- * @brief OBJFile::handleVertexNormal Handles vertex normal data. Invoked
- * when the line starts with "vn".
- * @param values Line contents split by whitespace.
- */
-void OBJFile::handleVertexNormal(const QStringList& values) {
-  vertexNormals.append(
-      QVector3D(values[1].toFloat(), values[2].toFloat(), values[3].toFloat()));
+  int numVertices = 0, numFaces = 0, numCorners = 0;
+  for (const OBJChunk& chunk : chunks) {
+    numVertices += chunk.vertexCoords.size();
+    numFaces += chunk.faceValences.size();
+    numCorners += chunk.faceCoordInd.size();
+  }
+  vertexCoords.reserve(numVertices);
+  faceValences.reserve(numFaces);
+  faceOffsets.reserve(numFaces + 1);
+  faceCoordInd.reserve(numCorners);
+  faceOffsets.append(0);
+  for (int i = 0; i < numChunks; i++) {
+    appendChunk(chunks[i]);
+    // Release the chunk as soon as it has been copied
+    chunks[i] = OBJChunk();
+  }
 }
 
 /**
- * @brief OBJFile::handleFace Handles face index data. Invoked
- * when the line starts with "f".
- * @param values Line contents split by whitespace.
+ * @brief OBJFile::appendChunk Appends the data of a parsed chunk and resolves
+ * its relative indices.
+ * @param chunk The chunk, which directly follows the chunks appended so far.
  */
-void OBJFile::handleFace(const QStringList& values) {
-  QVector<int> faceCoordsIndices;
-  QVector<int> faceTexIndices;
-  QVector<int> faceNormalIndices;
-  for (int k = 1; k < values.size(); k++) {
-    QStringList indices = values[k].split("/");
-
-    // Note -1, OBJ starts indexing from 1.
-    faceCoordsIndices.append(indices[0].toInt() - 1);
-
-    if (indices.size() > 1) {
-      if (!indices[1].isEmpty()) {
-        faceTexIndices.append(indices[1].toInt() - 1);
-      }
+void OBJFile::appendChunk(const OBJChunk& chunk) {
+  int vertexOffset = vertexCoords.size();
+  int corners = faceCoordInd.size();
+  int chunkCorners = chunk.faceCoordInd.size();
 
-      if (indices.size() > 2) {
-        if (!indices[2].isEmpty()) {
-          faceNormalIndices.append(indices[2].toInt() - 1);
-        }
-      }
-    }
+  appendCornerIndices(faceTexInd, corners, chunk.faceTexInd, chunkCorners,
+                      chunk.texFixups, textureCoords.size());
+  appendCornerIndices(faceNormalInd, corners, chunk.faceNormalInd,
+                      chunkCorners, chunk.normalFixups, vertexNormals.size());
+
+  vertexCoords.append(chunk.vertexCoords);
+  textureCoords.append(chunk.textureCoords);
+  vertexNormals.append(chunk.vertexNormals);
+  faceCoordInd.append(chunk.faceCoordInd);
+  for (int position : chunk.coordFixups) {
+    faceCoordInd[corners + position] += vertexOffset;
   }
-  faceCoordInd.append(faceCoordsIndices);
-  faceTexIndices.append(faceTexIndices);
-  faceNormalIndices.append(faceNormalIndices);
-  faceValences.append(values.size() - 1);
+  for (int valence : chunk.faceValences) {
+    faceValences.append(valence);
+    faceOffsets.append(faceOffsets.last() + valence);
+  }
+  ignoredLines += chunk.ignoredLines;
 }
 
 /**
@@ -130,12 +442,5 @@ bool OBJFile::loadedSuccessfully() const { return loadSuccess; }
  */
 void OBJFile::normalizeMesh(float desiredScale) {
   float scale = calcBoundingBoxScale(vertexCoords, desiredScale);
-  QMatrix4x4 transformMatrix;
-  transformMatrix.setToIdentity();
-  transformMatrix.scale(scale);
-  for (int i = 0; i < vertexCoords.size(); ++i) {
-    QVector3D coord =
-        QVector3D(transformMatrix * QVector4D(vertexCoords[i], 1));
-    vertexCoords[i] = coord;
-  }
+  scaleCoords(vertexCoords, scale);
 }
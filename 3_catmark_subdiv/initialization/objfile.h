@@ -6,31 +6,42 @@
 #include <QVector3D>
 #include <QVector>
 
+struct OBJChunk;
+
 /**
  * @brief The OBJFile class is used for storing info from the .obj files.
+ * The file is memory-mapped and parsed directly from its bytes. Large files are
+ * split into chunks at line boundaries that are parsed in parallel. The face
+ * indices of all faces are stored in flat arrays.
  */
 class OBJFile {
  public:
-  OBJFile(const QString& fileName);
+  OBJFile(const QString& fileName, bool parallel = true);
   ~OBJFile();
 
   bool loadedSuccessfully() const;
   void normalizeMesh(float desiredScale);
 
+  inline int numFaces() const { return faceValences.size(); }
+  inline int numIgnoredLines() const { return ignoredLines; }
+
  private:
-  void handleVertex(const QStringList& values);
-  void handleVertexTexCoords(const QStringList& values);
-  void handleVertexNormal(const QStringList& values);
-  void handleFace(const QStringList& values);
+  void parse(const char* data, qint64 size, bool parallel);
+  void appendChunk(const OBJChunk& chunk);
 
   QVector<QVector3D> vertexCoords;
   QVector<QVector2D> textureCoords;
   QVector<QVector3D> vertexNormals;
   QVector<int> faceValences;
-  QVector<QVector<int>> faceCoordInd;
-  QVector<QVector<int>> faceTexInd;
-  QVector<QVector<int>> faceNormalInd;
-
+  // The indices of face f are stored at [faceOffsets[f], faceOffsets[f + 1])
+  QVector<int> faceOffsets;
+  QVector<int> faceCoordInd;
+  // Same layout as faceCoordInd, -1 if a face corner has no texture coordinate
+  // or normal. Empty if the file has none at all.
+  QVector<int> faceTexInd;
+  QVector<int> faceNormalInd;
+
+  int ignoredLines;
   bool loadSuccess;
 
   friend class MeshInitializer;
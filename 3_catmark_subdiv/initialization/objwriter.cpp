@@ -0,0 +1,101 @@
+#include "objwriter.h"
+
+#include <cstdio>
+
+#include "util/profiler.h"
+
+// Size at which the formatted text is written to the file
+#define OBJ_WRITER_BLOCK_SIZE (1 << 20)
+
+/**
+ * @brief OBJWriter::OBJWriter Creates a writer for a file. Nothing is written
+ * until write is called.
+ * @param fileName Path of the output file.
+ */
+OBJWriter::OBJWriter(const QString& fileName) : file(fileName), ok(false) {}
+
+/**
+ * @brief OBJWriter::write Writes a mesh to the file.
+ * @param mesh The mesh.
+ * @param limitPositions Whether the limit positions of the vertices are
+ * written instead of their positions, see Mesh::evaluateLimit. The mesh itself
+ * is left unchanged.
+ * @param normals Whether a normal is written for every vertex: the limit
+ * normal with limit positions, the averaged face normal otherwise.
+ * @return False if the file could not be written, in which case it is
+ * discarded.
+ */
+bool OBJWriter::write(Mesh& mesh, bool limitPositions, bool normals) {
+  ProfileScope scope("OBJWriter::write");
+  if (!file.open(QIODevice::WriteOnly)) {
+    return false;
+  }
+  ok = true;
+
+  QVector<QVector3D> positions;
+  QVector<QVector3D> limitNormals;
+  if (limitPositions) {
+    mesh.evaluateLimit(positions, normals ? &limitNormals : nullptr);
+  } else {
+    const QVector<Vertex>& vertices = mesh.getVertices();
+    positions.resize(vertices.size());
+    for (int v = 0; v < vertices.size(); v++) {
+      positions[v] = vertices[v].coords;
+    }
+    if (normals) {
+      mesh.recalculateNormals();
+      limitNormals = mesh.getVertexNorms();
+    }
+  }
+
+  buffer.reserve(OBJ_WRITER_BLOCK_SIZE + 256);
+  char line[128];
+  for (const QVector3D& position : positions) {
+    int length = snprintf(line, sizeof(line), "v %.6g %.6g %.6g\n",
+                          position.x(), position.y(), position.z());
+    buffer.append(line, length);
+    flush(false);
+  }
+  for (const QVector3D& normal : limitNormals) {
+    int length = snprintf(line, sizeof(line), "vn %.6g %.6g %.6g\n",
+                          normal.x(), normal.y(), normal.z());
+    buffer.append(line, length);
+    flush(false);
+  }
+
+  QVector<Face>& faces = mesh.getFaces();
+  for (const Face& face : faces) {
+    buffer.append("f", 1);
+    HalfEdge* currentEdge = face.side;
+    for (int m = 0; m < face.valence; m++) {
+      const int v = currentEdge->origin->index + 1;
+      int length = normals ? snprintf(line, sizeof(line), " %d//%d", v, v)
+                           : snprintf(line, sizeof(line), " %d", v);
+      buffer.append(line, length);
+      currentEdge = currentEdge->next;
+    }
+    buffer.append("\n", 1);
+    flush(false);
+  }
+
+  flush(true);
+  if (!ok) {
+    file.cancelWriting();
+  }
+  return file.commit() && ok;
+}
+
+/**
+ * @brief OBJWriter::flush Writes the buffered text to the file once it has
+ * grown to a block, unless a previous write failed.
+ * @param force Whether to write it regardless of its size.
+ * @return False if this or a previous write failed.
+ */
+bool OBJWriter::flush(bool force) {
+  if (!force && buffer.size() < OBJ_WRITER_BLOCK_SIZE) {
+    return ok;
+  }
+  ok = ok && file.write(buffer.constData(), buffer.size()) == buffer.size();
+  buffer.clear();
+  return ok;
+}
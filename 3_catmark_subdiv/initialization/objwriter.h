@@ -0,0 +1,31 @@
+#ifndef OBJ_WRITER_H
+#define OBJ_WRITER_H
+
+#include <QByteArray>
+#include <QSaveFile>
+#include <QString>
+
+#include "mesh/mesh.h"
+
+/**
+ * @brief The OBJWriter class writes a mesh as an .obj file: one v line per
+ * vertex in index order, optionally one vn line per vertex, and one f line per
+ * face with 1-based indices. The text is formatted into a buffer that is
+ * written in large blocks, and the file only appears once everything was
+ * written.
+ */
+class OBJWriter {
+ public:
+  OBJWriter(const QString& fileName);
+
+  bool write(Mesh& mesh, bool limitPositions, bool normals);
+
+ private:
+  bool flush(bool force);
+
+  QSaveFile file;
+  QByteArray buffer;
+  bool ok;
+};
+
+#endif  // OBJ_WRITER_H
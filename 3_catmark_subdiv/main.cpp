@@ -1,4 +1,5 @@
 #include <QApplication>
+#include <QOpenGLContext>
 #include <QSurfaceFormat>
 
 #include "mainwindow.h"
@@ -14,8 +15,15 @@ int main(int argc, char *argv[]) {
 
   QSurfaceFormat glFormat;
   glFormat.setProfile(QSurfaceFormat::CoreProfile);
-  glFormat.setVersion(4, 1);
+  glFormat.setVersion(4, 3);
   glFormat.setOption(QSurfaceFormat::DebugContext);
+  // Compute shader subdivision needs OpenGL 4.3; fall back to 4.1 when the
+  // driver does not provide it
+  QOpenGLContext probe;
+  probe.setFormat(glFormat);
+  if (!probe.create() || probe.format().version() < qMakePair(4, 3)) {
+    glFormat.setVersion(4, 1);
+  }
   QSurfaceFormat::setDefaultFormat(glFormat);
 
   MainWindow w;
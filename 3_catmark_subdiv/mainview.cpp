@@ -1,18 +1,14 @@
 #include "mainview.h"
 
 #include <math.h>
-#include <algorithm>
-#include <limits>
 
 #include <QLoggingCategory>
 #include <QOpenGLVersionFunctionsFactory>
-#include <QSet>
 
 #include "mesh/mesh.h"
 #include "mesh/halfedge.h"
 #include "mesh/vertex.h"
-#include <QSet>
-extern bool g_showLimitPosition;
+#include "util/profiler.h"
 
 /**
  * @brief MainView::MainView
@@ -26,6 +22,7 @@ MainView::MainView(QWidget* Parent) : QOpenGLWidget(Parent), scale(1.0f) {}
 MainView::~MainView() {
   debugLogger.stopLogging();
   makeCurrent();
+  glDeleteQueries(2, timerQueries);
 }
 
 /**
@@ -65,6 +62,11 @@ void MainView::initializeGL() {
 
   // initialize renderers here with the current context
   meshRenderer.init(functions, &settings);
+  tessellationRenderer.init(functions, &settings);
+  glGenQueries(2, timerQueries);
+  if (!gpuSubdivider.init(this->context())) {
+    qDebug() << ":: GPU subdivision unavailable, subdividing on the CPU";
+  }
   updateMatrices();
 }
 
@@ -77,10 +79,16 @@ void MainView::resizeGL(int newWidth, int newHeight) {
   qDebug() << ".. resizeGL";
 
   settings.dispRatio = float(newWidth) / float(newHeight);
+  settings.viewportHeight = float(newHeight);
 
   settings.projectionMatrix.setToIdentity();
   settings.projectionMatrix.perspective(settings.FoV, settings.dispRatio, 0.1f,
                                         40.0f);
+  meshRenderer.resizePickBuffers(int(newWidth * devicePixelRatioF()),
+                                 int(newHeight * devicePixelRatioF()));
+  // The frame times depend on the number of pixels
+  levelSelector.clearFrameTimes();
+  tessellationSelector.clearFrameTimes();
   updateMatrices();
 }
 
@@ -106,10 +114,119 @@ void MainView::updateMatrices() {
  * @param mesh The mesh used to update the buffer content with.
  */
 void MainView::updateBuffers(Mesh& mesh) {
-  g_showLimitPosition = settings.showLimitPosition;
-  mesh.extractAttributes(settings.selectedEdge, settings.selectedVertex);
+  mesh.extractAttributes(settings.showLimitPosition);
+  uploadBuffers(mesh);
+}
+
+/**
+ * @brief MainView::uploadBuffers Updates the buffers of the renderers from
+ * attributes that were already extracted, for instance by the
+ * SubdivisionWorker. Must be called on the GUI thread, which owns the OpenGL
+ * context.
+ * @param mesh The mesh used to update the buffer content with. Its attributes
+ * must have been extracted with the current limit position setting.
+ */
+void MainView::uploadBuffers(Mesh& mesh) {
   meshRenderer.updateBuffers(mesh);
+  // The display data lives on the GPU now
+  mesh.releaseDisplayData();
+  if (settings.gpuSubdivision && gpuSubdivider.isInitialized()) {
+    // The mesh is the control mesh and only provides the edges and vertices
+    meshRenderer.setSurfaceBuffers(
+        gpuSubdivider.getVertexBuffer(), GPUSubdivider::VERTEX_STRIDE,
+        gpuSubdivider.getIndexBuffer(), gpuSubdivider.getIndexCount(),
+        gpuSubdivider.getLineIndexCount());
+    if (gpuSubdivider.getLevels() > 0) {
+      tessellationRenderer.setPatchBuffers(
+          gpuSubdivider.getVertexBuffer(), GPUSubdivider::VERTEX_STRIDE,
+          gpuSubdivider.getPatchIndexBuffer(),
+          gpuSubdivider.getDrawCommandBuffer());
+    }
+  }
   currentMesh = &mesh;  // Store reference for edge picking
+  updateHighlight();
+}
+
+/**
+ * @brief MainView::updatePositions Updates the vertex coordinates and normals
+ * of the mesh that is shown, such as after the limit position setting
+ * changed. The other buffers are kept. Falls back to updateBuffers for any
+ * other mesh.
+ * @param mesh The mesh.
+ */
+void MainView::updatePositions(Mesh& mesh) {
+  if (currentMesh != &mesh) {
+    updateBuffers(mesh);
+    return;
+  }
+  mesh.extractAttributes(settings.showLimitPosition);
+  makeCurrent();
+  meshRenderer.updatePositions(mesh);
+  doneCurrent();
+  mesh.releaseDisplayData();
+  update();
+}
+
+/**
+ * @brief MainView::updatePatches Updates the patches drawn in tessellation
+ * mode.
+ * @param mesh The mesh whose vertices are the control points.
+ * @param patchIndices The patch table of the mesh, see LevelCache::patchTable.
+ * @param approxPatches The approximate patches of the mesh, see
+ * LevelCache::approxPatchTable.
+ */
+void MainView::updatePatches(Mesh& mesh, const QVector<int>& patchIndices,
+                             const ApproxPatchTable& approxPatches) {
+  makeCurrent();
+  tessellationRenderer.updateBuffers(mesh, patchIndices, approxPatches);
+  update();
+}
+
+/**
+ * @brief MainView::updateHighlight Highlights the selected edge and vertex of
+ * the current mesh. This only changes uniforms of the MeshRenderer, so it is
+ * cheap enough for every selection change.
+ */
+void MainView::updateHighlight() {
+  int edgeSlot = -1;
+  int vertexIndex = -1;
+  if (currentMesh != nullptr && settings.selectedEdge != nullptr) {
+    edgeSlot = currentMesh->edgeDisplaySlot(settings.selectedEdge->edgeIndex);
+  }
+  if (settings.selectedVertex != nullptr) {
+    vertexIndex = settings.selectedVertex->index;
+  }
+  meshRenderer.setHighlight(edgeSlot, vertexIndex);
+  update();
+}
+
+/**
+ * @brief MainView::updateGPUSubdivision Subdivides the control mesh with the
+ * GPUSubdivider up to the current subdivision level and draws the result. Only
+ * valid when hasGPUSubdivision returns true.
+ * @param controlMesh The control mesh. Its edges and vertices are drawn on top
+ * of the subdivided surface.
+ */
+void MainView::updateGPUSubdivision(Mesh& controlMesh) {
+  makeCurrent();
+  gpuSubdivider.subdivide(CompactMesh::fromMesh(controlMesh),
+                          settings.subdivisionLevel);
+  updateBuffers(controlMesh);
+}
+
+/**
+ * @brief MainView::resetLevelOfDetail Forgets the frame times and the chosen
+ * triangle size of the automatic level of detail, for instance after a new
+ * model was loaded or the frame budget changed. The level is chosen again on
+ * the next frame.
+ */
+void MainView::resetLevelOfDetail() {
+  levelSelector.clearFrameTimes();
+  tessellationSelector.clearFrameTimes();
+  requestedLevel = -1;
+  tessellationStep = LOD_TESSELLATION_STEPS;
+  settings.triangleSizeScale = 1.0f;
+  settings.uniformUpdateRequired = true;
   update();
 }
 
@@ -120,7 +237,13 @@ void MainView::updateSharpness(float sharpness) {
         settings.selectedEdge->twin->sharpness = sharpness;
       }
       if (currentMesh != nullptr) {
-        updateBuffers(*currentMesh);
+        // Sharpness only affects the finer levels, so on this level just the
+        // color of the edge changes. This is called outside paintGL, so the
+        // context has to be made current for the buffer update.
+        makeCurrent();
+        meshRenderer.updateEdgeColor(*currentMesh, *settings.selectedEdge);
+        doneCurrent();
+        update();
       }
     }
 }
@@ -129,28 +252,35 @@ void MainView::clearEdgeSelection() {
   settings.selectedEdge = nullptr;  // Clear the selected edge reference
   selectedEdgeSharpness = -2.0f;
   emit edgeSelected(-2.0f);
-  if (currentMesh != nullptr) {
-    updateBuffers(*currentMesh);  // Update buffers to remove highlighting
-  } else {
-    update();
-  }
+  updateHighlight();
 }
 
 void MainView::clearVertexSelection() {
   settings.selectedVertex = nullptr;  // Clear the selected vertex reference
   selectedVertexSharpEdgeCount = -1;
   emit vertexSelected(-1);
-  if (currentMesh != nullptr) {
-    updateBuffers(*currentMesh);  // Update buffers to remove highlighting
-  } else {
-    update();
-  }
+  updateHighlight();
 }
 
 /**
  * @brief MainView::paintGL Draw call.
  */
 void MainView::paintGL() {
+  ProfileScope scope("MainView::paintGL");
+  collectGPUTimes();
+  if (settings.modelLoaded && settings.autoLevelOfDetail) {
+    updateLevelOfDetail();
+  }
+  const bool timed = Profiler::isEnabled() || settings.autoLevelOfDetail;
+  if (timed) {
+    timerQueryStarts[currentTimerQuery] = Profiler::now();
+    timerQueryTessellated[currentTimerQuery] = settings.tesselationMode;
+    timerQuerySteps[currentTimerQuery] = settings.tesselationMode
+                                             ? tessellationStep
+                                             : settings.subdivisionLevel;
+    glBeginQuery(GL_TIME_ELAPSED, timerQueries[currentTimerQuery]);
+  }
+
   glClearColor(0.0, 0.0, 0.0, 1.0);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -161,6 +291,9 @@ void MainView::paintGL() {
   }
 
   if (settings.modelLoaded) {
+    if (settings.tesselationMode) {
+      tessellationRenderer.draw();
+    }
     if (settings.showCpuMesh) {
       meshRenderer.draw();
     }
@@ -169,6 +302,104 @@ void MainView::paintGL() {
       settings.uniformUpdateRequired = false;
     }
   }
+
+  if (timed) {
+    glEndQuery(GL_TIME_ELAPSED);
+    currentTimerQuery = 1 - currentTimerQuery;
+  }
+}
+
+/**
+ * @brief MainView::collectGPUTimes Records the GPU time of the frames whose
+ * timer queries have finished with the Profiler and the level selectors.
+ * Queries that are still pending are left for a later frame, so this never
+ * waits for the GPU. The GPU events are placed at the moment their draw calls
+ * were issued.
+ */
+void MainView::collectGPUTimes() {
+  for (int q = 0; q < 2; q++) {
+    if (timerQueryStarts[q] < 0) {
+      continue;
+    }
+    GLint available = 0;
+    glGetQueryObjectiv(timerQueries[q], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      continue;
+    }
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(timerQueries[q], GL_QUERY_RESULT, &elapsed);
+    Profiler::record("MainView::paintGL (GPU)", timerQueryStarts[q],
+                     qint64(elapsed), true);
+    timerQueryStarts[q] = -1;
+    float milliseconds = float(elapsed) / 1.0e6f;
+    if (timerQueryTessellated[q]) {
+      tessellationSelector.addFrameTime(timerQuerySteps[q], milliseconds);
+    } else {
+      levelSelector.addFrameTime(timerQuerySteps[q], milliseconds);
+    }
+  }
+}
+
+/**
+ * @brief MainView::updateLevelOfDetail Chooses the level of detail of the
+ * frame in the automatic mode. In tessellation mode the triangle size is
+ * chosen, only limited by the frame budget, since the tessellation already
+ * follows the projected size; a step is twice as many triangles. Otherwise
+ * the subdivision level is chosen at which the edges are about the target
+ * triangle size on screen, limited by the frame budget; a level is four
+ * times as many faces. Other levels are requested with levelOfDetailChanged,
+ * so this frame is still drawn at the current level. The view keeps drawing
+ * until the frame time of the current step is known.
+ */
+void MainView::updateLevelOfDetail() {
+  if (settings.tesselationMode) {
+    int step = tessellationSelector.select(
+        tessellationStep, LOD_TESSELLATION_STEPS, LOD_TESSELLATION_STEPS,
+        settings.frameBudget, 2.0f);
+    if (step != tessellationStep) {
+      tessellationStep = step;
+      settings.triangleSizeScale =
+          powf(2.0f, 0.5f * (LOD_TESSELLATION_STEPS - step));
+      settings.uniformUpdateRequired = true;
+    }
+    if (tessellationSelector.isMeasuring(step)) {
+      update();
+    }
+    return;
+  }
+
+  // Edges halve in length with every level
+  float edgePixels = controlEdgeLength * pixelsPerUnit();
+  float desired = -1.0f;
+  if (edgePixels > 0.0f) {
+    desired = log2f(edgePixels / settings.pixelsPerTriangle);
+  }
+  int level =
+      levelSelector.select(settings.subdivisionLevel, settings.maxAutoLevel,
+                           desired, settings.frameBudget, 4.0f);
+  if (level == settings.subdivisionLevel) {
+    requestedLevel = level;
+  } else if (level != requestedLevel) {
+    requestedLevel = level;
+    emit levelOfDetailChanged(level);
+  }
+  if (levelSelector.isMeasuring(settings.subdivisionLevel)) {
+    update();
+  }
+}
+
+/**
+ * @brief MainView::pixelsPerUnit Gives the length on screen of a unit of model
+ * space at the centre of the model, which is the origin.
+ * @return The length in pixels.
+ */
+float MainView::pixelsPerUnit() const {
+  float depth = -settings.modelViewMatrix.map(QVector3D()).z();
+  if (depth <= 0.0f) {
+    return 0.0f;
+  }
+  return settings.projectionMatrix(1, 1) * 0.5f * settings.viewportHeight *
+         scale / depth;
 }
 
 /**
@@ -264,16 +495,19 @@ void MainView::mousePressEvent(QMouseEvent* event) {
     if (selectedVertex != nullptr) {
       // Check if vertex is on boundary - use -2 as sentinel value for "boundary"
       settings.selectedVertex = selectedVertex;
-      if (selectedVertex->isBoundaryVertex()) {
+      if (!currentMesh->isClassified()) {
+        currentMesh->classifyVertices();
+      }
+      int v = selectedVertex->index;
+      if (currentMesh->vertexRule(v) == Mesh::BOUNDARY_VERTEX) {
         selectedVertexSharpEdgeCount = -2;  // -2 indicates boundary vertex
         emit vertexSelected(-999);
       } else {
-        int sharpEdgeCount = countSharpEdgesAtVertex(*selectedVertex);
+        int sharpEdgeCount = currentMesh->numCreaseEdges(v);
         selectedVertexSharpEdgeCount = sharpEdgeCount;
         emit vertexSelected(sharpEdgeCount);
       }
       clearEdgeSelection();  // Clear edge selection when selecting vertex
-      updateBuffers(*currentMesh);
     } else {
       clearVertexSelection();
     }
@@ -284,8 +518,6 @@ void MainView::mousePressEvent(QMouseEvent* event) {
       selectedEdgeSharpness = selectedEdge->sharpness;
       emit edgeSelected(selectedEdgeSharpness);
       clearVertexSelection();  // Clear vertex selection when selecting edge
-      //currentMesh->getEdgeColors()[0] = QVector3D(0.0f, 0.4f, 0.0f);
-      updateBuffers(*currentMesh);
     } else {
       clearEdgeSelection();
     }
@@ -300,6 +532,8 @@ void MainView::wheelEvent(QWheelEvent* event) {
   // Delta is usually 120
   float phi = 1.0f + (event->angleDelta().y() / 2000.0f);
   scale = fmin(fmax(phi * scale, 0.01f), 100.0f);
+  // The number of tessellated triangles follows the zoom
+  tessellationSelector.clearFrameTimes();
   updateMatrices();
 }
 
@@ -333,187 +567,63 @@ void MainView::onMessageLogged(QOpenGLDebugMessage Message) {
 
 /**
  * @brief MainView::pickEdgeAtScreenPosition Finds the edge closest to the given
- * screen coordinates by projecting edges to screen space and finding the minimum distance.
+ * screen coordinates with an ID buffer, see MeshRenderer::pickEdge.
  * @param x Screen x coordinate in pixels.
  * @param y Screen y coordinate in pixels.
  * @return Pointer to the closest half-edge, or nullptr if no edge found.
  */
 HalfEdge* MainView::pickEdgeAtScreenPosition(float x, float y) {
   if (currentMesh == nullptr) return nullptr;
-  
-  QVector2D screenPos(x, y);
-  QVector<HalfEdge>& halfEdges = currentMesh->getHalfEdges();
-  
-  float minDistance = std::numeric_limits<float>::max();
-  HalfEdge* closestEdge = nullptr;
-  
-  // Convert screen coordinates to normalized device coordinates
-  float ndcX = (2.0f * x / width()) - 1.0f;
-  float ndcY = 1.0f - (2.0f * y / height());  // Flip Y axis
-  
-  // Project all edges to screen space and find the closest one
-  QSet<QPair<int, int>> processedEdges;  // Avoid processing same edge twice
-  
-  for (int h = 0; h < halfEdges.size(); ++h) {
-    HalfEdge* edge = &halfEdges[h];
-    int v1Idx = edge->origin->index;
-    int v2Idx = edge->next->origin->index;
-    
-    // Create canonical edge representation
-    QPair<int, int> edgePair = (v1Idx < v2Idx) ? 
-                               QPair<int, int>(v1Idx, v2Idx) : 
-                               QPair<int, int>(v2Idx, v1Idx);
-    
-    if (processedEdges.contains(edgePair)) continue;
-    processedEdges.insert(edgePair);
-    
-    // Get vertex positions in world space
-    QVector3D v1World = currentMesh->getVertices()[v1Idx].coords;
-    QVector3D v2World = currentMesh->getVertices()[v2Idx].coords;
-    
-    // Transform to view space
-    QVector4D v1View = settings.modelViewMatrix * QVector4D(v1World, 1.0f);
-    QVector4D v2View = settings.modelViewMatrix * QVector4D(v2World, 1.0f);
-    
-    // Project to clip space
-    QVector4D v1Clip = settings.projectionMatrix * v1View;
-    QVector4D v2Clip = settings.projectionMatrix * v2View;
-    
-    // Perspective divide to get NDC
-    if (v1Clip.w() != 0.0f && v2Clip.w() != 0.0f) {
-      QVector3D v1NDC = QVector3D(v1Clip.x(), v1Clip.y(), v1Clip.z()) / v1Clip.w();
-      QVector3D v2NDC = QVector3D(v2Clip.x(), v2Clip.y(), v2Clip.z()) / v2Clip.w();
-      
-      // Check if edge is in front of camera
-      if (v1NDC.z() > -1.0f && v1NDC.z() < 1.0f &&
-          v2NDC.z() > -1.0f && v2NDC.z() < 1.0f) {
-        
-        // Calculate distance from click point to edge in screen space
-        QVector2D p1(v1NDC.x(), v1NDC.y());
-        QVector2D p2(v2NDC.x(), v2NDC.y());
-        QVector2D clickPos(ndcX, ndcY);
-        
-        // Vector from p1 to p2
-        QVector2D edgeDir = p2 - p1;
-        float edgeLength = edgeDir.length();
-        
-        if (edgeLength > 0.001f) {
-          edgeDir.normalize();
-          
-          // Vector from p1 to click point
-          QVector2D toClick = clickPos - p1;
-          
-          // Project toClick onto edgeDir
-          float projection = QVector2D::dotProduct(toClick, edgeDir);
-          
-          // Clamp to edge segment
-          projection = std::max(0.0f, std::min(projection, edgeLength));
-          
-          // Find closest point on edge
-          QVector2D closestPoint = p1 + edgeDir * projection;
-          
-          // Distance from click to closest point on edge
-          float distance = (clickPos - closestPoint).length();
-          
-          // Use a threshold (edges closer than this are considered "clicked")
-          const float pickThreshold = 0.05f;  // Adjust based on screen size
-          
-          if (distance < pickThreshold && distance < minDistance) {
-            minDistance = distance;
-            closestEdge = edge;
-          }
-        }
-      }
-    }
+
+  qreal ratio = devicePixelRatioF();
+  makeCurrent();
+  int slot = meshRenderer.pickEdge(int(x * ratio), int((height() - y) * ratio),
+                                   pickRadius());
+  restoreFramebuffer();
+  if (slot < 0 || slot >= currentMesh->numEdgeSlots()) {
+    return nullptr;
   }
-  
-  return closestEdge;
+  return &currentMesh->getHalfEdges()[currentMesh->edgeSlotHalfEdge(slot)];
 }
 
 /**
- * @brief MainView::pickVertexAtScreenPosition Finds the vertex closest to the given
- * screen coordinates by projecting vertices to screen space and finding the minimum distance.
+ * @brief MainView::pickVertexAtScreenPosition Finds the vertex closest to the
+ * given screen coordinates with an ID buffer, see MeshRenderer::pickVertex.
  * @param x Screen x coordinate in pixels.
  * @param y Screen y coordinate in pixels.
  * @return Pointer to the closest vertex, or nullptr if no vertex found.
  */
 Vertex* MainView::pickVertexAtScreenPosition(float x, float y) {
   if (currentMesh == nullptr) return nullptr;
-  
-  QVector<Vertex>& vertices = currentMesh->getVertices();
-  
-  float minDistance = std::numeric_limits<float>::max();
-  Vertex* closestVertex = nullptr;
-  
-  // Convert screen coordinates to normalized device coordinates
-  float ndcX = (2.0f * x / width()) - 1.0f;
-  float ndcY = 1.0f - (2.0f * y / height());  // Flip Y axis
-  
-  // Project all vertices to screen space and find the closest one
-  for (int v = 0; v < vertices.size(); ++v) {
-    Vertex* vertex = &vertices[v];
-    
-    // Get vertex position in world space
-    QVector3D vWorld = vertex->coords;
-    
-    // Transform to view space
-    QVector4D vView = settings.modelViewMatrix * QVector4D(vWorld, 1.0f);
-    
-    // Project to clip space
-    QVector4D vClip = settings.projectionMatrix * vView;
-    
-    // Perspective divide to get NDC
-    if (vClip.w() != 0.0f) {
-      QVector3D vNDC = QVector3D(vClip.x(), vClip.y(), vClip.z()) / vClip.w();
-      
-      // Check if vertex is in front of camera
-      if (vNDC.z() > -1.0f && vNDC.z() < 1.0f) {
-        
-        // Calculate distance from click point to vertex in screen space
-        QVector2D vertexPos(vNDC.x(), vNDC.y());
-        QVector2D clickPos(ndcX, ndcY);
-        
-        float distance = (clickPos - vertexPos).length();
-        
-        // Use a threshold (vertices closer than this are considered "clicked")
-        const float pickThreshold = 0.05f;  // Adjust based on screen size
-        
-        if (distance < pickThreshold && distance < minDistance) {
-          minDistance = distance;
-          closestVertex = vertex;
-        }
-      }
-    }
+
+  qreal ratio = devicePixelRatioF();
+  makeCurrent();
+  int index = meshRenderer.pickVertex(
+      int(x * ratio), int((height() - y) * ratio), pickRadius());
+  restoreFramebuffer();
+  if (index < 0 || index >= currentMesh->getVertices().size()) {
+    return nullptr;
   }
-  
-  return closestVertex;
+  return &currentMesh->getVertices()[index];
 }
 
 /**
- * @brief MainView::countSharpEdgesAtVertex Counts the number of sharp edges
- * incident to a vertex, similar to CatmullClarkSubdivider::countCreaseEdges.
- * @param vertex The vertex to count sharp edges for.
- * @return The number of unique sharp edges incident to the vertex.
+ * @brief MainView::pickRadius Gives the distance within which an edge or
+ * vertex counts as clicked.
+ * @return The distance in framebuffer pixels.
  */
-int MainView::countSharpEdgesAtVertex(const Vertex& vertex) const {
-  // Count the number of unique sharp edges incident to this vertex
-  // Use a more robust approach: iterate through all half-edges and check
-  // which ones are incident to this vertex (works for both single and multi-face meshes)
-  QSet<int> sharpEdgeIndices;  // Use edge indices to avoid duplicates
-  
-  if (currentMesh == nullptr) return 0;
-  
-  // Iterate through all half-edges and check which ones are incident to this vertex
-  QVector<HalfEdge>& halfEdges = currentMesh->getHalfEdges();
-  for (int h = 0; h < halfEdges.size(); ++h) {
-    HalfEdge* edge = &halfEdges[h];
-    // Check if this half-edge originates from the vertex
-    if (edge->origin == &vertex) {
-      if (edge->isSharpEdge()) {
-        sharpEdgeIndices.insert(edge->edgeIndex);
-      }
-    }
-  }
-  
-  return sharpEdgeIndices.size();
+int MainView::pickRadius() const {
+  // Half of the height is 1 in normalized device coordinates
+  const float pickThreshold = 0.05f;
+  return qMax(1, int(pickThreshold * 0.5f * height() * devicePixelRatioF()));
+}
+
+/**
+ * @brief MainView::restoreFramebuffer Binds the framebuffer and viewport of the
+ * widget again after picking.
+ */
+void MainView::restoreFramebuffer() {
+  qreal ratio = devicePixelRatioF();
+  glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+  glViewport(0, 0, int(width() * ratio), int(height() * ratio));
 }
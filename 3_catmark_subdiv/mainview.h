@@ -11,6 +11,12 @@
 #include "mesh/mesh.h"
 #include "renderers/meshrenderer.h"
 #include "renderers/tessrenderer.h"
+#include "subdivision/gpusubdivider.h"
+#include "subdivision/levelselector.h"
+
+// Triangle sizes the automatic level of detail chooses from in tessellation
+// mode, each a factor sqrt(2) larger than the next
+#define LOD_TESSELLATION_STEPS 6
 
 /**
  * @brief The MainView class represents the main view of the UI. It handles and
@@ -26,7 +32,18 @@ class MainView : public QOpenGLWidget, protected QOpenGLFunctions_4_1_Core {
   void updateMatrices();
   void updateUniforms();
   void updateBuffers(Mesh& currentMesh);
+  void uploadBuffers(Mesh& currentMesh);
+  void updatePositions(Mesh& mesh);
+  void updatePatches(Mesh& mesh, const QVector<int>& patchIndices,
+                     const ApproxPatchTable& approxPatches);
   void updateSharpness(float sharpness);
+  void updateHighlight();
+  void updateGPUSubdivision(Mesh& controlMesh);
+  bool hasGPUSubdivision() const { return gpuSubdivider.isInitialized(); }
+
+  // Automatic level of detail
+  void setControlEdgeLength(float length) { controlEdgeLength = length; }
+  void resetLevelOfDetail();
 
   // Edge selection
   void setCurrentMesh(Mesh* mesh) { currentMesh = mesh; }
@@ -40,6 +57,8 @@ class MainView : public QOpenGLWidget, protected QOpenGLFunctions_4_1_Core {
  signals:
   void edgeSelected(float sharpness);  // Signal emitted when an edge is selected
   void vertexSelected(int sharpEdgeCount);  // Signal emitted when a vertex is selected
+  // The automatic level of detail asks for another subdivision level
+  void levelOfDetailChanged(int level);
 
  protected:
   void initializeGL() override;
@@ -55,7 +74,11 @@ class MainView : public QOpenGLWidget, protected QOpenGLFunctions_4_1_Core {
   QVector2D toNormalizedScreenCoordinates(float x, float y);
   HalfEdge* pickEdgeAtScreenPosition(float x, float y);  // Find edge closest to click position
   Vertex* pickVertexAtScreenPosition(float x, float y);  // Find vertex closest to click position
-  int countSharpEdgesAtVertex(const Vertex& vertex) const;  // Count sharp edges incident to vertex
+  int pickRadius() const;
+  void restoreFramebuffer();
+  void collectGPUTimes();
+  void updateLevelOfDetail();
+  float pixelsPerUnit() const;
 
   QOpenGLDebugLogger debugLogger;
   
@@ -70,6 +93,30 @@ class MainView : public QOpenGLWidget, protected QOpenGLFunctions_4_1_Core {
   bool dragging;
 
   MeshRenderer meshRenderer;
+  TessellationRenderer tessellationRenderer;
+  GPUSubdivider gpuSubdivider;
+
+  // GL_TIME_ELAPSED queries of the last two frames, used alternately so the
+  // result of a frame can be read while the next one is drawn. The start is
+  // the Profiler time at which the frame was issued, or -1 if the result was
+  // collected.
+  GLuint timerQueries[2] = {0, 0};
+  qint64 timerQueryStarts[2] = {-1, -1};
+  int currentTimerQuery = 0;
+  // Level of detail step of the frame of each timer query, and whether it was
+  // a tessellation step
+  int timerQuerySteps[2] = {0, 0};
+  bool timerQueryTessellated[2] = {false, false};
+
+  // Frame times per subdivision level and per tessellation step
+  LevelSelector levelSelector;
+  LevelSelector tessellationSelector;
+  // Mean edge length of the control mesh, in model units
+  float controlEdgeLength = 0.0f;
+  // Level last asked for with levelOfDetailChanged, or -1
+  int requestedLevel = -1;
+  // Current tessellation step; the finest one is the chosen triangle size
+  int tessellationStep = LOD_TESSELLATION_STEPS;
 
   Settings settings;
 
@@ -1,18 +1,27 @@
 #include "mainwindow.h"
 
+#include "initialization/creasefile.h"
+#include "initialization/creasepresets.h"
 #include "initialization/meshinitializer.h"
+#include "initialization/meshreorderer.h"
 #include "initialization/objfile.h"
-#include "subdivision/catmullclarksubdivider.h"
-#include "subdivision/subdivider.h"
+#include "subdivision/levelselector.h"
 #include "ui_mainwindow.h"
+#include "util/profiler.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFileInfo>
 #include <QSignalBlocker>
 
+// Interval at which the profiler overlay is refreshed in milliseconds
+#define PROFILER_OVERLAY_INTERVAL 500
+
 /**
  * @brief MainWindow::MainWindow Creates a new Main Window UI.
  * @param parent Qt parent widget.
  */
 MainWindow::MainWindow(QWidget* parent)
-    : QMainWindow(parent), ui(new Ui::MainWindow) {
+    : QMainWindow(parent), ui(new Ui::MainWindow), worker(levels) {
   ui->setupUi(this);
   ui->MeshGroupBox->setEnabled(ui->MainDisplay->settings.modelLoaded);
   ui->ShowSharpEdgesCheckBox->setChecked(ui->MainDisplay->settings.showSharpEdges);
@@ -22,16 +31,146 @@ MainWindow::MainWindow(QWidget* parent)
   connect(ui->MainDisplay, &MainView::edgeSelected, this, &MainWindow::onEdgeSelected);
   // Connect vertex selection signal
   connect(ui->MainDisplay, &MainView::vertexSelected, this, &MainWindow::onVertexSelected);
+  connect(&worker, &SubdivisionWorker::levelFinished, this,
+          &MainWindow::onLevelFinished);
+  // Queued, since the level of detail is chosen while a frame is drawn
+  connect(ui->MainDisplay, &MainView::levelOfDetailChanged, this,
+          &MainWindow::onLevelOfDetailChanged, Qt::QueuedConnection);
+
+  profilerOverlay = new QLabel(ui->MainDisplay);
+  profilerOverlay->setAttribute(Qt::WA_TransparentForMouseEvents);
+  profilerOverlay->setStyleSheet(
+      "background-color: rgba(0, 0, 0, 160); color: white; "
+      "font-family: monospace; padding: 6px;");
+  profilerOverlay->move(10, 10);
+  profilerOverlay->hide();
+  connect(&profilerTimer, &QTimer::timeout, this,
+          &MainWindow::updateProfilerOverlay);
 }
 
 /**
  * @brief MainWindow::~MainWindow Deconstructs the main window.
  */
 MainWindow::~MainWindow() {
+  worker.cancelAndWait();
   delete ui;
 
-  meshes.clear();
-  meshes.squeeze();
+  levels.clear();
+}
+
+/**
+ * @brief MainWindow::displayedLevel Gives the level whose mesh is shown and
+ * can be picked. With GPU subdivision that is always the control mesh.
+ * @return The displayed level.
+ */
+int MainWindow::displayedLevel() const {
+  if (ui->MainDisplay->settings.gpuSubdivision) {
+    return 0;
+  }
+  return ui->MainDisplay->settings.subdivisionLevel;
+}
+
+/**
+ * @brief MainWindow::updatePatches Updates the patches of the displayed level
+ * in tessellation mode. With GPU subdivision, the GPUSubdivider provides the
+ * patches of the subdivided levels, so only the control mesh uses the patch
+ * table of the LevelCache.
+ */
+void MainWindow::updatePatches() {
+  const Settings& settings = ui->MainDisplay->settings;
+  if (!settings.modelLoaded || !settings.tesselationMode ||
+      (settings.gpuSubdivision && settings.subdivisionLevel > 0)) {
+    return;
+  }
+  int k = displayedLevel();
+  const QVector<int>& patchIndices = levels.patchTable(k);
+  const ApproxPatchTable& approxPatches = levels.approxPatchTable(k);
+  ui->MainDisplay->updatePatches(levels.level(k), patchIndices,
+                                 approxPatches);
+}
+
+/**
+ * @brief MainWindow::showLevel Shows a subdivision level, generating it on the
+ * GUI thread if it is not resident.
+ * @param level The subdivision level.
+ */
+void MainWindow::showLevel(int level) {
+  ui->MainDisplay->settings.subdivisionLevel = level;
+  Mesh& mesh = levels.level(displayedLevel());
+  Profiler::setLevel(level);
+  if (ui->MainDisplay->settings.gpuSubdivision) {
+    ui->MainDisplay->updateGPUSubdivision(mesh);
+  } else {
+    ui->MainDisplay->updateBuffers(mesh);
+  }
+  ui->MainDisplay->setCurrentMesh(&mesh);
+  updatePatches();
+  levels.reportFootprint();
+}
+
+/**
+ * @brief MainWindow::requestLevel Shows a subdivision level. A level that is
+ * not resident is generated in the background and shown as it finishes, see
+ * onLevelFinished; the current level stays on screen until then. The
+ * selection belongs to the current level, so it is cleared.
+ * @param level The subdivision level.
+ */
+void MainWindow::requestLevel(int level) {
+  const QSignalBlocker edgeSharpnessBlocker(ui->EdgeSharpness);
+  ui->MainDisplay->clearEdgeSelection();
+  ui->MainDisplay->clearVertexSelection();
+  worker.cancel();
+  if (!ui->MainDisplay->settings.gpuSubdivision &&
+      worker.start(level, ui->MainDisplay->settings.showLimitPosition)) {
+    return;
+  }
+  showLevel(level);
+}
+
+/**
+ * @brief MainWindow::onLevelOfDetailChanged Switches to the level chosen by
+ * the automatic level of detail.
+ * @param level The subdivision level.
+ */
+void MainWindow::onLevelOfDetailChanged(int level) {
+  const Settings& settings = ui->MainDisplay->settings;
+  if (!settings.modelLoaded || !settings.autoLevelOfDetail ||
+      level == settings.subdivisionLevel) {
+    return;
+  }
+  requestLevel(level);
+}
+
+/**
+ * @brief MainWindow::onLevelFinished Shows a level as soon as the
+ * SubdivisionWorker finished it. The selection belongs to the previously shown
+ * level, so it is cleared.
+ * @param level The subdivision level.
+ * @param limitPositions Whether the worker extracted the attributes at the
+ * limit positions.
+ */
+void MainWindow::onLevelFinished(int level, bool limitPositions) {
+  Settings& settings = ui->MainDisplay->settings;
+  if (settings.gpuSubdivision) {
+    return;
+  }
+  const QSignalBlocker edgeSharpnessBlocker(ui->EdgeSharpness);
+  ui->MainDisplay->clearEdgeSelection();
+  ui->MainDisplay->clearVertexSelection();
+  settings.subdivisionLevel = level;
+  Mesh& mesh = levels.level(level);
+  Profiler::setLevel(level);
+  if (limitPositions == settings.showLimitPosition) {
+    ui->MainDisplay->uploadBuffers(mesh);
+  } else {
+    // The setting changed while the level was generated
+    ui->MainDisplay->updateBuffers(mesh);
+  }
+  ui->MainDisplay->setCurrentMesh(&mesh);
+  updatePatches();
+  if (level == ui->SubdivSteps->value()) {
+    levels.reportFootprint();
+  }
 }
 
 /**
@@ -40,32 +179,71 @@ MainWindow::~MainWindow() {
  * @param fileName Path of the .obj file.
  */
 void MainWindow::importOBJ(const QString& fileName) {
-  OBJFile newModel = OBJFile(fileName);
-  meshes.clear();
-  meshes.squeeze();
+  worker.cancelAndWait();
+  levels.clear();
+  Profiler::setModel(QFileInfo(fileName).fileName());
 
-  if (newModel.loadedSuccessfully()) {
-    MeshInitializer meshInitializer;
-    meshes.append(meshInitializer.constructHalfEdgeMesh(newModel));
-    
-    // Set crease edges for specific models
-    if (fileName.contains("CreaseCube", Qt::CaseInsensitive)) {
-      setupCreaseCube(meshes[0]);
-    } else if (fileName.contains("CreaseSquare", Qt::CaseInsensitive)) {
-      setupCreaseSquare(meshes[0]);
-    } else if (fileName.contains("CreaseOctahedron", Qt::CaseInsensitive)) {
-      setupCreaseOctahedron(meshes[0]);
+  // The cached control mesh skips parsing and half-edge construction, and is
+  // loaded into the storage of a previous mesh
+  QByteArray key = MeshCache::sourceKey(fileName);
+  Mesh* controlMesh = levels.acquire(MeshPool::Sizes());
+  bool loaded = levels.getMeshCache().load(key, *controlMesh);
+  if (!loaded) {
+    levels.recycle(controlMesh);
+    controlMesh = nullptr;
+    QElapsedTimer timer;
+    timer.start();
+    OBJFile newModel = OBJFile(fileName);
+    loaded = newModel.loadedSuccessfully();
+    if (loaded) {
+      MeshInitializer meshInitializer;
+      controlMesh = new Mesh(meshInitializer.constructHalfEdgeMesh(newModel));
+      if (MeshCache::isWorthStoring(timer.elapsed())) {
+        levels.getMeshCache().store(key, *controlMesh);
+      }
+    }
+  }
+
+  if (loaded) {
+    // Set crease edges from the sidecar file of the model, or for specific
+    // bundled models
+    const QString creaseFileName = CreaseFile::sidecarFileName(fileName);
+    if (QFileInfo::exists(creaseFileName)) {
+      CreaseFile creaseFile(creaseFileName);
+      creaseFile.apply(*controlMesh);
+    } else {
+      applyCreasePreset(fileName, *controlMesh);
+    }
+    // The creases use the vertex indices of the file, so the mesh is reordered
+    // afterwards; the cache keeps the mesh in file order
+    if (ui->MainDisplay->settings.reorderMeshes) {
+      MeshReorderer().reorder(*controlMesh);
+      key = MeshCache::variantKey(key, "reordered");
     }
+    levels.reset(controlMesh, key);
+    ui->MainDisplay->setControlEdgeLength(
+        LevelSelector::meanEdgeLength(levels.level(0)));
+    ui->MainDisplay->resetLevelOfDetail();
     
-    ui->MainDisplay->updateBuffers(meshes[0]);
-    ui->MainDisplay->setCurrentMesh(&meshes[0]);
+    ui->MainDisplay->settings.subdivisionLevel = 0;
+    if (ui->MainDisplay->settings.gpuSubdivision) {
+      ui->MainDisplay->updateGPUSubdivision(levels.level(0));
+    } else {
+      ui->MainDisplay->updateBuffers(levels.level(0));
+    }
+    ui->MainDisplay->setCurrentMesh(&levels.level(0));
     ui->MainDisplay->settings.modelLoaded = true;
+    updatePatches();
   } else {
+    delete controlMesh;
     ui->MainDisplay->settings.modelLoaded = false;
   }
 
   ui->MeshGroupBox->setEnabled(ui->MainDisplay->settings.modelLoaded);
-  ui->SubdivSteps->setValue(0);
+  // In the automatic mode the steps are the finest level and are kept
+  if (!ui->MainDisplay->settings.autoLevelOfDetail) {
+    ui->SubdivSteps->setValue(0);
+  }
   ui->MainDisplay->update();
 }
 
@@ -83,23 +261,40 @@ void MainWindow::on_MeshPresetComboBox_currentTextChanged(
 }
 
   void MainWindow::on_SubdivSteps_valueChanged(int value) {
-    ui->MainDisplay->settings.subdivisionLevel = value;
-    // Clear edge and vertex selection when subdividing (selected edges/vertices may point to different mesh)
-    const QSignalBlocker edgeSharpnessBlocker(ui->EdgeSharpness);
-    ui->MainDisplay->clearEdgeSelection();
-    ui->MainDisplay->clearVertexSelection();
-    Subdivider* subdivider = new CatmullClarkSubdivider();
-    for (int k = meshes.size() - 1; k < value; k++) {
-      meshes.append(subdivider->subdivide(meshes[k]));
+    Settings& settings = ui->MainDisplay->settings;
+    settings.maxAutoLevel = value;
+    if (settings.autoLevelOfDetail) {
+      // Only the finest level the automatic level of detail may choose
+      if (settings.subdivisionLevel > value) {
+        requestLevel(value);
+      }
+      ui->MainDisplay->update();
+      return;
     }
-    ui->MainDisplay->updateBuffers(meshes[value]);
-    ui->MainDisplay->setCurrentMesh(&meshes[value]);
-    delete subdivider;
+    requestLevel(value);
   }
 
+void MainWindow::on_AutoLevelCheckBox_toggled(bool checked) {
+    Settings& settings = ui->MainDisplay->settings;
+    settings.autoLevelOfDetail = checked;
+    settings.maxAutoLevel = ui->SubdivSteps->value();
+    ui->MainDisplay->resetLevelOfDetail();
+    if (!checked && settings.modelLoaded) {
+      // Back to the level of the steps
+      requestLevel(ui->SubdivSteps->value());
+    }
+}
+
+void MainWindow::on_FrameBudget_valueChanged(double budget) {
+    ui->MainDisplay->settings.frameBudget = static_cast<float>(budget);
+    ui->MainDisplay->resetLevelOfDetail();
+}
+
 void MainWindow::on_LimitPositionCheckBox_toggled(bool checked) {
     ui->MainDisplay->settings.showLimitPosition = checked;
-    ui->MainDisplay->updateBuffers(meshes[ui->SubdivSteps->value()]);
+    // Only the coordinates and normals of the level change
+    ui->MainDisplay->updatePositions(levels.level(displayedLevel()));
+    updatePatches();
     ui->MainDisplay->update();
 }
 
@@ -115,6 +310,76 @@ void MainWindow::on_ShowVerticesCheckBox_toggled(bool checked) {
     ui->MainDisplay->update();
 }
 
+void MainWindow::on_GPUSubdivisionCheckBox_toggled(bool checked) {
+    if (checked && !ui->MainDisplay->hasGPUSubdivision()) {
+      qDebug() << ":: GPU subdivision requires OpenGL 4.3";
+      const QSignalBlocker blocker(ui->GPUSubdivisionCheckBox);
+      ui->GPUSubdivisionCheckBox->setChecked(false);
+      return;
+    }
+    Settings& settings = ui->MainDisplay->settings;
+    settings.gpuSubdivision = checked;
+    if (settings.modelLoaded) {
+      // The frame times of the CPU levels do not apply to the GPU ones
+      ui->MainDisplay->resetLevelOfDetail();
+      int level = ui->SubdivSteps->value();
+      if (settings.autoLevelOfDetail) {
+        level = qMin(settings.subdivisionLevel, level);
+      }
+      requestLevel(level);
+    }
+}
+
+void MainWindow::on_TessellationCheckBox_toggled(bool checked) {
+    ui->MainDisplay->settings.tesselationMode = checked;
+    ui->MainDisplay->settings.uniformUpdateRequired = true;
+    updatePatches();
+    ui->MainDisplay->update();
+}
+
+void MainWindow::on_TriangleSize_valueChanged(double size) {
+    ui->MainDisplay->settings.pixelsPerTriangle = static_cast<float>(size);
+    ui->MainDisplay->settings.uniformUpdateRequired = true;
+    ui->MainDisplay->update();
+}
+
+void MainWindow::on_CullBackFacesCheckBox_toggled(bool checked) {
+    ui->MainDisplay->settings.cullBackFacingPatches = checked;
+    ui->MainDisplay->settings.uniformUpdateRequired = true;
+    ui->MainDisplay->update();
+}
+
+void MainWindow::on_ReorderCheckBox_toggled(bool checked) {
+    // Takes effect when the next model is loaded
+    ui->MainDisplay->settings.reorderMeshes = checked;
+}
+
+void MainWindow::on_ShowProfilerCheckBox_toggled(bool checked) {
+    Profiler::setEnabled(checked);
+    profilerOverlay->setVisible(checked);
+    if (checked) {
+      updateProfilerOverlay();
+      profilerTimer.start(PROFILER_OVERLAY_INTERVAL);
+    } else {
+      profilerTimer.stop();
+    }
+}
+
+void MainWindow::on_ExportTrace_pressed() {
+    QString fileName = QFileDialog::getSaveFileName(
+        this, "Export Trace", "trace.json", tr("Chrome Trace (*.json)"));
+    if (!fileName.isEmpty()) {
+      Profiler::exportChromeTrace(fileName);
+    }
+}
+
+void MainWindow::updateProfilerOverlay() {
+    profilerOverlay->setText(Profiler::summary());
+    profilerOverlay->adjustSize();
+    // Keep the frame times coming while the view is otherwise idle
+    ui->MainDisplay->update();
+}
+
 void MainWindow::onEdgeSelected(float sharpness) {
   if (sharpness >= -1.0f) {
     ui->EdgeSharpness->setDisabled(false);
@@ -141,8 +406,25 @@ void MainWindow::on_EdgeSharpness_valueChanged(double sharpness) {
         ui->EdgeSharpness->setValue(sharpness);
     }
     ui->EdgeSharpness->setValue(sharpness);
+    // The worker may be subdividing the edited level
+    bool resume = worker.isBusy();
+    worker.cancelAndWait();
     ui->MainDisplay->updateSharpness(static_cast<float>(sharpness));
-    meshes.resize(ui->MainDisplay->settings.subdivisionLevel + 1);
+    if (ui->MainDisplay->settings.selectedEdge != nullptr) {
+      levels.markModified(displayedLevel(),
+                          ui->MainDisplay->settings.selectedEdge->index);
+      if (ui->MainDisplay->settings.gpuSubdivision) {
+        ui->MainDisplay->updateGPUSubdivision(levels.level(0));
+      }
+      updatePatches();
+    }
+    if (ui->MainDisplay->settings.autoLevelOfDetail) {
+      // Requests the level again on the next frame
+      ui->MainDisplay->resetLevelOfDetail();
+    } else if (resume) {
+      worker.start(ui->SubdivSteps->value(),
+                   ui->MainDisplay->settings.showLimitPosition);
+    }
 }
 
 void MainWindow::onVertexSelected(int sharpEdgeCount) {
@@ -156,73 +438,3 @@ void MainWindow::onVertexSelected(int sharpEdgeCount) {
     ui->VertexSharpEdgeCountLabel->setText(QString::number(sharpEdgeCount));
   }
 }
-
-/**
- * @brief MainWindow::setupCreaseCube Sets up crease edges on a cube model.
- * Sets the top face edges (around z=0.5) as creases with different sharpness values
- * to demonstrate semi-sharp creases. This matches the example from Figure 7 in the paper.
- * @param mesh The cube mesh to set crease edges on.
- */
-void MainWindow::setupCreaseCube(Mesh &mesh) {
-  // Cube vertex layout (0-indexed after OBJ 1-based to 0-based conversion):
-  // 0: (-0.5, -0.5, -0.5) bottom-left-back
-  // 1: (-0.5, -0.5,  0.5) bottom-left-front
-  // 2: (-0.5,  0.5, -0.5) top-left-back
-  // 3: (-0.5,  0.5,  0.5) top-left-front
-  // 4: ( 0.5, -0.5, -0.5) bottom-right-back
-  // 5: ( 0.5, -0.5,  0.5) bottom-right-front
-  // 6: ( 0.5,  0.5, -0.5) top-right-back
-  // 7: ( 0.5,  0.5,  0.5) top-right-front
-  
-  // Set top face edges as creases (edges connecting vertices 2, 3, 6, 7)
-  // Top face edges form a square: 2-3-7-6
-  // (top-left-back, top-left-front, top-right-front, top-right-back)
-  
-  // Top front edge (3-7): sharpness 2
-  float sharpness = 3.0f;
-  mesh.setCreaseEdge(3, 2, sharpness);
-  mesh.setCreaseEdge(2, 6, sharpness);
-  mesh.setCreaseEdge(6, 7, sharpness);
-  mesh.setCreaseEdge(7, 3, sharpness);
-
-  mesh.setCreaseEdge(0, 1, sharpness);
-  mesh.setCreaseEdge(1, 5, sharpness);
-  mesh.setCreaseEdge(5, 4, sharpness);
-  mesh.setCreaseEdge(4, 0, sharpness);
-
-}
-
-/**
- * @brief MainWindow::setupCreaseSquare Sets up crease edges on a 2D square model
- * for easy visualization of crease rules. The square is flat (z=0) making it easy
- * to see the subdivision behavior.
- * @param mesh The square mesh to set crease edges on.
- */
-void MainWindow::setupCreaseSquare(Mesh &mesh) {
-  // Set top edge (2-3) as crease with sharpness 2
-  // This edge will use sharp rules for 2 subdivision steps, then become smooth
-  mesh.setCreaseEdge(1, 2, -1);
-  mesh.setCreaseEdge(2, 3, -1);
-  mesh.setCreaseEdge(3, 0, -1);
-  mesh.setCreaseEdge(0, 1, -1);
-}
-
-
-/**
- * @brief MainWindow::setupCreaseOctahedron Sets up crease edges on a 3D octahedron model
- * for visualization of crossing crease rules.
- * @param mesh The octahedron mesh to set crease edges on.
- */
-void MainWindow::setupCreaseOctahedron(Mesh &mesh) {
-    // Set top edge (2-3) as crease with sharpness 2
-    // This edge will use sharp rules for 2 subdivision steps, then become smooth
-    mesh.setCreaseEdge(1, 2, 4);
-    mesh.setCreaseEdge(3, 0, 4);
-    mesh.setCreaseEdge(3, 1, 4);
-    mesh.setCreaseEdge(2, 0, 4);
-
-    mesh.setCreaseEdge(0, 4, 2);
-    mesh.setCreaseEdge(4, 1, 2);
-    mesh.setCreaseEdge(1, 5, 2);
-    mesh.setCreaseEdge(5, 0, 2);
-}
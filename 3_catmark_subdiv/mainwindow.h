@@ -2,10 +2,13 @@
 #define MAINWINDOW_H
 
 #include <QFileDialog>
+#include <QLabel>
 #include <QMainWindow>
+#include <QTimer>
 
 #include "mesh/mesh.h"
-#include "subdivision/subdivider.h"
+#include "subdivision/levelcache.h"
+#include "subdivision/subdivisionworker.h"
 
 namespace Ui {
 class MainWindow;
@@ -25,23 +28,41 @@ class MainWindow : public QMainWindow {
   void on_LoadOBJ_pressed();
   void on_MeshPresetComboBox_currentTextChanged(const QString &meshName);
   void on_SubdivSteps_valueChanged(int subdivLevel);
+  void on_AutoLevelCheckBox_toggled(bool checked);
+  void on_FrameBudget_valueChanged(double budget);
   void on_EdgeSharpness_valueChanged(double sharpness);
 
   void on_LimitPositionCheckBox_toggled(bool checked);
   void on_ShowSharpEdgesCheckBox_toggled(bool checked);
   void on_ShowVerticesCheckBox_toggled(bool checked);
+  void on_GPUSubdivisionCheckBox_toggled(bool checked);
+  void on_TessellationCheckBox_toggled(bool checked);
+  void on_TriangleSize_valueChanged(double size);
+  void on_CullBackFacesCheckBox_toggled(bool checked);
+  void on_ReorderCheckBox_toggled(bool checked);
+  void on_ShowProfilerCheckBox_toggled(bool checked);
+  void on_ExportTrace_pressed();
+  void updateProfilerOverlay();
+  void onLevelFinished(int level, bool limitPositions);
+  void onLevelOfDetailChanged(int level);
   
   void onEdgeSelected(float sharpness);  // Slot for edge selection signal
   void onVertexSelected(int sharpEdgeCount);  // Slot for vertex selection signal
 
  private:
   void importOBJ(const QString &fileName);
-  void setupCreaseCube(Mesh &mesh);  // Sets up crease edges on a cube model
-  void setupCreaseSquare(Mesh &mesh);  // Sets up crease edges on a 2D square model
-  void setupCreaseOctahedron(Mesh &mesh);
+  int displayedLevel() const;
+  void updatePatches();
+  void showLevel(int level);
+  void requestLevel(int level);
   Ui::MainWindow *ui;
-  Subdivider *subdivider;
-  QVector<Mesh> meshes;
+  LevelCache levels;
+  // Generates the levels that are not resident; declared after levels, as it
+  // uses them until it is destroyed
+  SubdivisionWorker worker;
+  // Statistics of the Profiler, drawn over the main display
+  QLabel *profilerOverlay;
+  QTimer profilerTimer;
 };
 
 #endif  // MAINWINDOW_H
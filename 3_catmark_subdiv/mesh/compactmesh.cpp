@@ -0,0 +1,348 @@
+#include "compactmesh.h"
+
+#include "mesh.h"
+
+/**
+ * @brief CompactMesh::CompactMesh Initializes an empty compact mesh.
+ */
+CompactMesh::CompactMesh() : faceCount(0) {}
+
+/**
+ * @brief CompactMesh::fromMesh Converts a pointer-based half-edge mesh into a
+ * compact mesh. The half-edges are renumbered such that those of a face are
+ * stored contiguously, starting at the half-edge with the lowest index in the
+ * face. Meshes produced by the MeshInitializer and the CatmullClarkSubdivider
+ * already use this layout, in which case the half-edge indices are unchanged.
+ * Vertex, face and edge indices are always kept.
+ * @param mesh The mesh to convert.
+ * @return The compact version of the mesh.
+ */
+CompactMesh CompactMesh::fromMesh(Mesh& mesh) {
+  QVector<Face>& faces = mesh.getFaces();
+  QVector<HalfEdge>& halfEdges = mesh.getHalfEdges();
+  QVector<Vertex>& vertices = mesh.getVertices();
+
+  bool quadMesh = true;
+  for (int f = 0; f < faces.size(); f++) {
+    if (faces[f].valence != 4) {
+      quadMesh = false;
+      break;
+    }
+  }
+
+  CompactMesh compact;
+  compact.resize(vertices.size(), halfEdges.size(), faces.size(),
+                 mesh.numEdges(), quadMesh);
+
+  // Renumber the half-edges face by face
+  QVector<int> newIndex(halfEdges.size(), -1);
+  int h = 0;
+  for (int f = 0; f < faces.size(); f++) {
+    HalfEdge* first = faces[f].side;
+    HalfEdge* edge = first->next;
+    for (int i = 1; i < faces[f].valence; i++) {
+      if (edge->index < first->index) {
+        first = edge;
+      }
+      edge = edge->next;
+    }
+    if (!quadMesh) {
+      compact.faceOffsets[f] = h;
+    }
+    edge = first;
+    for (int i = 0; i < faces[f].valence; i++) {
+      newIndex[edge->index] = h;
+      if (!quadMesh) {
+        compact.halfEdgeFaces[h] = f;
+      }
+      h++;
+      edge = edge->next;
+    }
+  }
+  if (!quadMesh) {
+    compact.faceOffsets[faces.size()] = h;
+  }
+
+  for (int i = 0; i < halfEdges.size(); i++) {
+    const HalfEdge& edge = halfEdges[i];
+    int j = newIndex[i];
+    compact.origins[j] = edge.origin->index;
+    compact.twins[j] = edge.twin == nullptr ? -1 : newIndex[edge.twin->index];
+    compact.edges[j] = edge.edgeIndex;
+    compact.sharpness[edge.edgeIndex] = edge.sharpness;
+  }
+
+  for (int v = 0; v < vertices.size(); v++) {
+    const Vertex& vertex = vertices[v];
+    compact.setPosition(v, vertex.coords);
+    if (vertex.out == nullptr) {
+      compact.vertexOut[v] = -1;
+    } else if (vertex.isBoundaryVertex()) {
+      compact.vertexOut[v] = newIndex[vertex.nextBoundaryHalfEdge()->index];
+    } else {
+      compact.vertexOut[v] = newIndex[vertex.out->index];
+    }
+  }
+  return compact;
+}
+
+/**
+ * @brief CompactMesh::toMesh Converts this compact mesh into a pointer-based
+ * half-edge mesh. All indices are kept, so the half-edge at index h in the mesh
+ * corresponds to half-edge h of this compact mesh. Face normals and the display
+ * attributes are not computed; call Mesh::extractAttributes for that. The
+ * vertex classification is discarded.
+ * @param mesh The mesh to write into. Its vertices, half-edges and faces are
+ * replaced.
+ */
+void CompactMesh::toMesh(Mesh& mesh) const {
+  QVector<Vertex>& vertices = mesh.vertices;
+  QVector<HalfEdge>& halfEdges = mesh.halfEdges;
+  QVector<Face>& faces = mesh.faces;
+  vertices.resize(numVerts());
+  halfEdges.resize(numHalfEdges());
+  faces.resize(numFaces());
+  mesh.edgeCount = numEdges();
+  mesh.quadMesh = isQuadMesh();
+  mesh.clearClassification();
+
+  for (int v = 0; v < numVerts(); v++) {
+    int out = vertexOut[v];
+    vertices[v] = Vertex(position(v), out < 0 ? nullptr : &halfEdges[out],
+                         out < 0 ? 0 : valence(v), v);
+  }
+  for (int f = 0; f < numFaces(); f++) {
+    faces[f] = Face(&halfEdges[faceSide(f)], faceValence(f), f);
+  }
+  for (int h = 0; h < numHalfEdges(); h++) {
+    HalfEdge& edge = halfEdges[h];
+    edge.origin = &vertices[origins[h]];
+    edge.next = &halfEdges[next(h)];
+    edge.prev = &halfEdges[prev(h)];
+    edge.twin = twins[h] < 0 ? nullptr : &halfEdges[twins[h]];
+    edge.face = &faces[face(h)];
+    edge.index = h;
+    edge.edgeIndex = edges[h];
+    edge.sharpness = sharpness[edges[h]];
+  }
+}
+
+/**
+ * @brief CompactMesh::valence Calculates the valence of a vertex by walking
+ * around its outgoing half-edges.
+ * @param v Index of the vertex.
+ * @return The number of edges incident to the vertex. For a boundary vertex
+ * this includes the incoming boundary edge.
+ */
+int CompactMesh::valence(int v) const {
+  int start = vertexOut[v];
+  int n = 0;
+  int h = start;
+  do {
+    n++;
+    h = twins[prev(h)];
+  } while (h >= 0 && h != start);
+  return h < 0 ? n + 1 : n;
+}
+
+/**
+ * @brief CompactMesh::isConsistent Checks that the arrays describe a mesh that
+ * can be walked safely: every index is within the counts of the mesh, the
+ * faces partition the half-edges, twins are mutual and every vertex is the
+ * origin of its outgoing half-edge. Geometry and sharpness are not checked.
+ * Used for data that was not produced by this program, such as cache files.
+ * @return True if the mesh is consistent; false otherwise.
+ */
+bool CompactMesh::isConsistent() const {
+  const int numH = numHalfEdges();
+  if (twins.size() != numH || edges.size() != numH ||
+      posX.size() != numVerts() || posY.size() != numVerts() ||
+      posZ.size() != numVerts()) {
+    return false;
+  }
+  if (isQuadMesh()) {
+    if (numH != 4 * qint64(faceCount)) {
+      return false;
+    }
+  } else {
+    if (faceOffsets.size() != faceCount + 1 || halfEdgeFaces.size() != numH ||
+        faceOffsets[0] != 0 || faceOffsets[faceCount] != numH) {
+      return false;
+    }
+    for (int f = 0; f < faceCount; f++) {
+      if (faceOffsets[f + 1] <= faceOffsets[f]) {
+        return false;
+      }
+      for (int h = faceOffsets[f]; h < faceOffsets[f + 1]; h++) {
+        if (halfEdgeFaces[h] != f) {
+          return false;
+        }
+      }
+    }
+  }
+  for (int h = 0; h < numH; h++) {
+    int twin = twins[h];
+    if (origins[h] < 0 || origins[h] >= numVerts() || edges[h] < 0 ||
+        edges[h] >= numEdges() || twin >= numH ||
+        (twin >= 0 && (twin == h || twins[twin] != h))) {
+      return false;
+    }
+  }
+  for (int v = 0; v < numVerts(); v++) {
+    int out = vertexOut[v];
+    if (out >= numH || (out >= 0 && origins[out] != v)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief CompactMesh::resize Resizes all arrays. The contents of the arrays are
+ * undefined afterwards.
+ * @param numVerts Number of vertices.
+ * @param numHalfEdges Number of half-edges.
+ * @param numFaces Number of faces.
+ * @param numEdges Number of undirected edges.
+ * @param quadMesh Whether every face is a quad. In that case no face offsets
+ * and per half-edge faces are stored.
+ */
+void CompactMesh::resize(int numVerts, int numHalfEdges, int numFaces,
+                         int numEdges, bool quadMesh) {
+  origins.resize(numHalfEdges);
+  twins.resize(numHalfEdges);
+  edges.resize(numHalfEdges);
+  if (quadMesh) {
+    faceOffsets.clear();
+    halfEdgeFaces.clear();
+  } else {
+    faceOffsets.resize(numFaces + 1);
+    halfEdgeFaces.resize(numHalfEdges);
+  }
+  vertexOut.resize(numVerts);
+  posX.resize(numVerts);
+  posY.resize(numVerts);
+  posZ.resize(numVerts);
+  sharpness.resize(numEdges);
+  faceCount = numFaces;
+}
+
+/**
+ * @brief CompactMesh::extractSubmesh Copies a subset of the faces of this mesh
+ * into a new mesh. Faces are stored in the given order and vertices and edges
+ * are renumbered in order of first use, so the half-edges of the i-th given
+ * face become the sides of face i. Half-edges whose twin is not part of the
+ * subset become boundary half-edges, and vertices that end up on the boundary
+ * of the submesh point at such a half-edge.
+ * @param faces Indices of the faces to copy.
+ * @return The submesh.
+ */
+CompactMesh CompactMesh::extractSubmesh(const QVector<int>& faces) const {
+  // Kept with every entry -1 between calls, so that extracting a few faces of
+  // a large mesh does not cost a pass over the whole mesh
+  static thread_local QVector<int> vertexMap;
+  static thread_local QVector<int> edgeMap;
+  static thread_local QVector<int> halfEdgeMap;
+  if (vertexMap.size() < numVerts()) {
+    vertexMap.resize(numVerts(), -1);
+  }
+  if (edgeMap.size() < numEdges()) {
+    edgeMap.resize(numEdges(), -1);
+  }
+  if (halfEdgeMap.size() < numHalfEdges()) {
+    halfEdgeMap.resize(numHalfEdges(), -1);
+  }
+  int subNumVerts = 0;
+  int subNumEdges = 0;
+  int subNumHalfEdges = 0;
+  bool quadMesh = true;
+  for (int f : faces) {
+    int side = faceSide(f);
+    int valence = faceValence(f);
+    quadMesh = quadMesh && valence == 4;
+    for (int k = 0; k < valence; k++) {
+      int h = side + k;
+      halfEdgeMap[h] = subNumHalfEdges++;
+      if (vertexMap[origins[h]] < 0) {
+        vertexMap[origins[h]] = subNumVerts++;
+      }
+      if (edgeMap[edges[h]] < 0) {
+        edgeMap[edges[h]] = subNumEdges++;
+      }
+    }
+  }
+
+  CompactMesh submesh;
+  submesh.resize(subNumVerts, subNumHalfEdges, faces.size(), subNumEdges,
+                 quadMesh);
+  submesh.vertexOut.fill(-1);
+  int j = 0;
+  for (int i = 0; i < faces.size(); i++) {
+    int side = faceSide(faces[i]);
+    int valence = faceValence(faces[i]);
+    if (!quadMesh) {
+      submesh.faceOffsets[i] = j;
+    }
+    for (int k = 0; k < valence; k++, j++) {
+      int h = side + k;
+      int v = vertexMap[origins[h]];
+      int e = edgeMap[edges[h]];
+      submesh.origins[j] = v;
+      submesh.twins[j] = twins[h] < 0 ? -1 : halfEdgeMap[twins[h]];
+      submesh.edges[j] = e;
+      submesh.sharpness[e] = sharpness[edges[h]];
+      if (!quadMesh) {
+        submesh.halfEdgeFaces[j] = i;
+      }
+      submesh.setPosition(v, position(origins[h]));
+    }
+  }
+  if (!quadMesh) {
+    submesh.faceOffsets[faces.size()] = j;
+  }
+
+  for (int h = 0; h < subNumHalfEdges; h++) {
+    int v = submesh.origins[h];
+    int out = submesh.vertexOut[v];
+    if (out < 0 || (submesh.twins[h] < 0 && submesh.twins[out] >= 0)) {
+      submesh.vertexOut[v] = h;
+    }
+  }
+
+  for (int f : faces) {
+    int side = faceSide(f);
+    for (int k = 0; k < faceValence(f); k++) {
+      int h = side + k;
+      vertexMap[origins[h]] = -1;
+      edgeMap[edges[h]] = -1;
+      halfEdgeMap[h] = -1;
+    }
+  }
+  return submesh;
+}
+
+/**
+ * @brief CompactMesh::interleavedPositions Gathers the vertex positions into a
+ * single array, which is the layout the renderers expect.
+ * @return The vertex positions.
+ */
+QVector<QVector3D> CompactMesh::interleavedPositions() const {
+  QVector<QVector3D> positions(numVerts());
+  for (int v = 0; v < numVerts(); v++) {
+    positions[v] = position(v);
+  }
+  return positions;
+}
+
+/**
+ * @brief CompactMesh::memoryFootprint Calculates the number of bytes used by
+ * the arrays of this mesh.
+ * @return The size of the mesh data in bytes.
+ */
+qint64 CompactMesh::memoryFootprint() const {
+  qint64 ints = qint64(origins.size()) + twins.size() + edges.size() +
+                faceOffsets.size() + halfEdgeFaces.size() + vertexOut.size();
+  qint64 floats =
+      qint64(posX.size()) + posY.size() + posZ.size() + sharpness.size();
+  return ints * qint64(sizeof(int)) + floats * qint64(sizeof(float));
+}
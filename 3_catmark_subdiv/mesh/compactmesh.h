@@ -0,0 +1,126 @@
+#ifndef COMPACT_MESH_H
+#define COMPACT_MESH_H
+
+#include <QVector3D>
+#include <QVector>
+
+class Mesh;
+
+/**
+ * @brief The CompactMesh class is an index-based half-edge mesh stored as a
+ * structure of arrays. Topology is kept in plain int32 arrays and geometry in
+ * separate float arrays, so the data contains no pointers and can be copied,
+ * memory-mapped or uploaded as is.
+ *
+ * Half-edges of a face are stored contiguously and follow each other in order.
+ * For a quad mesh (every level after the first subdivision step) the face of
+ * half-edge h is h / 4 and next/prev follow from the same indexing rules as in
+ * CatmullClarkSubdivider, so only origin, twin and edge are stored: 12 bytes
+ * per half-edge. Other meshes additionally store per-face offsets and the face
+ * of every half-edge.
+ *
+ * The outgoing half-edge of a boundary vertex is always its outgoing boundary
+ * half-edge, so walking twin(prev(h)) from it visits every outgoing half-edge.
+ */
+class CompactMesh {
+ public:
+  CompactMesh();
+
+  static CompactMesh fromMesh(Mesh& mesh);
+  void toMesh(Mesh& mesh) const;
+
+  inline int numVerts() const { return vertexOut.size(); }
+  inline int numHalfEdges() const { return origins.size(); }
+  inline int numFaces() const { return faceCount; }
+  inline int numEdges() const { return sharpness.size(); }
+  inline bool isQuadMesh() const { return faceOffsets.isEmpty(); }
+
+  inline int next(int h) const {
+    if (isQuadMesh()) {
+      return h % 4 == 3 ? h - 3 : h + 1;
+    }
+    int f = halfEdgeFaces[h];
+    return h + 1 == faceOffsets[f + 1] ? faceOffsets[f] : h + 1;
+  }
+  inline int prev(int h) const {
+    if (isQuadMesh()) {
+      return h % 4 == 0 ? h + 3 : h - 1;
+    }
+    int f = halfEdgeFaces[h];
+    return h == faceOffsets[f] ? faceOffsets[f + 1] - 1 : h - 1;
+  }
+  inline int face(int h) const {
+    return isQuadMesh() ? h / 4 : halfEdgeFaces[h];
+  }
+  inline int faceSide(int f) const {
+    return isQuadMesh() ? 4 * f : faceOffsets[f];
+  }
+  inline int faceValence(int f) const {
+    return isQuadMesh() ? 4 : faceOffsets[f + 1] - faceOffsets[f];
+  }
+  inline bool isBoundaryVertex(int v) const {
+    return twins[vertexOut[v]] < 0;
+  }
+  inline bool isSharpEdge(int e) const {
+    return sharpness[e] > 0.0f || sharpness[e] == -1.0f;
+  }
+  inline QVector3D position(int v) const {
+    return QVector3D(posX[v], posY[v], posZ[v]);
+  }
+  inline void setPosition(int v, const QVector3D& p) {
+    posX[v] = p.x();
+    posY[v] = p.y();
+    posZ[v] = p.z();
+  }
+  int valence(int v) const;
+  bool isConsistent() const;
+
+  inline QVector<int>& getOrigins() { return origins; }
+  inline QVector<int>& getTwins() { return twins; }
+  inline QVector<int>& getEdges() { return edges; }
+  inline QVector<int>& getFaceOffsets() { return faceOffsets; }
+  inline QVector<int>& getHalfEdgeFaces() { return halfEdgeFaces; }
+  inline QVector<int>& getVertexOut() { return vertexOut; }
+  inline QVector<float>& getPosX() { return posX; }
+  inline QVector<float>& getPosY() { return posY; }
+  inline QVector<float>& getPosZ() { return posZ; }
+  inline QVector<float>& getSharpness() { return sharpness; }
+
+  inline const QVector<int>& getOrigins() const { return origins; }
+  inline const QVector<int>& getTwins() const { return twins; }
+  inline const QVector<int>& getEdges() const { return edges; }
+  inline const QVector<int>& getVertexOut() const { return vertexOut; }
+  inline const QVector<float>& getPosX() const { return posX; }
+  inline const QVector<float>& getPosY() const { return posY; }
+  inline const QVector<float>& getPosZ() const { return posZ; }
+  inline const QVector<float>& getSharpness() const { return sharpness; }
+
+  void resize(int numVerts, int numHalfEdges, int numFaces, int numEdges,
+              bool quadMesh);
+  CompactMesh extractSubmesh(const QVector<int>& faces) const;
+  QVector<QVector3D> interleavedPositions() const;
+  qint64 memoryFootprint() const;
+
+ private:
+  // Per half-edge
+  QVector<int> origins;
+  QVector<int> twins;  // -1 for boundary half-edges
+  QVector<int> edges;
+  // Only for meshes that are not pure quad meshes
+  QVector<int> faceOffsets;  // numFaces + 1 entries
+  QVector<int> halfEdgeFaces;
+
+  // Per vertex
+  QVector<int> vertexOut;
+  QVector<float> posX, posY, posZ;
+
+  // Per (undirected) edge
+  QVector<float> sharpness;
+
+  int faceCount;
+
+  friend class CompactCatmullClarkSubdivider;
+  friend class MeshCache;
+};
+
+#endif  // COMPACT_MESH_H
@@ -2,10 +2,12 @@
 
 #include <assert.h>
 #include <math.h>
+#include <string.h>
 #include <cmath> // for cosf, M_PI, etc.
 
 #include <QDebug>
-#include <QSet>
+
+#include "util/profiler.h"
 
 /**
  * @brief Mesh::Mesh Initializes an empty mesh.
@@ -24,99 +26,354 @@ Mesh::~Mesh() {
   faces.squeeze();
 }
 
+// Valences up to this use the precomputed masks of limitMask
+#define LIMIT_MASK_MAX_VALENCE 32
+
 /**
- * @brief Mesh::recalculateNormals Recalculates the face and vertex normals.
+ * @brief The LimitMask struct holds the weights that evaluate the limit
+ * position and the two limit tangents of a smooth interior vertex of valence n
+ * from its one-ring: the vertex v, the far ends e_j of its edges and the
+ * centroids f_j of its faces, where face j lies between e_j and e_{j+1}.
+ *
+ * The position is
+ *   ((n - 1) n v + 2 sum e_j + 4 sum f_j) / (n (n + 5)),
+ * which is the quad-mesh rule applied after one subdivision step, so it holds
+ * for faces of any valence. Likewise, the tangents are the eigenvector masks
+ * of Halstead et al. applied to the ring after one step, with the new edge
+ * points expanded into e_j and f_j:
+ *   t = sum A / 4 c_j e_j + (1 + A / 4) (c_j + c_{j+1}) f_j,
+ * with c_j = cos(2 pi j / n) for the first and sin(2 pi j / n) for the
+ * second tangent, and A = 1 + cos(2 pi / n) + cos(pi / n) sqrt(2 (9 +
+ * cos(2 pi / n))).
  */
-void Mesh::recalculateNormals() {
-  for (int f = 0; f < numFaces(); f++) {
-    faces[f].recalculateNormal();
+struct LimitMask {
+  float vertexWeight;
+  float edgeWeight;
+  float faceWeight;
+  float tangentEdgeWeight;
+  float tangentFaceWeight;
+  QVector<float> cosines;
+  QVector<float> sines;
+};
+
+/**
+ * @brief makeLimitMask Computes the limit mask of a valence.
+ * @param n The valence, at least 3.
+ * @return The limit mask.
+ */
+static LimitMask makeLimitMask(int n) {
+  LimitMask mask;
+  mask.vertexWeight = float(n - 1) / float(n + 5);
+  mask.edgeWeight = 2.0f / float(n * (n + 5));
+  mask.faceWeight = 4.0f / float(n * (n + 5));
+  double theta = 2.0 * M_PI / n;
+  double a = 1.0 + cos(theta) + cos(M_PI / n) * sqrt(2.0 * (9.0 + cos(theta)));
+  mask.tangentEdgeWeight = float(a / 4.0);
+  mask.tangentFaceWeight = float(1.0 + a / 4.0);
+  mask.cosines.resize(n);
+  mask.sines.resize(n);
+  for (int j = 0; j < n; j++) {
+    mask.cosines[j] = float(cos(theta * j));
+    mask.sines[j] = float(sin(theta * j));
   }
+  return mask;
+}
 
-  vertexNormals.clear();
-  vertexNormals.fill({0, 0, 0}, numVerts());
+/**
+ * @brief limitMask Gives the limit mask of a valence. Valences up to
+ * LIMIT_MASK_MAX_VALENCE come from a table that is built on first use.
+ * @param n The valence, at least 3.
+ * @param storage Receives the mask of higher valences.
+ * @return The limit mask.
+ */
+static const LimitMask& limitMask(int n, LimitMask& storage) {
+  static const QVector<LimitMask> masks = [] {
+    QVector<LimitMask> table(LIMIT_MASK_MAX_VALENCE + 1);
+    for (int valence = 3; valence <= LIMIT_MASK_MAX_VALENCE; valence++) {
+      table[valence] = makeLimitMask(valence);
+    }
+    return table;
+  }();
+  if (n > LIMIT_MASK_MAX_VALENCE) {
+    storage = makeLimitMask(n);
+    return storage;
+  }
+  return masks[n];
+}
 
-  // normal computation
-  for (int h = 0; h < numHalfEdges(); ++h) {
-    HalfEdge* edge = &halfEdges[h];
-    QVector3D pPrev = edge->prev->origin->coords;
-    QVector3D pCur = edge->origin->coords;
-    QVector3D pNext = edge->next->origin->coords;
+/**
+ * @brief cornerNormal Computes the normal of the corner of a face at the
+ * origin of a half-edge, scaled by sin(angle) / (|a| |b|) for the edges a and
+ * b of the corner. Since |a x b| = |a| |b| sin(angle), this only takes a cross
+ * product and two squared lengths.
+ * @param edge The half-edge that starts at the corner.
+ * @param coords The vertex coordinates to use, indexed by vertex index.
+ * @return The weighted corner normal, or zero for a degenerate corner.
+ */
+static QVector3D cornerNormal(const HalfEdge* edge, const QVector3D* coords) {
+  const QVector3D cur = coords[edge->origin->index];
+  const QVector3D edgeA = coords[edge->prev->origin->index] - cur;
+  const QVector3D edgeB = coords[edge->next->origin->index] - cur;
+  const float lengths = edgeA.lengthSquared() * edgeB.lengthSquared();
+  if (lengths == 0.0f) {
+    return QVector3D();
+  }
+  return QVector3D::crossProduct(edgeB, edgeA) / lengths;
+}
 
-    QVector3D edgeA = (pPrev - pCur);
-    QVector3D edgeB = (pNext - pCur);
+/**
+ * @brief averagedNormal Computes the normal of a vertex as the weighted sum of
+ * its corner normals, see cornerNormal, by walking its outgoing half-edges.
+ * @param vertex The vertex.
+ * @param coords The vertex coordinates to use, indexed by vertex index.
+ * @return The unit normal of the vertex, or zero for an isolated vertex.
+ */
+static QVector3D averagedNormal(const Vertex& vertex, const QVector3D* coords) {
+  if (vertex.out == nullptr) {
+    return QVector3D();
+  }
+  HalfEdge* start =
+      vertex.isBoundaryVertex() ? vertex.nextBoundaryHalfEdge() : vertex.out;
+  QVector3D normal;
+  HalfEdge* edge = start;
+  do {
+    normal += cornerNormal(edge, coords);
+    edge = edge->prev->twin;
+  } while (edge != nullptr && edge != start);
+  // don't use normalized, since this presents issues with small numbers
+  return normal / normal.length();
+}
 
-    float edgeLengths = edgeA.length() * edgeB.length();
-    float edgeDot = QVector3D::dotProduct(edgeA, edgeB) / edgeLengths;
-    float angle = sqrt(1 - edgeDot * edgeDot);
+/**
+ * @brief isSmoothInteriorVertex Checks whether the limit masks apply to a
+ * vertex: it must be an interior vertex of valence 3 or more without incident
+ * sharp edges.
+ * @param vertex The vertex.
+ * @return True if the vertex is a smooth interior vertex; false otherwise.
+ */
+static bool isSmoothInteriorVertex(const Vertex& vertex) {
+  if (vertex.out == nullptr || vertex.valence < 3) {
+    return false;
+  }
+  HalfEdge* edge = vertex.out;
+  int valence = 0;
+  do {
+    if (edge->isSharpEdge() || edge->prev->twin == nullptr) {
+      return false;
+    }
+    edge = edge->prev->twin;
+    valence++;
+  } while (edge != vertex.out && valence <= vertex.valence);
+  return edge == vertex.out && valence == vertex.valence;
+}
 
-    vertexNormals[edge->origin->index] +=
-        (angle * edge->face->normal) / edgeLengths;
+/**
+ * @brief Mesh::recalculateNormals Recalculates the vertex normals from the
+ * vertex coordinates, see gatherNormals.
+ */
+void Mesh::recalculateNormals() {
+  const int numVertices = vertices.size();
+  QVector<QVector3D>& coords = coordScratch();
+  coords.resize(numVertices);
+  copyCoords(coords.data());
+  gatherNormals(coords.constData());
+}
+
+/**
+ * @brief Mesh::copyCoords Copies the vertex coordinates in parallel.
+ * @param coords Receives the coordinates, indexed by vertex index.
+ */
+void Mesh::copyCoords(QVector3D* coords) const {
+  const int numVertices = vertices.size();
+  const Vertex* vertexData = vertices.constData();
+#pragma omp parallel for schedule(static)
+  for (int v = 0; v < numVertices; ++v) {
+    coords[v] = vertexData[v].coords;
   }
+}
 
-  for (int v = 0; v < numVerts(); ++v) {
-    vertexNormals[v] /= vertexNormals[v].length();
+/**
+ * @brief Mesh::gatherNormals Computes the vertex normals. Every vertex gathers
+ * the corner normals of its faces, so the vertices are independent and
+ * processed in parallel. For planar faces, this gives the same normals as
+ * weighting the face normals by the corner angles.
+ * @param coords The vertex coordinates to use, indexed by vertex index.
+ */
+void Mesh::gatherNormals(const QVector3D* coords) {
+  const int numVertices = vertices.size();
+  vertexNormals.resize(numVertices);
+  const Vertex* vertexData = vertices.constData();
+  QVector3D* normals = vertexNormals.data();
+#pragma omp parallel for schedule(static)
+  for (int v = 0; v < numVertices; ++v) {
+    normals[v] = averagedNormal(vertexData[v], coords);
   }
 }
 
-// Global/Static flag to control limit position extraction (set by the UI at runtime)
-bool g_showLimitPosition = false;
-bool g_prevShowLimitPosition = false;
+/**
+ * @brief Mesh::coordScratch Gives scratch storage for vertex coordinates of
+ * the calling thread. It keeps its capacity between calls, so evaluating
+ * meshes of similar size does not allocate.
+ * @return The scratch storage, with unspecified contents.
+ */
+QVector<QVector3D>& Mesh::coordScratch() {
+  static thread_local QVector<QVector3D> scratch;
+  return scratch;
+}
 
 /**
- * @brief Mesh::extractAttributes Extracts the normals, vertex coordinates and
- * indices into easy-to-access buffers.
- * @param selectedEdge Optional pointer to the currently selected edge for highlighting
- * @param selectedVertex Optional pointer to the currently selected vertex for highlighting
- */
-void Mesh::extractAttributes(HalfEdge* selectedEdge, Vertex* selectedVertex) {
-    if (g_showLimitPosition && !g_prevShowLimitPosition) {
-        backupOriginalCoordsIfNeeded();
-        projectVerticesToCatmullClarkLimit();
+ * @brief Mesh::evaluateLimit Evaluates the Catmull-Clark limit positions of
+ * all vertices, and optionally their limit normals, without changing the
+ * mesh. Smooth interior vertices use the masks of LimitMask, so their normals
+ * are exact. Boundary vertices use the limit rule of the boundary curve; other
+ * vertices keep the smooth rule for their position and get the averaged corner
+ * normal of the limit positions. Every vertex gathers from its one-ring in
+ * parallel.
+ * @param positions Receives the limit positions, indexed by vertex index.
+ * @param normals Receives the limit normals if not null.
+ */
+void Mesh::evaluateLimit(QVector<QVector3D>& positions,
+                         QVector<QVector3D>* normals) {
+  const int numVertices = vertices.size();
+  const int numFaces = faces.size();
+  // Face centroids followed by the control coordinates
+  QVector<QVector3D>& scratch = coordScratch();
+  scratch.resize(numFaces + numVertices);
+  QVector3D* facePoints = scratch.data();
+  QVector3D* coords = facePoints + numFaces;
+  copyCoords(coords);
+  positions.resize(numVertices);
+  QVector3D* limit = positions.data();
+  QVector3D* limitNormals = nullptr;
+  if (normals != nullptr) {
+    normals->resize(numVertices);
+    limitNormals = normals->data();
+  }
+  const Vertex* vertexData = vertices.constData();
+  const Face* faceData = faces.constData();
+
+#pragma omp parallel
+  {
+#pragma omp for schedule(static)
+    for (int f = 0; f < numFaces; ++f) {
+      const HalfEdge* edge = faceData[f].side;
+      QVector3D centroid;
+      for (int m = 0; m < faceData[f].valence; m++) {
+        centroid += coords[edge->origin->index];
+        edge = edge->next;
+      }
+      facePoints[f] = centroid / float(faceData[f].valence);
     }
-    if (!g_showLimitPosition && g_prevShowLimitPosition) {
-        restoreOriginalCoords();
+
+#pragma omp for schedule(static)
+    for (int v = 0; v < numVertices; ++v) {
+      const Vertex& vertex = vertexData[v];
+      if (vertex.out == nullptr) {
+        limit[v] = coords[v];
+      } else if (vertex.isBoundaryVertex()) {
+        // Boundary: p_limit = (1/6)*p_prev + (4/6)*v + (1/6)*p_next
+        QVector3D next = coords[vertex.nextBoundaryHalfEdge()->next->origin->index];
+        QVector3D prev = coords[vertex.prevBoundaryHalfEdge()->origin->index];
+        limit[v] = (prev + 4.0f * coords[v] + next) / 6.0f;
+      } else {
+        const int n = vertex.valence;
+        LimitMask storage;
+        const LimitMask& mask = limitMask(n, storage);
+        QVector3D edgeSum, faceSum;
+        const HalfEdge* edge = vertex.out;
+        for (int j = 0; j < n; ++j) {
+          edgeSum += coords[edge->next->origin->index];
+          faceSum += facePoints[edge->face->index];
+          edge = edge->prev->twin;
+        }
+        limit[v] = mask.vertexWeight * coords[v] + mask.edgeWeight * edgeSum +
+                   mask.faceWeight * faceSum;
+      }
     }
-    g_prevShowLimitPosition = g_showLimitPosition;
-    recalculateNormals();
 
-  vertexCoords.clear();
-  vertexCoords.reserve(vertices.size());
-  for (int v = 0; v < vertices.size(); v++) {
-    vertexCoords.append(vertices[v].coords);
+    if (limitNormals != nullptr) {
+#pragma omp for schedule(static)
+      for (int v = 0; v < numVertices; ++v) {
+        const Vertex& vertex = vertexData[v];
+        if (!isSmoothInteriorVertex(vertex)) {
+          limitNormals[v] = averagedNormal(vertex, limit);
+          continue;
+        }
+        const int n = vertex.valence;
+        LimitMask storage;
+        const LimitMask& mask = limitMask(n, storage);
+        QVector3D tangentU, tangentV;
+        const HalfEdge* edge = vertex.out;
+        for (int j = 0; j < n; ++j) {
+          const int k = j + 1 < n ? j + 1 : 0;
+          const QVector3D e = coords[edge->next->origin->index];
+          const QVector3D f = facePoints[edge->face->index];
+          tangentU += mask.tangentEdgeWeight * mask.cosines[j] * e +
+                      mask.tangentFaceWeight *
+                          (mask.cosines[j] + mask.cosines[k]) * f;
+          tangentV += mask.tangentEdgeWeight * mask.sines[j] * e +
+                      mask.tangentFaceWeight * (mask.sines[j] + mask.sines[k]) *
+                          f;
+          edge = edge->prev->twin;
+        }
+        QVector3D normal = QVector3D::crossProduct(tangentU, tangentV);
+        limitNormals[v] = normal / normal.length();
+      }
+    }
   }
+}
 
-  polyIndices.clear();
-  polyIndices.reserve(halfEdges.size());
-  for (int f = 0; f < faces.size(); f++) {
-    HalfEdge* currentEdge = faces[f].side;
-    for (int m = 0; m < faces[f].valence; m++) {
-      polyIndices.append(currentEdge->origin->index);
-      currentEdge = currentEdge->next;
-    }
-    // append MAX_INT to signify end of face
-    polyIndices.append(INT_MAX);
+/**
+ * @brief Mesh::extractAttributes Extracts the normals, vertex coordinates and
+ * indices into easy-to-access buffers. The faces, edges and vertices are all
+ * drawn from the same vertex coordinates: the faces as triangles, the edges as
+ * pairs of vertex indices and the vertices in index order. The selection is
+ * not part of the attributes; MeshRenderer::setHighlight draws it. Only
+ * touches the display data of this mesh, so different meshes can be extracted
+ * concurrently.
+ * @param limitPositions Whether the coordinates and normals are those of the
+ * limit surface, see evaluateLimit. The mesh itself is left unchanged.
+ */
+void Mesh::extractAttributes(bool limitPositions) {
+  ProfileScope scope("Mesh::extractAttributes");
+  if (limitPositions) {
+    ProfileScope limitScope("Mesh::evaluateLimit");
+    evaluateLimit(vertexCoords, &vertexNormals);
+  } else {
+    ProfileScope normalScope("Mesh::recalculateNormals");
+    vertexCoords.resize(vertices.size());
+    copyCoords(vertexCoords.data());
+    gatherNormals(vertexCoords.constData());
   }
-  polyIndices.squeeze();
-
-  quadIndices.clear();
-  quadIndices.reserve(halfEdges.size() + faces.size());
-  for (int k = 0; k < faces.size(); k++) {
-    Face* face = &faces[k];
-    HalfEdge* currentEdge = face->side;
-    if (face->valence == 4) {
-      for (int m = 0; m < face->valence; m++) {
-        quadIndices.append(currentEdge->origin->index);
+
+  {
+    // The buffers are resized to an upper bound, filled in place and cut to
+    // size, which keeps their capacity for the next extraction
+    ProfileScope indexScope("Mesh::extractIndices");
+    // A face of valence n becomes a fan of n - 2 triangles around its first
+    // corner
+    const int numTriangles = halfEdges.size() - 2 * faces.size();
+    triangleIndices.resize(3 * qMax(0, numTriangles));
+    unsigned int* triangleIndex = triangleIndices.data();
+    for (int f = 0; f < faces.size(); f++) {
+      HalfEdge* first = faces[f].side;
+      HalfEdge* currentEdge = first->next;
+      for (int m = 2; m < faces[f].valence; m++) {
+        *triangleIndex++ = first->origin->index;
+        *triangleIndex++ = currentEdge->origin->index;
+        *triangleIndex++ = currentEdge->next->origin->index;
         currentEdge = currentEdge->next;
       }
     }
+    triangleIndices.resize(triangleIndex - triangleIndices.constData());
+  }
+
+  {
+    ProfileScope edgeScope("Mesh::extractEdgeData");
+    extractEdgeData();
   }
-  quadIndices.squeeze();
-  
-  // Extract edge data for visualization
-  extractEdgeData(selectedEdge);
-  
-  // Extract vertex data for visualization
-  extractVertexData(selectedVertex);
+  ProfileScope vertexScope("Mesh::extractVertexData");
+  extractVertexData();
 }
 
 /**
@@ -143,57 +400,114 @@ int Mesh::numFaces() { return faces.size(); }
  */
 int Mesh::numEdges() { return edgeCount; }
 
-void Mesh::backupOriginalCoordsIfNeeded() {
-    if (originalCoords.isEmpty()) {
-        originalCoords.reserve(vertices.size());
-        for (const Vertex &v : vertices) {
-            originalCoords.append(v.coords);
-        }
-    }
+/**
+ * @brief Mesh::releaseDisplayData Frees the buffers filled by
+ * extractAttributes. They are only needed until they have been uploaded, and
+ * extractAttributes recreates them on the next update.
+ */
+void Mesh::releaseDisplayData() {
+  vertexCoords = QVector<QVector3D>();
+  vertexNormals = QVector<QVector3D>();
+  triangleIndices = QVector<unsigned int>();
+  edgeIndices = QVector<unsigned int>();
+  edgeColors = QVector<quint32>();
+  vertexColors = QVector<quint32>();
 }
 
-void Mesh::restoreOriginalCoords() {
-    if (originalCoords.size() == vertices.size()) {
-        for (int i = 0; i < vertices.size(); ++i) {
-            vertices[i].coords = originalCoords[i];
-        }
-        originalCoords.clear();
-    }
+/**
+ * @brief Mesh::memoryFootprint Calculates the number of bytes used by the
+ * half-edge data and the display buffers of this mesh.
+ * @return The size of the mesh data in bytes.
+ */
+qint64 Mesh::memoryFootprint() const {
+  qint64 topology = qint64(vertices.size()) * qint64(sizeof(Vertex)) +
+                    qint64(halfEdges.size()) * qint64(sizeof(HalfEdge)) +
+                    qint64(faces.size()) * qint64(sizeof(Face));
+  qint64 points = qint64(vertexCoords.size()) + vertexNormals.size();
+  qint64 indices = qint64(triangleIndices.size()) + edgeIndices.size() +
+                   edgeColors.size() + vertexColors.size() +
+                   edgeDisplaySlots.size() + edgeSlotHalfEdges.size() +
+                   vertexCreaseEdges.size() + vertexCreaseBlends.size();
+  qint64 bytes = qint64(vertexRules.size()) + vertexCreaseCounts.size();
+  return topology + points * qint64(sizeof(QVector3D)) +
+         indices * qint64(sizeof(unsigned int)) + bytes;
 }
 
+/**
+ * @brief Mesh::clear Empties the mesh, but keeps the capacity of all its
+ * vectors, so it can be filled again without allocating, see MeshPool.
+ */
+void Mesh::clear() {
+  vertices.clear();
+  halfEdges.clear();
+  faces.clear();
+  edgeCount = 0;
+  quadMesh = false;
+  clearClassification();
+  vertexCoords.clear();
+  vertexNormals.clear();
+  triangleIndices.clear();
+  edgeIndices.clear();
+  edgeColors.clear();
+  edgeDisplaySlots.clear();
+  edgeSlotHalfEdges.clear();
+  vertexColors.clear();
+}
+
+/**
+ * @brief Mesh::reserve Reserves the half-edge data and the vertex
+ * classification for the given sizes. The display buffers grow on the first
+ * call to extractAttributes.
+ * @param numVerts Number of vertices.
+ * @param numHalfEdges Number of half-edges.
+ * @param numFaces Number of faces.
+ */
+void Mesh::reserve(int numVerts, int numHalfEdges, int numFaces) {
+  vertices.reserve(numVerts);
+  halfEdges.reserve(numHalfEdges);
+  faces.reserve(numFaces);
+  vertexRules.reserve(numVerts);
+  vertexCreaseCounts.reserve(numVerts);
+  vertexCreaseEdges.reserve(2 * numVerts);
+  vertexCreaseBlends.reserve(numVerts);
+}
+
+/**
+ * @brief Mesh::capacityFootprint Calculates the number of bytes allocated by
+ * the vectors of this mesh, which may be more than memoryFootprint counts when
+ * the mesh was cleared or shrunk.
+ * @return The allocated size of the mesh data in bytes.
+ */
+qint64 Mesh::capacityFootprint() const {
+  qint64 topology = qint64(vertices.capacity()) * qint64(sizeof(Vertex)) +
+                    qint64(halfEdges.capacity()) * qint64(sizeof(HalfEdge)) +
+                    qint64(faces.capacity()) * qint64(sizeof(Face));
+  qint64 points = qint64(vertexCoords.capacity()) + vertexNormals.capacity();
+  qint64 indices = qint64(triangleIndices.capacity()) +
+                   edgeIndices.capacity() + edgeColors.capacity() +
+                   vertexColors.capacity() + edgeDisplaySlots.capacity() +
+                   edgeSlotHalfEdges.capacity() +
+                   vertexCreaseEdges.capacity() + vertexCreaseBlends.capacity();
+  qint64 bytes =
+      qint64(vertexRules.capacity()) + vertexCreaseCounts.capacity();
+  return topology + points * qint64(sizeof(QVector3D)) +
+         indices * qint64(sizeof(unsigned int)) + bytes;
+}
+
+/**
+ * @brief Mesh::projectVerticesToCatmullClarkLimit Moves all vertices to their
+ * limit positions, see evaluateLimit.
+ */
 void Mesh::projectVerticesToCatmullClarkLimit() {
-    // Assumes backup has already been done!
-    QVector<QVector3D> limitPositions(vertices.size());
-    for (int vi = 0; vi < vertices.size(); ++vi) {
-        Vertex &v = vertices[vi];
-        if (v.isBoundaryVertex()) {
-            // Boundary: p_limit = (1/6)*p_prev + (4/6)*v + (1/6)*p_next
-            HalfEdge* nextB = v.nextBoundaryHalfEdge();
-            HalfEdge* prevB = v.prevBoundaryHalfEdge();
-            QVector3D V = v.coords;
-            QVector3D Vnext = nextB->next->origin->coords;
-            QVector3D Vprev = prevB->origin->coords;
-            limitPositions[vi] = (Vprev + 4.0f * V + Vnext) / 6.0f;
-        } else {
-            // Interior: Loop et al. 2009 / Halstead et al.
-            int n = v.valence;
-            float theta = 2 * M_PI / n;
-            float c = cosf(theta);
-            float w = (5.0f/8.0f) - powf((3.0f + 2.0f*c)/8.0f, 2);
-            w /= n;
-
-            QVector3D neighborSum(0,0,0);
-            HalfEdge* h = v.out;
-            for (int j = 0; j < n; ++j) {
-                neighborSum += h->next->origin->coords;
-                h = h->prev->twin;
-            }
-            limitPositions[vi] = (1.0f - w*n) * v.coords + w * neighborSum;
-        }
-    }
-    for (int vi = 0; vi < vertices.size(); ++vi) {
-        vertices[vi].coords = limitPositions[vi];
-    }
+  QVector<QVector3D> limit;
+  evaluateLimit(limit, nullptr);
+  const QVector3D* limitData = limit.constData();
+  Vertex* vertexData = vertices.data();
+  const int numVertices = vertices.size();
+#pragma omp parallel for schedule(static)
+  for (int v = 0; v < numVertices; ++v) {
+    vertexData[v].coords = limitData[v];
+  }
 }
 
 /**
@@ -202,8 +516,10 @@ void Mesh::projectVerticesToCatmullClarkLimit() {
  * @param vertexIdx1 Index of the first vertex.
  * @param vertexIdx2 Index of the second vertex.
  * @param sharpness The sharpness value (0 = smooth, >0 = crease, can be non-integer, -1 = infinite).
+ * The vertex classification is discarded.
  */
 void Mesh::setCreaseEdge(int vertexIdx1, int vertexIdx2, float sharpness) {
+  clearClassification();
   // Find all half-edges connecting these two vertices
   for (int h = 0; h < halfEdges.size(); ++h) {
     HalfEdge* edge = &halfEdges[h];
@@ -228,98 +544,189 @@ void Mesh::setCreaseEdge(int vertexIdx1, int vertexIdx2, float sharpness) {
 }
 
 /**
- * @brief Mesh::extractEdgeData Extracts edge coordinates and colors based on
- * sharpness for visualization. Red = sharp edge, Yellow = smooth edge.
- * @param selectedEdge Optional pointer to the currently selected edge for highlighting
+ * @brief Mesh::classifyVertices Classifies every vertex in one sweep over the
+ * mesh: its subdivision rule, its first two crease edges and, for crease
+ * vertices, how much of the smooth rule is blended in. Every vertex only walks
+ * its own one-ring, so the vertices are classified in parallel.
+ * CatmullClarkSubdivider classifies the vertices of the new mesh while it
+ * refines the topology, so this is only needed for control meshes.
  */
-void Mesh::extractEdgeData(HalfEdge* selectedEdge) {
-  edgeCoords.clear();
-  edgeColors.clear();
-  
-  // Use a set to avoid drawing each edge twice (since we have half-edges)
-  QSet<QPair<int, int>> processedEdges;
-  
+void Mesh::classifyVertices() {
+  const int numVertices = vertices.size();
+  resizeClassification(numVertices);
+#pragma omp parallel for schedule(static)
+  for (int v = 0; v < numVertices; ++v) {
+    classifyVertex(v);
+  }
+}
+
+/**
+ * @brief Mesh::classifyVertex Classifies a single vertex again, for instance
+ * after the sharpness of one of its edges changed. Does nothing if the mesh is
+ * not classified.
+ * @param v Index of the vertex.
+ */
+void Mesh::classifyVertex(int v) {
+  if (!classified) {
+    return;
+  }
+  const Vertex& vertex = vertices[v];
+  if (vertex.out == nullptr) {
+    // Isolated vertex: there is no one-ring to apply the smooth rule to
+    setVertexClass(v, CORNER_VERTEX, 0, -1, -1, 0.0f);
+    return;
+  }
+  int creases[2] = {-1, -1};
+  int count = 0;
+  const HalfEdge* edge = vertex.out;
+  // Outgoing half-edges around a vertex all belong to different edges
+  do {
+    if (edge->isSharpEdge()) {
+      if (count < 2) {
+        creases[count] = edge->index;
+      }
+      count++;
+    }
+    edge = edge->prev->twin;
+  } while (edge != nullptr && edge != vertex.out);
+
+  if (edge == nullptr) {
+    setVertexClass(v, BOUNDARY_VERTEX, 0, -1, -1, 0.0f);
+  } else if (count >= 3) {
+    setVertexClass(v, CORNER_VERTEX, count, creases[0], creases[1], 0.0f);
+  } else if (count == 2) {
+    float blend = creaseBlendFactor(halfEdges[creases[0]].sharpness,
+                                    halfEdges[creases[1]].sharpness);
+    setVertexClass(v, CREASE_VERTEX, count, creases[0], creases[1], blend);
+  } else {
+    setVertexClass(v, SMOOTH_VERTEX, count, creases[0], -1, 0.0f);
+  }
+}
+
+/**
+ * @brief Mesh::clearClassification Discards the vertex classification, for
+ * instance after the sharpness of many edges changed.
+ */
+void Mesh::clearClassification() {
+  classified = false;
+  vertexRules.clear();
+  vertexCreaseCounts.clear();
+  vertexCreaseEdges.clear();
+  vertexCreaseBlends.clear();
+}
+
+/**
+ * @brief Mesh::resizeClassification Sizes the classification arrays and marks
+ * the mesh as classified. The caller must fill in every vertex.
+ * @param numVerts Number of vertices.
+ */
+void Mesh::resizeClassification(int numVerts) {
+  classified = true;
+  vertexRules.resize(numVerts);
+  vertexCreaseCounts.resize(numVerts);
+  vertexCreaseEdges.resize(2 * numVerts);
+  vertexCreaseBlends.resize(numVerts);
+}
+
+/**
+ * @brief Mesh::creaseBlendFactor Calculates how much of the smooth vertex rule
+ * is blended into the crease rule of a vertex with exactly two crease edges.
+ * This is the average of the fractional sharpness of both crease edges, or 0
+ * if either of them is infinitely sharp.
+ * @param sharpness1 Sharpness of the first crease edge.
+ * @param sharpness2 Sharpness of the second crease edge.
+ * @return The blend factor. 0 means the crease rule is used as is.
+ */
+float Mesh::creaseBlendFactor(float sharpness1, float sharpness2) {
+  if (sharpness1 == -1.0f || sharpness2 == -1.0f) {
+    return 0.0f;
+  }
+  return ((sharpness1 - floorf(sharpness1)) +
+          (sharpness2 - floorf(sharpness2))) /
+         2.0f;
+}
+
+/**
+ * @brief Mesh::extractEdgeData Extracts edge indices and colors based on
+ * sharpness for visualization. Red = sharp edge, Yellow = smooth edge. Each
+ * edge is drawn once, from the first of its half-edges, as a line between two
+ * of the extracted vertex coordinates. The buffers are filled in place, see
+ * extractAttributes.
+ */
+void Mesh::extractEdgeData() {
+  edgeIndices.resize(2 * edgeCount);
+  edgeColors.resize(edgeCount);
+  edgeDisplaySlots.fill(-1, edgeCount);
+  edgeSlotHalfEdges.resize(edgeCount);
+
+  int slot = 0;
   for (int h = 0; h < halfEdges.size(); ++h) {
     HalfEdge* edge = &halfEdges[h];
-    int v1 = edge->origin->index;
-    int v2 = edge->next->origin->index;
-    
-    // Create a canonical edge representation (smaller index first)
-    QPair<int, int> edgePair = (v1 < v2) ? QPair<int, int>(v1, v2) : QPair<int, int>(v2, v1);
-    
-    // Only process each edge once
-    if (!processedEdges.contains(edgePair)) {
-      processedEdges.insert(edgePair);
-      
-      // Add edge coordinates
-      edgeCoords.append(vertices[v1].coords);
-      edgeCoords.append(vertices[v2].coords);
-      
-      // Check if this is the selected edge (check both half-edges)
-      bool isSelected = (selectedEdge != nullptr && 
-                         (edge == selectedEdge || edge->twin == selectedEdge));
-      
-      QVector3D color;
-      if (isSelected) {
-        // Highlight selected edge with bright cyan
-        color = QVector3D(0.0f, 1.0f, 1.0f);  // Cyan for selected edge
-      } else {
-        // Determine color based on sharpness
-        float s = edge->sharpness;
-        if (s == -1.0f) {
-          // Infinite sharpness: bright red
-          color = QVector3D(1.0f, 0.0f, 0.0f);
-        } else if (s > 0.0f) {
-          // Semi-sharp or sharp: interpolate from red to yellow based on sharpness
-          float normalized = fmin(fmax(s, 0.0f), 5.0f) / 5.0f;
-          color = QVector3D(1.0f, (1.0f - normalized), 0.0f);
-        } else {
-          // Smooth edge: yellow
-          color = QVector3D(1.0f, 1.0f, 0.0f);
-        }
-      }
-      
-      // Add color for both vertices of the edge
-      edgeColors.append(color);
-      edgeColors.append(color);
+    if (edgeDisplaySlots[edge->edgeIndex] >= 0) {
+      continue;
     }
+    edgeDisplaySlots[edge->edgeIndex] = slot;
+    edgeSlotHalfEdges[slot] = h;
+    edgeIndices[2 * slot] = edge->origin->index;
+    edgeIndices[2 * slot + 1] = edge->next->origin->index;
+    edgeColors[slot] = edgeDisplayColor(*edge);
+    slot++;
   }
-  
-  edgeCoords.squeeze();
-  edgeColors.squeeze();
+  edgeIndices.resize(2 * slot);
+  edgeColors.resize(slot);
+  edgeSlotHalfEdges.resize(slot);
 }
 
 /**
- * @brief Mesh::extractVertexData Extracts vertex coordinates and colors based on
- * whether they are boundary vertices. Blue = boundary vertex, Green = normal vertex.
- * @param selectedVertex Optional pointer to the currently selected vertex for highlighting
+ * @brief Mesh::edgeDisplayColor Gives the color an edge is drawn with, from
+ * yellow for smooth edges to red for sharp ones.
+ * @param edge One of the half-edges of the edge.
+ * @return The color of the edge, see packDisplayColor.
  */
-void Mesh::extractVertexData(Vertex* selectedVertex) {
-  vertexDisplayCoords.clear();
-  vertexDisplayColors.clear();
-  
+quint32 Mesh::edgeDisplayColor(const HalfEdge& edge) {
+  // Determine color based on sharpness
+  float s = edge.sharpness;
+  if (s == -1.0f) {
+    // Infinite sharpness: bright red
+    return packDisplayColor(QVector3D(1.0f, 0.0f, 0.0f));
+  }
+  if (s > 0.0f) {
+    // Semi-sharp or sharp: interpolate from red to yellow based on sharpness
+    float normalized = fmin(fmax(s, 0.0f), 5.0f) / 5.0f;
+    return packDisplayColor(QVector3D(1.0f, (1.0f - normalized), 0.0f));
+  }
+  // Smooth edge: yellow
+  return packDisplayColor(QVector3D(1.0f, 1.0f, 0.0f));
+}
+
+/**
+ * @brief Mesh::packDisplayColor Packs a color into the layout of the edge and
+ * vertex color buffers: one byte per channel in the order red, green, blue and
+ * alpha in memory, as read by an RGBA8 buffer texture.
+ * @param color The color, with channels in [0, 1].
+ * @return The packed, opaque color.
+ */
+quint32 Mesh::packDisplayColor(const QVector3D& color) {
+  quint8 channels[4] = {0, 0, 0, 255};
+  for (int k = 0; k < 3; k++) {
+    channels[k] = quint8(qBound(0.0f, color[k], 1.0f) * 255.0f + 0.5f);
+  }
+  quint32 packed;
+  memcpy(&packed, channels, sizeof(packed));
+  return packed;
+}
+
+/**
+ * @brief Mesh::extractVertexData Extracts vertex colors based on whether they
+ * are boundary vertices. Blue = boundary vertex, Green = normal vertex.
+ * Vertices are drawn in index order, at the extracted vertex coordinates.
+ */
+void Mesh::extractVertexData() {
+  const quint32 boundaryColor = packDisplayColor(QVector3D(0.0f, 0.0f, 1.0f));
+  const quint32 interiorColor = packDisplayColor(QVector3D(0.0f, 1.0f, 0.0f));
+  vertexColors.resize(vertices.size());
   for (int v = 0; v < vertices.size(); ++v) {
-    Vertex* vertex = &vertices[v];
-    
-    // Add vertex coordinates
-    vertexDisplayCoords.append(vertex->coords);
-    
-    // Check if this is the selected vertex
-    bool isSelected = (selectedVertex != nullptr && vertex == selectedVertex);
-    
-    QVector3D color;
-    if (isSelected) {
-      // Highlight selected vertex with bright magenta
-      color = QVector3D(1.0f, 0.0f, 1.0f);  // Magenta for selected vertex
-    } else if (vertex->isBoundaryVertex()) {
-      color = QVector3D(0.0f, 0.0f, 1.0f);  // Blue for boundary vertices
-    } else {
-      color = QVector3D(0.0f, 1.0f, 0.0f);  // Green for normal vertices
-    }
-    
-    vertexDisplayColors.append(color);
+    vertexColors[v] =
+        vertices[v].isBoundaryVertex() ? boundaryColor : interiorColor;
   }
-  
-  vertexDisplayCoords.squeeze();
-  vertexDisplayColors.squeeze();
 }
@@ -13,6 +13,20 @@
  */
 class Mesh {
  public:
+  /**
+   * @brief The VertexRule enum is the subdivision rule of a vertex. Interior
+   * vertices with zero or one crease edge are smooth, with two crease edges
+   * they are crease vertices and with three or more they are corners.
+   * Isolated vertices, which are not referenced by any face, are corners as
+   * well, so they keep their position.
+   */
+  enum VertexRule : quint8 {
+    SMOOTH_VERTEX,
+    CREASE_VERTEX,
+    CORNER_VERTEX,
+    BOUNDARY_VERTEX
+  };
+
   Mesh();
   ~Mesh();
 
@@ -22,56 +36,120 @@ class Mesh {
 
   inline QVector<QVector3D>& getVertexCoords() { return vertexCoords; }
   inline QVector<QVector3D>& getVertexNorms() { return vertexNormals; }
-  inline QVector<unsigned int>& getPolyIndices() { return polyIndices; }
-  inline QVector<unsigned int>& getQuadIndices() { return quadIndices; }
-  inline QVector<QVector3D>& getEdgeCoords() { return edgeCoords; }
-  inline QVector<QVector3D>& getEdgeColors() { return edgeColors; }
-  inline QVector<QVector3D>& getVertexDisplayCoords() { return vertexDisplayCoords; }
-  inline QVector<QVector3D>& getVertexDisplayColors() { return vertexDisplayColors; }
-
-  void extractAttributes(HalfEdge* selectedEdge = nullptr, Vertex* selectedVertex = nullptr);
+  inline QVector<unsigned int>& getTriangleIndices() {
+    return triangleIndices;
+  }
+  inline QVector<unsigned int>& getEdgeIndices() { return edgeIndices; }
+  inline QVector<quint32>& getEdgeColors() { return edgeColors; }
+  inline QVector<quint32>& getVertexColors() { return vertexColors; }
+
+  void extractAttributes(bool limitPositions = false);
   void recalculateNormals();
   void projectVerticesToCatmullClarkLimit();
+  void evaluateLimit(QVector<QVector3D>& positions,
+                     QVector<QVector3D>* normals = nullptr);
+
+  void classifyVertices();
+  void classifyVertex(int v);
+  void clearClassification();
+  inline bool isClassified() const { return classified; }
+  inline VertexRule vertexRule(int v) const {
+    return VertexRule(vertexRules[v]);
+  }
+  // Number of crease edges of an interior vertex; 0 for boundary vertices
+  inline int numCreaseEdges(int v) const { return vertexCreaseCounts[v]; }
+  // Outgoing half-edge of the first (k = 0) or second crease edge, or -1
+  inline int creaseHalfEdge(int v, int k) const {
+    return vertexCreaseEdges[2 * v + k];
+  }
+  inline float creaseBlend(int v) const { return vertexCreaseBlends[v]; }
+  static float creaseBlendFactor(float sharpness1, float sharpness2);
+
+  // True if every face is a quad whose half-edges are 4f to 4f + 3 in order,
+  // as in every subdivided mesh
+  inline bool isQuadMesh() const { return quadMesh; }
 
   int numVerts();
   int numHalfEdges();
   int numFaces();
   int numEdges();
 
-  void backupOriginalCoordsIfNeeded();
-  void restoreOriginalCoords();
+  void releaseDisplayData();
+  qint64 memoryFootprint() const;
+  void clear();
+  void reserve(int numVerts, int numHalfEdges, int numFaces);
+  qint64 capacityFootprint() const;
+
+  static quint32 edgeDisplayColor(const HalfEdge& edge);
+  static quint32 packDisplayColor(const QVector3D& color);
+  // Position of an edge in the edge buffers, or -1 if it is not drawn. The
+  // indices of its vertices are at 2 * slot, its color at slot
+  inline int edgeDisplaySlot(int edgeIndex) const {
+    return edgeIndex < edgeDisplaySlots.size() ? edgeDisplaySlots[edgeIndex]
+                                               : -1;
+  }
+  // Index of the half-edge an edge slot was extracted from
+  inline int edgeSlotHalfEdge(int slot) const {
+    return edgeSlotHalfEdges[slot];
+  }
+  inline int numEdgeSlots() const { return edgeSlotHalfEdges.size(); }
 
   // Utility function to set crease edges (for testing semi-sharp creases)
   // Sets sharpness for all half-edges of edges connecting the specified vertices
   void setCreaseEdge(int vertexIdx1, int vertexIdx2, float sharpness);
 
  private:
-  void extractEdgeData(HalfEdge* selectedEdge = nullptr);  // Extracts edge coordinates and colors for visualization
-  void extractVertexData(Vertex* selectedVertex = nullptr);  // Extracts vertex coordinates and colors for visualization
+  void extractEdgeData();  // Extracts edge indices and colors for visualization
+  void extractVertexData();  // Extracts vertex colors for visualization
+  void copyCoords(QVector3D* coords) const;
+  void gatherNormals(const QVector3D* coords);
+  static QVector<QVector3D>& coordScratch();
+  void resizeClassification(int numVerts);
+  inline void setVertexClass(int v, VertexRule rule, int numCreaseEdges,
+                             int crease1, int crease2, float blend) {
+    vertexRules[v] = rule;
+    vertexCreaseCounts[v] = quint8(qMin(numCreaseEdges, 255));
+    vertexCreaseEdges[2 * v] = crease1;
+    vertexCreaseEdges[2 * v + 1] = crease2;
+    vertexCreaseBlends[v] = blend;
+  }
+
+  // Shared by the faces, edges and vertices that are drawn
   QVector<QVector3D> vertexCoords;
   QVector<QVector3D> vertexNormals;
-  QVector<unsigned int> polyIndices;
-  // for quad tessellation
-  QVector<unsigned int> quadIndices;
-  QVector<QVector3D> originalCoords;
-  // for edge visualization
-  QVector<QVector3D> edgeCoords;
-  QVector<QVector3D> edgeColors;
-  // for vertex visualization
-  QVector<QVector3D> vertexDisplayCoords;
-  QVector<QVector3D> vertexDisplayColors;
+  // Every face as a fan of triangles
+  QVector<unsigned int> triangleIndices;
+  // for edge visualization: two vertex indices and one color per edge slot
+  QVector<unsigned int> edgeIndices;
+  QVector<quint32> edgeColors;
+  // Kept after releaseDisplayData for partial updates of the edge colors and
+  // for picking
+  QVector<int> edgeDisplaySlots;
+  QVector<int> edgeSlotHalfEdges;
+  // for vertex visualization: one color per vertex
+  QVector<quint32> vertexColors;
 
   QVector<Vertex> vertices;
   QVector<Face> faces;
   QVector<HalfEdge> halfEdges;
 
   int edgeCount;
+  bool quadMesh = false;
+
+  // Per-vertex classification, see classifyVertices
+  bool classified = false;
+  QVector<quint8> vertexRules;
+  QVector<quint8> vertexCreaseCounts;
+  QVector<int> vertexCreaseEdges;  // Two entries per vertex
+  QVector<float> vertexCreaseBlends;
 
   // These classes require access to the private fields to prevent a bunch of
   // function calls.
   friend class MeshInitializer;
+  friend class MeshReorderer;
   friend class Subdivider;
   friend class CatmullClarkSubdivider;
+  friend class CompactMesh;
 };
 
 #endif  // MESH_H
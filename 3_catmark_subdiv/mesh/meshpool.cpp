@@ -0,0 +1,136 @@
+#include "meshpool.h"
+
+/**
+ * @brief MeshPool::Sizes::of Gives the element counts of a mesh.
+ * @param mesh The mesh.
+ * @return The sizes of the mesh.
+ */
+MeshPool::Sizes MeshPool::Sizes::of(Mesh& mesh) {
+  Sizes sizes;
+  sizes.numVerts = mesh.numVerts();
+  sizes.numHalfEdges = mesh.numHalfEdges();
+  sizes.numFaces = mesh.numFaces();
+  sizes.numEdges = mesh.numEdges();
+  return sizes;
+}
+
+/**
+ * @brief MeshPool::Sizes::subdivided Gives the element counts after a single
+ * Catmull-Clark step: every vertex, face and edge gives a vertex, every
+ * half-edge four half-edges and a face, and every edge is split into two edges
+ * plus one new edge per half-edge.
+ * @return The sizes of the subdivided mesh.
+ */
+MeshPool::Sizes MeshPool::Sizes::subdivided() const {
+  Sizes sizes;
+  sizes.numVerts = numVerts + numFaces + numEdges;
+  sizes.numHalfEdges = 4 * numHalfEdges;
+  sizes.numFaces = numHalfEdges;
+  sizes.numEdges = 2 * numEdges + numHalfEdges;
+  return sizes;
+}
+
+/**
+ * @brief MeshPool::MeshPool Creates an empty pool.
+ */
+MeshPool::MeshPool() {}
+
+/**
+ * @brief MeshPool::~MeshPool Deconstructor. Deletes all pooled meshes.
+ */
+MeshPool::~MeshPool() { clear(); }
+
+/**
+ * @brief MeshPool::acquire Takes an empty mesh from the pool for a mesh of the
+ * given sizes. Of the pooled meshes with enough storage, the one with the
+ * least storage is taken, so smaller requests do not use up the storage of
+ * large levels. If no pooled mesh is large enough, a new mesh is created with
+ * the storage reserved, see Mesh::reserve.
+ * @param sizes The sizes of the mesh that will be written into it.
+ * @return An empty mesh. The caller takes ownership of it.
+ */
+Mesh* MeshPool::acquire(const Sizes& sizes) {
+  int best = -1;
+  qint64 bestSize = 0;
+  for (int k = 0; k < meshes.size(); k++) {
+    Mesh* mesh = meshes[k];
+    if (mesh->getVertices().capacity() < sizes.numVerts ||
+        mesh->getHalfEdges().capacity() < sizes.numHalfEdges ||
+        mesh->getFaces().capacity() < sizes.numFaces) {
+      continue;
+    }
+    qint64 size = mesh->capacityFootprint();
+    if (best < 0 || size < bestSize) {
+      best = k;
+      bestSize = size;
+    }
+  }
+  if (best < 0) {
+    Mesh* mesh = new Mesh();
+    mesh->reserve(sizes.numVerts, sizes.numHalfEdges, sizes.numFaces);
+    return mesh;
+  }
+  Mesh* mesh = meshes[best];
+  meshes[best] = meshes.last();
+  meshes.removeLast();
+  return mesh;
+}
+
+/**
+ * @brief MeshPool::release Returns a mesh to the pool. The mesh is emptied, see
+ * Mesh::clear, and may be handed out again by acquire.
+ * @param mesh The mesh. The pool takes ownership of it. May be nullptr.
+ */
+void MeshPool::release(Mesh* mesh) {
+  if (mesh == nullptr) {
+    return;
+  }
+  mesh->clear();
+  meshes.append(mesh);
+}
+
+/**
+ * @brief MeshPool::trim Deletes the largest pooled meshes until the pool fits
+ * within a budget.
+ * @param budget The number of bytes the pooled meshes may use. May be
+ * negative, in which case the pool is emptied.
+ */
+void MeshPool::trim(qint64 budget) {
+  qint64 total = memoryFootprint();
+  while (!meshes.isEmpty() && total > budget) {
+    int largest = 0;
+    for (int k = 1; k < meshes.size(); k++) {
+      if (meshes[k]->capacityFootprint() >
+          meshes[largest]->capacityFootprint()) {
+        largest = k;
+      }
+    }
+    total -= meshes[largest]->capacityFootprint();
+    delete meshes[largest];
+    meshes[largest] = meshes.last();
+    meshes.removeLast();
+  }
+}
+
+/**
+ * @brief MeshPool::clear Deletes all pooled meshes.
+ */
+void MeshPool::clear() {
+  for (Mesh* mesh : meshes) {
+    delete mesh;
+  }
+  meshes.clear();
+}
+
+/**
+ * @brief MeshPool::memoryFootprint Calculates the number of bytes allocated by
+ * the pooled meshes.
+ * @return The total size in bytes.
+ */
+qint64 MeshPool::memoryFootprint() const {
+  qint64 total = 0;
+  for (const Mesh* mesh : meshes) {
+    total += mesh->capacityFootprint();
+  }
+  return total;
+}
@@ -0,0 +1,52 @@
+#ifndef MESH_POOL_H
+#define MESH_POOL_H
+
+#include <QVector>
+
+#include "mesh.h"
+
+/**
+ * @brief The MeshPool class keeps meshes that are no longer needed, emptied
+ * but with their storage, so that new subdivision levels can be written into
+ * it instead of allocating. The sizes of a level follow from its parent, see
+ * Sizes::subdivided, so the storage of every level can be chosen before it is
+ * generated. Once the pool holds the storage of a ladder of levels, for
+ * instance after the levels of the previous model were released, generating
+ * the ladder again allocates no half-edge data; the display buffers are reused
+ * as long as they were not released with Mesh::releaseDisplayData.
+ *
+ * The pool is not thread-safe, but a mesh that was acquired may be filled on
+ * any thread.
+ */
+class MeshPool {
+ public:
+  /**
+   * @brief The Sizes struct holds the element counts of a mesh.
+   */
+  struct Sizes {
+    int numVerts = 0;
+    int numHalfEdges = 0;
+    int numFaces = 0;
+    int numEdges = 0;
+
+    static Sizes of(Mesh& mesh);
+    Sizes subdivided() const;
+  };
+
+  MeshPool();
+  ~MeshPool();
+
+  Mesh* acquire(const Sizes& sizes);
+  void release(Mesh* mesh);
+  void trim(qint64 budget);
+  void clear();
+
+  qint64 memoryFootprint() const;
+  inline int numMeshes() const { return meshes.size(); }
+
+ private:
+  // Empty meshes, each with the storage it had when it was released
+  QVector<Mesh*> meshes;
+};
+
+#endif  // MESH_POOL_H
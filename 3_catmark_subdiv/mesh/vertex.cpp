@@ -69,10 +69,14 @@ HalfEdge* Vertex::prevBoundaryHalfEdge() const {
 /**
  * @brief Vertex::isBoundaryVertex Determines whether this vertex lies on a
  * boundary or not.
- * @return True if the vertex lies on a boundary; false otherwise.
+ * @return True if the vertex lies on a boundary; false otherwise, also for an
+ * isolated vertex.
  */
 bool Vertex::isBoundaryVertex() const {
   HalfEdge* h = out;
+  if (h == nullptr) {
+    return false;
+  }
   if (h->isBoundaryEdge()) {
     return true;
   }
@@ -0,0 +1,132 @@
+#include "dynamicbuffer.h"
+
+#include <string.h>
+
+/**
+ * @brief DynamicBuffer::DynamicBuffer Creates an empty dynamic buffer. It can
+ * only be used after a call to create.
+ */
+DynamicBuffer::DynamicBuffer()
+    : gl(nullptr),
+      target(GL_ARRAY_BUFFER),
+      id(0),
+      size(0),
+      capacity(0),
+      stagingId(0),
+      stagingCapacity(0),
+      stagingHead(0) {}
+
+/**
+ * @brief DynamicBuffer::create Creates the OpenGL buffer. The context of the
+ * functions must be current.
+ * @param gl OpenGL functions pointer.
+ * @param target The target the buffer is bound to, such as GL_ARRAY_BUFFER.
+ */
+void DynamicBuffer::create(QOpenGLFunctions_4_1_Core* gl, GLenum target) {
+  this->gl = gl;
+  this->target = target;
+  gl->glGenBuffers(1, &id);
+}
+
+/**
+ * @brief DynamicBuffer::destroy Deletes the OpenGL buffer and its staging
+ * ring.
+ */
+void DynamicBuffer::destroy() {
+  if (gl != nullptr) {
+    gl->glDeleteBuffers(1, &id);
+    if (stagingId != 0) {
+      gl->glDeleteBuffers(1, &stagingId);
+    }
+  }
+  id = 0;
+  size = 0;
+  capacity = 0;
+  stagingId = 0;
+  stagingCapacity = 0;
+  stagingHead = 0;
+}
+
+/**
+ * @brief DynamicBuffer::setData Replaces the contents of the buffer. The
+ * storage is orphaned, so draws that still use the old contents do not block
+ * the upload.
+ * @param data The new contents.
+ * @param size The size of the new contents in bytes.
+ */
+void DynamicBuffer::setData(const void* data, qint64 size) {
+  this->size = size;
+  if (size > capacity) {
+    allocate(size);
+  } else {
+    bind();
+    gl->glBufferData(target, capacity, nullptr, GL_DYNAMIC_DRAW);
+  }
+  if (size > 0) {
+    gl->glBufferSubData(target, 0, size, data);
+  }
+}
+
+/**
+ * @brief DynamicBuffer::updateRange Overwrites part of the buffer, without
+ * passing the rest of the contents. The range goes through the staging ring,
+ * see DynamicBuffer. It must lie within the size of the last setData call.
+ * @param offset Offset of the range in bytes.
+ * @param data The new contents of the range.
+ * @param size The size of the range in bytes.
+ */
+void DynamicBuffer::updateRange(qint64 offset, const void* data,
+                                qint64 size) {
+  if (size <= 0 || offset < 0 || offset + size > this->size) {
+    return;
+  }
+  if (stagingId == 0) {
+    gl->glGenBuffers(1, &stagingId);
+  }
+  gl->glBindBuffer(GL_COPY_READ_BUFFER, stagingId);
+  if (stagingHead + size > stagingCapacity) {
+    // Copies that still read the ring keep the old storage, and none of the
+    // new storage is in use
+    stagingCapacity =
+        qMax(qint64(DYNAMIC_BUFFER_STAGING_SIZE), qMax(stagingCapacity, size));
+    gl->glBufferData(GL_COPY_READ_BUFFER, stagingCapacity, nullptr,
+                     GL_STREAM_DRAW);
+    stagingHead = 0;
+  }
+  // The region was not written since the storage was orphaned, so no pending
+  // copy reads it and the map does not have to wait
+  void* region = gl->glMapBufferRange(
+      GL_COPY_READ_BUFFER, stagingHead, size,
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+          GL_MAP_UNSYNCHRONIZED_BIT);
+  bool staged = false;
+  if (region != nullptr) {
+    memcpy(region, data, size_t(size));
+    staged = gl->glUnmapBuffer(GL_COPY_READ_BUFFER) == GL_TRUE;
+  }
+  if (staged) {
+    gl->glBindBuffer(GL_COPY_WRITE_BUFFER, id);
+    gl->glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                            stagingHead, offset, size);
+    gl->glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    const qint64 alignment = DYNAMIC_BUFFER_STAGING_ALIGNMENT;
+    stagingHead += (size + alignment - 1) / alignment * alignment;
+  } else {
+    // The ring lost its contents; write directly and start over next time
+    stagingHead = stagingCapacity;
+    bind();
+    gl->glBufferSubData(target, offset, size, data);
+  }
+  gl->glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+/**
+ * @brief DynamicBuffer::allocate Grows the storage of the buffer by at least
+ * half, discarding its contents.
+ * @param minimumCapacity The minimum new capacity in bytes.
+ */
+void DynamicBuffer::allocate(qint64 minimumCapacity) {
+  capacity = qMax(minimumCapacity, capacity + capacity / 2);
+  bind();
+  gl->glBufferData(target, capacity, nullptr, GL_DYNAMIC_DRAW);
+}
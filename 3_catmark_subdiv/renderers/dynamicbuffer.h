@@ -0,0 +1,57 @@
+#ifndef DYNAMIC_BUFFER_H
+#define DYNAMIC_BUFFER_H
+
+#include <QOpenGLFunctions_4_1_Core>
+
+// Initial size of the staging ring of a DynamicBuffer in bytes
+#define DYNAMIC_BUFFER_STAGING_SIZE (64 * 1024)
+// Alignment of the ranges in the staging ring in bytes
+#define DYNAMIC_BUFFER_STAGING_ALIGNMENT 16
+
+/**
+ * @brief The DynamicBuffer class wraps an OpenGL buffer whose contents are
+ * replaced or partially updated often. The allocation only grows, so the
+ * buffer name and the vertex array and texture bindings referring to it stay
+ * valid.
+ *
+ * setData replaces the whole contents. The storage is orphaned first, so the
+ * driver hands out fresh storage instead of waiting for draws that still read
+ * the old contents. updateRange writes a range that the caller knows has
+ * changed. It never writes into the live buffer from the CPU: the range is
+ * written into an unused region of a staging ring, mapped unsynchronized, and
+ * copied into place on the GPU, after the draws submitted before it. When the
+ * ring is full its storage is orphaned as well, so the CPU never waits for the
+ * GPU.
+ */
+class DynamicBuffer {
+ public:
+  DynamicBuffer();
+
+  void create(QOpenGLFunctions_4_1_Core* gl, GLenum target);
+  void destroy();
+
+  void setData(const void* data, qint64 size);
+  void updateRange(qint64 offset, const void* data, qint64 size);
+
+  inline void bind() const { gl->glBindBuffer(target, id); }
+  inline GLuint getId() const { return id; }
+  inline qint64 getSize() const { return size; }
+  inline qint64 getCapacity() const { return capacity; }
+
+ private:
+  void allocate(qint64 minimumCapacity);
+
+  QOpenGLFunctions_4_1_Core* gl;
+  GLenum target;
+  GLuint id;
+  qint64 size;
+  qint64 capacity;
+
+  // Staging ring of updateRange, created on first use. Everything before the
+  // head has been written since the storage was last orphaned.
+  GLuint stagingId;
+  qint64 stagingCapacity;
+  qint64 stagingHead;
+};
+
+#endif  // DYNAMIC_BUFFER_H
@@ -3,30 +3,53 @@
 #include <cmath>
 #include <algorithm>
 
+#include "util/profiler.h"
+
+// Colors of the selected edge and vertex
+static const QVector3D EDGE_HIGHLIGHT_COLOR(0.0f, 1.0f, 1.0f);
+static const QVector3D VERTEX_HIGHLIGHT_COLOR(1.0f, 0.0f, 1.0f);
+
 /**
  * @brief MeshRenderer::MeshRenderer Creates a new mesh renderer.
  */
-MeshRenderer::MeshRenderer() : meshIBOSize(0), edgeVertexCount(0), vertexDisplayCount(0), edgeShader(nullptr) {}
+MeshRenderer::MeshRenderer()
+    : meshIBOSize(0),
+      wireIndexCount(0),
+      wireIndexOffset(0),
+      edgeIndexCount(0),
+      vertexDisplayCount(0),
+      highlightedEdgeSlot(-1),
+      highlightedVertex(-1),
+      edgeShader(nullptr),
+      pickShader(nullptr),
+      pickWidth(0),
+      pickHeight(0) {}
 
 /**
  * @brief MeshRenderer::~MeshRenderer Deconstructor.
  */
 MeshRenderer::~MeshRenderer() {
   gl->glDeleteVertexArrays(1, &vao);
+  gl->glDeleteVertexArrays(1, &wireVAO);
   gl->glDeleteVertexArrays(1, &edgeVAO);
   gl->glDeleteVertexArrays(1, &vertexVAO);
+  gl->glDeleteTextures(1, &edgeColorsTexture);
+  gl->glDeleteTextures(1, &vertexColorsTexture);
 
-  gl->glDeleteBuffers(1, &meshCoordsBO);
-  gl->glDeleteBuffers(1, &meshNormalsBO);
-  gl->glDeleteBuffers(1, &meshIndexBO);
-  gl->glDeleteBuffers(1, &edgeCoordsBO);
-  gl->glDeleteBuffers(1, &edgeColorsBO);
-  gl->glDeleteBuffers(1, &vertexCoordsBO);
-  gl->glDeleteBuffers(1, &vertexColorsBO);
+  meshCoordsBuffer.destroy();
+  meshNormalsBuffer.destroy();
+  meshIndexBuffer.destroy();
+  edgeIndexBuffer.destroy();
+  edgeColorsBuffer.destroy();
+  vertexColorsBuffer.destroy();
   
   if (edgeShader) {
     delete edgeShader;
   }
+  delete pickShader;
+  gl->glDeleteFramebuffers(1, &pickFBO);
+  gl->glDeleteRenderbuffers(1, &pickColorRB);
+  gl->glDeleteRenderbuffers(1, &pickDepthRB);
 }
 
 /**
@@ -42,140 +65,372 @@ void MeshRenderer::initShaders() {
   edgeShader->addShaderFromSourceFile(QOpenGLShader::Vertex, pathVert);
   edgeShader->addShaderFromSourceFile(QOpenGLShader::Fragment, pathFrag);
   edgeShader->link();
+
+  pickShader = new QOpenGLShaderProgram();
+  pickShader->addShaderFromSourceFile(QOpenGLShader::Vertex,
+                                      ":/shaders/pick.vert");
+  pickShader->addShaderFromSourceFile(QOpenGLShader::Fragment,
+                                      ":/shaders/pick.frag");
+  pickShader->link();
 }
 
 /**
  * @brief MeshRenderer::initBuffers Initializes the buffers. Uses indexed
- * rendering. The coordinates and normals are passed into the shaders.
+ * rendering. The coordinates and normals are passed into the shaders; the
+ * edge and vertex colors are bound as buffer textures in draw.
  */
 void MeshRenderer::initBuffers() {
   gl->glGenVertexArrays(1, &vao);
   gl->glBindVertexArray(vao);
 
-  gl->glGenBuffers(1, &meshCoordsBO);
-  gl->glBindBuffer(GL_ARRAY_BUFFER, meshCoordsBO);
+  meshCoordsBuffer.create(gl, GL_ARRAY_BUFFER);
+  meshCoordsBuffer.bind();
   gl->glEnableVertexAttribArray(0);
   gl->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
 
-  gl->glGenBuffers(1, &meshNormalsBO);
-  gl->glBindBuffer(GL_ARRAY_BUFFER, meshNormalsBO);
+  meshNormalsBuffer.create(gl, GL_ARRAY_BUFFER);
+  meshNormalsBuffer.bind();
   gl->glEnableVertexAttribArray(1);
   gl->glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
 
-  gl->glGenBuffers(1, &meshIndexBO);
-  gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshIndexBO);
+  meshIndexBuffer.create(gl, GL_ELEMENT_ARRAY_BUFFER);
+  meshIndexBuffer.bind();
 
   gl->glBindVertexArray(0);
-  
+
+  // The wireframe draws the edge indices with the attributes of the surface
+  gl->glGenVertexArrays(1, &wireVAO);
+  gl->glBindVertexArray(wireVAO);
+
+  meshCoordsBuffer.bind();
+  gl->glEnableVertexAttribArray(0);
+  gl->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+  meshNormalsBuffer.bind();
+  gl->glEnableVertexAttribArray(1);
+  gl->glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+  edgeIndexBuffer.create(gl, GL_ELEMENT_ARRAY_BUFFER);
+  edgeIndexBuffer.bind();
+
+  gl->glBindVertexArray(0);
+
   // Initialize edge rendering buffers
   gl->glGenVertexArrays(1, &edgeVAO);
   gl->glBindVertexArray(edgeVAO);
-  
-  gl->glGenBuffers(1, &edgeCoordsBO);
-  gl->glBindBuffer(GL_ARRAY_BUFFER, edgeCoordsBO);
+
+  meshCoordsBuffer.bind();
   gl->glEnableVertexAttribArray(0);
   gl->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-  
-  gl->glGenBuffers(1, &edgeColorsBO);
-  gl->glBindBuffer(GL_ARRAY_BUFFER, edgeColorsBO);
-  gl->glEnableVertexAttribArray(1);
-  gl->glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-  
+  edgeIndexBuffer.bind();
+
   gl->glBindVertexArray(0);
-  
+
   // Initialize vertex rendering buffers
   gl->glGenVertexArrays(1, &vertexVAO);
   gl->glBindVertexArray(vertexVAO);
-  
-  gl->glGenBuffers(1, &vertexCoordsBO);
-  gl->glBindBuffer(GL_ARRAY_BUFFER, vertexCoordsBO);
+
+  meshCoordsBuffer.bind();
   gl->glEnableVertexAttribArray(0);
   gl->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-  
-  gl->glGenBuffers(1, &vertexColorsBO);
-  gl->glBindBuffer(GL_ARRAY_BUFFER, vertexColorsBO);
-  gl->glEnableVertexAttribArray(1);
-  gl->glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-  
+
   gl->glBindVertexArray(0);
+
+  // One packed RGBA8 color per edge and per vertex, read by primitive index.
+  // Binding a buffer creates it, so it can be attached to its texture.
+  edgeColorsBuffer.create(gl, GL_TEXTURE_BUFFER);
+  edgeColorsBuffer.bind();
+  gl->glGenTextures(1, &edgeColorsTexture);
+  gl->glBindTexture(GL_TEXTURE_BUFFER, edgeColorsTexture);
+  gl->glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA8, edgeColorsBuffer.getId());
+
+  vertexColorsBuffer.create(gl, GL_TEXTURE_BUFFER);
+  vertexColorsBuffer.bind();
+  gl->glGenTextures(1, &vertexColorsTexture);
+  gl->glBindTexture(GL_TEXTURE_BUFFER, vertexColorsTexture);
+  gl->glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA8, vertexColorsBuffer.getId());
+
+  gl->glBindTexture(GL_TEXTURE_BUFFER, 0);
+  gl->glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+  // The picking attachments get their storage in resizePickBuffers
+  gl->glGenFramebuffers(1, &pickFBO);
+  gl->glGenRenderbuffers(1, &pickColorRB);
+  gl->glGenRenderbuffers(1, &pickDepthRB);
 }
 
 /**
  * @brief MeshRenderer::updateBuffers Updates the buffers based on the provided
- * mesh.
+ * mesh. The buffers keep their allocations, see DynamicBuffer. Use
+ * updatePositions or updateEdgeColor when only part of the mesh changed.
  * @param mesh The mesh to update the buffer contents with.
  */
 void MeshRenderer::updateBuffers(Mesh& mesh) {
+  ProfileScope scope("MeshRenderer::updateBuffers");
   QVector<QVector3D>& vertexCoords = mesh.getVertexCoords();
   QVector<QVector3D>& vertexNormals = mesh.getVertexNorms();
-  QVector<unsigned int>& polyIndices = mesh.getPolyIndices();
-
-  gl->glBindBuffer(GL_ARRAY_BUFFER, meshCoordsBO);
-  gl->glBufferData(GL_ARRAY_BUFFER, sizeof(QVector3D) * vertexCoords.size(),
-                   vertexCoords.data(), GL_STATIC_DRAW);
+  QVector<unsigned int>& triangleIndices = mesh.getTriangleIndices();
 
-  gl->glBindBuffer(GL_ARRAY_BUFFER, meshNormalsBO);
-  gl->glBufferData(GL_ARRAY_BUFFER, sizeof(QVector3D) * vertexNormals.size(),
-                   vertexNormals.data(), GL_STATIC_DRAW);
+  // Draw the surface from the buffers of this renderer again, see
+  // setSurfaceBuffers
+  bindSurface(meshCoordsBuffer.getId(), 0, meshIndexBuffer.getId(),
+              edgeIndexBuffer.getId());
 
-  gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshIndexBO);
-  gl->glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                   sizeof(unsigned int) * polyIndices.size(),
-                   polyIndices.data(), GL_STATIC_DRAW);
+  meshCoordsBuffer.setData(vertexCoords.data(),
+                           sizeof(QVector3D) * vertexCoords.size());
+  meshNormalsBuffer.setData(vertexNormals.data(),
+                            sizeof(QVector3D) * vertexNormals.size());
+  meshIndexBuffer.setData(triangleIndices.data(),
+                          sizeof(unsigned int) * triangleIndices.size());
+  meshIBOSize = triangleIndices.size();
 
-  meshIBOSize = polyIndices.size();
-  
   // Update edge buffers
-  QVector<QVector3D>& edgeCoords = mesh.getEdgeCoords();
-  QVector<QVector3D>& edgeColors = mesh.getEdgeColors();
-  
-  gl->glBindVertexArray(edgeVAO);
-  
-  gl->glBindBuffer(GL_ARRAY_BUFFER, edgeCoordsBO);
-  if (!edgeCoords.empty()) {
-    gl->glBufferData(GL_ARRAY_BUFFER, sizeof(QVector3D) * edgeCoords.size(),
-                     edgeCoords.data(), GL_STATIC_DRAW);
-  } else {
-    gl->glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+  QVector<unsigned int>& edgeIndices = mesh.getEdgeIndices();
+  QVector<quint32>& edgeColors = mesh.getEdgeColors();
+  edgeIndexBuffer.setData(edgeIndices.data(),
+                          sizeof(unsigned int) * edgeIndices.size());
+  edgeColorsBuffer.setData(edgeColors.data(),
+                           sizeof(quint32) * edgeColors.size());
+  edgeIndexCount = edgeIndices.size();
+  wireIndexCount = edgeIndexCount;
+  wireIndexOffset = 0;
+
+  // Update vertex display buffers
+  QVector<quint32>& vertexColors = mesh.getVertexColors();
+  vertexColorsBuffer.setData(vertexColors.data(),
+                             sizeof(quint32) * vertexColors.size());
+  vertexDisplayCount = vertexColors.size();
+}
+
+/**
+ * @brief MeshRenderer::updatePositions Updates only the vertex coordinates and
+ * normals, for instance when switching to the limit positions. The indices and
+ * colors of the last updateBuffers call are kept, and so is a surface set by
+ * setSurfaceBuffers.
+ * @param mesh The mesh the buffers were last updated with. Its attributes must
+ * have been extracted again.
+ */
+void MeshRenderer::updatePositions(Mesh& mesh) {
+  ProfileScope scope("MeshRenderer::updatePositions");
+  QVector<QVector3D>& vertexCoords = mesh.getVertexCoords();
+  QVector<QVector3D>& vertexNormals = mesh.getVertexNorms();
+  meshCoordsBuffer.setData(vertexCoords.data(),
+                           sizeof(QVector3D) * vertexCoords.size());
+  meshNormalsBuffer.setData(vertexNormals.data(),
+                            sizeof(QVector3D) * vertexNormals.size());
+}
+
+/**
+ * @brief MeshRenderer::bindSurface Points the vertex arrays of the surface and
+ * the wireframe at a vertex and index buffer.
+ * @param vertexBuffer Buffer with the vertex coordinates at the start of every
+ * vertex.
+ * @param stride Size of a vertex in bytes, or 0 if the coordinates are packed.
+ * @param triangleBuffer Buffer with the triangle indices.
+ * @param lineBuffer Buffer with the line indices of the wireframe.
+ */
+void MeshRenderer::bindSurface(GLuint vertexBuffer, int stride,
+                               GLuint triangleBuffer, GLuint lineBuffer) {
+  gl->glBindVertexArray(vao);
+  gl->glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+  gl->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, nullptr);
+  gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, triangleBuffer);
+  gl->glBindVertexArray(wireVAO);
+  gl->glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+  gl->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, nullptr);
+  gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lineBuffer);
+  gl->glBindVertexArray(0);
+}
+
+/**
+ * @brief MeshRenderer::updateEdgeColor Re-uploads the color of a single edge,
+ * using the layout of the last full update of the edge buffers. Only the four
+ * bytes of the color are written, see DynamicBuffer::updateRange.
+ * @param mesh The mesh the edge buffers were last updated with.
+ * @param edge One of the half-edges of the edge.
+ */
+void MeshRenderer::updateEdgeColor(Mesh& mesh, const HalfEdge& edge) {
+  int slot = mesh.edgeDisplaySlot(edge.edgeIndex);
+  if (slot < 0) {
+    return;
   }
-  
-  gl->glBindBuffer(GL_ARRAY_BUFFER, edgeColorsBO);
-  if (!edgeColors.empty()) {
-    gl->glBufferData(GL_ARRAY_BUFFER, sizeof(QVector3D) * edgeColors.size(),
-                     edgeColors.data(), GL_STATIC_DRAW);
-  } else {
-    gl->glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+  quint32 color = Mesh::edgeDisplayColor(edge);
+  edgeColorsBuffer.updateRange(slot * sizeof(quint32), &color, sizeof(color));
+}
+
+/**
+ * @brief MeshRenderer::setSurfaceBuffers Draws the surface from buffers that
+ * were filled elsewhere, such as by the GPUSubdivider, instead of the buffers
+ * of the last updateBuffers call. The edge and vertex buffers are unchanged.
+ * The next call to updateBuffers switches back.
+ * @param vertexBuffer Buffer with the vertex coordinates at the start of every
+ * vertex.
+ * @param stride Size of a vertex in bytes.
+ * @param indexBuffer Buffer with the triangle indices, followed by the line
+ * indices of the wireframe.
+ * @param triangleIndexCount Number of triangle indices.
+ * @param lineIndexCount Number of line indices.
+ */
+void MeshRenderer::setSurfaceBuffers(GLuint vertexBuffer, int stride,
+                                     GLuint indexBuffer,
+                                     int triangleIndexCount,
+                                     int lineIndexCount) {
+  bindSurface(vertexBuffer, stride, indexBuffer, indexBuffer);
+  meshIBOSize = triangleIndexCount;
+  wireIndexCount = lineIndexCount;
+  wireIndexOffset = qint64(sizeof(GLuint)) * triangleIndexCount;
+}
+
+/**
+ * @brief MeshRenderer::setHighlight Sets the edge and vertex that are drawn in
+ * the highlight colors. Only a pair of uniforms changes, so selecting does not
+ * touch the buffers.
+ * @param edgeSlot Position of the selected edge in the edge buffers, see
+ * Mesh::edgeDisplaySlot, or -1 for none.
+ * @param vertexIndex Index of the selected vertex, or -1 for none.
+ */
+void MeshRenderer::setHighlight(int edgeSlot, int vertexIndex) {
+  highlightedEdgeSlot = edgeSlot;
+  highlightedVertex = vertexIndex;
+}
+
+/**
+ * @brief MeshRenderer::resizePickBuffers Resizes the offscreen framebuffer used
+ * for picking. It must match the size of the framebuffer the mesh is drawn to.
+ * The color attachment holds one 32-bit unsigned integer ID per pixel.
+ * @param width Width in pixels.
+ * @param height Height in pixels.
+ */
+void MeshRenderer::resizePickBuffers(int width, int height) {
+  pickWidth = width;
+  pickHeight = height;
+  gl->glBindRenderbuffer(GL_RENDERBUFFER, pickColorRB);
+  gl->glRenderbufferStorage(GL_RENDERBUFFER, GL_R32UI, width, height);
+  gl->glBindRenderbuffer(GL_RENDERBUFFER, pickDepthRB);
+  gl->glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width,
+                            height);
+  gl->glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  gl->glBindFramebuffer(GL_FRAMEBUFFER, pickFBO);
+  gl->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                GL_RENDERBUFFER, pickColorRB);
+  gl->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                GL_RENDERBUFFER, pickDepthRB);
+  gl->glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/**
+ * @brief MeshRenderer::pickEdge Finds the drawn edge closest to a pixel.
+ * @param x Horizontal framebuffer coordinate, from the left.
+ * @param y Vertical framebuffer coordinate, from the bottom.
+ * @param radius Maximum distance in pixels.
+ * @return Slot of the edge in the edge buffers, see Mesh::edgeDisplaySlot, or
+ * -1 if no edge is within the radius.
+ */
+int MeshRenderer::pickEdge(int x, int y, int radius) {
+  return pick(edgeVAO, GL_LINES, edgeIndexCount, true, x, y, radius);
+}
+
+/**
+ * @brief MeshRenderer::pickVertex Finds the drawn vertex closest to a pixel.
+ * @param x Horizontal framebuffer coordinate, from the left.
+ * @param y Vertical framebuffer coordinate, from the bottom.
+ * @param radius Maximum distance in pixels.
+ * @return Index of the vertex, or -1 if no vertex is within the radius.
+ */
+int MeshRenderer::pickVertex(int x, int y, int radius) {
+  gl->glPointSize(6.0f);
+  int vertex =
+      pick(vertexVAO, GL_POINTS, vertexDisplayCount, false, x, y, radius);
+  gl->glPointSize(1.0f);
+  return vertex;
+}
+
+/**
+ * @brief MeshRenderer::pick Draws the index of every primitive as an integer
+ * ID into the square of the offscreen framebuffer around a pixel and reads that
+ * square back. Unless in wireframe mode, the surface is drawn into the depth
+ * buffer first, so hidden primitives cannot be picked. Leaves the picking
+ * framebuffer bound; the caller has to restore its own framebuffer and
+ * viewport.
+ * @param primitiveVAO Vertex array of the primitives.
+ * @param mode Primitive type.
+ * @param count Number of vertices or indices to draw.
+ * @param indexed Whether the vertex array has an index buffer to draw.
+ * @param x Horizontal framebuffer coordinate, from the left.
+ * @param y Vertical framebuffer coordinate, from the bottom.
+ * @param radius Maximum distance in pixels.
+ * @return Index of the closest primitive, or -1 if none is within the radius.
+ */
+int MeshRenderer::pick(GLuint primitiveVAO, GLenum mode, int count,
+                       bool indexed, int x, int y, int radius) {
+  int left = std::max(x - radius, 0);
+  int bottom = std::max(y - radius, 0);
+  int right = std::min(x + radius, pickWidth - 1);
+  int top = std::min(y + radius, pickHeight - 1);
+  if (count == 0 || left > right || bottom > top) {
+    return -1;
   }
-  
-  edgeVertexCount = edgeCoords.size();
-  
-  gl->glBindVertexArray(0);
-  
-  // Update vertex display buffers
-  QVector<QVector3D>& vertexDisplayCoords = mesh.getVertexDisplayCoords();
-  QVector<QVector3D>& vertexDisplayColors = mesh.getVertexDisplayColors();
-  
-  gl->glBindVertexArray(vertexVAO);
-  
-  gl->glBindBuffer(GL_ARRAY_BUFFER, vertexCoordsBO);
-  if (!vertexDisplayCoords.empty()) {
-    gl->glBufferData(GL_ARRAY_BUFFER, sizeof(QVector3D) * vertexDisplayCoords.size(),
-                     vertexDisplayCoords.data(), GL_STATIC_DRAW);
-  } else {
-    gl->glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+  int w = right - left + 1;
+  int h = top - bottom + 1;
+
+  gl->glBindFramebuffer(GL_FRAMEBUFFER, pickFBO);
+  gl->glViewport(0, 0, pickWidth, pickHeight);
+  gl->glEnable(GL_SCISSOR_TEST);
+  gl->glScissor(left, bottom, w, h);
+  // An integer attachment is cleared with an integer value
+  const GLuint noPrimitive[4] = {0, 0, 0, 0};
+  gl->glClearBufferuiv(GL_COLOR, 0, noPrimitive);
+  gl->glClear(GL_DEPTH_BUFFER_BIT);
+  gl->glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+  pickShader->bind();
+  pickShader->setUniformValue("modelviewmatrix", settings->modelViewMatrix);
+  pickShader->setUniformValue("projectionmatrix", settings->projectionMatrix);
+
+  if (!settings->wireframeMode) {
+    // Depth only, pushed back so the edges on the surface stay in front
+    pickShader->setUniformValue("depthonly", true);
+    gl->glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    gl->glEnable(GL_POLYGON_OFFSET_FILL);
+    gl->glPolygonOffset(1.0f, 1.0f);
+    gl->glBindVertexArray(vao);
+    gl->glDrawElements(GL_TRIANGLES, meshIBOSize, GL_UNSIGNED_INT, nullptr);
+    gl->glDisable(GL_POLYGON_OFFSET_FILL);
+    gl->glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
   }
-  
-  gl->glBindBuffer(GL_ARRAY_BUFFER, vertexColorsBO);
-  if (!vertexDisplayColors.empty()) {
-    gl->glBufferData(GL_ARRAY_BUFFER, sizeof(QVector3D) * vertexDisplayColors.size(),
-                     vertexDisplayColors.data(), GL_STATIC_DRAW);
+
+  pickShader->setUniformValue("depthonly", false);
+  gl->glBindVertexArray(primitiveVAO);
+  if (indexed) {
+    gl->glDrawElements(mode, count, GL_UNSIGNED_INT, nullptr);
   } else {
-    gl->glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+    gl->glDrawArrays(mode, 0, count);
   }
-  
-  vertexDisplayCount = vertexDisplayCoords.size();
-  
   gl->glBindVertexArray(0);
+  pickShader->release();
+  gl->glDisable(GL_SCISSOR_TEST);
+
+  QVector<GLuint> ids(w * h);
+  gl->glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  gl->glReadPixels(left, bottom, w, h, GL_RED_INTEGER, GL_UNSIGNED_INT,
+                   ids.data());
+
+  int closest = -1;
+  int closestDistance = radius * radius + 1;
+  for (int j = 0; j < h; j++) {
+    for (int i = 0; i < w; i++) {
+      GLuint id = ids[j * w + i];
+      int dx = left + i - x;
+      int dy = bottom + j - y;
+      int distance = dx * dx + dy * dy;
+      if (id != 0 && distance < closestDistance) {
+        closest = int(id - 1);
+        closestDistance = distance;
+      }
+    }
+  }
+  return closest;
 }
 
 /**
@@ -205,27 +460,24 @@ void MeshRenderer::draw() {
   if (settings->uniformUpdateRequired) {
     updateUniforms();
   }
-  // enable primitive restart to allow for drawing faces of arbitrary valence
-  gl->glEnable(GL_PRIMITIVE_RESTART);
-  gl->glPrimitiveRestartIndex(INT_MAX);
-
-  gl->glBindVertexArray(vao);
 
+  // Faces of any valence arrive as fans of triangles, so no primitive
+  // restart is needed
   if (settings->wireframeMode) {
-    gl->glDrawElements(GL_LINE_LOOP, meshIBOSize, GL_UNSIGNED_INT, nullptr);
+    gl->glBindVertexArray(wireVAO);
+    gl->glDrawElements(GL_LINES, wireIndexCount, GL_UNSIGNED_INT,
+                       reinterpret_cast<const void*>(wireIndexOffset));
   } else {
-    gl->glDrawElements(GL_TRIANGLE_FAN, meshIBOSize, GL_UNSIGNED_INT, nullptr);
+    gl->glBindVertexArray(vao);
+    gl->glDrawElements(GL_TRIANGLES, meshIBOSize, GL_UNSIGNED_INT, nullptr);
   }
 
   gl->glBindVertexArray(0);
 
   shaders[settings->currentShader]->release();
-
-  // disable it again as you might want to draw something else at some point
-  gl->glDisable(GL_PRIMITIVE_RESTART);
   
   // Draw colored edges if enabled
-  if (settings->showSharpEdges && edgeVertexCount > 0 && edgeShader) {
+  if (settings->showSharpEdges && edgeIndexCount > 0 && edgeShader) {
     // Use edge shader for colored edge rendering
     edgeShader->bind();
     
@@ -241,6 +493,11 @@ void MeshRenderer::draw() {
       gl->glUniformMatrix4fv(uniProjection, 1, false,
                              settings->projectionMatrix.data());
     }
+    edgeShader->setUniformValue("highlightedprimitive", highlightedEdgeSlot);
+    edgeShader->setUniformValue("highlightcolor", EDGE_HIGHLIGHT_COLOR);
+    edgeShader->setUniformValue("colors", 0);
+    gl->glActiveTexture(GL_TEXTURE0);
+    gl->glBindTexture(GL_TEXTURE_BUFFER, edgeColorsTexture);
     
     gl->glBindVertexArray(edgeVAO);
     // Query supported line width range and clamp to valid range
@@ -255,9 +512,10 @@ void MeshRenderer::draw() {
     } else {
       gl->glLineWidth(1.0f);  // Use 1.0 which is always supported
     }
-    gl->glDrawArrays(GL_LINES, 0, edgeVertexCount);
+    gl->glDrawElements(GL_LINES, edgeIndexCount, GL_UNSIGNED_INT, nullptr);
     gl->glLineWidth(1.0f);  // Reset line width
     gl->glBindVertexArray(0);
+    gl->glBindTexture(GL_TEXTURE_BUFFER, 0);
     
     edgeShader->release();
   }
@@ -279,12 +537,18 @@ void MeshRenderer::draw() {
       gl->glUniformMatrix4fv(uniProjection, 1, false,
                              settings->projectionMatrix.data());
     }
+    edgeShader->setUniformValue("highlightedprimitive", highlightedVertex);
+    edgeShader->setUniformValue("highlightcolor", VERTEX_HIGHLIGHT_COLOR);
+    edgeShader->setUniformValue("colors", 0);
+    gl->glActiveTexture(GL_TEXTURE0);
+    gl->glBindTexture(GL_TEXTURE_BUFFER, vertexColorsTexture);
     
     gl->glBindVertexArray(vertexVAO);
     gl->glPointSize(6.0f);  // Make vertices visible
     gl->glDrawArrays(GL_POINTS, 0, vertexDisplayCount);
     gl->glPointSize(1.0f);  // Reset point size
     gl->glBindVertexArray(0);
+    gl->glBindTexture(GL_TEXTURE_BUFFER, 0);
     
     edgeShader->release();
   }
@@ -4,11 +4,16 @@
 #include <QOpenGLShaderProgram>
 
 #include "../mesh/mesh.h"
+#include "dynamicbuffer.h"
 #include "renderer.h"
 
 /**
  * @brief The MeshRenderer class is responsible for rendering a mesh. Can render
- * any arbitrary mesh.
+ * any arbitrary mesh. The surface, the wireframe, the edges and the vertices
+ * are all drawn from one buffer of vertex coordinates, each with its own
+ * indices. The colors of the edges and vertices are per primitive, so they are
+ * read from buffer textures by primitive index instead of being stored with
+ * every vertex.
  */
 class MeshRenderer : public Renderer {
  public:
@@ -17,6 +22,14 @@ class MeshRenderer : public Renderer {
 
   void updateUniforms();
   void updateBuffers(Mesh& m);
+  void updatePositions(Mesh& m);
+  void updateEdgeColor(Mesh& m, const HalfEdge& edge);
+  void setHighlight(int edgeSlot, int vertexIndex);
+  void setSurfaceBuffers(GLuint vertexBuffer, int stride, GLuint indexBuffer,
+                         int triangleIndexCount, int lineIndexCount);
+  void resizePickBuffers(int width, int height);
+  int pickEdge(int x, int y, int radius);
+  int pickVertex(int x, int y, int radius);
   void draw();
 
  protected:
@@ -24,25 +37,46 @@ class MeshRenderer : public Renderer {
   void initBuffers() override;
 
  private:
+  int pick(GLuint primitiveVAO, GLenum mode, int count, bool indexed, int x,
+           int y, int radius);
+  void bindSurface(GLuint vertexBuffer, int stride, GLuint triangleBuffer,
+                   GLuint lineBuffer);
+
+  // Triangles of the surface
   GLuint vao;
-  GLuint meshCoordsBO, meshNormalsBO, meshIndexBO;
+  DynamicBuffer meshCoordsBuffer, meshNormalsBuffer, meshIndexBuffer;
   int meshIBOSize;
 
-  // Edge rendering buffers
+  // Lines of the wireframe: the edges, at the vertices of the surface
+  GLuint wireVAO;
+  int wireIndexCount;
+  qint64 wireIndexOffset;
+
+  // Edge rendering buffers, indexing the mesh coordinates
   GLuint edgeVAO;
-  GLuint edgeCoordsBO, edgeColorsBO;
-  int edgeVertexCount;
+  DynamicBuffer edgeIndexBuffer, edgeColorsBuffer;
+  GLuint edgeColorsTexture;
+  int edgeIndexCount;
 
-  // Vertex rendering buffers
+  // Vertex rendering buffers, drawing the mesh coordinates in order
   GLuint vertexVAO;
-  GLuint vertexCoordsBO, vertexColorsBO;
+  DynamicBuffer vertexColorsBuffer;
+  GLuint vertexColorsTexture;
   int vertexDisplayCount;
 
+  // Selection, see setHighlight
+  int highlightedEdgeSlot, highlightedVertex;
+
   // Uniforms
   GLint uniModelViewMatrix, uniProjectionMatrix, uniNormalMatrix;
   
   // Edge shader (also used for vertex rendering)
   QOpenGLShaderProgram* edgeShader;
+
+  // Offscreen framebuffer for picking, see pick
+  QOpenGLShaderProgram* pickShader;
+  GLuint pickFBO, pickColorRB, pickDepthRB;
+  int pickWidth, pickHeight;
 };
 
 #endif  // MESHRENDERER_H
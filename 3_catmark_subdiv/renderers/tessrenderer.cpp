@@ -1,208 +1,35 @@
 #include "tessrenderer.h"
 
-#include <QSet>
-#include <cmath>
-#include <algorithm>
-#include <array>
-#include <vector>
-
-#include "../mesh/face.h"
-#include "../mesh/halfedge.h"
-#include "../mesh/vertex.h"
-
-namespace {
-
-bool isRegularVertex(Vertex* v) {
-  return v != nullptr && v->valence == 4 && !v->isBoundaryVertex();
-}
-
-// Collect the 9 faces of the 3x3 patch around the center face.
-// Gather the 3x3 patch faces around the center quad:
-// center + 4 edge neighbours + 4 corner (diagonal) neighbours.
-// Returns false if any neighbour is missing or the topology is not a regular
-// interior quad configuration.
-bool collectPatchFaces(Face* center, QSet<Face*>& outFaces) {
-  outFaces.clear();
-  if (center == nullptr || center->side == nullptr || center->valence != 4)
-    return false;
-
-  auto edgeFace = [](HalfEdge* he) -> Face* {
-    return (he && he->twin) ? he->twin->face : nullptr;
-  };
-
-  // Cardinal edges
-  HalfEdge* e0 = center->side;             // east
-  HalfEdge* e1 = e0 ? e0->next : nullptr;  // north
-  HalfEdge* e2 = e1 ? e1->next : nullptr;  // west
-  HalfEdge* e3 = e2 ? e2->next : nullptr;  // south
-  if (!e0 || !e1 || !e2 || !e3) return false;
-
-  Face* east  = edgeFace(e0);
-  Face* north = edgeFace(e1);
-  Face* west  = edgeFace(e2);
-  Face* south = edgeFace(e3);
-  if (!east || !north || !west || !south) return false;
-
-  // Diagonals: step across the corner via next->twin twice
-  auto diagAcross = [](HalfEdge* fromEdge, HalfEdge* nextEdge) -> Face* {
-    HalfEdge* he = nextEdge;
-    if (!he || !he->twin) return nullptr;
-    he = he->twin->next;
-    if (!he || !he->twin) return nullptr;
-    return he->twin->face;
-  };
-
-  Face* ne = diagAcross(e0, e1);
-  Face* nw = diagAcross(e1, e2);
-  Face* sw = diagAcross(e2, e3);
-  Face* se = diagAcross(e3, e0);
-  if (!ne || !nw || !sw || !se) return false;
-
-  outFaces.insert(center);
-  outFaces.insert(east);
-  outFaces.insert(north);
-  outFaces.insert(west);
-  outFaces.insert(south);
-  outFaces.insert(ne);
-  outFaces.insert(nw);
-  outFaces.insert(sw);
-  outFaces.insert(se);
-
-  return outFaces.size() == 9;
-}
-
-struct ProjectedVertex {
-  int index;
-  QVector3D pos;
-  float u;
-  float v;
-};
-
-bool buildControlNet(Face* center, Mesh& mesh,
-                     std::array<QVector3D, 16>& controlNet) {
-  if (center == nullptr || center->valence != 4) return false;
-
-  QSet<Face*> faces;
-  if (!collectPatchFaces(center, faces)) return false;
-
-  // Validate faces/vertices and collect the 16 unique vertices.
-  QSet<int> vertexIds;
-  for (Face* f : faces) {
-    if (f == nullptr || f->valence != 4 || f->side == nullptr) return false;
-    HalfEdge* e = f->side;
-    for (int k = 0; k < 4; ++k) {
-      if (e == nullptr || e->origin == nullptr) return false;
-      Vertex* v = e->origin;
-      if (!isRegularVertex(v)) return false;
-      vertexIds.insert(v->index);
-      e = e->next;
-    }
-  }
-
-  if (vertexIds.size() != 16) return false;
-
-  // Build a local 2D frame (u,v) on the center face for consistent ordering.
-  HalfEdge* e0 = center->side;
-  if (e0 == nullptr || e0->next == nullptr || e0->next->next == nullptr ||
-      e0->next->next->next == nullptr)
-    return false;
-
-  QVector3D p0 = e0->origin->coords;
-  QVector3D p1 = e0->next->origin->coords;
-  QVector3D p2 = e0->next->next->origin->coords;
-  QVector3D p3 = e0->next->next->next->origin->coords;
-  QVector3D faceCenter = (p0 + p1 + p2 + p3) / 4.0f;
-
-  QVector3D uDir = p1 - p0;
-  if (uDir.lengthSquared() < 1e-10f) return false;
-  uDir.normalize();
-
-  QVector3D faceNormal = center->normal;
-  if (faceNormal.lengthSquared() < 1e-10f) {
-    faceNormal = QVector3D::crossProduct(p1 - p0, p2 - p0);
-  }
-  if (faceNormal.lengthSquared() < 1e-10f) return false;
-  faceNormal.normalize();
-
-  QVector3D vDir = QVector3D::crossProduct(faceNormal, uDir);
-  if (vDir.lengthSquared() < 1e-10f) return false;
-  vDir.normalize();
-
-  std::vector<ProjectedVertex> projected;
-  projected.reserve(16);
-  for (int vid : vertexIds) {
-    if (vid < 0 || vid >= mesh.getVertices().size()) return false;
-    const QVector3D pos = mesh.getVertices()[vid].coords;
-    QVector3D rel = pos - faceCenter;
-    float u = QVector3D::dotProduct(rel, uDir);
-    float v = QVector3D::dotProduct(rel, vDir);
-    projected.push_back({vid, pos, u, v});
-  }
-
-  if (projected.size() != 16) return false;
-
-  // Robust row grouping: sort by v, then cluster into 4 rows with tolerance;
-  // sort each row by u.
-  std::sort(projected.begin(), projected.end(),
-            [](const ProjectedVertex& a, const ProjectedVertex& b) {
-              if (std::abs(a.v - b.v) > 1e-5f) return a.v < b.v;
-              return a.u < b.u;
-            });
-
-  float minV = projected.front().v;
-  float maxV = projected.back().v;
-  float vRange = maxV - minV;
-  float vEps = vRange * 0.15f + 1e-5f;  // loose clustering
-
-  std::vector<std::vector<ProjectedVertex>> rows;
-  for (const auto& pv : projected) {
-    if (rows.empty() ||
-        std::abs(pv.v - rows.back().front().v) > vEps) {
-      rows.push_back({});
-    }
-    rows.back().push_back(pv);
-  }
-
-  if (rows.size() != 4) return false;
-  for (auto& row : rows) {
-    std::sort(row.begin(), row.end(),
-              [](const ProjectedVertex& a, const ProjectedVertex& b) {
-                return a.u < b.u;
-              });
-    if (row.size() != 4) return false;
-  }
-
-  for (int r = 0; r < 4; ++r) {
-    for (int c = 0; c < 4; ++c) {
-      controlNet[r * 4 + c] = rows[r][c].pos;
-    }
-  }
-
-  return true;
-}
-
-}  // namespace
+#include "util/profiler.h"
 
 /**
  * @brief TessellationRenderer::TessellationRenderer Creates a new tessellation
  * renderer.
  */
-TessellationRenderer::TessellationRenderer() : patchVertexCount(0) {}
+TessellationRenderer::TessellationRenderer()
+    : patchIndexCount(0), drawCommandBO(0), approxPointCount(0) {}
 
 /**
  * @brief TessellationRenderer::~TessellationRenderer Deconstructor.
  */
 TessellationRenderer::~TessellationRenderer() {
+  delete tessellationShader;
+  delete approxShader;
   gl->glDeleteVertexArrays(1, &vao);
-  gl->glDeleteBuffers(1, &patchCoordsBO);
+  gl->glDeleteVertexArrays(1, &approxVAO);
+  controlPointsBuffer.destroy();
+  patchIndexBuffer.destroy();
+  approxPointsBuffer.destroy();
 }
 
 /**
  * @brief TessellationRenderer::initShaders Initializes the shaders used for the
- * Tessellation.
+ * Tessellation. Both programs use the same sources; the one for approximate
+ * patches always evaluates Bezier patches.
  */
 void TessellationRenderer::initShaders() {
   tessellationShader = constructTesselationShader("patch");
+  approxShader = constructTesselationShader("patch");
 }
 
 /**
@@ -234,15 +61,26 @@ QOpenGLShaderProgram* TessellationRenderer::constructTesselationShader(
 }
 
 /**
- * @brief TessellationRenderer::initBuffers Initializes the buffers. The buffer
- * stores 16 control points per regular patch; no index buffer is needed.
+ * @brief TessellationRenderer::initBuffers Initializes the buffers. The vertex
+ * array draws the control points through the patch index buffer.
  */
 void TessellationRenderer::initBuffers() {
   gl->glGenVertexArrays(1, &vao);
   gl->glBindVertexArray(vao);
 
-  gl->glGenBuffers(1, &patchCoordsBO);
-  gl->glBindBuffer(GL_ARRAY_BUFFER, patchCoordsBO);
+  controlPointsBuffer.create(gl, GL_ARRAY_BUFFER);
+  controlPointsBuffer.bind();
+  gl->glEnableVertexAttribArray(0);
+  gl->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+  patchIndexBuffer.create(gl, GL_ELEMENT_ARRAY_BUFFER);
+  patchIndexBuffer.bind();
+
+  gl->glGenVertexArrays(1, &approxVAO);
+  gl->glBindVertexArray(approxVAO);
+
+  approxPointsBuffer.create(gl, GL_ARRAY_BUFFER);
+  approxPointsBuffer.bind();
   gl->glEnableVertexAttribArray(0);
   gl->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
 
@@ -251,47 +89,87 @@ void TessellationRenderer::initBuffers() {
 
 /**
  * @brief TessellationRenderer::updateBuffers Updates the buffers based on the
- * provided mesh. Only regular 3x3 patches (all valences = 4, all quads) are
- * added; irregular patches are skipped entirely.
+ * provided mesh. The buffers only upload the pages that changed, so when just
+ * the positions changed, the patch table is not uploaded again, and when
+ * nothing changed, nothing is.
  * @param currentMesh The mesh to update the buffer contents with.
+ * @param patchIndices The patch table of the mesh, see
+ * PatchTable::buildIndexTable.
+ * @param approxPatches The approximate patches of the other quads of the mesh.
  */
-void TessellationRenderer::updateBuffers(Mesh& currentMesh) {
-  std::vector<QVector3D> packedControlPoints;
-  packedControlPoints.reserve(currentMesh.getFaces().size() * 16);
+void TessellationRenderer::updateBuffers(
+    Mesh& currentMesh, const QVector<int>& patchIndices,
+    const ApproxPatchTable& approxPatches) {
+  ProfileScope scope("TessellationRenderer::updateBuffers");
+  const QVector<Vertex>& vertices = currentMesh.getVertices();
+  const int numVerts = vertices.size();
+  QVector<QVector3D> controlPoints(numVerts);
+#pragma omp parallel for schedule(static)
+  for (int v = 0; v < numVerts; v++) {
+    controlPoints[v] = vertices[v].coords;
+  }
 
-  for (Face& face : currentMesh.getFaces()) {
-    if (face.valence != 4 || face.side == nullptr) continue;
+  gl->glBindVertexArray(vao);
+  controlPointsBuffer.setData(controlPoints.constData(),
+                              qint64(numVerts) * qint64(sizeof(QVector3D)));
+  patchIndexBuffer.setData(patchIndices.constData(),
+                           qint64(patchIndices.size()) * qint64(sizeof(int)));
+  // Draw from the buffers of this renderer again, see setPatchBuffers
+  controlPointsBuffer.bind();
+  gl->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+  patchIndexBuffer.bind();
+  gl->glBindVertexArray(0);
+  drawCommandBO = 0;
 
-    std::array<QVector3D, 16> net;
-    if (buildControlNet(&face, currentMesh, net)) {
-      packedControlPoints.insert(packedControlPoints.end(), net.begin(),
-                                 net.end());
-    }
-  }
+  patchIndexCount = patchIndices.size();
 
-  gl->glBindBuffer(GL_ARRAY_BUFFER, patchCoordsBO);
-  if (!packedControlPoints.empty()) {
-    gl->glBufferData(GL_ARRAY_BUFFER,
-                     sizeof(QVector3D) * packedControlPoints.size(),
-                     packedControlPoints.data(), GL_DYNAMIC_DRAW);
-  } else {
-    gl->glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
-  }
+  QVector<QVector3D> approxPoints;
+  approxPatches.apply(controlPoints, approxPoints);
+  approxPointsBuffer.setData(
+      approxPoints.constData(),
+      qint64(approxPoints.size()) * qint64(sizeof(QVector3D)));
+  approxPointCount = approxPoints.size();
+}
 
-  patchVertexCount = static_cast<int>(packedControlPoints.size());
+/**
+ * @brief TessellationRenderer::setPatchBuffers Draws patches from buffers that
+ * were filled elsewhere, such as by the GPUSubdivider, using an indirect draw
+ * call so the number of patches never has to be read back. No approximate
+ * patches are drawn. The next call to updateBuffers switches back.
+ * @param vertexBuffer Buffer with the vertex coordinates at the start of every
+ * vertex.
+ * @param stride Size of a vertex in bytes.
+ * @param patchIndexBuffer Buffer with 16 control point indices per patch.
+ * @param drawCommandBuffer Buffer with the indirect draw command.
+ */
+void TessellationRenderer::setPatchBuffers(GLuint vertexBuffer, int stride,
+                                           GLuint patchIndexBuffer,
+                                           GLuint drawCommandBuffer) {
+  gl->glBindVertexArray(vao);
+  gl->glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+  gl->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, nullptr);
+  gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, patchIndexBuffer);
+  gl->glBindVertexArray(0);
+  drawCommandBO = drawCommandBuffer;
+  approxPointCount = 0;
 }
 
 /**
- * @brief TessellationRenderer::updateUniforms Updates the uniforms in the
- * shader.
+ * @brief TessellationRenderer::updateUniforms Updates the uniforms in a
+ * shader. The shader must be bound.
+ * @param shader One of the tessellation shaders.
+ * @param useBezierPatch Whether the shader evaluates Bezier patches instead of
+ * B-spline patches.
  */
-void TessellationRenderer::updateUniforms() {
-  uniModelViewMatrix = tessellationShader->uniformLocation("modelviewmatrix");
-  uniProjectionMatrix = tessellationShader->uniformLocation("projectionmatrix");
-  uniNormalMatrix = tessellationShader->uniformLocation("normalmatrix");
-  uniUseBezier = tessellationShader->uniformLocation("useBezierPatch");
-  GLint uniOuter = tessellationShader->uniformLocation("outerTessLevel");
-  GLint uniInner = tessellationShader->uniformLocation("innerTessLevel");
+void TessellationRenderer::updateUniforms(QOpenGLShaderProgram* shader,
+                                          bool useBezierPatch) {
+  GLint uniModelViewMatrix = shader->uniformLocation("modelviewmatrix");
+  GLint uniProjectionMatrix = shader->uniformLocation("projectionmatrix");
+  GLint uniNormalMatrix = shader->uniformLocation("normalmatrix");
+  GLint uniUseBezier = shader->uniformLocation("useBezierPatch");
+  GLint uniPixelsPerTriangle = shader->uniformLocation("pixelspertriangle");
+  GLint uniViewportHeight = shader->uniformLocation("viewportheight");
+  GLint uniCullBackFaces = shader->uniformLocation("cullbackfaces");
 
   gl->glUniformMatrix4fv(uniModelViewMatrix, 1, false,
                          settings->modelViewMatrix.data());
@@ -299,31 +177,48 @@ void TessellationRenderer::updateUniforms() {
                          settings->projectionMatrix.data());
   gl->glUniformMatrix3fv(uniNormalMatrix, 1, false,
                          settings->normalMatrix.data());
-  gl->glUniform1i(uniUseBezier, settings->useBezierPatch ? 1 : 0);
-  if (uniOuter >= 0) gl->glUniform1f(uniOuter, 4.0f);
-  if (uniInner >= 0) gl->glUniform1f(uniInner, 4.0f);
+  gl->glUniform1i(uniUseBezier, useBezierPatch ? 1 : 0);
+  gl->glUniform1f(uniPixelsPerTriangle,
+                  settings->pixelsPerTriangle * settings->triangleSizeScale);
+  gl->glUniform1f(uniViewportHeight, settings->viewportHeight);
+  gl->glUniform1i(uniCullBackFaces, settings->cullBackFacingPatches ? 1 : 0);
 }
 
 /**
- * @brief MeshRenderer::draw Draw call.
+ * @brief TessellationRenderer::draw Draw call.
  */
 void TessellationRenderer::draw() {
-  if (patchVertexCount == 0) {
-    return;  // nothing to draw (all irregular patches skipped)
+  if (settings->uniformUpdateRequired) {
+    // Also when nothing is drawn, the uniforms would be outdated later on
+    tessellationShader->bind();
+    updateUniforms(tessellationShader, settings->useBezierPatch);
+    approxShader->bind();
+    updateUniforms(approxShader, true);
+    approxShader->release();
   }
 
-  tessellationShader->bind();
+  gl->glPatchParameteri(GL_PATCH_VERTICES, 16);
 
-  if (settings->uniformUpdateRequired) {
-    updateUniforms();
+  if (patchIndexCount > 0 || drawCommandBO != 0) {
+    tessellationShader->bind();
+    gl->glBindVertexArray(vao);
+    if (drawCommandBO != 0) {
+      gl->glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandBO);
+      gl->glDrawElementsIndirect(GL_PATCHES, GL_UNSIGNED_INT, nullptr);
+      gl->glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    } else {
+      gl->glDrawElements(GL_PATCHES, patchIndexCount, GL_UNSIGNED_INT,
+                         nullptr);
+    }
+    tessellationShader->release();
   }
 
-  gl->glBindVertexArray(vao);
-
-  gl->glPatchParameteri(GL_PATCH_VERTICES, 16);
-  gl->glDrawArrays(GL_PATCHES, 0, patchVertexCount);
+  if (approxPointCount > 0) {
+    approxShader->bind();
+    gl->glBindVertexArray(approxVAO);
+    gl->glDrawArrays(GL_PATCHES, 0, approxPointCount);
+    approxShader->release();
+  }
 
   gl->glBindVertexArray(0);
-
-  tessellationShader->release();
 }
@@ -4,19 +4,28 @@
 #include <QOpenGLShaderProgram>
 
 #include "../mesh/mesh.h"
+#include "../subdivision/approxpatchtable.h"
+#include "dynamicbuffer.h"
 #include "renderer.h"
 
 /**
  * @brief The TessellationRenderer class is responsible for rendering
- * Tessellated patches.
+ * Tessellated patches. The patches are drawn from the vertex coordinates of the
+ * mesh with a patch table of 16 control point indices per patch, see
+ * PatchTable::buildIndexTable, as index buffer. The quads that are not
+ * regular are drawn as approximating Bezier patches, see ApproxPatchTable, by a
+ * second tessellation program.
  */
 class TessellationRenderer : public Renderer {
  public:
   TessellationRenderer();
   ~TessellationRenderer() override;
 
-  void updateUniforms();
-  void updateBuffers(Mesh& m);
+  void updateUniforms(QOpenGLShaderProgram* shader, bool useBezierPatch);
+  void updateBuffers(Mesh& m, const QVector<int>& patchIndices,
+                     const ApproxPatchTable& approxPatches);
+  void setPatchBuffers(GLuint vertexBuffer, int stride,
+                       GLuint patchIndexBuffer, GLuint drawCommandBuffer);
   void draw();
 
  protected:
@@ -26,13 +35,18 @@ class TessellationRenderer : public Renderer {
 
  private:
   GLuint vao;
-  GLuint patchCoordsBO;
-  int patchVertexCount;
+  DynamicBuffer controlPointsBuffer;
+  DynamicBuffer patchIndexBuffer;
+  int patchIndexCount;
+  // Set by setPatchBuffers; 0 when drawing the patches of updateBuffers
+  GLuint drawCommandBO;
   QOpenGLShaderProgram* tessellationShader;
 
-  // Uniforms
-  GLint uniModelViewMatrix, uniProjectionMatrix, uniNormalMatrix;
-  GLint uniUseBezier;
+  // Approximate patches, 16 control points each
+  GLuint approxVAO;
+  DynamicBuffer approxPointsBuffer;
+  int approxPointCount;
+  QOpenGLShaderProgram* approxShader;
 };
 
 #endif  // TessRenderer_H
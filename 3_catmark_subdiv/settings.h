@@ -28,14 +28,38 @@ typedef struct Settings {
   // Fixed mode: uniform cubic B-spline (no toggle)
   bool useBezierPatch = false;
 
+  // Target edge length of the tessellated triangles in pixels, and of the
+  // edges of the level chosen by the automatic level of detail
+  float pixelsPerTriangle = 8.0f;
+  // Factor on pixelsPerTriangle chosen by the automatic level of detail
+  float triangleSizeScale = 1.0f;
+  // Skip patches facing away from the viewer in tessellation mode
+  bool cullBackFacingPatches = true;
+
   float FoV = 80;
   float dispRatio = 16.0f / 9.0f;
+  // Height of the view in pixels
+  float viewportHeight = 720.0f;
   float rotAngle = 0.0f;
 
   int subdivisionLevel = 0;
 
-  Vertex* selectedVertex;
-  HalfEdge* selectedEdge;
+  // Choose the subdivision level, or the triangle size in tessellation mode,
+  // from the projected size and the frame time, see LevelSelector
+  bool autoLevelOfDetail = false;
+  // Finest level the automatic level of detail may choose
+  int maxAutoLevel = 0;
+  // GPU time per frame the automatic level of detail stays within, in ms
+  float frameBudget = 16.0f;
+
+  // Renumber loaded meshes for memory locality, see MeshReorderer
+  bool reorderMeshes = true;
+
+  // Subdivide with compute shaders instead of on the CPU, see GPUSubdivider
+  bool gpuSubdivision = false;
+
+  Vertex* selectedVertex = nullptr;
+  HalfEdge* selectedEdge = nullptr;
 
   bool uniformUpdateRequired = true;
 
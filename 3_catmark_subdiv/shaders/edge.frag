@@ -1,10 +1,17 @@
 #version 410
-// Edge fragment shader - just output the vertex color
+// Edge fragment shader - output the color of the primitive
 
-layout(location = 0) in vec3 vertcolor_fs;
+// One color per edge or vertex, indexed by primitive
+uniform samplerBuffer colors;
+// The selection: the primitive drawn in highlightcolor instead of its own
+// color, or -1 for none
+uniform int highlightedprimitive;
+uniform vec3 highlightcolor;
 
 out vec4 fColor;
 
 void main() {
-  fColor = vec4(vertcolor_fs, 1.0);
+  bool highlighted = gl_PrimitiveID == highlightedprimitive;
+  fColor = highlighted ? vec4(highlightcolor, 1.0)
+                       : vec4(texelFetch(colors, gl_PrimitiveID).rgb, 1.0);
 }
@@ -0,0 +1,12 @@
+#version 410
+// Picking fragment shader - writes the index of the primitive plus one into an
+// unsigned integer attachment, so the cleared value 0 means nothing was drawn
+
+// Set when only the depth of the surface is drawn
+uniform bool depthonly;
+
+out uint fId;
+
+void main() {
+  fId = depthonly ? 0u : uint(gl_PrimitiveID) + 1u;
+}
@@ -0,0 +1,11 @@
+#version 410
+// Picking vertex shader
+
+layout(location = 0) in vec3 vertcoords_vs;
+
+uniform mat4 modelviewmatrix;
+uniform mat4 projectionmatrix;
+
+void main() {
+  gl_Position = projectionmatrix * modelviewmatrix * vec4(vertcoords_vs, 1.0);
+}
@@ -0,0 +1,131 @@
+#include "adaptivesubdivider.h"
+
+#include <QDebug>
+
+/**
+ * @brief AdaptiveMesh::memoryFootprint Calculates the number of bytes used by
+ * the patches and polygons.
+ * @return The size of the data in bytes.
+ */
+qint64 AdaptiveMesh::memoryFootprint() const {
+  qint64 points = qint64(patches.getControlPoints().size()) +
+                  approxPatches.getControlPoints().size() +
+                  polygonCoords.size();
+  qint64 ints = qint64(patches.getDepths().size()) +
+                approxPatches.getDepths().size() + polygonOffsets.size();
+  return points * qint64(sizeof(QVector3D)) + ints * qint64(sizeof(int));
+}
+
+/**
+ * @brief AdaptiveSubdivider::AdaptiveSubdivider Creates a new adaptive
+ * subdivider.
+ * @param maxDepth The maximum number of subdivision steps around irregular
+ * features.
+ */
+AdaptiveSubdivider::AdaptiveSubdivider(int maxDepth) : maxDepth(maxDepth) {}
+
+/**
+ * @brief AdaptiveSubdivider::subdivide Adaptively subdivides a mesh.
+ * @param controlMesh The control mesh.
+ * @return The patches and remaining polygons.
+ */
+AdaptiveMesh AdaptiveSubdivider::subdivide(Mesh& controlMesh) const {
+  return subdivide(CompactMesh::fromMesh(controlMesh));
+}
+
+/**
+ * @brief AdaptiveSubdivider::subdivide Adaptively subdivides a mesh. Each level
+ * classifies the faces that descend from the irregular faces of the previous
+ * level. Regular faces become patches; the others are refined by subdividing
+ * the submesh made up of them and all faces touching their vertices. That ring
+ * makes the new positions of everything inside the refined region, and the
+ * topology around it, identical to uniform subdivision. Positions on the outer
+ * border of the submesh are not, but they are never used.
+ * @param controlMesh The control mesh.
+ * @return The patches and remaining polygons.
+ */
+AdaptiveMesh AdaptiveSubdivider::subdivide(
+    const CompactMesh& controlMesh) const {
+  AdaptiveMesh result;
+  CompactMesh mesh = controlMesh;
+  QVector<int> marked(mesh.numFaces());
+  for (int f = 0; f < marked.size(); f++) {
+    marked[f] = f;
+  }
+
+  for (int depth = 0; !marked.isEmpty(); depth++) {
+    const int numMarked = marked.size();
+    QVector<char> regular(numMarked);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < numMarked; i++) {
+      regular[i] = PatchTable::isRegularFace(mesh, marked[i]) ? 1 : 0;
+    }
+
+    QVector<int> refine;
+    for (int i = 0; i < numMarked; i++) {
+      int f = marked[i];
+      if (regular[i]) {
+        result.patches.appendPatch(mesh, f, depth);
+      } else if (depth == maxDepth &&
+                 ApproxPatchTable::isApproximableFace(mesh, f)) {
+        QVector3D points[16];
+        ApproxPatchTable::controlPoints(mesh, f, points);
+        result.approxPatches.appendControlPoints(points, depth);
+      } else if (depth == maxDepth) {
+        int side = mesh.faceSide(f);
+        for (int k = 0; k < mesh.faceValence(f); k++) {
+          int v = mesh.getOrigins()[side + k];
+          result.polygonCoords.append(mesh.position(v));
+        }
+        result.polygonOffsets.append(result.polygonCoords.size());
+      } else {
+        refine.append(f);
+      }
+    }
+    if (refine.isEmpty()) {
+      break;
+    }
+
+    // Add the ring of faces around the vertices of the faces to refine
+    QVector<char> inSubmesh(mesh.numFaces(), 0);
+    QVector<char> touched(mesh.numVerts(), 0);
+    for (int f : refine) {
+      inSubmesh[f] = 1;
+      int side = mesh.faceSide(f);
+      for (int k = 0; k < mesh.faceValence(f); k++) {
+        touched[mesh.getOrigins()[side + k]] = 1;
+      }
+    }
+    QVector<int> faces = refine;
+    for (int f = 0; f < mesh.numFaces(); f++) {
+      if (inSubmesh[f]) {
+        continue;
+      }
+      int side = mesh.faceSide(f);
+      for (int k = 0; k < mesh.faceValence(f); k++) {
+        if (touched[mesh.getOrigins()[side + k]]) {
+          faces.append(f);
+          break;
+        }
+      }
+    }
+
+    CompactMesh submesh = mesh.extractSubmesh(faces);
+    mesh = subdivider.subdivide(submesh);
+
+    // The children of submesh face f are the faces of its half-edges
+    marked.clear();
+    for (int f = 0; f < refine.size(); f++) {
+      int side = submesh.faceSide(f);
+      for (int k = 0; k < submesh.faceValence(f); k++) {
+        marked.append(side + k);
+      }
+    }
+  }
+
+  qDebug() << ":: Adaptive subdivision to depth" << maxDepth << "resulted in"
+           << result.patches.numPatches() << "patches,"
+           << result.approxPatches.numPatches() << "approximate patches and"
+           << result.numPolygons() << "polygons";
+  return result;
+}
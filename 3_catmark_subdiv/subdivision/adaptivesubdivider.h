@@ -0,0 +1,59 @@
+#ifndef ADAPTIVE_SUBDIVIDER_H
+#define ADAPTIVE_SUBDIVIDER_H
+
+#include "mesh/compactmesh.h"
+#include "mesh/mesh.h"
+#include "subdivision/approxpatchtable.h"
+#include "subdivision/compactsubdivider.h"
+#include "subdivision/patchtable.h"
+
+/**
+ * @brief The AdaptiveMesh struct is the result of adaptive subdivision: the
+ * regular parts of the surface as bicubic B-spline patches, the faces that
+ * were still irregular at the maximum depth as approximating Bezier patches
+ * (see ApproxPatchTable) where possible, and as polygons otherwise.
+ */
+struct AdaptiveMesh {
+  PatchTable patches;
+  // Bezier control points, in the same layout as the B-spline patches
+  PatchTable approxPatches;
+  // Vertex positions of the remaining polygons; polygon i uses the entries
+  // polygonOffsets[i] up to polygonOffsets[i + 1]
+  QVector<QVector3D> polygonCoords;
+  QVector<int> polygonOffsets = {0};
+
+  inline int numPolygons() const { return polygonOffsets.size() - 1; }
+  qint64 memoryFootprint() const;
+};
+
+/**
+ * @brief The AdaptiveSubdivider class refines a mesh only around its irregular
+ * features: extraordinary vertices, non-quad faces, boundaries and sharp edges.
+ * Every face that is regular (see PatchTable::isRegularFace) is emitted as a
+ * B-spline patch at the level it became regular, which evaluates to exactly
+ * the limit surface of uniform subdivision. Only the remaining faces are
+ * subdivided further, together with the ring of faces around them, until the
+ * maximum depth is reached. The faces left there are approximated by Bezier
+ * patches where possible, so the patches cover the whole surface unless it has
+ * boundaries, sharp edges or non-quad faces.
+ *
+ * Since the number of irregular faces only doubles per level along features
+ * instead of quadrupling everywhere, memory and time at high depths are much
+ * lower than with uniform refinement. Adjacent patches of different depths
+ * meet at T-junctions, which can show as small cracks when tessellated.
+ */
+class AdaptiveSubdivider {
+ public:
+  AdaptiveSubdivider(int maxDepth);
+
+  AdaptiveMesh subdivide(Mesh& controlMesh) const;
+  AdaptiveMesh subdivide(const CompactMesh& controlMesh) const;
+
+  inline int getMaxDepth() const { return maxDepth; }
+
+ private:
+  int maxDepth;
+  CompactCatmullClarkSubdivider subdivider;
+};
+
+#endif  // ADAPTIVE_SUBDIVIDER_H
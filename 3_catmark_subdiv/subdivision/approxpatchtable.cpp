@@ -0,0 +1,325 @@
+#include "approxpatchtable.h"
+
+#include <QVarLengthArray>
+
+#include "patchtable.h"
+
+// Grid position of each corner of the face and the grid directions (row,
+// column) of its outgoing half-edge (U) and of its incoming half-edge reversed
+// (V), as in PatchTable::controlPointIndices but on the Bezier control net
+static const int corners[4][2] = {{0, 0}, {0, 3}, {3, 3}, {3, 0}};
+static const int dirU[4][2] = {{0, 1}, {1, 0}, {0, -1}, {-1, 0}};
+static const int dirV[4][2] = {{1, 0}, {0, -1}, {-1, 0}, {0, 1}};
+
+/**
+ * @brief The CornerRing struct holds the neighbours of a corner of a face, in
+ * the order of the outgoing half-edges twin(prev(h)) starting at the half-edge
+ * of the face. Face j around the vertex has the corners v, edges[j],
+ * diagonals[j] and edges[j + 1].
+ */
+struct CornerRing {
+  int vertex;
+  QVarLengthArray<int, 16> edges;
+  QVarLengthArray<int, 16> diagonals;
+
+  inline int valence() const { return edges.size(); }
+  inline int edge(int j) const { return edges[j % edges.size()]; }
+};
+
+/**
+ * @brief cornerRing Collects the neighbours of a corner of an approximable
+ * face.
+ * @param mesh The mesh.
+ * @param h The half-edge of the face that starts at the corner.
+ * @param ring The ring to fill.
+ */
+static void cornerRing(const CompactMesh& mesh, int h, CornerRing& ring) {
+  const QVector<int>& origins = mesh.getOrigins();
+  const QVector<int>& twins = mesh.getTwins();
+  ring.vertex = origins[h];
+  ring.edges.clear();
+  ring.diagonals.clear();
+  int start = h;
+  do {
+    int next = mesh.next(h);
+    ring.edges.append(origins[next]);
+    ring.diagonals.append(origins[mesh.next(next)]);
+    h = twins[mesh.prev(h)];
+  } while (h != start);
+}
+
+/**
+ * @brief ApproxPatchTable::ApproxPatchTable Creates an empty table.
+ */
+ApproxPatchTable::ApproxPatchTable() : offsets({0}) {}
+
+/**
+ * @brief ApproxPatchTable::ApproxPatchTable Builds the stencils of all quads of
+ * a mesh that are approximable but not regular. As in
+ * PatchTable::buildIndexTable, the faces are classified in parallel and a
+ * prefix sum over the stencil sizes places the stencils of every face, so they
+ * can be built in parallel as well.
+ * @param mesh The mesh.
+ */
+ApproxPatchTable::ApproxPatchTable(const CompactMesh& mesh) {
+  const int numFaces = mesh.numFaces();
+  QVector<int> sizes(numFaces);
+#pragma omp parallel for schedule(static)
+  for (int f = 0; f < numFaces; f++) {
+    bool approximate = !PatchTable::isRegularFace(mesh, f) &&
+                       isApproximableFace(mesh, f);
+    sizes[f] = approximate ? stencilSize(mesh, f) : 0;
+  }
+
+  QVector<int> stencilOffsets;
+  int total = 0;
+  for (int f = 0; f < numFaces; f++) {
+    if (sizes[f] > 0) {
+      faces.append(f);
+      stencilOffsets.append(total);
+      total += sizes[f];
+    }
+  }
+
+  const int numPatches = faces.size();
+  offsets.resize(16 * numPatches + 1);
+  indices.resize(total);
+  weights.resize(total);
+  int* patchOffsets = offsets.data();
+  int* patchIndices = indices.data();
+  float* patchWeights = weights.data();
+#pragma omp parallel for schedule(dynamic, 64)
+  for (int i = 0; i < numPatches; i++) {
+    int begin = stencilOffsets[i];
+    faceStencils(mesh, faces[i], patchOffsets + 16 * i,
+                 patchIndices + begin, patchWeights + begin);
+    for (int k = 0; k < 16; k++) {
+      patchOffsets[16 * i + k] += begin;
+    }
+  }
+  offsets[16 * numPatches] = total;
+}
+
+/**
+ * @brief ApproxPatchTable::isApproximableFace Checks whether a face is a quad
+ * whose vertices are interior vertices without incident sharp edges, surrounded
+ * by quads only. Regular faces satisfy this as well.
+ * @param mesh The mesh.
+ * @param f Index of the face.
+ * @return True if the face can be approximated; false otherwise.
+ */
+bool ApproxPatchTable::isApproximableFace(const CompactMesh& mesh, int f) {
+  if (mesh.faceValence(f) != 4) {
+    return false;
+  }
+  const QVector<int>& twins = mesh.getTwins();
+  const QVector<int>& edges = mesh.getEdges();
+  int side = mesh.faceSide(f);
+  for (int k = 0; k < 4; k++) {
+    int start = side + k;
+    int h = start;
+    int valence = 0;
+    do {
+      if (twins[h] < 0 || mesh.isSharpEdge(edges[h]) ||
+          mesh.faceValence(mesh.face(h)) != 4) {
+        return false;
+      }
+      h = twins[mesh.prev(h)];
+      // A non-manifold vertex could make the walk miss the start
+      if (h < 0 || ++valence > mesh.numHalfEdges()) {
+        return false;
+      }
+    } while (h != start);
+    // Valence 2 corners make the control net degenerate
+    if (valence < 3) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief ApproxPatchTable::stencilSize Counts the stencil entries of the 16
+ * control points of an approximable face: 2n + 1 for a corner of valence n, 4
+ * for an interior and 6 for an edge control point.
+ * @param mesh The mesh.
+ * @param f Index of an approximable face.
+ * @return The number of entries.
+ */
+int ApproxPatchTable::stencilSize(const CompactMesh& mesh, int f) {
+  const QVector<int>& twins = mesh.getTwins();
+  int side = mesh.faceSide(f);
+  int size = 4 * (4 + 2 * 6);
+  for (int k = 0; k < 4; k++) {
+    int h = side + k;
+    do {
+      size += 2;
+      h = twins[mesh.prev(h)];
+    } while (h != side + k);
+    size++;
+  }
+  return size;
+}
+
+/**
+ * @brief ApproxPatchTable::faceStencils Builds the stencils of the 16 control
+ * points of an approximable face.
+ * @param mesh The mesh.
+ * @param f Index of an approximable face.
+ * @param offsets Array of 16 entries that receives the start of the stencil of
+ * every control point, relative to the start of indices and weights.
+ * @param indices Receives the vertex indices of the stencils, see stencilSize.
+ * @param weights Receives the weights of the stencils.
+ */
+void ApproxPatchTable::faceStencils(const CompactMesh& mesh, int f,
+                                    int* offsets, int* indices,
+                                    float* weights) {
+  CornerRing rings[4];
+  int side = mesh.faceSide(f);
+  for (int k = 0; k < 4; k++) {
+    cornerRing(mesh, side + k, rings[k]);
+  }
+
+  // Stencils are stored in the order of the control points
+  int sizes[16];
+  for (int k = 0; k < 4; k++) {
+    int r = corners[k][0];
+    int c = corners[k][1];
+    sizes[r * 4 + c] = 2 * rings[k].valence() + 1;
+    sizes[(r + dirU[k][0]) * 4 + (c + dirU[k][1])] = 6;
+    sizes[(r + dirV[k][0]) * 4 + (c + dirV[k][1])] = 6;
+    sizes[(r + dirU[k][0] + dirV[k][0]) * 4 + (c + dirU[k][1] + dirV[k][1])] =
+        4;
+  }
+  int total = 0;
+  for (int i = 0; i < 16; i++) {
+    offsets[i] = total;
+    total += sizes[i];
+  }
+
+  for (int k = 0; k < 4; k++) {
+    const CornerRing& ring = rings[k];
+    const int n = ring.valence();
+    const float scale = 1.0f / (n + 5);
+    int r = corners[k][0];
+    int c = corners[k][1];
+
+    // Corner: the limit position. The ring starts at the neighbour with the
+    // lowest index, so every face around the vertex sums the same terms in
+    // the same order and gets exactly the same position, see patch.tesc.
+    int start = 0;
+    for (int j = 1; j < n; j++) {
+      if (ring.edges[j] < ring.edges[start]) {
+        start = j;
+      }
+    }
+    int i = offsets[r * 4 + c];
+    indices[i] = ring.vertex;
+    weights[i++] = n * scale;
+    for (int j = 0; j < n; j++) {
+      indices[i] = ring.edge(start + j);
+      weights[i++] = 4.0f * scale / n;
+      indices[i] = ring.diagonals[(start + j) % n];
+      weights[i++] = scale / n;
+    }
+
+    // Interior point of face 0, the face itself
+    i = offsets[(r + dirU[k][0] + dirV[k][0]) * 4 +
+                (c + dirU[k][1] + dirV[k][1])];
+    indices[i] = ring.vertex;
+    weights[i++] = n * scale;
+    indices[i] = ring.edge(0);
+    weights[i++] = 2.0f * scale;
+    indices[i] = ring.edge(1);
+    weights[i++] = 2.0f * scale;
+    indices[i] = ring.diagonals[0];
+    weights[i++] = scale;
+
+    // Edge points: the average of the interior points of faces 0 and n - 1
+    // along the outgoing half-edge, and of faces 0 and 1 along the incoming one
+    const int shared[2] = {0, 1};
+    const int other[2] = {1, 0};
+    const int neighbourFace[2] = {n - 1, 1};
+    const int neighbourEdge[2] = {n - 1, 2};
+    const int* dirs[2] = {dirU[k], dirV[k]};
+    for (int e = 0; e < 2; e++) {
+      i = offsets[(r + dirs[e][0]) * 4 + (c + dirs[e][1])];
+      indices[i] = ring.vertex;
+      weights[i++] = n * scale;
+      indices[i] = ring.edge(shared[e]);
+      weights[i++] = 2.0f * scale;
+      indices[i] = ring.edge(other[e]);
+      weights[i++] = scale;
+      indices[i] = ring.diagonals[0];
+      weights[i++] = 0.5f * scale;
+      indices[i] = ring.edge(neighbourEdge[e]);
+      weights[i++] = scale;
+      indices[i] = ring.diagonals[neighbourFace[e]];
+      weights[i++] = 0.5f * scale;
+    }
+  }
+}
+
+/**
+ * @brief ApproxPatchTable::controlPoints Computes the 16 Bezier control points
+ * of an approximable face directly, without keeping the stencils.
+ * @param mesh The mesh.
+ * @param f Index of an approximable face, see isApproximableFace.
+ * @param points Array of 16 entries that receives the control points.
+ */
+void ApproxPatchTable::controlPoints(const CompactMesh& mesh, int f,
+                                     QVector3D* points) {
+  const int size = stencilSize(mesh, f);
+  int stencilOffsets[17];
+  QVarLengthArray<int, 256> stencilIndices(size);
+  QVarLengthArray<float, 256> stencilWeights(size);
+  faceStencils(mesh, f, stencilOffsets, stencilIndices.data(),
+               stencilWeights.data());
+  stencilOffsets[16] = size;
+  for (int p = 0; p < 16; p++) {
+    QVector3D point;
+    for (int i = stencilOffsets[p]; i < stencilOffsets[p + 1]; i++) {
+      point += stencilWeights[i] * mesh.position(stencilIndices[i]);
+    }
+    points[p] = point;
+  }
+}
+
+/**
+ * @brief ApproxPatchTable::apply Computes the control points of all patches
+ * from the vertex positions of the mesh the table was built for.
+ * @param coords Positions of the vertices.
+ * @param controlPoints Is resized to 16 entries per patch and filled with the
+ * control points, in the layout of PatchTable.
+ */
+void ApproxPatchTable::apply(const QVector<QVector3D>& coords,
+                             QVector<QVector3D>& controlPoints) const {
+  const int numPoints = 16 * numPatches();
+  controlPoints.resize(numPoints);
+  const QVector3D* vertices = coords.constData();
+  QVector3D* points = controlPoints.data();
+
+#pragma omp parallel for schedule(static)
+  for (int p = 0; p < numPoints; p++) {
+    float x = 0.0f, y = 0.0f, z = 0.0f;
+    for (int k = offsets[p]; k < offsets[p + 1]; k++) {
+      const QVector3D& v = vertices[indices[k]];
+      float w = weights[k];
+      x += w * v.x();
+      y += w * v.y();
+      z += w * v.z();
+    }
+    points[p] = QVector3D(x, y, z);
+  }
+}
+
+/**
+ * @brief ApproxPatchTable::memoryFootprint Calculates the number of bytes used
+ * by the stencils.
+ * @return The size of the table in bytes.
+ */
+qint64 ApproxPatchTable::memoryFootprint() const {
+  return qint64(faces.size() + offsets.size() + indices.size()) *
+             qint64(sizeof(int)) +
+         qint64(weights.size()) * qint64(sizeof(float));
+}
@@ -0,0 +1,59 @@
+#ifndef APPROX_PATCH_TABLE_H
+#define APPROX_PATCH_TABLE_H
+
+#include <QVector3D>
+#include <QVector>
+
+#include "mesh/compactmesh.h"
+
+/**
+ * @brief The ApproxPatchTable class approximates the limit surface of the quads
+ * that are not regular (see PatchTable::isRegularFace) by bicubic Bezier
+ * patches, following the geometry patches of ACC (Loop and Schaefer,
+ * "Approximating Catmull-Clark Subdivision Surfaces with Bicubic Patches").
+ * Around a corner of valence n:
+ * - the interior control point in face j is (n v + 2 e_j + 2 e_j+1 + f_j) /
+ *   (n + 5), with e the edge neighbours and f the diagonal neighbours of v,
+ * - an edge control point is the average of the interior points of the two
+ *   faces at the edge,
+ * - the corner is the limit position of v.
+ * For valence 4 this is exactly the Bezier form of the B-spline patch. Since
+ * the control points of an edge of the patch only depend on the two faces at
+ * that edge, neighbouring patches share their boundary curves and the surface
+ * is watertight, though not tangent continuous at extraordinary vertices.
+ *
+ * A quad can be approximated when its vertices are interior vertices without
+ * incident sharp edges that are surrounded by quads only. The control points
+ * are stored as stencils over the vertices of the mesh in the layout of
+ * PatchTable, so new positions only need a sparse product.
+ */
+class ApproxPatchTable {
+ public:
+  ApproxPatchTable();
+  explicit ApproxPatchTable(const CompactMesh& mesh);
+
+  static bool isApproximableFace(const CompactMesh& mesh, int f);
+  static void controlPoints(const CompactMesh& mesh, int f,
+                            QVector3D* points);
+
+  void apply(const QVector<QVector3D>& coords,
+             QVector<QVector3D>& controlPoints) const;
+
+  inline int numPatches() const { return faces.size(); }
+  // Face of every patch
+  inline const QVector<int>& getFaces() const { return faces; }
+  qint64 memoryFootprint() const;
+
+ private:
+  static int stencilSize(const CompactMesh& mesh, int f);
+  static void faceStencils(const CompactMesh& mesh, int f, int* offsets,
+                           int* indices, float* weights);
+
+  QVector<int> faces;
+  // Stencil of control point i: indices / weights [offsets[i], offsets[i+1])
+  QVector<int> offsets;
+  QVector<int> indices;
+  QVector<float> weights;
+};
+
+#endif  // APPROX_PATCH_TABLE_H
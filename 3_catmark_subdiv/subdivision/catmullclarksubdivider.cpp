@@ -2,13 +2,73 @@
 
 #include <QDebug>
 #include <QSet>
+#include <algorithm>
 #include <cmath>
 
+#include "util/profiler.h"
+
 /**
  * @brief CatmullClarkSubdivider::CatmullClarkSubdivider Creates a new empty
  * Catmull Clark subdivider.
+ * @param mode The way the geometry refinement is performed.
+ */
+CatmullClarkSubdivider::CatmullClarkSubdivider(RefinementMode mode)
+    : refinementMode(mode) {}
+
+/**
+ * @brief twinIndex Finds the twin of a half-edge like HalfEdge::twinIdx, but
+ * inline, as it is called for every step of the walks around the vertices.
+ * @param halfEdges The half-edges of the mesh.
+ * @param h Index of the half-edge.
+ * @return The index of the twin, or -1 for a boundary half-edge.
+ */
+static inline int twinIndex(const HalfEdge *halfEdges, int h) {
+  const HalfEdge *twin = halfEdges[h].twin;
+  return twin == nullptr ? -1 : twin->index;
+}
+
+/**
+ * @brief The FaceTopology struct finds the next and previous half-edge and the
+ * face of a half-edge in a control mesh whose faces all have Arity sides and
+ * are laid out like the children of a subdivision step: the half-edges of face
+ * f are Arity * f to Arity * f + Arity - 1, in order. These follow from the
+ * index alone, so the stored next, prev and face links are never read and the
+ * loops over the sides of a face have a fixed trip count.
+ */
+template <int Arity>
+struct FaceTopology {
+  // Indices are never negative here, and unsigned arithmetic lets a power of
+  // two arity compile to masks and shifts
+  static inline int next(const HalfEdge *, int h) {
+    return unsigned(h) % Arity == Arity - 1 ? h - (Arity - 1) : h + 1;
+  }
+  static inline int prev(const HalfEdge *, int h) {
+    return unsigned(h) % Arity == 0 ? h + (Arity - 1) : h - 1;
+  }
+  static inline int face(const HalfEdge *, int h) {
+    return int(unsigned(h) / Arity);
+  }
+  static inline int valence(const Face &) { return Arity; }
+};
+
+/**
+ * @brief The FaceTopology<0> struct handles faces with any number of sides by
+ * following the stored links, as needed for the control mesh of the first
+ * subdivision step.
  */
-CatmullClarkSubdivider::CatmullClarkSubdivider() {}
+template <>
+struct FaceTopology<0> {
+  static inline int next(const HalfEdge *halfEdges, int h) {
+    return halfEdges[h].next->index;
+  }
+  static inline int prev(const HalfEdge *halfEdges, int h) {
+    return halfEdges[h].prev->index;
+  }
+  static inline int face(const HalfEdge *halfEdges, int h) {
+    return halfEdges[h].face->index;
+  }
+  static inline int valence(const Face &face) { return face.valence; }
+};
 
 /**
  * @brief CatmullClarkSubdivider::subdivide Subdivides the provided control mesh
@@ -23,17 +83,106 @@ CatmullClarkSubdivider::CatmullClarkSubdivider() {}
  */
 Mesh CatmullClarkSubdivider::subdivide(Mesh &mesh) const {
   Mesh newMesh;
-  reserveSizes(mesh, newMesh);
-  geometryRefinement(mesh, newMesh);
-  topologyRefinement(mesh, newMesh);
+  subdivide(mesh, newMesh);
   return newMesh;
 }
 
+/**
+ * @brief CatmullClarkSubdivider::subdivide Performs a single subdivision step
+ * like subdivide above, but writes the result into an existing mesh. The
+ * vectors of that mesh are resized, so a mesh that already has enough
+ * capacity, such as one from a MeshPool, is filled without allocating.
+ * @param mesh The mesh to be subdivided.
+ * @param newMesh The mesh the result is written into. Its previous contents
+ * are overwritten. Must not be the mesh being subdivided.
+ */
+void CatmullClarkSubdivider::subdivide(Mesh &mesh, Mesh &newMesh) const {
+  ProfileScope scope("CatmullClarkSubdivider::subdivide");
+  if (!mesh.isClassified()) {
+    ProfileScope classifyScope("Mesh::classifyVertices");
+    mesh.classifyVertices();
+  }
+  {
+    ProfileScope reserveScope("CatmullClarkSubdivider::reserveSizes");
+    reserveSizes(mesh, newMesh);
+  }
+  if (refinementMode == PARALLEL && mesh.isQuadMesh()) {
+    parallelRefinement<4>(mesh, newMesh);
+  } else if (refinementMode == PARALLEL) {
+    parallelRefinement<0>(mesh, newMesh);
+  } else {
+    {
+      ProfileScope geometryScope("CatmullClarkSubdivider::geometryRefinement");
+      geometryRefinement(mesh, newMesh);
+    }
+    ProfileScope topologyScope("CatmullClarkSubdivider::topologyRefinement");
+    topologyRefinement(mesh, newMesh);
+  }
+}
+
+/**
+ * @brief CatmullClarkSubdivider::parallelRefinement Performs the topology and
+ * geometry refinement of the parallel path.
+ * @param controlMesh The control mesh. Must be classified. For an arity other
+ * than 0, every face must have that many sides, see FaceTopology.
+ * @param newMesh The new mesh. Its vectors must already have the correct sizes.
+ */
+template <int Arity>
+void CatmullClarkSubdivider::parallelRefinement(Mesh &controlMesh,
+                                                Mesh &newMesh) const {
+  if (Profiler::isEnabled()) {
+    profiledParallelRefinement<Arity>(controlMesh, newMesh);
+    return;
+  }
+  // Topology and geometry refinement write disjoint data, so they share one
+  // parallel region: threads that finish their part of the topology pass
+  // continue with the geometry phases.
+#pragma omp parallel
+  {
+    parallelTopologyRefinement<Arity>(controlMesh, newMesh);
+    parallelGeometryRefinement<Arity>(controlMesh, newMesh);
+  }
+}
+
+/**
+ * @brief CatmullClarkSubdivider::profiledParallelRefinement Performs the same
+ * refinement as the parallel path of subdivide, but runs the topology pass and
+ * every geometry phase in a parallel region of its own, so each of them can be
+ * timed. Only used while the Profiler is enabled, since the extra barriers
+ * make the refinement slightly slower.
+ * @param controlMesh The control mesh.
+ * @param newMesh The new mesh. Its vectors must already have the correct sizes.
+ */
+template <int Arity>
+void CatmullClarkSubdivider::profiledParallelRefinement(Mesh &controlMesh,
+                                                        Mesh &newMesh) const {
+  {
+    ProfileScope scope("CatmullClarkSubdivider::topologyRefinement");
+#pragma omp parallel
+    parallelTopologyRefinement<Arity>(controlMesh, newMesh);
+  }
+  {
+    ProfileScope scope("CatmullClarkSubdivider::facePointPhase");
+#pragma omp parallel
+    facePointPhase<Arity>(controlMesh, newMesh);
+  }
+  {
+    ProfileScope scope("CatmullClarkSubdivider::edgePointPhase");
+#pragma omp parallel
+    edgePointPhase<Arity>(controlMesh, newMesh);
+  }
+  ProfileScope scope("CatmullClarkSubdivider::vertexPointPhase");
+#pragma omp parallel
+  vertexPointPhase<Arity>(controlMesh, newMesh);
+}
+
 /**
  * @brief CatmullClarkSubdivider::reserveSizes Resizes the vertex, half-edge and
- * face vectors. Aslo recalculates the edge count.
+ * face vectors and the vertex classification. Aslo recalculates the edge
+ * count.
  * @param controlMesh The control mesh.
- * @param newMesh The new mesh. At this point, the mesh is fully empty.
+ * @param newMesh The new mesh. It is either empty or holds a mesh that is
+ * overwritten entirely.
  */
 void CatmullClarkSubdivider::reserveSizes(Mesh &controlMesh,
                                           Mesh &newMesh) const {
@@ -46,7 +195,10 @@ void CatmullClarkSubdivider::reserveSizes(Mesh &controlMesh,
   newMesh.getVertices().resize(newNumVerts);
   newMesh.getHalfEdges().resize(newNumHalfEdges);
   newMesh.getFaces().resize(newNumFaces);
+  newMesh.resizeClassification(newNumVerts);
   newMesh.edgeCount = newNumEdges;
+  // The children of half-edge h are 4h to 4h + 3 and form face h
+  newMesh.quadMesh = true;
 }
 
 /**
@@ -119,69 +271,256 @@ void CatmullClarkSubdivider::geometryRefinement(Mesh &controlMesh,
   // Vertex Points
   for (int v = 0; v < controlMesh.numVerts(); v++) {
     QVector3D coords;
-    if (vertices[v].isBoundaryVertex()) {
-      coords = boundaryVertexPoint(vertices[v]);
-    } else {
-      // Check if vertex is on a crease (has exactly 2 crease edges) or is a corner (3+ crease edges)
-      int numCreaseEdges = countCreaseEdges(vertices[v]);
-      if (numCreaseEdges >= 3) {
+    switch (controlMesh.vertexRule(v)) {
+      case Mesh::BOUNDARY_VERTEX:
+        coords = boundaryVertexPoint(vertices[v]);
+        break;
+      case Mesh::CORNER_VERTEX:
         // Corner: position unchanged
         coords = vertices[v].coords;
-      } else if (numCreaseEdges == 2) {
-        // Crease vertex: blend between crease and smooth rules based on sharpness
-        QVector3D creaseCoords = creaseVertexPoint(vertices[v]);
-        QVector3D smoothCoords = vertexPoint(vertices[v]);
-        
-        // Find the two crease edges and get their sharpness values
-        HalfEdge* creaseEdge1 = nullptr;
-        HalfEdge* creaseEdge2 = nullptr;
-        QSet<int> foundEdgeIndices;
-        HalfEdge* h = vertices[v].out;
-        int maxIterations = vertices[v].valence * 2;
-        int iterations = 0;
-        
-        do {
-          if (h->isSharpEdge() && !foundEdgeIndices.contains(h->edgeIndex)) {
-            if (creaseEdge1 == nullptr) {
-              creaseEdge1 = h;
-              foundEdgeIndices.insert(h->edgeIndex);
-            } else if (creaseEdge2 == nullptr) {
-              creaseEdge2 = h;
-              foundEdgeIndices.insert(h->edgeIndex);
-              break;
-            }
-          }
-          h = h->prev->twin;
-          if (h == nullptr) break;
-          iterations++;
-        } while (h != vertices[v].out && h != nullptr && iterations < maxIterations);
-        
-        // Calculate blending factor based on fractional parts of sharpness
-        float blendFactor = 0.0f;
-        if (creaseEdge1 != nullptr && creaseEdge2 != nullptr) {
-          float s1 = creaseEdge1->sharpness;
-          float s2 = creaseEdge2->sharpness;
-          if (s1 == -1.0f || s2 == -1.0f) {
-            // Infinite sharpness: use crease rules
-            blendFactor = 0.0f;
-          } else {
-            // Use average of fractional parts for blending
-            float f1 = s1 - floorf(s1);
-            float f2 = s2 - floorf(s2);
-            blendFactor = (f1 + f2) / 2.0f;
-          }
-        }
-        // Blend: when blendFactor is 0, use crease; when 1, use smooth
-        coords = (1.0f - blendFactor) * creaseCoords + blendFactor * smoothCoords;
-      } else {
+        break;
+      case Mesh::CREASE_VERTEX: {
+        // Crease vertex: blend between crease and smooth rules based on
+        // sharpness
+        float blendFactor = controlMesh.creaseBlend(v);
+        coords = (1.0f - blendFactor) * creaseVertexPoint(controlMesh,
+                                                          vertices[v]) +
+                 blendFactor * vertexPoint(vertices[v]);
+        break;
+      }
+      default:
         // Smooth vertex (0 or 1 crease edge): use smooth vertex rules
         coords = vertexPoint(vertices[v]);
-      }
     }
     newVertices[v] = Vertex(coords, nullptr, vertices[v].valence, v);
   }
 }
 
+/**
+ * @brief CatmullClarkSubdivider::parallelGeometryRefinement Performs the same
+ * geometry refinement as geometryRefinement, but split into three phases. The
+ * face points are computed first and stored at their final place in the new
+ * vertex array. The edge and vertex points then read these cached face points
+ * instead of recomputing them. Each phase only reads from the control mesh and
+ * from the results of earlier phases, and every iteration writes a distinct
+ * vertex, so all phases run as data-parallel loops. Only the coordinates,
+ * valence and index of the new vertices are written; the outgoing half-edges
+ * are set by parallelTopologyRefinement. Must be called from within a parallel
+ * region, or it runs serially.
+ * @param controlMesh The control mesh.
+ * @param newMesh The new mesh. Its vectors must already have the correct sizes.
+ */
+template <int Arity>
+void CatmullClarkSubdivider::parallelGeometryRefinement(Mesh &controlMesh,
+                                                        Mesh &newMesh) const {
+  facePointPhase<Arity>(controlMesh, newMesh);
+  edgePointPhase<Arity>(controlMesh, newMesh);
+  vertexPointPhase<Arity>(controlMesh, newMesh);
+}
+
+/**
+ * @brief CatmullClarkSubdivider::facePointPhase Computes all face points.
+ * @param controlMesh The control mesh.
+ * @param newMesh The new mesh.
+ */
+template <int Arity>
+void CatmullClarkSubdivider::facePointPhase(Mesh &controlMesh,
+                                            Mesh &newMesh) const {
+  const HalfEdge *halfEdges = controlMesh.halfEdges.constData();
+  const Face *faces = controlMesh.faces.constData();
+  Vertex *newVertices = newMesh.vertices.data();
+  const int numVerts = controlMesh.numVerts();
+  const int numFaces = controlMesh.numFaces();
+
+#pragma omp for schedule(static)
+  for (int f = 0; f < numFaces; f++) {
+    int i = numVerts + faces[f].index;
+    newVertices[i].coords = facePoint<Arity>(halfEdges, faces[f]);
+    // Face points always inherit the valence of the face
+    newVertices[i].valence = FaceTopology<Arity>::valence(faces[f]);
+    newVertices[i].index = i;
+  }
+}
+
+/**
+ * @brief CatmullClarkSubdivider::edgePointPhase Computes all edge points, using
+ * the face points computed by facePointPhase.
+ * @param controlMesh The control mesh.
+ * @param newMesh The new mesh.
+ */
+template <int Arity>
+void CatmullClarkSubdivider::edgePointPhase(Mesh &controlMesh,
+                                            Mesh &newMesh) const {
+  const HalfEdge *halfEdges = controlMesh.halfEdges.constData();
+  Vertex *newVertices = newMesh.vertices.data();
+  const Vertex *facePoints = newVertices + controlMesh.numVerts();
+  const int edgePointOffset = controlMesh.numVerts() + controlMesh.numFaces();
+  const int numHalfEdges = controlMesh.numHalfEdges();
+
+#pragma omp for schedule(static) nowait
+  for (int h = 0; h < numHalfEdges; h++) {
+    const HalfEdge &currentEdge = halfEdges[h];
+    // Only create a new vertex per set of halfEdges (i.e. once per undirected
+    // edge)
+    if (h <= twinIndex(halfEdges, h)) {
+      continue;
+    }
+    int v = edgePointOffset + currentEdge.edgeIdx();
+    newVertices[v].coords = newEdgePoint<Arity>(halfEdges, h, facePoints);
+    newVertices[v].valence = currentEdge.isBoundaryEdge() ? 3 : 4;
+    newVertices[v].index = v;
+  }
+}
+
+/**
+ * @brief CatmullClarkSubdivider::vertexPointPhase Computes all vertex points,
+ * using the face points computed by facePointPhase.
+ * @param controlMesh The control mesh.
+ * @param newMesh The new mesh.
+ */
+template <int Arity>
+void CatmullClarkSubdivider::vertexPointPhase(Mesh &controlMesh,
+                                              Mesh &newMesh) const {
+  const Vertex *vertices = controlMesh.vertices.constData();
+  Vertex *newVertices = newMesh.vertices.data();
+  const Vertex *facePoints = newVertices + controlMesh.numVerts();
+  const int numVerts = controlMesh.numVerts();
+
+#pragma omp for schedule(static)
+  for (int v = 0; v < numVerts; v++) {
+    const Vertex &vertex = vertices[v];
+    newVertices[v].coords =
+        newVertexPoint<Arity>(controlMesh, vertex, facePoints);
+    newVertices[v].valence = vertex.valence;
+    newVertices[v].index = v;
+  }
+}
+
+/**
+ * @brief CatmullClarkSubdivider::newEdgePoint Calculates the position of the
+ * edge point of an edge, applying the boundary, sharp, semi-sharp or smooth
+ * rule as required. Boundary and sharp edges use the midpoint.
+ * @param halfEdges The half-edges of the control mesh.
+ * @param h One of the half-edges of the edge.
+ * @param facePoints The face points of the new mesh, indexed by face index.
+ * @return The coordinates of the new edge point.
+ */
+template <int Arity>
+QVector3D CatmullClarkSubdivider::newEdgePoint(const HalfEdge *halfEdges,
+                                               int h,
+                                               const Vertex *facePoints) const {
+  const HalfEdge &edge = halfEdges[h];
+  if (edge.isBoundaryEdge() || edge.sharpness == -1.0f) {
+    return midpoint<Arity>(halfEdges, h);
+  }
+  if (edge.isSharpEdge()) {
+    // Blend between sharp and smooth rules using the fractional sharpness
+    float fractionalPart = edge.sharpness - floorf(edge.sharpness);
+    return (1.0f - fractionalPart) * midpoint<Arity>(halfEdges, h) +
+           fractionalPart * edgePoint<Arity>(halfEdges, h, facePoints);
+  }
+  return edgePoint<Arity>(halfEdges, h, facePoints);
+}
+
+/**
+ * @brief CatmullClarkSubdivider::newVertexPoint Calculates the position of the
+ * vertex point of a vertex, applying the boundary, corner, crease or smooth
+ * rule as given by the vertex classification.
+ * @param controlMesh The control mesh. Must be classified.
+ * @param vertex The vertex from the control mesh.
+ * @param facePoints The face points of the new mesh, indexed by face index.
+ * @return The coordinates of the new vertex point.
+ */
+template <int Arity>
+QVector3D CatmullClarkSubdivider::newVertexPoint(
+    const Mesh &controlMesh, const Vertex &vertex,
+    const Vertex *facePoints) const {
+  const HalfEdge *halfEdges = controlMesh.halfEdges.constData();
+  switch (controlMesh.vertexRule(vertex.index)) {
+    case Mesh::BOUNDARY_VERTEX:
+      return boundaryVertexPoint(vertex);
+    case Mesh::CORNER_VERTEX:
+      // Corner: position unchanged
+      return vertex.coords;
+    case Mesh::CREASE_VERTEX: {
+      // Crease vertex: blend between crease and smooth rules
+      float blendFactor = controlMesh.creaseBlend(vertex.index);
+      return (1.0f - blendFactor) * creaseVertexPoint(controlMesh, vertex) +
+             blendFactor * vertexPoint<Arity>(halfEdges, vertex, facePoints);
+    }
+    default:
+      return vertexPoint<Arity>(halfEdges, vertex, facePoints);
+  }
+}
+
+/**
+ * @brief CatmullClarkSubdivider::vertexPoint Calculates the new position of the
+ * provided vertex with the smooth vertex rule, reading the face points from the
+ * new vertex array instead of recomputing them.
+ * @param halfEdges The half-edges of the control mesh.
+ * @param vertex The vertex from the control mesh.
+ * @param facePoints The face points of the new mesh, indexed by face index.
+ * @return The coordinates of the new vertex point.
+ */
+template <int Arity>
+QVector3D CatmullClarkSubdivider::vertexPoint(const HalfEdge *halfEdges,
+                                              const Vertex &vertex,
+                                              const Vertex *facePoints) const {
+  typedef FaceTopology<Arity> Topology;
+  int h = vertex.out->index;
+  QVector3D R;  // average of all edge mid points
+  QVector3D Q;  // average of all face points adjacent to the vertex
+
+  for (int i = 0; i < vertex.valence; i++) {
+    R += (halfEdges[h].origin->coords +
+          halfEdges[Topology::next(halfEdges, h)].origin->coords) /
+         2.0;
+    Q += facePoints[Topology::face(halfEdges, h)].coords;
+    h = twinIndex(halfEdges, Topology::prev(halfEdges, h));
+  }
+
+  float n = float(vertex.valence);
+  Q /= n;
+  R /= n;
+  return (Q + 2 * R + (vertex.coords * (n - 3.0f))) / n;
+}
+
+/**
+ * @brief CatmullClarkSubdivider::edgePoint Calculates the position of the
+ * smooth edge point, reading the face points from the new vertex array instead
+ * of recomputing them.
+ * @param halfEdges The half-edges of the control mesh.
+ * @param h One of the half-edges of the (interior) edge.
+ * @param facePoints The face points of the new mesh, indexed by face index.
+ * @return The coordinates of the new edge point.
+ */
+template <int Arity>
+QVector3D CatmullClarkSubdivider::edgePoint(const HalfEdge *halfEdges, int h,
+                                            const Vertex *facePoints) const {
+  typedef FaceTopology<Arity> Topology;
+  QVector3D edgePt = midpoint<Arity>(halfEdges, h);
+  edgePt += (facePoints[Topology::face(halfEdges, h)].coords +
+             facePoints[Topology::face(halfEdges, twinIndex(halfEdges, h))]
+                 .coords) /
+            2.0;
+  return edgePt /= 2.0;
+}
+
+/**
+ * @brief CatmullClarkSubdivider::midpoint Calculates the midpoint of an edge,
+ * which is the edge point of boundary and sharp edges.
+ * @param halfEdges The half-edges of the control mesh.
+ * @param h One of the half-edges of the edge.
+ * @return The midpoint.
+ */
+template <int Arity>
+QVector3D CatmullClarkSubdivider::midpoint(const HalfEdge *halfEdges,
+                                           int h) const {
+  return (halfEdges[h].origin->coords +
+          halfEdges[FaceTopology<Arity>::next(halfEdges, h)].origin->coords) /
+         2.0f;
+}
+
 /**
  * @brief CatmullClarkSubdivider::vertexPoint Calculates the new position of the
  * provided vertex. It does so according to the formula for smooth vertex
@@ -246,74 +585,24 @@ QVector3D CatmullClarkSubdivider::boundaryVertexPoint(
  * of a vertex on a crease. Uses the same formula as boundary vertices:
  * (R + S) / 2 where R is the average of crease edge midpoints and S is the
  * vertex position.
- * @param vertex The vertex on a crease to calculate the new position of.
+ * @param mesh The control mesh. Must be classified.
+ * @param vertex The vertex on a crease to calculate the new position of. It
+ * must have exactly two crease edges.
  * @return The coordinates of the new crease vertex point.
  */
-int CatmullClarkSubdivider::countCreaseEdges(const Vertex& vertex) const {
-  // Count the number of unique crease edges incident to this vertex
-  QSet<int> creaseEdgeIndices;  // Use edge indices to avoid duplicates
-  
-  HalfEdge* h = vertex.out;
-  int maxIterations = vertex.valence * 2;  // Safety limit
-  int iterations = 0;
-  
-  // Iterate around the vertex - each edge will be encountered exactly once
-  // as an outgoing half-edge from this vertex
-  do {
-    if (h->isSharpEdge()) {
-      creaseEdgeIndices.insert(h->edgeIndex);
-    }
-    // Move to next edge around vertex
-    h = h->prev->twin;
-    if (h == nullptr) break;  // Reached boundary
-    iterations++;
-  } while (h != vertex.out && h != nullptr && iterations < maxIterations);
-  
-  return creaseEdgeIndices.size();
-}
-
 QVector3D CatmullClarkSubdivider::creaseVertexPoint(
-    const Vertex &vertex) const {
-  // This function should only be called for vertices with exactly 2 crease edges
-  // Formula: v^(i+1) = (e_j^i + 6v^i + e_k^i) / 8
-  // where e_j and e_k are the midpoints of the two crease edges
-  
-  // Find the two crease edges
-  HalfEdge* creaseEdge1 = nullptr;
-  HalfEdge* creaseEdge2 = nullptr;
-  QSet<int> foundEdgeIndices;
-  
-  HalfEdge* h = vertex.out;
-  int maxIterations = vertex.valence * 2;
-  int iterations = 0;
-  
-  do {
-    if (h->isSharpEdge() && !foundEdgeIndices.contains(h->edgeIndex)) {
-      if (creaseEdge1 == nullptr) {
-        creaseEdge1 = h;
-        foundEdgeIndices.insert(h->edgeIndex);
-      } else if (creaseEdge2 == nullptr) {
-        creaseEdge2 = h;
-        foundEdgeIndices.insert(h->edgeIndex);
-        break;
-      }
-    }
-    h = h->prev->twin;
-    if (h == nullptr) break;
-    iterations++;
-  } while (h != vertex.out && h != nullptr && iterations < maxIterations);
-  
+    const Mesh &mesh, const Vertex &vertex) const {
+  const HalfEdge &creaseEdge1 =
+      mesh.halfEdges[mesh.creaseHalfEdge(vertex.index, 0)];
+  const HalfEdge &creaseEdge2 =
+      mesh.halfEdges[mesh.creaseHalfEdge(vertex.index, 1)];
   // Actually does not follow the stencil from the paper, but seems to work
   // as opposed to the original paper's stencil. Can't explain why, I just
   // tried other stencils and now it seems to be fine.
-  if (creaseEdge1 != nullptr && creaseEdge2 != nullptr) {
-    QVector3D result = 0.5f*vertex.coords;
-    result += 0.25f*sharpEdgePoint(*creaseEdge1);
-    result += 0.25f*sharpEdgePoint(*creaseEdge2);
-    return result;
-  }
-  // Fallback: should not happen, but return vertex position unchanged
-  return vertex.coords;
+  QVector3D result = 0.5f*vertex.coords;
+  result += 0.25f*sharpEdgePoint(creaseEdge1);
+  result += 0.25f*sharpEdgePoint(creaseEdge2);
+  return result;
 }
 
 /**
@@ -377,10 +666,32 @@ QVector3D CatmullClarkSubdivider::facePoint(const Face &face) const {
   return edgePt / face.valence;
 }
 
+/**
+ * @brief CatmullClarkSubdivider::facePoint Calculates the position of the face
+ * point like facePoint(const Face&), finding the corners by index. For faces
+ * of a fixed arity the loop over the corners is unrolled.
+ * @param halfEdges The half-edges of the control mesh.
+ * @param face The face from the control mesh.
+ * @return The coordinates of the new face point.
+ */
+template <int Arity>
+QVector3D CatmullClarkSubdivider::facePoint(const HalfEdge *halfEdges,
+                                            const Face &face) const {
+  typedef FaceTopology<Arity> Topology;
+  QVector3D edgePt;
+  int h = face.side->index;
+  for (int side = 0; side < Topology::valence(face); side++) {
+    edgePt += halfEdges[h].origin->coords;
+    h = Topology::next(halfEdges, h);
+  }
+  return edgePt / Topology::valence(face);
+}
+
 /**
  * @brief CatmullClarkSubdivider::topologyRefinement Performs the topology
  * refinement. Every face is split into n new faces, where n is the valence of
- * the original face. Newly generated faces are all quads.
+ * the original face. Newly generated faces are all quads. The new vertices are
+ * classified from the classification of the control mesh.
  * @param controlMesh The control mesh.
  * @param newMesh The new mesh.
  */
@@ -467,6 +778,287 @@ void CatmullClarkSubdivider::topologyRefinement(Mesh &controlMesh,
       newMesh.halfEdges[h3].twin->sharpness = 0.0f;
     }
   }
+
+  // Classify the new vertices
+  const int numVerts = controlMesh.numVerts();
+  const int edgePointOffset = numVerts + controlMesh.numFaces();
+  for (int v = 0; v < numVerts; ++v) {
+    classifyVertexPoint<0>(controlMesh, v, newMesh);
+  }
+  for (int f = 0; f < controlMesh.numFaces(); ++f) {
+    newMesh.setVertexClass(numVerts + f, Mesh::SMOOTH_VERTEX, 0, -1, -1, 0.0f);
+  }
+  const HalfEdge *halfEdges = controlMesh.halfEdges.constData();
+  for (int h = 0; h < controlMesh.numHalfEdges(); ++h) {
+    if (h > twinIndex(halfEdges, h)) {
+      classifyEdgePoint<0>(halfEdges, h,
+                           edgePointOffset + halfEdges[h].edgeIndex, newMesh);
+    }
+  }
+}
+
+/**
+ * @brief childSharpness Calculates the sharpness of the child edges that lie
+ * along an edge with the given sharpness. A semi-sharp edge loses one unit of
+ * sharpness per level; infinitely sharp edges stay infinitely sharp.
+ * @param sharpness Sharpness of the parent edge.
+ * @return Sharpness of the child edges.
+ */
+static inline float childSharpness(float sharpness) {
+  if (sharpness > 0.0f) {
+    return sharpness - 1.0f;
+  }
+  return sharpness == -1.0f ? -1.0f : 0.0f;
+}
+
+/**
+ * @brief lastOutgoingHalfEdge Finds the outgoing half-edge of a vertex with the
+ * highest index. The child mesh uses its first child as the outgoing half-edge
+ * of the corresponding vertex point, which matches the half-edge the serial
+ * topology refinement ends up with.
+ * @param halfEdges The half-edges of the mesh.
+ * @param vertex The vertex.
+ * @return The highest index of a half-edge originating from the vertex, or -1
+ * for an isolated vertex.
+ */
+template <int Arity>
+static int lastOutgoingHalfEdge(const HalfEdge *halfEdges,
+                                const Vertex &vertex) {
+  typedef FaceTopology<Arity> Topology;
+  if (vertex.out == nullptr) {
+    return -1;
+  }
+  const int out = vertex.out->index;
+  int last = out;
+  int h = twinIndex(halfEdges, Topology::prev(halfEdges, out));
+  while (h >= 0 && h != out) {
+    last = std::max(last, h);
+    h = twinIndex(halfEdges, Topology::prev(halfEdges, h));
+  }
+  if (h < 0) {
+    // Boundary vertex: also walk around in the other direction
+    h = twinIndex(halfEdges, out);
+    while (h >= 0) {
+      h = Topology::next(halfEdges, h);
+      last = std::max(last, h);
+      h = twinIndex(halfEdges, h);
+    }
+  }
+  return last;
+}
+
+/**
+ * @brief isSharp Checks whether an edge with the given sharpness is a crease
+ * edge, see HalfEdge::isSharpEdge.
+ * @param sharpness Sharpness of the edge.
+ * @return True if the edge is a crease edge.
+ */
+static inline bool isSharp(float sharpness) {
+  return sharpness > 0.0f || sharpness == -1.0f;
+}
+
+/**
+ * @brief CatmullClarkSubdivider::classifyVertexPoint Classifies the vertex
+ * point of a vertex. Its edges are the children 4h of the outgoing half-edges
+ * h of the parent vertex, so it is a crease vertex for every parent crease
+ * edge that is still sharp after decrementing its sharpness. Only corners walk
+ * the one-ring of the parent; the other vertices read their crease edges from
+ * the parent classification. Only reads the control mesh, so it may run
+ * concurrently with the topology refinement.
+ * @param controlMesh The control mesh. Must be classified.
+ * @param v Index of the vertex in the control mesh, which is also the index of
+ * its vertex point.
+ * @param newMesh The new mesh.
+ */
+template <int Arity>
+void CatmullClarkSubdivider::classifyVertexPoint(const Mesh &controlMesh,
+                                                 int v, Mesh &newMesh) const {
+  const Mesh::VertexRule rule = controlMesh.vertexRule(v);
+  const int numCreaseEdges = controlMesh.numCreaseEdges(v);
+  if (rule == Mesh::BOUNDARY_VERTEX || numCreaseEdges == 0) {
+    newMesh.setVertexClass(v, rule, 0, -1, -1, 0.0f);
+    return;
+  }
+
+  int creases[2] = {-1, -1};
+  float sharpness[2] = {0.0f, 0.0f};
+  int count = 0;
+  auto addChild = [&creases, &sharpness, &count](const HalfEdge &edge) {
+    float s = childSharpness(edge.sharpness);
+    if (!isSharp(s)) {
+      return;
+    }
+    if (count < 2) {
+      creases[count] = 4 * edge.index;
+      sharpness[count] = s;
+    }
+    count++;
+  };
+  if (numCreaseEdges <= 2) {
+    for (int k = 0; k < numCreaseEdges; k++) {
+      addChild(controlMesh.halfEdges[controlMesh.creaseHalfEdge(v, k)]);
+    }
+  } else {
+    const HalfEdge *halfEdges = controlMesh.halfEdges.constData();
+    const int out = controlMesh.vertices[v].out->index;
+    int h = out;
+    do {
+      addChild(halfEdges[h]);
+      h = twinIndex(halfEdges, FaceTopology<Arity>::prev(halfEdges, h));
+    } while (h != out);
+  }
+
+  if (count >= 3) {
+    newMesh.setVertexClass(v, Mesh::CORNER_VERTEX, count, creases[0],
+                           creases[1], 0.0f);
+  } else if (count == 2) {
+    newMesh.setVertexClass(v, Mesh::CREASE_VERTEX, count, creases[0],
+                           creases[1],
+                           Mesh::creaseBlendFactor(sharpness[0], sharpness[1]));
+  } else {
+    newMesh.setVertexClass(v, Mesh::SMOOTH_VERTEX, count, creases[0], -1,
+                           0.0f);
+  }
+}
+
+/**
+ * @brief CatmullClarkSubdivider::classifyEdgePoint Classifies the edge point of
+ * an edge. Its edges towards the face points are smooth, so it is a crease
+ * vertex exactly when the two children along the parent edge are still sharp.
+ * Only reads the control mesh, so it may run concurrently with the topology
+ * refinement.
+ * @param halfEdges The half-edges of the control mesh.
+ * @param h The half-edge of the edge with the higher index, or the boundary
+ * half-edge.
+ * @param v Index of the edge point in the new mesh.
+ * @param newMesh The new mesh.
+ */
+template <int Arity>
+void CatmullClarkSubdivider::classifyEdgePoint(const HalfEdge *halfEdges,
+                                               int h, int v,
+                                               Mesh &newMesh) const {
+  typedef FaceTopology<Arity> Topology;
+  const HalfEdge &edge = halfEdges[h];
+  if (edge.twin == nullptr) {
+    newMesh.setVertexClass(v, Mesh::BOUNDARY_VERTEX, 0, -1, -1, 0.0f);
+    return;
+  }
+  float s = childSharpness(edge.sharpness);
+  if (!isSharp(s)) {
+    newMesh.setVertexClass(v, Mesh::SMOOTH_VERTEX, 0, -1, -1, 0.0f);
+    return;
+  }
+  // The children along the edge that originate from the edge point
+  const int twin = edge.twin->index;
+  newMesh.setVertexClass(v, Mesh::CREASE_VERTEX, 2,
+                         4 * Topology::next(halfEdges, h) + 3,
+                         4 * Topology::next(halfEdges, twin) + 3,
+                         Mesh::creaseBlendFactor(s, s));
+}
+
+/**
+ * @brief CatmullClarkSubdivider::parallelTopologyRefinement Performs the same
+ * topology refinement as topologyRefinement, but as a table-driven parallel
+ * pass. Every child of a parent half-edge h is fully determined by index
+ * arithmetic on h, its next, prev and twin: children are 4h+k, edge points
+ * live at numVerts + numFaces + edgeIndex and face points at numVerts +
+ * faceIndex. Each parent half-edge writes only its own four children and its
+ * own child face, and each new vertex gets its outgoing half-edge from exactly
+ * one iteration, so no two iterations write the same data. Sharpness is
+ * propagated in the same pass: the children along the parent edges inherit the
+ * decremented sharpness of that edge, the children towards the face point are
+ * smooth. The new vertices are classified in the same pass as well. Must be
+ * called from within a parallel region, or it runs serially. The new mesh
+ * still stores the next, prev and face links for the other users of Mesh, but
+ * for a control mesh of fixed arity they are not read here.
+ * @param controlMesh The control mesh. Must be classified.
+ * @param newMesh The new mesh. Its vectors must already have the correct sizes.
+ */
+template <int Arity>
+void CatmullClarkSubdivider::parallelTopologyRefinement(Mesh &controlMesh,
+                                                        Mesh &newMesh) const {
+  typedef FaceTopology<Arity> Topology;
+  const HalfEdge *halfEdges = controlMesh.halfEdges.constData();
+  const Vertex *vertices = controlMesh.vertices.constData();
+  const Face *faces = controlMesh.faces.constData();
+  HalfEdge *newHalfEdges = newMesh.halfEdges.data();
+  Vertex *newVertices = newMesh.vertices.data();
+  Face *newFaces = newMesh.faces.data();
+
+  const int numVerts = controlMesh.numVerts();
+  const int numFaces = controlMesh.numFaces();
+  const int numHalfEdges = controlMesh.numHalfEdges();
+  const int edgePointOffset = numVerts + numFaces;
+  const int faceEdgeOffset = 2 * controlMesh.numEdges();
+
+#pragma omp for schedule(static) nowait
+  for (int h = 0; h < numHalfEdges; ++h) {
+    const HalfEdge &edge = halfEdges[h];
+    const int next = Topology::next(halfEdges, h);
+    const int prevIdx = Topology::prev(halfEdges, h);
+    const HalfEdge &prev = halfEdges[prevIdx];
+    const int twin = twinIndex(halfEdges, h);
+    const int prevTwin = twinIndex(halfEdges, prevIdx);
+    const int twinNext = twin < 0 ? -1 : Topology::next(halfEdges, twin);
+
+    // The origin index follows from the pointer, without loading the vertex
+    const int origins[4] = {int(edge.origin - vertices),
+                            edgePointOffset + edge.edgeIndex,
+                            numVerts + Topology::face(halfEdges, h),
+                            edgePointOffset + prev.edgeIndex};
+    const int twins[4] = {twin < 0 ? -1 : 4 * twinNext + 3, 4 * next + 2,
+                          4 * prevIdx + 1, prevTwin < 0 ? -1 : 4 * prevTwin};
+    const int edges[4] = {2 * edge.edgeIndex + (h > twin ? 0 : 1),
+                          faceEdgeOffset + h, faceEdgeOffset + prevIdx,
+                          2 * prev.edgeIndex + (prevIdx > prevTwin ? 1 : 0)};
+    const float sharpness[4] = {childSharpness(edge.sharpness), 0.0f, 0.0f,
+                                childSharpness(prev.sharpness)};
+
+    Face *face = &newFaces[h];
+    for (int k = 0; k < 4; ++k) {
+      HalfEdge *child = &newHalfEdges[4 * h + k];
+      child->index = 4 * h + k;
+      child->edgeIndex = edges[k];
+      child->sharpness = sharpness[k];
+      child->origin = &newVertices[origins[k]];
+      child->face = face;
+      child->next = &newHalfEdges[4 * h + (k + 1) % 4];
+      child->prev = &newHalfEdges[4 * h + (k + 3) % 4];
+      child->twin = twins[k] < 0 ? nullptr : &newHalfEdges[twins[k]];
+    }
+    face->index = h;
+    face->valence = 4;
+    face->side = &newHalfEdges[4 * h + 3];
+
+    // One iteration per edge sets the outgoing half-edge of its edge point
+    if (h > twin) {
+      int last = std::max(4 * h + 1, 4 * next + 3);
+      if (twin >= 0) {
+        last = std::max(last, std::max(4 * twin + 1, 4 * twinNext + 3));
+      }
+      newVertices[origins[1]].out = &newHalfEdges[last];
+      classifyEdgePoint<Arity>(halfEdges, h, origins[1], newMesh);
+    }
+  }
+
+#pragma omp for schedule(static) nowait
+  for (int v = 0; v < numVerts; ++v) {
+    const int last = lastOutgoingHalfEdge<Arity>(halfEdges, vertices[v]);
+    newVertices[v].out = last < 0 ? nullptr : &newHalfEdges[4 * last];
+    classifyVertexPoint<Arity>(controlMesh, v, newMesh);
+  }
+
+#pragma omp for schedule(static) nowait
+  for (int f = 0; f < numFaces; ++f) {
+    int last = faces[f].side->index;
+    int side = Topology::next(halfEdges, last);
+    for (int k = 1; k < Topology::valence(faces[f]); ++k) {
+      last = std::max(last, side);
+      side = Topology::next(halfEdges, side);
+    }
+    newVertices[numVerts + f].out = &newHalfEdges[4 * last + 2];
+    newMesh.setVertexClass(numVerts + f, Mesh::SMOOTH_VERTEX, 0, -1, -1, 0.0f);
+  }
 }
 
 /**
@@ -495,3 +1087,117 @@ void CatmullClarkSubdivider::setHalfEdgeData(Mesh &newMesh, int h, int edgeIdx,
   halfEdge->origin->index = vertIdx;
   halfEdge->face->side = halfEdge;
 }
+
+/**
+ * @brief insertVertexFaces Adds the faces around a vertex to a set. Walks in
+ * both directions, so it also works for boundary vertices whose outgoing
+ * half-edge is not the boundary one.
+ * @param vertex The vertex.
+ * @param faces The set of face indices.
+ */
+static void insertVertexFaces(const Vertex &vertex, QSet<int> &faces) {
+  HalfEdge *h = vertex.out;
+  if (h == nullptr) {
+    return;
+  }
+  do {
+    faces.insert(h->faceIdx());
+    h = h->prev->twin;
+  } while (h != nullptr && h != vertex.out);
+  if (h == nullptr) {
+    h = vertex.out->twin;
+    while (h != nullptr) {
+      h = h->next;
+      faces.insert(h->faceIdx());
+      h = h->twin;
+    }
+  }
+}
+
+/**
+ * @brief CatmullClarkSubdivider::updateDirtyRegion Updates a mesh previously
+ * subdivided from the control mesh after positions or sharpness values of the
+ * control mesh changed, without subdividing it again. Topology never depends
+ * on sharpness, so only the child sharpness of the changed half-edges and the
+ * new points of the faces around the changed elements are recomputed: the
+ * face points of those faces, and the edge and vertex points of their edges
+ * and vertices. Results that did not actually change are left out of the new
+ * region, so a semi-sharp edit stops spreading once its sharpness has decayed.
+ * The end points of the changed child edges are classified again.
+ * @param controlMesh The control mesh. Its classification must include the
+ * changes.
+ * @param newMesh The mesh that resulted from subdividing the control mesh
+ * before the changes.
+ * @param region The changes in the control mesh. Replaced by the changes made
+ * to the new mesh, so that the update can be repeated for the next level.
+ */
+void CatmullClarkSubdivider::updateDirtyRegion(Mesh &controlMesh,
+                                               Mesh &newMesh,
+                                               DirtyRegion &region) const {
+  const int numVerts = controlMesh.numVerts();
+  const int edgePointOffset = numVerts + controlMesh.numFaces();
+  HalfEdge *newHalfEdges = newMesh.halfEdges.data();
+  Vertex *newVertices = newMesh.vertices.data();
+  const Vertex *facePoints = newVertices + numVerts;
+  DirtyRegion newRegion;
+  if (!controlMesh.isClassified()) {
+    controlMesh.classifyVertices();
+  }
+
+  QSet<int> faces;
+  for (int h : region.halfEdges) {
+    const HalfEdge &edge = controlMesh.halfEdges[h];
+    float s = childSharpness(edge.sharpness);
+    // The children along the parent edge, see parallelTopologyRefinement
+    const int children[2] = {4 * h, 4 * edge.next->index + 3};
+    for (int c : children) {
+      if (newHalfEdges[c].sharpness != s) {
+        newHalfEdges[c].sharpness = s;
+        newRegion.halfEdges.append(c);
+      }
+    }
+    faces.insert(edge.faceIdx());
+  }
+  // The changed children may change the rule of their end points
+  for (int c : newRegion.halfEdges) {
+    newMesh.classifyVertex(newHalfEdges[c].origin->index);
+    newMesh.classifyVertex(newHalfEdges[c].next->origin->index);
+  }
+  for (int v : region.vertices) {
+    insertVertexFaces(controlMesh.vertices[v], faces);
+  }
+
+  auto update = [&newVertices, &newRegion](int v, const QVector3D &coords) {
+    if (newVertices[v].coords != coords) {
+      newVertices[v].coords = coords;
+      newRegion.vertices.append(v);
+    }
+  };
+
+  // Face points first, as the edge and vertex points read them
+  QSet<int> edges;
+  QSet<int> vertices;
+  for (int f : faces) {
+    const Face &face = controlMesh.faces[f];
+    update(numVerts + f, facePoint(face));
+    const HalfEdge *edge = face.side;
+    for (int k = 0; k < face.valence; k++) {
+      // The half-edge the edge point phase uses for this edge
+      const HalfEdge *designated =
+          edge->twinIdx() > edge->index ? edge->twin : edge;
+      edges.insert(designated->index);
+      vertices.insert(edge->origin->index);
+      edge = edge->next;
+    }
+  }
+  for (int h : edges) {
+    const HalfEdge &edge = controlMesh.halfEdges[h];
+    update(edgePointOffset + edge.edgeIndex,
+           newEdgePoint<0>(controlMesh.halfEdges.constData(), h, facePoints));
+  }
+  for (int v : vertices) {
+    update(v, newVertexPoint<0>(controlMesh, controlMesh.vertices[v],
+                                facePoints));
+  }
+  region = newRegion;
+}
@@ -10,12 +10,55 @@
  */
 class CatmullClarkSubdivider : public Subdivider {
  public:
-  CatmullClarkSubdivider();
+  /**
+   * @brief The RefinementMode enum selects how the geometry is refined.
+   * PARALLEL computes all face points first and lets the edge and vertex
+   * points read those cached results, with every phase running as a parallel
+   * loop. Control meshes that are quad meshes, see Mesh::isQuadMesh, take a
+   * path specialized for quads that finds neighbours by index arithmetic.
+   * REFERENCE is the original serial implementation that recomputes face
+   * points wherever they are needed.
+   */
+  enum RefinementMode { PARALLEL, REFERENCE };
+
+  /**
+   * @brief The DirtyRegion struct lists the vertices whose position and the
+   * half-edges whose sharpness changed in a mesh. Both half-edges of an edge
+   * are listed.
+   */
+  struct DirtyRegion {
+    QVector<int> vertices;
+    QVector<int> halfEdges;
+  };
+
+  CatmullClarkSubdivider(RefinementMode mode = PARALLEL);
   Mesh subdivide(Mesh& mesh) const override;
+  void subdivide(Mesh& mesh, Mesh& newMesh) const;
+  void updateDirtyRegion(Mesh& controlMesh, Mesh& newMesh,
+                         DirtyRegion& region) const;
+
+  inline RefinementMode getRefinementMode() const { return refinementMode; }
 
  private:
   void reserveSizes(Mesh& mesh, Mesh& newMesh) const;
   void geometryRefinement(Mesh& mesh, Mesh& newMesh) const;
+
+  // The parallel path is specialized on the number of sides of every face of
+  // the control mesh; an arity of 0 handles arbitrary faces
+  template <int Arity>
+  void parallelRefinement(Mesh& mesh, Mesh& newMesh) const;
+  template <int Arity>
+  void parallelGeometryRefinement(Mesh& mesh, Mesh& newMesh) const;
+  template <int Arity>
+  void facePointPhase(Mesh& mesh, Mesh& newMesh) const;
+  template <int Arity>
+  void edgePointPhase(Mesh& mesh, Mesh& newMesh) const;
+  template <int Arity>
+  void vertexPointPhase(Mesh& mesh, Mesh& newMesh) const;
+  template <int Arity>
+  void parallelTopologyRefinement(Mesh& mesh, Mesh& newMesh) const;
+  template <int Arity>
+  void profiledParallelRefinement(Mesh& mesh, Mesh& newMesh) const;
   void topologyRefinement(Mesh& mesh, Mesh& newMesh) const;
 
   void setHalfEdgeData(Mesh& newMesh, int h, int edgeIdx, int vertIdx,
@@ -27,8 +70,38 @@ class CatmullClarkSubdivider : public Subdivider {
   QVector3D sharpEdgePoint(const HalfEdge& edge) const;  // For crease edges
   QVector3D vertexPoint(const Vertex& vertex) const;
   QVector3D boundaryVertexPoint(const Vertex& vertex) const;
-  QVector3D creaseVertexPoint(const Vertex& vertex) const;  // For vertices on creases (exactly 2 crease edges)
-  int countCreaseEdges(const Vertex& vertex) const;  // Count unique crease edges incident to vertex
+  QVector3D creaseVertexPoint(const Mesh& mesh, const Vertex& vertex) const;
+
+  // Variants that find the neighbours by index and read face points cached in
+  // the new vertex array
+  template <int Arity>
+  QVector3D facePoint(const HalfEdge* halfEdges, const Face& face) const;
+  template <int Arity>
+  QVector3D midpoint(const HalfEdge* halfEdges, int h) const;
+  template <int Arity>
+  QVector3D edgePoint(const HalfEdge* halfEdges, int h,
+                      const Vertex* facePoints) const;
+  template <int Arity>
+  QVector3D vertexPoint(const HalfEdge* halfEdges, const Vertex& vertex,
+                        const Vertex* facePoints) const;
+
+  // Full rules, shared by the phases and updateDirtyRegion
+  template <int Arity>
+  QVector3D newEdgePoint(const HalfEdge* halfEdges, int h,
+                         const Vertex* facePoints) const;
+  template <int Arity>
+  QVector3D newVertexPoint(const Mesh& controlMesh, const Vertex& vertex,
+                           const Vertex* facePoints) const;
+
+  // Classification of the new vertices, see Mesh::classifyVertices
+  template <int Arity>
+  void classifyVertexPoint(const Mesh& controlMesh, int v,
+                           Mesh& newMesh) const;
+  template <int Arity>
+  void classifyEdgePoint(const HalfEdge* halfEdges, int h, int v,
+                         Mesh& newMesh) const;
+
+  RefinementMode refinementMode;
 };
 
 #endif  // CATMULL_CLARK_SUBDIVIDER_H
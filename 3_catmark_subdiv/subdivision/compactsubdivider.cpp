@@ -0,0 +1,396 @@
+#include "compactsubdivider.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "util/pointkernels.h"
+
+// Number of faces, half-edges or vertices per call of a point kernel
+#define KERNEL_CHUNK 1024
+// Number of vertices whose terms are gathered before they are combined
+#define VERTEX_CHUNK 256
+
+/**
+ * @brief CompactCatmullClarkSubdivider::CompactCatmullClarkSubdivider Creates
+ * a new compact Catmull-Clark subdivider.
+ */
+CompactCatmullClarkSubdivider::CompactCatmullClarkSubdivider() {}
+
+/**
+ * @brief CompactCatmullClarkSubdivider::subdivide Performs a single
+ * subdivision step. The face points are computed first, after which the edge
+ * and vertex points read them from the new mesh. Children of half-edge h are
+ * stored at 4h+k, edge points at numVerts + numFaces + edgeIndex and face
+ * points at numVerts + faceIndex, exactly as in CatmullClarkSubdivider.
+ * @param mesh The mesh to be subdivided.
+ * @return The subdivided mesh.
+ */
+CompactMesh CompactCatmullClarkSubdivider::subdivide(
+    const CompactMesh& mesh) const {
+  CompactMesh newMesh;
+  newMesh.resize(mesh.numVerts() + mesh.numFaces() + mesh.numEdges(),
+                 4 * mesh.numHalfEdges(), mesh.numHalfEdges(),
+                 2 * mesh.numEdges() + mesh.numHalfEdges(), true);
+  topologyRefinement(mesh, newMesh);
+  facePoints(mesh, newMesh);
+  edgePoints(mesh, newMesh);
+  vertexPoints(mesh, newMesh);
+  return newMesh;
+}
+
+/**
+ * @brief childSharpness Calculates the sharpness of the child edges that lie
+ * along an edge with the given sharpness.
+ * @param sharpness Sharpness of the parent edge.
+ * @return Sharpness of the child edges.
+ */
+static inline float childSharpness(float sharpness) {
+  if (sharpness > 0.0f) {
+    return sharpness - 1.0f;
+  }
+  return sharpness == -1.0f ? -1.0f : 0.0f;
+}
+
+/**
+ * @brief quadMeshStreams Gives the arrays of a quad mesh for the point
+ * kernels.
+ * @param mesh The mesh. Must be a quad mesh.
+ * @return The arrays of the mesh.
+ */
+static QuadMeshStreams quadMeshStreams(const CompactMesh& mesh) {
+  QuadMeshStreams streams;
+  streams.positions = {mesh.getPosX().constData(), mesh.getPosY().constData(),
+                       mesh.getPosZ().constData()};
+  streams.origins = mesh.getOrigins().constData();
+  streams.twins = mesh.getTwins().constData();
+  streams.edges = mesh.getEdges().constData();
+  streams.sharpness = mesh.getSharpness().constData();
+  return streams;
+}
+
+/**
+ * @brief pointStreams Gives the positions of a range of vertices for the point
+ * kernels.
+ * @param mesh The mesh.
+ * @param first The first vertex of the range.
+ * @return The positions, indexed from the first vertex.
+ */
+static PointStreams pointStreams(CompactMesh& mesh, int first) {
+  return {mesh.getPosX().data() + first, mesh.getPosY().data() + first,
+          mesh.getPosZ().data() + first};
+}
+
+/**
+ * @brief constPointStreams Gives the positions of a range of vertices for the
+ * point kernels.
+ * @param mesh The mesh.
+ * @param first The first vertex of the range.
+ * @return The positions, indexed from the first vertex.
+ */
+static ConstPointStreams constPointStreams(const CompactMesh& mesh,
+                                           int first) {
+  return {mesh.getPosX().constData() + first,
+          mesh.getPosY().constData() + first,
+          mesh.getPosZ().constData() + first};
+}
+
+/**
+ * @brief CompactCatmullClarkSubdivider::facePoints Computes all face points.
+ * The half-edges of a face are contiguous, so this reads the origins of a face
+ * without following any links. Quad meshes use the quadFacePoints kernel.
+ * @param mesh The control mesh.
+ * @param newMesh The new mesh.
+ */
+void CompactCatmullClarkSubdivider::facePoints(const CompactMesh& mesh,
+                                                CompactMesh& newMesh) const {
+  const int numVerts = mesh.numVerts();
+  const int numFaces = mesh.numFaces();
+
+  if (mesh.isQuadMesh()) {
+    const QuadMeshStreams streams = quadMeshStreams(mesh);
+    const PointStreams points = pointStreams(newMesh, numVerts);
+#pragma omp parallel for schedule(static)
+    for (int begin = 0; begin < numFaces; begin += KERNEL_CHUNK) {
+      quadFacePoints(streams, begin, std::min(begin + KERNEL_CHUNK, numFaces),
+                     points);
+    }
+    return;
+  }
+
+#pragma omp parallel for schedule(static)
+  for (int f = 0; f < numFaces; f++) {
+    int side = mesh.faceSide(f);
+    int valence = mesh.faceValence(f);
+    QVector3D point;
+    for (int i = 0; i < valence; i++) {
+      point += mesh.position(mesh.origins[side + i]);
+    }
+    newMesh.setPosition(numVerts + f, point / valence);
+  }
+}
+
+/**
+ * @brief CompactCatmullClarkSubdivider::edgePoints Computes all edge points.
+ * Boundary and infinitely sharp edges use the midpoint, smooth edges the
+ * average of the midpoint and the adjacent face points, and semi-sharp edges
+ * blend both using the fractional sharpness. Quad meshes use the
+ * quadEdgePoints kernel.
+ * @param mesh The control mesh.
+ * @param newMesh The new mesh, which already contains the face points.
+ */
+void CompactCatmullClarkSubdivider::edgePoints(const CompactMesh& mesh,
+                                                CompactMesh& newMesh) const {
+  const int numVerts = mesh.numVerts();
+  const int edgePointOffset = mesh.numVerts() + mesh.numFaces();
+  const int numHalfEdges = mesh.numHalfEdges();
+
+  if (mesh.isQuadMesh()) {
+    const QuadMeshStreams streams = quadMeshStreams(mesh);
+    const ConstPointStreams facePoints = constPointStreams(newMesh, numVerts);
+    const PointStreams points = pointStreams(newMesh, edgePointOffset);
+#pragma omp parallel for schedule(static)
+    for (int begin = 0; begin < numHalfEdges; begin += KERNEL_CHUNK) {
+      quadEdgePoints(streams, facePoints, begin,
+                     std::min(begin + KERNEL_CHUNK, numHalfEdges), points);
+    }
+    return;
+  }
+
+#pragma omp parallel for schedule(static)
+  for (int h = 0; h < numHalfEdges; h++) {
+    int twin = mesh.twins[h];
+    // Only once per undirected edge
+    if (h <= twin) {
+      continue;
+    }
+    int e = mesh.edges[h];
+    QVector3D mid = (mesh.position(mesh.origins[h]) +
+                     mesh.position(mesh.origins[mesh.next(h)])) /
+                    2.0f;
+    float s = mesh.sharpness[e];
+    QVector3D coords = mid;
+    if (twin >= 0 && s != -1.0f) {
+      QVector3D smooth =
+          (mid + (newMesh.position(numVerts + mesh.face(h)) +
+                  newMesh.position(numVerts + mesh.face(twin))) /
+                     2.0f) /
+          2.0f;
+      if (s > 0.0f) {
+        float fractionalPart = s - floorf(s);
+        coords = (1.0f - fractionalPart) * mid + fractionalPart * smooth;
+      } else {
+        coords = smooth;
+      }
+    }
+    newMesh.setPosition(edgePointOffset + e, coords);
+  }
+}
+
+/**
+ * @brief The VertexTermChunk struct holds the terms of a chunk of vertices
+ * until they are combined into vertex points.
+ */
+struct VertexTermChunk {
+  float Q[3][VERTEX_CHUNK];
+  float R[3][VERTEX_CHUNK];
+  float C[3][VERTEX_CHUNK];
+  float valence[VERTEX_CHUNK];
+  float blend[VERTEX_CHUNK];
+};
+
+/**
+ * @brief CompactCatmullClarkSubdivider::vertexPoints Computes all vertex
+ * points. The terms of the vertex points are gathered from the one-rings a
+ * chunk at a time, after which the combineVertexPoints kernel combines them.
+ * @param mesh The control mesh.
+ * @param newMesh The new mesh, which already contains the face points.
+ */
+void CompactCatmullClarkSubdivider::vertexPoints(const CompactMesh& mesh,
+                                                  CompactMesh& newMesh) const {
+  const int numVerts = mesh.numVerts();
+  const PointStreams points = pointStreams(newMesh, 0);
+
+#pragma omp parallel
+  {
+    VertexTermChunk chunk;
+#pragma omp for schedule(static)
+    for (int begin = 0; begin < numVerts; begin += VERTEX_CHUNK) {
+      const int count = std::min(VERTEX_CHUNK, numVerts - begin);
+      for (int i = 0; i < count; i++) {
+        QVector3D Q;
+        QVector3D R;
+        QVector3D C = vertexPointTerms(mesh, newMesh, begin + i, Q, R,
+                                       chunk.valence[i], chunk.blend[i]);
+        for (int c = 0; c < 3; c++) {
+          chunk.Q[c][i] = Q[c];
+          chunk.R[c][i] = R[c];
+          chunk.C[c][i] = C[c];
+        }
+      }
+
+      VertexPointTerms terms;
+      terms.S = constPointStreams(mesh, begin);
+      terms.Q = {chunk.Q[0], chunk.Q[1], chunk.Q[2]};
+      terms.R = {chunk.R[0], chunk.R[1], chunk.R[2]};
+      terms.C = {chunk.C[0], chunk.C[1], chunk.C[2]};
+      terms.valence = chunk.valence;
+      terms.blend = chunk.blend;
+      combineVertexPoints(
+          terms, count,
+          {points.x + begin, points.y + begin, points.z + begin});
+    }
+  }
+}
+
+/**
+ * @brief CompactCatmullClarkSubdivider::vertexPointTerms Gathers the terms of
+ * the new position of a vertex in a single walk around its outgoing
+ * half-edges, see VertexPointTerms. Boundary vertices use (2S + M1 + M2) / 4
+ * with M1 and M2 the midpoints of the boundary edges. Interior vertices with
+ * three or more crease edges stay in place, with exactly two crease edges the
+ * crease rule is blended with the smooth rule, and otherwise the smooth rule
+ * (Q + 2R + (n - 3)S) / n is used.
+ * @param mesh The control mesh.
+ * @param newMesh The new mesh, which already contains the face points.
+ * @param v Index of the vertex in the control mesh.
+ * @param Q Is set to the sum of the adjacent face points.
+ * @param R Is set to the sum of the incident edge midpoints.
+ * @param valence Is set to the number of incident edges.
+ * @param blend Is set to the weight of the smooth rule.
+ * @return The boundary, corner or crease point.
+ */
+QVector3D CompactCatmullClarkSubdivider::vertexPointTerms(
+    const CompactMesh& mesh, const CompactMesh& newMesh, int v, QVector3D& Q,
+    QVector3D& R, float& valence, float& blend) const {
+  const int start = mesh.vertexOut[v];
+  QVector3D S = mesh.position(v);
+  Q = QVector3D();
+  R = QVector3D();
+  valence = 1.0f;
+  blend = 0.0f;
+  if (start < 0) {
+    // Isolated vertex
+    return S;
+  }
+
+  QVector3D creaseMids[2];
+  float creaseSharpness[2] = {0.0f, 0.0f};
+  int numCreaseEdges = 0;
+  int n = 0;
+  int h = start;
+  int last = start;
+  do {
+    QVector3D mid = (S + mesh.position(mesh.origins[mesh.next(h)])) / 2.0f;
+    R += mid;
+    Q += newMesh.position(mesh.numVerts() + mesh.face(h));
+    int e = mesh.edges[h];
+    if (mesh.isSharpEdge(e)) {
+      if (numCreaseEdges < 2) {
+        creaseMids[numCreaseEdges] = mid;
+        creaseSharpness[numCreaseEdges] = mesh.sharpness[e];
+      }
+      numCreaseEdges++;
+    }
+    n++;
+    last = h;
+    h = mesh.twins[mesh.prev(h)];
+  } while (h >= 0 && h != start);
+  valence = float(n);
+
+  if (mesh.twins[start] < 0) {
+    // The outgoing half-edge of a boundary vertex is its outgoing boundary
+    // half-edge, so the walk ended at the incoming one.
+    QVector3D nextMid =
+        (S + mesh.position(mesh.origins[mesh.next(start)])) / 2.0f;
+    QVector3D prevMid =
+        (S + mesh.position(mesh.origins[mesh.prev(last)])) / 2.0f;
+    return (2.0f * S + nextMid + prevMid) / 4.0f;
+  }
+  if (numCreaseEdges >= 3) {
+    // Corner: position unchanged
+    return S;
+  }
+  if (numCreaseEdges < 2) {
+    blend = 1.0f;
+    return S;
+  }
+
+  QVector3D crease = 0.5f * S + 0.25f * creaseMids[0] + 0.25f * creaseMids[1];
+  float s1 = creaseSharpness[0];
+  float s2 = creaseSharpness[1];
+  if (s1 != -1.0f && s2 != -1.0f) {
+    blend = ((s1 - floorf(s1)) + (s2 - floorf(s2))) / 2.0f;
+  }
+  return crease;
+}
+
+/**
+ * @brief CompactCatmullClarkSubdivider::topologyRefinement Builds the topology
+ * of the new mesh. Every parent half-edge writes its four children, the
+ * sharpness of the child edges it is responsible for, and the outgoing
+ * half-edge of the edge point when it is the designated half-edge of its edge.
+ * Vertex points keep the first child of their outgoing half-edge, so boundary
+ * vertices keep an outgoing boundary half-edge, and boundary edge points get
+ * the child along the boundary.
+ * @param mesh The control mesh.
+ * @param newMesh The new mesh. Its arrays must already have the correct sizes.
+ */
+void CompactCatmullClarkSubdivider::topologyRefinement(
+    const CompactMesh& mesh, CompactMesh& newMesh) const {
+  const int numVerts = mesh.numVerts();
+  const int numFaces = mesh.numFaces();
+  const int numEdges = mesh.numEdges();
+  const int numHalfEdges = mesh.numHalfEdges();
+  const int edgePointOffset = numVerts + numFaces;
+
+#pragma omp parallel for schedule(static)
+  for (int h = 0; h < numHalfEdges; h++) {
+    int next = mesh.next(h);
+    int prev = mesh.prev(h);
+    int twin = mesh.twins[h];
+    int prevTwin = mesh.twins[prev];
+    int e = mesh.edges[h];
+    int prevEdge = mesh.edges[prev];
+    int c = 4 * h;
+
+    newMesh.origins[c] = mesh.origins[h];
+    newMesh.origins[c + 1] = edgePointOffset + e;
+    newMesh.origins[c + 2] = numVerts + mesh.face(h);
+    newMesh.origins[c + 3] = edgePointOffset + prevEdge;
+
+    newMesh.twins[c] = twin < 0 ? -1 : 4 * mesh.next(twin) + 3;
+    newMesh.twins[c + 1] = 4 * next + 2;
+    newMesh.twins[c + 2] = 4 * prev + 1;
+    newMesh.twins[c + 3] = prevTwin < 0 ? -1 : 4 * prevTwin;
+
+    int childEdge = 2 * e + (h > twin ? 0 : 1);
+    newMesh.edges[c] = childEdge;
+    newMesh.edges[c + 1] = 2 * numEdges + h;
+    newMesh.edges[c + 2] = 2 * numEdges + prev;
+    newMesh.edges[c + 3] = 2 * prevEdge + (prev > prevTwin ? 1 : 0);
+
+    float s = childSharpness(mesh.sharpness[e]);
+    newMesh.sharpness[childEdge] = s;
+    newMesh.sharpness[2 * numEdges + h] = 0.0f;
+    if (twin < 0) {
+      // No twin to write the other half of a boundary edge
+      newMesh.sharpness[2 * e + 1] = s;
+    }
+
+    if (h > twin) {
+      newMesh.vertexOut[edgePointOffset + e] =
+          twin < 0 ? 4 * next + 3 : c + 1;
+    }
+  }
+
+#pragma omp parallel for schedule(static)
+  for (int v = 0; v < numVerts; v++) {
+    int out = mesh.vertexOut[v];
+    newMesh.vertexOut[v] = out < 0 ? -1 : 4 * out;
+  }
+
+#pragma omp parallel for schedule(static)
+  for (int f = 0; f < numFaces; f++) {
+    newMesh.vertexOut[numVerts + f] = 4 * mesh.faceSide(f) + 2;
+  }
+}
@@ -0,0 +1,30 @@
+#ifndef COMPACT_SUBDIVIDER_H
+#define COMPACT_SUBDIVIDER_H
+
+#include "mesh/compactmesh.h"
+
+/**
+ * @brief The CompactCatmullClarkSubdivider class performs Catmull-Clark
+ * subdivision directly on a CompactMesh. It applies the same face, edge,
+ * vertex, boundary and crease rules as CatmullClarkSubdivider and uses the
+ * same indexing scheme for the children, but only works on index arrays. The
+ * subdivided mesh is always a quad mesh. The arithmetic of the rules is done
+ * by the SIMD kernels of pointkernels.h, directly on the coordinate arrays.
+ */
+class CompactCatmullClarkSubdivider {
+ public:
+  CompactCatmullClarkSubdivider();
+  CompactMesh subdivide(const CompactMesh& mesh) const;
+
+ private:
+  void facePoints(const CompactMesh& mesh, CompactMesh& newMesh) const;
+  void edgePoints(const CompactMesh& mesh, CompactMesh& newMesh) const;
+  void vertexPoints(const CompactMesh& mesh, CompactMesh& newMesh) const;
+  void topologyRefinement(const CompactMesh& mesh, CompactMesh& newMesh) const;
+
+  QVector3D vertexPointTerms(const CompactMesh& mesh,
+                             const CompactMesh& newMesh, int v, QVector3D& Q,
+                             QVector3D& R, float& valence, float& blend) const;
+};
+
+#endif  // COMPACT_SUBDIVIDER_H
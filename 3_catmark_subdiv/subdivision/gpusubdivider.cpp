@@ -0,0 +1,325 @@
+#include "gpusubdivider.h"
+
+#include <QDebug>
+#include <QOpenGLVersionFunctionsFactory>
+
+// Passes of subdivide.comp, in the order they are dispatched
+enum SubdivisionPass {
+  TOPOLOGY = 0,
+  VERTEX_OUT = 1,
+  FACE_POINTS = 2,
+  EDGE_POINTS = 3,
+  VERTEX_POINTS = 4,
+  INDICES = 5
+};
+
+// std430 layouts of the structs in subdivide.comp and patches.comp
+struct GPUHalfEdge {
+  GLint origin, twin, edge, face;
+};
+
+struct GPUVertex {
+  GLfloat x, y, z;
+  GLint outgoing;
+};
+
+struct GPUDrawCommand {
+  GLuint count, instanceCount, firstIndex;
+  GLint baseVertex;
+  GLuint baseInstance;
+};
+
+static const int WORK_GROUP_SIZE = 64;
+
+/**
+ * @brief GPUSubdivider::GPUSubdivider Creates a new GPU subdivider. It can only
+ * be used after a successful call to init.
+ */
+GPUSubdivider::GPUSubdivider()
+    : gl(nullptr),
+      subdivisionShader(nullptr),
+      patchShader(nullptr),
+      current(0),
+      numVerts(0),
+      numHalfEdges(0),
+      numFaces(0),
+      numEdges(0),
+      quadMesh(false),
+      indexCount(0),
+      lineIndexCount(0),
+      levels(0) {}
+
+/**
+ * @brief GPUSubdivider::~GPUSubdivider Deconstructor. The context passed to
+ * init must be current.
+ */
+GPUSubdivider::~GPUSubdivider() {
+  if (gl == nullptr) {
+    return;
+  }
+  for (LevelBuffers& level : buffers) {
+    gl->glDeleteBuffers(1, &level.halfEdges);
+    gl->glDeleteBuffers(1, &level.vertices);
+    gl->glDeleteBuffers(1, &level.sharpness);
+  }
+  gl->glDeleteBuffers(1, &faceOffsetsBO);
+  gl->glDeleteBuffers(1, &indexBO);
+  gl->glDeleteBuffers(1, &patchIndexBO);
+  gl->glDeleteBuffers(1, &drawCommandBO);
+  delete subdivisionShader;
+  delete patchShader;
+}
+
+/**
+ * @brief GPUSubdivider::isSupported Checks whether a context can run the
+ * compute shaders.
+ * @param context The OpenGL context.
+ * @return True if the context provides OpenGL 4.3 or newer; false otherwise.
+ */
+bool GPUSubdivider::isSupported(QOpenGLContext* context) {
+  return context != nullptr &&
+         context->format().version() >= qMakePair(4, 3) &&
+         !context->isOpenGLES();
+}
+
+/**
+ * @brief GPUSubdivider::init Resolves the OpenGL 4.3 functions, compiles the
+ * compute shaders and creates the buffers.
+ * @param context The current OpenGL context.
+ * @return True if the subdivider can be used; false otherwise.
+ */
+bool GPUSubdivider::init(QOpenGLContext* context) {
+  if (!isSupported(context)) {
+    return false;
+  }
+  QOpenGLFunctions_4_3_Core* functions =
+      QOpenGLVersionFunctionsFactory::get<QOpenGLFunctions_4_3_Core>(context);
+  if (functions == nullptr || !functions->initializeOpenGLFunctions()) {
+    return false;
+  }
+
+  subdivisionShader = new QOpenGLShaderProgram();
+  subdivisionShader->addShaderFromSourceFile(QOpenGLShader::Compute,
+                                             ":/shaders/subdivide.comp");
+  patchShader = new QOpenGLShaderProgram();
+  patchShader->addShaderFromSourceFile(QOpenGLShader::Compute,
+                                       ":/shaders/patches.comp");
+  if (!subdivisionShader->link() || !patchShader->link()) {
+    qDebug() << ":: Failed to link the subdivision compute shaders";
+    delete subdivisionShader;
+    delete patchShader;
+    subdivisionShader = nullptr;
+    patchShader = nullptr;
+    return false;
+  }
+
+  gl = functions;
+  for (LevelBuffers& level : buffers) {
+    gl->glGenBuffers(1, &level.halfEdges);
+    gl->glGenBuffers(1, &level.vertices);
+    gl->glGenBuffers(1, &level.sharpness);
+  }
+  gl->glGenBuffers(1, &faceOffsetsBO);
+  gl->glGenBuffers(1, &indexBO);
+  gl->glGenBuffers(1, &patchIndexBO);
+  gl->glGenBuffers(1, &drawCommandBO);
+  qDebug() << ":: GPU subdivision initialized";
+  return true;
+}
+
+/**
+ * @brief GPUSubdivider::subdivide Uploads a control mesh and subdivides it on
+ * the GPU. Afterwards, the vertex, index and patch buffers contain the result.
+ * The context passed to init must be current.
+ * @param controlMesh The control mesh.
+ * @param levels The number of subdivision steps.
+ */
+void GPUSubdivider::subdivide(const CompactMesh& controlMesh, int levels) {
+  upload(controlMesh);
+  for (int k = 0; k < levels; k++) {
+    subdivisionStep();
+  }
+  extractIndices();
+  extractPatches();
+  this->levels = levels;
+
+  qDebug() << ":: GPU subdivision to level" << levels << "resulted in"
+           << numFaces << "faces";
+}
+
+/**
+ * @brief GPUSubdivider::upload Uploads a mesh into the current level buffers.
+ * @param mesh The mesh.
+ */
+void GPUSubdivider::upload(const CompactMesh& mesh) {
+  current = 0;
+  numVerts = mesh.numVerts();
+  numHalfEdges = mesh.numHalfEdges();
+  numFaces = mesh.numFaces();
+  numEdges = mesh.numEdges();
+  quadMesh = mesh.isQuadMesh();
+
+  QVector<GPUHalfEdge> halfEdges(numHalfEdges);
+  for (int h = 0; h < numHalfEdges; h++) {
+    halfEdges[h] = {mesh.getOrigins()[h], mesh.getTwins()[h],
+                    mesh.getEdges()[h], mesh.face(h)};
+  }
+  QVector<GPUVertex> vertices(numVerts);
+  for (int v = 0; v < numVerts; v++) {
+    QVector3D p = mesh.position(v);
+    vertices[v] = {p.x(), p.y(), p.z(), mesh.getVertexOut()[v]};
+  }
+  // A quad mesh does not need offsets, but the binding still needs storage
+  QVector<GLint> faceOffsets(quadMesh ? 1 : numFaces + 1);
+  if (!quadMesh) {
+    for (int f = 0; f < numFaces; f++) {
+      faceOffsets[f] = mesh.faceSide(f);
+    }
+    faceOffsets[numFaces] = numHalfEdges;
+  }
+
+  allocate(buffers[0].halfEdges, qint64(sizeof(GPUHalfEdge)) * numHalfEdges,
+           halfEdges.data());
+  allocate(buffers[0].vertices, qint64(sizeof(GPUVertex)) * numVerts,
+           vertices.data());
+  allocate(buffers[0].sharpness, qint64(sizeof(GLfloat)) * numEdges,
+           mesh.getSharpness().data());
+  allocate(faceOffsetsBO, qint64(sizeof(GLint)) * faceOffsets.size(),
+           faceOffsets.data());
+}
+
+/**
+ * @brief GPUSubdivider::subdivisionStep Subdivides the mesh in the current
+ * level buffers into the other level buffers, which then become current. The
+ * topology and vertex points are computed in the same passes as in
+ * CompactCatmullClarkSubdivider, with a barrier wherever a pass reads the
+ * output of an earlier one.
+ */
+void GPUSubdivider::subdivisionStep() {
+  const LevelBuffers& parent = buffers[current];
+  const LevelBuffers& child = buffers[1 - current];
+  allocate(child.halfEdges, qint64(sizeof(GPUHalfEdge)) * 4 * numHalfEdges);
+  allocate(child.vertices,
+           qint64(sizeof(GPUVertex)) * (numVerts + numFaces + numEdges));
+  allocate(child.sharpness,
+           qint64(sizeof(GLfloat)) * (2 * numEdges + numHalfEdges));
+
+  gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, parent.halfEdges);
+  gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, parent.vertices);
+  gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, parent.sharpness);
+  gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, faceOffsetsBO);
+  gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, child.halfEdges);
+  gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, child.vertices);
+  gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, child.sharpness);
+
+  subdivisionShader->bind();
+  setMeshUniforms();
+  // The topology and outgoing half-edges only read the parent, and the face
+  // points only write the coordinates of the face point vertices
+  dispatch(TOPOLOGY, numHalfEdges);
+  dispatch(VERTEX_OUT, numVerts + numFaces);
+  dispatch(FACE_POINTS, numFaces);
+  gl->glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+  dispatch(EDGE_POINTS, numHalfEdges);
+  dispatch(VERTEX_POINTS, numVerts);
+  gl->glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+  subdivisionShader->release();
+
+  int newNumVerts = numVerts + numFaces + numEdges;
+  numEdges = 2 * numEdges + numHalfEdges;
+  numFaces = numHalfEdges;
+  numHalfEdges = 4 * numHalfEdges;
+  numVerts = newNumVerts;
+  quadMesh = true;
+  current = 1 - current;
+}
+
+/**
+ * @brief GPUSubdivider::extractIndices Fills the index buffer with the faces
+ * of the current mesh as fans of triangles, followed by the two vertices of
+ * every edge, in the layout of Mesh::extractAttributes.
+ */
+void GPUSubdivider::extractIndices() {
+  indexCount = 3 * (numHalfEdges - 2 * numFaces);
+  lineIndexCount = 2 * numEdges;
+  allocate(indexBO, qint64(sizeof(GLuint)) * (indexCount + lineIndexCount));
+
+  gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0,
+                       buffers[current].halfEdges);
+  gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, faceOffsetsBO);
+  gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, indexBO);
+
+  subdivisionShader->bind();
+  setMeshUniforms();
+  dispatch(INDICES, numHalfEdges);
+  subdivisionShader->release();
+  gl->glMemoryBarrier(GL_ELEMENT_ARRAY_BARRIER_BIT |
+                      GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+/**
+ * @brief GPUSubdivider::extractPatches Fills the patch index buffer with the
+ * 16 control points of every regular face of the current mesh and sets the
+ * count of the indirect draw command accordingly. The control mesh may contain
+ * other polygons than quads, so it never gets any patches.
+ */
+void GPUSubdivider::extractPatches() {
+  GPUDrawCommand command = {0, 1, 0, 0, 0};
+  allocate(drawCommandBO, sizeof(command), &command);
+  if (!quadMesh) {
+    return;
+  }
+  allocate(patchIndexBO, qint64(sizeof(GLuint)) * 16 * numFaces);
+
+  gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0,
+                       buffers[current].halfEdges);
+  gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1,
+                       buffers[current].sharpness);
+  gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, patchIndexBO);
+  gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, drawCommandBO);
+
+  patchShader->bind();
+  patchShader->setUniformValue("numFaces", numFaces);
+  gl->glDispatchCompute((numFaces + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE, 1,
+                        1);
+  patchShader->release();
+  gl->glMemoryBarrier(GL_ELEMENT_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+}
+
+/**
+ * @brief GPUSubdivider::setMeshUniforms Passes the counts of the current mesh
+ * to the subdivision shader, which must be bound.
+ */
+void GPUSubdivider::setMeshUniforms() {
+  subdivisionShader->setUniformValue("numVerts", numVerts);
+  subdivisionShader->setUniformValue("numHalfEdges", numHalfEdges);
+  subdivisionShader->setUniformValue("numFaces", numFaces);
+  subdivisionShader->setUniformValue("numEdges", numEdges);
+  subdivisionShader->setUniformValue("quadMesh", quadMesh);
+}
+
+/**
+ * @brief GPUSubdivider::dispatch Runs one pass of the subdivision shader, which
+ * must be bound.
+ * @param pass The pass, see SubdivisionPass.
+ * @param count The number of elements the pass iterates over.
+ */
+void GPUSubdivider::dispatch(int pass, int count) {
+  if (count == 0) {
+    return;
+  }
+  subdivisionShader->setUniformValue("pass", pass);
+  gl->glDispatchCompute((count + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE, 1, 1);
+}
+
+/**
+ * @brief GPUSubdivider::allocate (Re)allocates the storage of a buffer.
+ * @param buffer The buffer.
+ * @param size The new size in bytes.
+ * @param data The initial contents, or nullptr to leave them undefined.
+ */
+void GPUSubdivider::allocate(GLuint buffer, qint64 size, const void* data) {
+  gl->glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+  gl->glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_DYNAMIC_COPY);
+  gl->glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
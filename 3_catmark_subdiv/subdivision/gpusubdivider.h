@@ -0,0 +1,79 @@
+#ifndef GPU_SUBDIVIDER_H
+#define GPU_SUBDIVIDER_H
+
+#include <QOpenGLContext>
+#include <QOpenGLFunctions_4_3_Core>
+#include <QOpenGLShaderProgram>
+
+#include "mesh/compactmesh.h"
+
+/**
+ * @brief The GPUSubdivider class performs Catmull-Clark subdivision with
+ * compute shaders. The control mesh is uploaded once; every subdivision step
+ * then runs the topology, face, edge and vertex point passes of
+ * CompactCatmullClarkSubdivider on buffers that stay on the GPU, ping-ponging
+ * between two sets of level buffers. The result is a vertex buffer with an
+ * index buffer of triangles and edge lines for MeshRenderer and, for
+ * subdivided levels, a patch
+ * index buffer with an indirect draw command for TessellationRenderer. Nothing
+ * is read back to the CPU.
+ *
+ * Compute shaders require OpenGL 4.3. Use isSupported to check the context and
+ * fall back to CatmullClarkSubdivider otherwise.
+ */
+class GPUSubdivider {
+ public:
+  GPUSubdivider();
+  ~GPUSubdivider();
+
+  static bool isSupported(QOpenGLContext* context);
+  bool init(QOpenGLContext* context);
+  inline bool isInitialized() const { return gl != nullptr; }
+
+  void subdivide(const CompactMesh& controlMesh, int levels);
+
+  // Vertex buffer with a stride of VERTEX_STRIDE bytes, coordinates first
+  inline GLuint getVertexBuffer() const { return buffers[current].vertices; }
+  // Index buffer with the triangles, followed by two indices per edge
+  inline GLuint getIndexBuffer() const { return indexBO; }
+  inline int getIndexCount() const { return indexCount; }
+  inline int getLineIndexCount() const { return lineIndexCount; }
+  // Only filled when at least one subdivision step was performed
+  inline GLuint getPatchIndexBuffer() const { return patchIndexBO; }
+  inline GLuint getDrawCommandBuffer() const { return drawCommandBO; }
+  inline int getLevels() const { return levels; }
+
+  static const int VERTEX_STRIDE = 4 * sizeof(GLint);
+
+ private:
+  // The buffers of one subdivision level
+  struct LevelBuffers {
+    GLuint halfEdges, vertices, sharpness;
+  };
+
+  void upload(const CompactMesh& mesh);
+  void subdivisionStep();
+  void extractIndices();
+  void extractPatches();
+  void setMeshUniforms();
+  void dispatch(int pass, int count);
+  void allocate(GLuint buffer, qint64 size, const void* data = nullptr);
+
+  QOpenGLFunctions_4_3_Core* gl;
+  QOpenGLShaderProgram* subdivisionShader;
+  QOpenGLShaderProgram* patchShader;
+
+  LevelBuffers buffers[2];
+  int current;
+  GLuint faceOffsetsBO, indexBO, patchIndexBO, drawCommandBO;
+
+  // Counts of the mesh in buffers[current]
+  int numVerts, numHalfEdges, numFaces, numEdges;
+  bool quadMesh;
+
+  int indexCount;
+  int lineIndexCount;
+  int levels;
+};
+
+#endif  // GPU_SUBDIVIDER_H
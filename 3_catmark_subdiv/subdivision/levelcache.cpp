@@ -0,0 +1,356 @@
+#include "levelcache.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+
+#include "subdivision/patchtable.h"
+#include "util/profiler.h"
+
+/**
+ * @brief LevelCache::LevelCache Creates an empty level cache.
+ * @param memoryBudget The number of bytes the resident levels may use.
+ */
+LevelCache::LevelCache(qint64 memoryBudget) : memoryBudget(memoryBudget) {}
+
+/**
+ * @brief LevelCache::~LevelCache Deconstructor. Deletes all resident levels.
+ */
+LevelCache::~LevelCache() { clear(); }
+
+/**
+ * @brief LevelCache::reset Replaces all levels by a new control mesh.
+ * @param controlMesh The control mesh. The cache takes ownership of it.
+ * @param key The cache key of the control mesh, see MeshCache. May be empty.
+ */
+void LevelCache::reset(Mesh* controlMesh, const QByteArray& key) {
+  clear();
+  levels.append(controlMesh);
+  keys.append(key);
+  pinned.append(true);
+  locks.append(0);
+  patchTables.append(QVector<int>());
+  approxPatchTables.append(ApproxPatchTable());
+  patchTablesBuilt.append(false);
+}
+
+/**
+ * @brief LevelCache::clear Discards all levels, including the control mesh.
+ * Their storage is kept for new levels, within the budget.
+ */
+void LevelCache::clear() {
+  for (Mesh* mesh : levels) {
+    pool.release(mesh);
+  }
+  pool.trim(memoryBudget);
+  levels.clear();
+  keys.clear();
+  pinned.clear();
+  locks.clear();
+  patchTables.clear();
+  approxPatchTables.clear();
+  patchTablesBuilt.clear();
+}
+
+/**
+ * @brief LevelCache::level Gives a subdivision level, generating it and any
+ * missing levels in between from the nearest resident ancestor. Afterwards,
+ * other levels are evicted until the budget is met. References to other
+ * levels may therefore become invalid.
+ * @param k The subdivision level. Level 0 is the control mesh, which must have
+ * been set using reset.
+ * @return The mesh of level k.
+ */
+Mesh& LevelCache::level(int k) {
+  int ancestor = residentAncestor(k);
+  for (int j = ancestor + 1; j <= k; j++) {
+    if (j == levels.size()) {
+      levels.append(nullptr);
+      keys.append(MeshCache::nextLevelKey(keys[j - 1], *levels[j - 1]));
+      pinned.append(false);
+      locks.append(0);
+      patchTables.append(QVector<int>());
+      approxPatchTables.append(ApproxPatchTable());
+      patchTablesBuilt.append(false);
+    }
+    Profiler::setLevel(j);
+    Mesh* mesh = acquire(MeshPool::Sizes::of(*levels[j - 1]).subdivided());
+    if (!meshCache.load(keys[j], *mesh)) {
+      QElapsedTimer timer;
+      timer.start();
+      subdivider.subdivide(*levels[j - 1], *mesh);
+      if (MeshCache::isWorthStoring(timer.elapsed())) {
+        meshCache.store(keys[j], *mesh);
+      }
+    }
+    levels[j] = mesh;
+  }
+  evict(k);
+  return *levels[k];
+}
+
+/**
+ * @brief LevelCache::adopt Takes over a level that was generated outside of
+ * the cache. The level must descend from the current levels: its key must be
+ * the key the cache would give it. Afterwards, other levels are evicted until
+ * the budget is met, like in level.
+ * @param k The subdivision level. All coarser levels must be known to the
+ * cache, although they need not be resident.
+ * @param mesh The mesh of level k. The cache takes ownership of it if it is
+ * adopted.
+ * @param key The cache key of the level, see MeshCache.
+ * @return False if level k is already resident, in which case the cache keeps
+ * its own mesh and the caller keeps ownership of the given one.
+ */
+bool LevelCache::adopt(int k, Mesh* mesh, const QByteArray& key) {
+  if (isResident(k)) {
+    return false;
+  }
+  if (k == levels.size()) {
+    levels.append(nullptr);
+    keys.append(QByteArray());
+    pinned.append(false);
+    locks.append(0);
+    patchTables.append(QVector<int>());
+    approxPatchTables.append(ApproxPatchTable());
+    patchTablesBuilt.append(false);
+  }
+  levels[k] = mesh;
+  keys[k] = key;
+  evict(k);
+  return true;
+}
+
+/**
+ * @brief LevelCache::residentAncestor Finds the finest resident level that is
+ * not finer than the given level.
+ * @param k The subdivision level.
+ * @return The nearest resident level at or below k. The control mesh is
+ * always resident.
+ */
+int LevelCache::residentAncestor(int k) const {
+  int ancestor = qMin(k, int(levels.size()) - 1);
+  while (levels[ancestor] == nullptr) {
+    ancestor--;
+  }
+  return ancestor;
+}
+
+/**
+ * @brief LevelCache::acquire Gives an empty mesh for a level, with the storage
+ * of a discarded level if one is large enough, see MeshPool::acquire. Levels
+ * generated outside of the cache are written into it before they are adopted.
+ * @param sizes The sizes of the level.
+ * @return An empty mesh. The caller takes ownership of it and either hands it
+ * to adopt or returns it with recycle.
+ */
+Mesh* LevelCache::acquire(const MeshPool::Sizes& sizes) {
+  return pool.acquire(sizes);
+}
+
+/**
+ * @brief LevelCache::recycle Keeps the storage of a mesh that is no longer
+ * needed, such as a level that was not adopted, for new levels.
+ * @param mesh The mesh. The cache takes ownership of it. May be nullptr.
+ */
+void LevelCache::recycle(Mesh* mesh) {
+  pool.release(mesh);
+  pool.trim(memoryBudget - totalFootprint());
+}
+
+/**
+ * @brief LevelCache::lock Prevents a resident level from being evicted until
+ * it is unlocked again, for instance while another thread subdivides it.
+ * Locks are counted, so a level can be locked more than once.
+ * @param k The subdivision level.
+ */
+void LevelCache::lock(int k) { locks[k]++; }
+
+/**
+ * @brief LevelCache::unlock Releases a lock taken with lock.
+ * @param k The subdivision level.
+ */
+void LevelCache::unlock(int k) {
+  if (k < locks.size() && locks[k] > 0) {
+    locks[k]--;
+  }
+}
+
+/**
+ * @brief LevelCache::markModified Records that the sharpness of an edge of a
+ * level was edited. The consecutive resident finer levels are updated
+ * incrementally; the first evicted level and everything beyond it are
+ * discarded. The edited level is never evicted, as its edits cannot be
+ * regenerated, and the finer levels are no longer stored in or loaded from the
+ * MeshCache, since their keys do not include the edit. The end points of the
+ * edge are classified again. No level may be locked, since finer levels may be
+ * deleted.
+ * @param k The edited level.
+ * @param halfEdge Index of one of the half-edges of the edited edge.
+ */
+void LevelCache::markModified(int k, int halfEdge) {
+  pinned[k] = true;
+  CatmullClarkSubdivider::DirtyRegion region;
+  const HalfEdge& edge = levels[k]->getHalfEdges()[halfEdge];
+  levels[k]->classifyVertex(edge.origin->index);
+  levels[k]->classifyVertex(edge.next->origin->index);
+  region.halfEdges.append(halfEdge);
+  if (edge.twin != nullptr) {
+    region.halfEdges.append(edge.twin->index);
+  }
+
+  int j = k + 1;
+  for (; j < levels.size() && levels[j] != nullptr; j++) {
+    ProfileScope scope("CatmullClarkSubdivider::updateDirtyRegion");
+    subdivider.updateDirtyRegion(*levels[j - 1], *levels[j], region);
+    keys[j] = QByteArray();
+  }
+  for (int i = j; i < levels.size(); i++) {
+    pool.release(levels[i]);
+  }
+  levels.resize(j);
+  keys.resize(j);
+  pinned.resize(j);
+  locks.resize(j);
+  patchTables.resize(j);
+  approxPatchTables.resize(j);
+  patchTablesBuilt.resize(j);
+  // Sharp edges make faces irregular, so the tables of the edited level and
+  // the updated finer levels are outdated
+  for (int i = k; i < j; i++) {
+    patchTables[i].clear();
+    approxPatchTables[i] = ApproxPatchTable();
+    patchTablesBuilt[i] = false;
+  }
+  pool.trim(memoryBudget - totalFootprint());
+}
+
+/**
+ * @brief LevelCache::patchTable Gives the patch table of a level, building it
+ * from the level if it is not cached. Like level, this may evict other levels.
+ * @param k The subdivision level.
+ * @return The control point indices of the patches of level k, see
+ * PatchTable::buildIndexTable.
+ */
+const QVector<int>& LevelCache::patchTable(int k) {
+  buildPatchTables(k);
+  return patchTables[k];
+}
+
+/**
+ * @brief LevelCache::approxPatchTable Gives the table of the approximate
+ * patches of a level, building it from the level if it is not cached. Like
+ * level, this may evict other levels.
+ * @param k The subdivision level.
+ * @return The approximate patches of the quads of level k that are not regular.
+ */
+const ApproxPatchTable& LevelCache::approxPatchTable(int k) {
+  buildPatchTables(k);
+  return approxPatchTables[k];
+}
+
+/**
+ * @brief LevelCache::buildPatchTables Builds both patch tables of a level if
+ * they are not cached.
+ * @param k The subdivision level.
+ */
+void LevelCache::buildPatchTables(int k) {
+  Mesh& mesh = level(k);
+  if (!patchTablesBuilt[k]) {
+    ProfileScope scope("LevelCache::buildPatchTables");
+    CompactMesh compact = CompactMesh::fromMesh(mesh);
+    patchTables[k] = PatchTable::buildIndexTable(compact);
+    approxPatchTables[k] = ApproxPatchTable(compact);
+    patchTablesBuilt[k] = true;
+  }
+}
+
+/**
+ * @brief LevelCache::evict Evicts the largest evictable levels until the
+ * resident levels fit within the budget or no evictable level is left. Pinned
+ * and locked levels are not evictable. The storage of evicted levels is pooled,
+ * but the pool is trimmed to what is left of the budget.
+ * @param keep The level that must stay resident.
+ */
+void LevelCache::evict(int keep) {
+  qint64 total = totalFootprint();
+  pool.trim(memoryBudget - total);
+  while (total > memoryBudget) {
+    int largest = -1;
+    qint64 largestSize = 0;
+    for (int j = 0; j < levels.size(); j++) {
+      if (j == keep || pinned[j] || locks[j] > 0 || levels[j] == nullptr) {
+        continue;
+      }
+      qint64 size = footprint(j);
+      if (size > largestSize) {
+        largest = j;
+        largestSize = size;
+      }
+    }
+    if (largest < 0) {
+      break;
+    }
+    pool.release(levels[largest]);
+    levels[largest] = nullptr;
+    patchTables[largest].clear();
+    approxPatchTables[largest] = ApproxPatchTable();
+    patchTablesBuilt[largest] = false;
+    total -= largestSize;
+  }
+  pool.trim(memoryBudget - total);
+}
+
+/**
+ * @brief LevelCache::footprint Calculates the number of bytes used by a level
+ * and its patch tables. The storage of a level counts in full, since it may
+ * have been reused from a larger level, see acquire.
+ * @param k The subdivision level.
+ * @return The size of the level in bytes, or 0 if it is not resident.
+ */
+qint64 LevelCache::footprint(int k) const {
+  if (levels[k] == nullptr) {
+    return 0;
+  }
+  return levels[k]->capacityFootprint() +
+         qint64(patchTables[k].size()) * qint64(sizeof(int)) +
+         approxPatchTables[k].memoryFootprint();
+}
+
+/**
+ * @brief LevelCache::totalFootprint Calculates the number of bytes used by all
+ * resident levels.
+ * @return The total size in bytes.
+ */
+qint64 LevelCache::totalFootprint() const {
+  qint64 total = 0;
+  for (int k = 0; k < levels.size(); k++) {
+    total += footprint(k);
+  }
+  return total;
+}
+
+/**
+ * @brief LevelCache::reportFootprint Prints the footprint of every level and
+ * the total against the budget.
+ */
+void LevelCache::reportFootprint() const {
+  for (int k = 0; k < levels.size(); k++) {
+    if (levels[k] == nullptr) {
+      qDebug() << ":: Level" << k << "evicted";
+    } else {
+      qDebug() << ":: Level" << k << footprint(k) / 1024 << "KiB"
+               << (pinned[k] ? "(pinned)" : "");
+    }
+  }
+  qDebug() << ":: Pool" << pool.numMeshes() << "meshes,"
+           << pool.memoryFootprint() / 1024 << "KiB";
+  qDebug() << ":: Total" << totalFootprint() / 1024 << "KiB of"
+           << memoryBudget / 1024 << "KiB";
+}
+
+/**
+ * @brief LevelCache::setMemoryBudget Changes the memory budget. Levels are
+ * evicted on the next call to level.
+ * @param budget The number of bytes the resident levels may use.
+ */
+void LevelCache::setMemoryBudget(qint64 budget) { memoryBudget = budget; }
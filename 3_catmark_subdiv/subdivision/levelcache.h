@@ -0,0 +1,93 @@
+#ifndef LEVEL_CACHE_H
+#define LEVEL_CACHE_H
+
+#include <QByteArray>
+#include <QVector>
+
+#include "initialization/meshcache.h"
+#include "mesh/mesh.h"
+#include "mesh/meshpool.h"
+#include "subdivision/approxpatchtable.h"
+#include "subdivision/catmullclarksubdivider.h"
+
+#define LEVEL_CACHE_DEFAULT_BUDGET (qint64(1) << 30)
+
+/**
+ * @brief The LevelCache class keeps the subdivision levels of a control mesh
+ * within a memory budget. Whenever the resident levels exceed the budget, the
+ * largest levels are evicted, except for the control mesh, the level that was
+ * just requested and levels whose sharpness was edited, since those cannot be
+ * regenerated. An evicted level is regenerated from its nearest resident
+ * ancestor when it is requested again, loading from the MeshCache where
+ * possible. After a sharpness edit, the finer resident levels are updated in
+ * place within the region affected by the edit.
+ *
+ * The patch tables of a level, see PatchTable::buildIndexTable and
+ * ApproxPatchTable, are built on first use and kept with the level until the
+ * level is evicted or the sharpness of the level or a coarser one is edited.
+ *
+ * Levels can also be generated elsewhere, such as by the SubdivisionWorker,
+ * and handed over with adopt. A level that is locked is never evicted, so
+ * another thread may keep reading it.
+ *
+ * Levels that are evicted, discarded or cleared are not deleted but returned
+ * to a MeshPool, and new levels are written into pooled meshes. The pool only
+ * keeps what is left of the memory budget after the resident levels, so
+ * regenerating evicted levels or the levels of a reloaded model reuses their
+ * storage without exceeding the budget.
+ */
+class LevelCache {
+ public:
+  LevelCache(qint64 memoryBudget = LEVEL_CACHE_DEFAULT_BUDGET);
+  ~LevelCache();
+
+  void reset(Mesh* controlMesh, const QByteArray& key);
+  void clear();
+  Mesh& level(int k);
+  bool adopt(int k, Mesh* mesh, const QByteArray& key);
+  int residentAncestor(int k) const;
+  Mesh* acquire(const MeshPool::Sizes& sizes);
+  void recycle(Mesh* mesh);
+  void lock(int k);
+  void unlock(int k);
+  void markModified(int k, int halfEdge);
+  const QVector<int>& patchTable(int k);
+  const ApproxPatchTable& approxPatchTable(int k);
+
+  qint64 footprint(int k) const;
+  qint64 totalFootprint() const;
+  void reportFootprint() const;
+
+  void setMemoryBudget(qint64 budget);
+  inline qint64 getMemoryBudget() const { return memoryBudget; }
+  inline int numLevels() const { return levels.size(); }
+  inline bool isResident(int k) const {
+    return k < levels.size() && levels[k] != nullptr;
+  }
+  inline const QByteArray& key(int k) const { return keys[k]; }
+  inline const MeshCache& getMeshCache() const { return meshCache; }
+
+ private:
+  void evict(int keep);
+  void buildPatchTables(int k);
+
+  // nullptr for evicted levels
+  QVector<Mesh*> levels;
+  // Cache keys of the levels, see MeshCache
+  QVector<QByteArray> keys;
+  QVector<bool> pinned;
+  // Number of locks per level, see lock
+  QVector<int> locks;
+  // Patch control point indices per level and the approximations of the
+  // other quads, valid if the built flag is set
+  QVector<QVector<int>> patchTables;
+  QVector<ApproxPatchTable> approxPatchTables;
+  QVector<bool> patchTablesBuilt;
+  qint64 memoryBudget;
+  MeshCache meshCache;
+  CatmullClarkSubdivider subdivider;
+  // Storage of discarded levels, see acquire
+  MeshPool pool;
+};
+
+#endif  // LEVEL_CACHE_H
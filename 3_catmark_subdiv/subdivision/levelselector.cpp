@@ -0,0 +1,121 @@
+#include "levelselector.h"
+
+/**
+ * @brief LevelSelector::LevelSelector Creates a level selector without frame
+ * times.
+ */
+LevelSelector::LevelSelector() {}
+
+/**
+ * @brief LevelSelector::meanEdgeLength Gives the average length of the edges
+ * of a mesh. Every subdivision step halves it, so it predicts the edge length
+ * of every level.
+ * @param mesh The mesh.
+ * @return The average edge length, or 0 for a mesh without edges.
+ */
+float LevelSelector::meanEdgeLength(Mesh& mesh) {
+  const QVector<HalfEdge>& halfEdges = mesh.getHalfEdges();
+  if (halfEdges.isEmpty()) {
+    return 0.0f;
+  }
+  double total = 0.0;
+  for (const HalfEdge& edge : halfEdges) {
+    total += (edge.next->origin->coords - edge.origin->coords).length();
+  }
+  return float(total / halfEdges.size());
+}
+
+/**
+ * @brief LevelSelector::clearFrameTimes Forgets the measured frame times, for
+ * instance after the model, the viewport or the budget changed.
+ */
+void LevelSelector::clearFrameTimes() {
+  frameTimes.clear();
+  frameCounts.clear();
+}
+
+/**
+ * @brief LevelSelector::addFrameTime Adds the measured time of a frame.
+ * @param step The step the frame was drawn at.
+ * @param milliseconds The GPU time of the frame.
+ */
+void LevelSelector::addFrameTime(int step, float milliseconds) {
+  if (step < 0) {
+    return;
+  }
+  if (step >= frameTimes.size()) {
+    frameTimes.resize(step + 1, 0.0f);
+    frameCounts.resize(step + 1, 0);
+  }
+  if (frameCounts[step] == 0) {
+    frameTimes[step] = milliseconds;
+  } else {
+    frameTimes[step] +=
+        LEVEL_SELECTOR_SMOOTHING * (milliseconds - frameTimes[step]);
+  }
+  frameCounts[step]++;
+}
+
+/**
+ * @brief LevelSelector::isMeasured Checks whether the frame time of a step is
+ * known well enough to base a decision on.
+ * @param step The step.
+ * @return True if enough frames were drawn at the step.
+ */
+bool LevelSelector::isMeasured(int step) const {
+  return step >= 0 && step < frameCounts.size() &&
+         frameCounts[step] >= LEVEL_SELECTOR_MIN_FRAMES;
+}
+
+/**
+ * @brief LevelSelector::isMeasuring Checks whether more frames at a step are
+ * needed before its frame time is known. The view should keep drawing until
+ * then, even if nothing changes.
+ * @param step The step.
+ * @return True if the step is not measured yet.
+ */
+bool LevelSelector::isMeasuring(int step) const { return !isMeasured(step); }
+
+/**
+ * @brief LevelSelector::select Chooses the step to draw next.
+ * @param current The step that is drawn now.
+ * @param maxStep The finest step that may be chosen.
+ * @param desired The step that fits the projected size, as a real number:
+ * step k is enough for every value up to k.
+ * @param budget The frame time budget in milliseconds.
+ * @param costFactor How many times more expensive each step is to draw than
+ * the step below it.
+ * @return The step, in [0, maxStep].
+ */
+int LevelSelector::select(int current, int maxStep, float desired,
+                          float budget, float costFactor) const {
+  current = qBound(0, current, maxStep);
+  int step = current;
+  while (step < maxStep && desired > step + LEVEL_SELECTOR_HYSTERESIS) {
+    step++;
+  }
+  while (step > 0 && desired < step - 1 - LEVEL_SELECTOR_HYSTERESIS) {
+    step--;
+  }
+
+  int limit = current;
+  while (limit > 0 && isMeasured(limit) && frameTimes[limit] > budget) {
+    limit--;
+  }
+  while (limit < step) {
+    float expected;
+    if (isMeasured(limit + 1)) {
+      expected = frameTimes[limit + 1];
+    } else if (isMeasured(limit)) {
+      expected = frameTimes[limit] * costFactor;
+    } else {
+      // Nothing to go by until the current step is measured
+      break;
+    }
+    if (expected > LEVEL_SELECTOR_BUDGET_MARGIN * budget) {
+      break;
+    }
+    limit++;
+  }
+  return qMin(step, limit);
+}
@@ -0,0 +1,57 @@
+#ifndef LEVEL_SELECTOR_H
+#define LEVEL_SELECTOR_H
+
+#include <QVector>
+
+#include "mesh/mesh.h"
+
+// Dead band around each switching point of the projected size, in levels
+#define LEVEL_SELECTOR_HYSTERESIS 0.25f
+// Fraction of the budget a finer step is expected to fit in before switching
+#define LEVEL_SELECTOR_BUDGET_MARGIN 0.8f
+// Frames per step before its frame time is trusted
+#define LEVEL_SELECTOR_MIN_FRAMES 4
+// Weight of a new frame in the moving average of the frame time
+#define LEVEL_SELECTOR_SMOOTHING 0.25f
+
+/**
+ * @brief The LevelSelector class chooses a level of detail for the automatic
+ * level of detail mode. The levels are a ladder of steps, from 0 (coarsest) up
+ * to a maximum, where every step is a fixed factor more expensive to draw than
+ * the one below it: a subdivision level, or a triangle size of the
+ * tessellation.
+ *
+ * The step follows the projected size of the surface, given as the desired
+ * step, such as the level at which the edges are the target length on screen.
+ * To avoid switching back and forth when the size hovers around a switching
+ * point, the step changes only once the desired step is more than
+ * LEVEL_SELECTOR_HYSTERESIS beyond that point.
+ *
+ * On top of that it is capped by a frame budget. The GPU time of the drawn
+ * frames is averaged per step; a step that is measured over the budget is left
+ * for a coarser one, and a finer step is only taken when it is measured or
+ * expected (by the cost factor) to fit within LEVEL_SELECTOR_BUDGET_MARGIN of
+ * the budget. The measurements are kept, so a step that was over budget is not
+ * tried again until clearFrameTimes is called.
+ */
+class LevelSelector {
+ public:
+  LevelSelector();
+
+  static float meanEdgeLength(Mesh& mesh);
+
+  void clearFrameTimes();
+  void addFrameTime(int step, float milliseconds);
+  bool isMeasuring(int step) const;
+  int select(int current, int maxStep, float desired, float budget,
+             float costFactor) const;
+
+ private:
+  bool isMeasured(int step) const;
+
+  // Moving average of the frame time and number of frames, per step
+  QVector<float> frameTimes;
+  QVector<int> frameCounts;
+};
+
+#endif  // LEVEL_SELECTOR_H
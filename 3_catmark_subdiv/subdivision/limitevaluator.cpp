@@ -0,0 +1,323 @@
+#include "limitevaluator.h"
+
+#include <algorithm>
+
+#include "subdivision/approxpatchtable.h"
+#include "subdivision/patchtable.h"
+#include "util/profiler.h"
+
+/**
+ * @brief bspline Evaluates the uniform cubic B-spline basis functions.
+ * @param t The parameter.
+ * @param basis Array of 4 entries that receives the values.
+ * @param derivative Array of 4 entries that receives the derivatives.
+ */
+static inline void bspline(float t, float* basis, float* derivative) {
+  float t2 = t * t;
+  float t3 = t2 * t;
+  basis[0] = (1.0f - 3.0f * t + 3.0f * t2 - t3) / 6.0f;
+  basis[1] = (4.0f - 6.0f * t2 + 3.0f * t3) / 6.0f;
+  basis[2] = (1.0f + 3.0f * t + 3.0f * t2 - 3.0f * t3) / 6.0f;
+  basis[3] = t3 / 6.0f;
+  derivative[0] = (-3.0f + 6.0f * t - 3.0f * t2) / 6.0f;
+  derivative[1] = (-12.0f * t + 9.0f * t2) / 6.0f;
+  derivative[2] = (3.0f + 6.0f * t - 9.0f * t2) / 6.0f;
+  derivative[3] = 3.0f * t2 / 6.0f;
+}
+
+/**
+ * @brief bernstein Evaluates the cubic Bernstein polynomials.
+ * @param t The parameter.
+ * @param basis Array of 4 entries that receives the values.
+ * @param derivative Array of 4 entries that receives the derivatives.
+ */
+static inline void bernstein(float t, float* basis, float* derivative) {
+  float it = 1.0f - t;
+  basis[0] = it * it * it;
+  basis[1] = 3.0f * it * it * t;
+  basis[2] = 3.0f * it * t * t;
+  basis[3] = t * t * t;
+  derivative[0] = -3.0f * it * it;
+  derivative[1] = 3.0f * it * it - 6.0f * it * t;
+  derivative[2] = 6.0f * it * t - 3.0f * t * t;
+  derivative[3] = 3.0f * t * t;
+}
+
+/**
+ * @brief evaluatePatch Evaluates a bicubic patch in the layout of PatchTable.
+ * @param points The 16 control points.
+ * @param bezier Whether the control points are Bezier instead of B-spline
+ * control points.
+ * @param u The parameter along the columns.
+ * @param v The parameter along the rows.
+ * @param sample Receives the position and the derivatives.
+ */
+static void evaluatePatch(const QVector3D* points, bool bezier, float u,
+                          float v, LimitSample& sample) {
+  float Bu[4], Bv[4], dBu[4], dBv[4];
+  if (bezier) {
+    bernstein(u, Bu, dBu);
+    bernstein(v, Bv, dBv);
+  } else {
+    bspline(u, Bu, dBu);
+    bspline(v, Bv, dBv);
+  }
+  sample.position = QVector3D();
+  sample.du = QVector3D();
+  sample.dv = QVector3D();
+  for (int r = 0; r < 4; r++) {
+    for (int c = 0; c < 4; c++) {
+      const QVector3D& point = points[r * 4 + c];
+      sample.position += Bv[r] * Bu[c] * point;
+      sample.du += Bv[r] * dBu[c] * point;
+      sample.dv += dBv[r] * Bu[c] * point;
+    }
+  }
+}
+
+/**
+ * @brief evaluateBilinear Interpolates the corners of a quad bilinearly.
+ * @param mesh The mesh.
+ * @param f Index of the quad.
+ * @param u The parameter along the first side.
+ * @param v The parameter along the last side, reversed.
+ * @param sample Receives the position and the derivatives.
+ */
+static void evaluateBilinear(const CompactMesh& mesh, int f, float u, float v,
+                             LimitSample& sample) {
+  int side = mesh.faceSide(f);
+  const QVector<int>& origins = mesh.getOrigins();
+  QVector3D p0 = mesh.position(origins[side]);
+  QVector3D p1 = mesh.position(origins[side + 1]);
+  QVector3D p2 = mesh.position(origins[side + 2]);
+  QVector3D p3 = mesh.position(origins[side + 3]);
+  sample.position = (1.0f - u) * (1.0f - v) * p0 + u * (1.0f - v) * p1 +
+                    u * v * p2 + (1.0f - u) * v * p3;
+  sample.du = (1.0f - v) * (p1 - p0) + v * (p2 - p3);
+  sample.dv = (1.0f - u) * (p3 - p0) + u * (p2 - p1);
+}
+
+// Derivatives with respect to the (u, v) of a quad in terms of those of its
+// child at corner k, row-major
+static const float quadrantJacobians[4][4] = {{2.0f, 0.0f, 0.0f, 2.0f},
+                                             {0.0f, -2.0f, 2.0f, 0.0f},
+                                             {-2.0f, 0.0f, 0.0f, -2.0f},
+                                             {0.0f, 2.0f, -2.0f, 0.0f}};
+
+/**
+ * @brief faceRing Collects a face and all faces around its vertices. This is
+ * the part of the mesh that determines the first subdivision step of the
+ * face and of its neighbourhood within the face.
+ * @param mesh The mesh.
+ * @param f Index of the face.
+ * @return The face followed by the faces around its vertices.
+ */
+static QVector<int> faceRing(const CompactMesh& mesh, int f) {
+  const QVector<int>& origins = mesh.getOrigins();
+  const QVector<int>& twins = mesh.getTwins();
+  const QVector<int>& vertexOut = mesh.getVertexOut();
+  QVector<int> faces = {f};
+  int side = mesh.faceSide(f);
+  for (int k = 0; k < mesh.faceValence(f); k++) {
+    int start = vertexOut[origins[side + k]];
+    int h = start;
+    do {
+      int g = mesh.face(h);
+      if (!faces.contains(g)) {
+        faces.append(g);
+      }
+      h = twins[mesh.prev(h)];
+    } while (h >= 0 && h != start);
+  }
+  return faces;
+}
+
+/**
+ * @brief LimitEvaluator::LimitEvaluator Creates a limit evaluator for a mesh.
+ * @param controlMesh The control mesh. It is copied, so later changes to it
+ * are not seen.
+ * @param maxDepth Maximum number of refinement steps per query, at least 1.
+ */
+LimitEvaluator::LimitEvaluator(Mesh& controlMesh, int maxDepth)
+    : controlMesh(CompactMesh::fromMesh(controlMesh)),
+      maxDepth(qMax(1, maxDepth)) {}
+
+/**
+ * @brief LimitEvaluator::LimitEvaluator Creates a limit evaluator for a
+ * compact mesh.
+ * @param controlMesh The control mesh. It is copied.
+ * @param maxDepth Maximum number of refinement steps per query, at least 1.
+ */
+LimitEvaluator::LimitEvaluator(const CompactMesh& controlMesh, int maxDepth)
+    : controlMesh(controlMesh), maxDepth(qMax(1, maxDepth)) {}
+
+/**
+ * @brief LimitEvaluator::evaluate Evaluates the limit surface at a single
+ * point. Use the batched version for many points.
+ * @param face Index of the face of the control mesh.
+ * @param u The first parameter, in [0, 1].
+ * @param v The second parameter, in [0, 1].
+ * @param corner The corner of a face that is not a quad, see LimitQuery.
+ * @return The limit sample.
+ */
+LimitSample LimitEvaluator::evaluate(int face, float u, float v,
+                                     int corner) const {
+  QVector<LimitQuery> queries(1);
+  queries[0].face = face;
+  queries[0].u = u;
+  queries[0].v = v;
+  queries[0].corner = corner;
+  QVector<LimitSample> samples;
+  evaluate(queries, samples);
+  return samples[0];
+}
+
+/**
+ * @brief LimitEvaluator::evaluate Evaluates the limit surface at many points.
+ * Parameters outside [0, 1] are clamped to the face.
+ * @param queries The points, with valid face indices and corners.
+ * @param samples Receives the sample of every query, in the same order.
+ */
+void LimitEvaluator::evaluate(const QVector<LimitQuery>& queries,
+                              QVector<LimitSample>& samples) const {
+  ProfileScope scope("LimitEvaluator::evaluate");
+  samples.resize(queries.size());
+
+  // Runs of queries in the same face, independent of the size of the mesh
+  QVector<int> order(queries.size());
+  for (int i = 0; i < queries.size(); i++) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&queries](int a, int b) {
+    return queries[a].face < queries[b].face;
+  });
+  QVector<int> runs;
+  for (int i = 0; i < order.size(); i++) {
+    if (i == 0 || queries[order[i]].face != queries[order[i - 1]].face) {
+      runs.append(i);
+    }
+  }
+  runs.append(order.size());
+
+#pragma omp parallel for schedule(dynamic)
+  for (int j = 0; j < runs.size() - 1; j++) {
+    QVector<Pending> pending(runs[j + 1] - runs[j]);
+    for (int i = 0; i < pending.size(); i++) {
+      const LimitQuery& query = queries[order[runs[j] + i]];
+      Pending& p = pending[i];
+      p.index = order[runs[j] + i];
+      p.corner = query.corner;
+      p.u = qBound(0.0f, query.u, 1.0f);
+      p.v = qBound(0.0f, query.v, 1.0f);
+      p.jacobian[0] = 1.0f;
+      p.jacobian[1] = 0.0f;
+      p.jacobian[2] = 0.0f;
+      p.jacobian[3] = 1.0f;
+    }
+    int f = queries[order[runs[j]]].face;
+    evaluateFace(controlMesh, f, 0, pending, samples);
+  }
+}
+
+/**
+ * @brief LimitEvaluator::evaluateFace Evaluates the queries that lie in one
+ * face, either directly or by refining the face and recursing into its
+ * children.
+ * @param mesh The mesh containing the face. Its vertices around the face must
+ * have their correct positions and neighbourhoods.
+ * @param f Index of the face.
+ * @param depth Number of refinement steps so far.
+ * @param pending The queries in the face.
+ * @param samples The samples of all queries.
+ */
+void LimitEvaluator::evaluateFace(const CompactMesh& mesh, int f, int depth,
+                                  const QVector<Pending>& pending,
+                                  QVector<LimitSample>& samples) const {
+  const bool regular = PatchTable::isRegularFace(mesh, f);
+  if (regular || depth == maxDepth) {
+    QVector3D points[16];
+    bool bezier = false;
+    bool bilinear = false;
+    if (regular) {
+      int indices[16];
+      PatchTable::controlPointIndices(mesh, f, indices);
+      for (int i = 0; i < 16; i++) {
+        points[i] = mesh.position(indices[i]);
+      }
+    } else if (ApproxPatchTable::isApproximableFace(mesh, f)) {
+      ApproxPatchTable::controlPoints(mesh, f, points);
+      bezier = true;
+    } else {
+      bilinear = true;
+    }
+
+    for (const Pending& p : pending) {
+      LimitSample local;
+      if (bilinear) {
+        evaluateBilinear(mesh, f, p.u, p.v, local);
+      } else {
+        evaluatePatch(points, bezier, p.u, p.v, local);
+      }
+      LimitSample& sample = samples[p.index];
+      sample.position = local.position;
+      sample.du = p.jacobian[0] * local.du + p.jacobian[1] * local.dv;
+      sample.dv = p.jacobian[2] * local.du + p.jacobian[3] * local.dv;
+      sample.normal = QVector3D::crossProduct(sample.du, sample.dv);
+      sample.normal.normalize();
+    }
+    return;
+  }
+
+  // The children of submesh face 0 are faces 0 up to its valence. Child k lies
+  // at corner k, with its parameter starting at that corner and running along
+  // the side that leaves it.
+  const int valence = mesh.faceValence(f);
+  CompactMesh submesh = mesh.extractSubmesh(faceRing(mesh, f));
+  CompactMesh refined = subdivider.subdivide(submesh);
+  QVector<QVector<Pending>> children(valence);
+  for (const Pending& p : pending) {
+    if (valence != 4) {
+      // Only at the control mesh: the query is given in its child directly
+      children[qBound(0, p.corner, valence - 1)].append(p);
+      continue;
+    }
+    int k;
+    if (p.v < 0.5f) {
+      k = p.u < 0.5f ? 0 : 1;
+    } else {
+      k = p.u < 0.5f ? 3 : 2;
+    }
+    Pending child = p;
+    switch (k) {
+      case 0:
+        child.u = 2.0f * p.u;
+        child.v = 2.0f * p.v;
+        break;
+      case 1:
+        child.u = 2.0f * p.v;
+        child.v = 2.0f * (1.0f - p.u);
+        break;
+      case 2:
+        child.u = 2.0f * (1.0f - p.u);
+        child.v = 2.0f * (1.0f - p.v);
+        break;
+      default:
+        child.u = 2.0f * (1.0f - p.v);
+        child.v = 2.0f * p.u;
+        break;
+    }
+    const float* m = quadrantJacobians[k];
+    const float* J = p.jacobian;
+    child.jacobian[0] = J[0] * m[0] + J[1] * m[2];
+    child.jacobian[1] = J[0] * m[1] + J[1] * m[3];
+    child.jacobian[2] = J[2] * m[0] + J[3] * m[2];
+    child.jacobian[3] = J[2] * m[1] + J[3] * m[3];
+    children[k].append(child);
+  }
+
+  for (int k = 0; k < valence; k++) {
+    if (!children[k].isEmpty()) {
+      evaluateFace(refined, k, depth + 1, children[k], samples);
+    }
+  }
+}
@@ -0,0 +1,99 @@
+#ifndef LIMIT_EVALUATOR_H
+#define LIMIT_EVALUATOR_H
+
+#include <QVector3D>
+#include <QVector>
+
+#include "mesh/compactmesh.h"
+#include "mesh/mesh.h"
+#include "subdivision/compactsubdivider.h"
+
+// Default number of local refinement steps before falling back to an
+// approximating patch
+#define LIMIT_EVALUATOR_MAX_DEPTH 10
+
+/**
+ * @brief The LimitQuery struct is a point on the limit surface, given by a
+ * face of the control mesh and a parameter (u, v) in [0, 1]^2. For a quad, u
+ * runs from the origin of its first side towards the second corner and v from
+ * the origin towards the last corner. Any other face is split into the quads
+ * of its first subdivision step, one per corner, and corner selects the quad
+ * whose (u, v) is meant, with the same orientation relative to that corner.
+ */
+struct LimitQuery {
+  int face;
+  float u;
+  float v;
+  int corner = 0;
+};
+
+/**
+ * @brief The LimitSample struct is the limit position with its partial
+ * derivatives with respect to u and v and the unit normal.
+ */
+struct LimitSample {
+  QVector3D position;
+  QVector3D du;
+  QVector3D dv;
+  QVector3D normal;
+};
+
+/**
+ * @brief The LimitEvaluator class evaluates the Catmull-Clark limit surface
+ * of a control mesh at arbitrary (face, u, v) points, without refining the
+ * whole mesh.
+ *
+ * A regular face (see PatchTable::isRegularFace) is evaluated exactly as its
+ * bicubic B-spline patch, the same way patch.tese does. Any other face is
+ * refined on its own: it is extracted together with the faces around its
+ * vertices, subdivided once, and the query descends into the child quad that
+ * contains it, with (u, v) mapped to the parameter of that child. Since the
+ * irregular part shrinks by half per step, this arrives at a regular patch
+ * after a few steps unless the point is close to an extraordinary vertex or
+ * a sharp edge. At the maximum depth the child is evaluated as its Bezier
+ * patch from ApproxPatchTable, or bilinearly where that does not apply
+ * (boundaries and sharp edges), which is exact up to the size of a face at
+ * that depth.
+ *
+ * Queries are grouped by face, so queries in the same face share the
+ * refinement, and different faces are evaluated in parallel. The derivatives
+ * are with respect to the parameter of the query, so du x dv points outwards
+ * for a consistently oriented mesh.
+ */
+class LimitEvaluator {
+ public:
+  LimitEvaluator(Mesh& controlMesh, int maxDepth = LIMIT_EVALUATOR_MAX_DEPTH);
+  LimitEvaluator(const CompactMesh& controlMesh,
+                 int maxDepth = LIMIT_EVALUATOR_MAX_DEPTH);
+
+  LimitSample evaluate(int face, float u, float v, int corner = 0) const;
+  void evaluate(const QVector<LimitQuery>& queries,
+                QVector<LimitSample>& samples) const;
+
+  inline int getMaxDepth() const { return maxDepth; }
+  inline const CompactMesh& getControlMesh() const { return controlMesh; }
+
+ private:
+  /**
+   * @brief The Pending struct is a query on its way down the refinement, with
+   * its parameter in the current face and the Jacobian (row-major) that maps
+   * derivatives in the current face to derivatives in the queried face.
+   */
+  struct Pending {
+    int index;
+    int corner;
+    float u;
+    float v;
+    float jacobian[4];
+  };
+
+  void evaluateFace(const CompactMesh& mesh, int f, int depth,
+                    const QVector<Pending>& pending,
+                    QVector<LimitSample>& samples) const;
+
+  CompactMesh controlMesh;
+  int maxDepth;
+  CompactCatmullClarkSubdivider subdivider;
+};
+
+#endif  // LIMIT_EVALUATOR_H
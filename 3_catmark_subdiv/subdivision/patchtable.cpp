@@ -0,0 +1,148 @@
+#include "patchtable.h"
+
+/**
+ * @brief PatchTable::PatchTable Creates an empty patch table.
+ */
+PatchTable::PatchTable() {}
+
+/**
+ * @brief PatchTable::isRegularFace Checks whether a face can be represented
+ * exactly by a single bicubic B-spline patch. This is the case when the face is
+ * a quad and each of its vertices is an interior vertex of valence 4 without
+ * incident sharp edges, surrounded by quads only.
+ * @param mesh The mesh.
+ * @param f Index of the face.
+ * @return True if the face is regular; false otherwise.
+ */
+bool PatchTable::isRegularFace(const CompactMesh& mesh, int f) {
+  if (mesh.faceValence(f) != 4) {
+    return false;
+  }
+  const QVector<int>& twins = mesh.getTwins();
+  const QVector<int>& edges = mesh.getEdges();
+  int side = mesh.faceSide(f);
+  for (int k = 0; k < 4; k++) {
+    int start = side + k;
+    int h = start;
+    for (int i = 0; i < 4; i++) {
+      if (twins[h] < 0 || mesh.isSharpEdge(edges[h]) ||
+          mesh.faceValence(mesh.face(h)) != 4) {
+        return false;
+      }
+      h = twins[mesh.prev(h)];
+      if (h < 0) {
+        return false;
+      }
+    }
+    // Valence 4: the walk must be back at the start
+    if (h != start) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief PatchTable::controlPointIndices Collects the 16 control points of the
+ * patch of a regular face. For every corner of the face, the diagonally
+ * opposite quad across that corner provides the three outer control points
+ * near the corner.
+ * @param mesh The mesh.
+ * @param f Index of a regular face, see isRegularFace.
+ * @param indices Array of 16 entries that receives the vertex indices.
+ */
+void PatchTable::controlPointIndices(const CompactMesh& mesh, int f,
+                                     int* indices) {
+  // Grid position of each corner and the grid directions (row, column) of its
+  // outgoing half-edge in the face (U) and of the incoming one reversed (V).
+  static const int corners[4][2] = {{1, 1}, {1, 2}, {2, 2}, {2, 1}};
+  static const int dirU[4][2] = {{0, 1}, {1, 0}, {0, -1}, {-1, 0}};
+  static const int dirV[4][2] = {{1, 0}, {0, -1}, {-1, 0}, {0, 1}};
+
+  const QVector<int>& origins = mesh.getOrigins();
+  const QVector<int>& twins = mesh.getTwins();
+  int side = mesh.faceSide(f);
+  for (int k = 0; k < 4; k++) {
+    int h = side + k;
+    int r = corners[k][0];
+    int c = corners[k][1];
+    int ur = dirU[k][0];
+    int uc = dirU[k][1];
+    int vr = dirV[k][0];
+    int vc = dirV[k][1];
+    // Outgoing half-edge of the corner in the diagonally opposite face
+    int opposite = twins[mesh.prev(twins[mesh.prev(h)])];
+    int next = mesh.next(opposite);
+    indices[r * 4 + c] = origins[h];
+    indices[(r - ur) * 4 + (c - uc)] = origins[next];
+    indices[(r - ur - vr) * 4 + (c - uc - vc)] = origins[mesh.next(next)];
+    indices[(r - vr) * 4 + (c - vc)] = origins[mesh.prev(opposite)];
+  }
+}
+
+/**
+ * @brief PatchTable::buildIndexTable Collects the control point indices of the
+ * patches of all regular faces of a mesh. The faces are classified in parallel
+ * first; a prefix sum over the result then gives every patch its place in the
+ * table, so the indices can be gathered in parallel as well.
+ * @param mesh The mesh.
+ * @return 16 vertex indices per regular face, in the order of the faces.
+ */
+QVector<int> PatchTable::buildIndexTable(const CompactMesh& mesh) {
+  const int numFaces = mesh.numFaces();
+  QVector<int> offsets(numFaces + 1);
+#pragma omp parallel for schedule(static)
+  for (int f = 0; f < numFaces; f++) {
+    offsets[f + 1] = isRegularFace(mesh, f) ? 1 : 0;
+  }
+  offsets[0] = 0;
+  for (int f = 0; f < numFaces; f++) {
+    offsets[f + 1] += offsets[f];
+  }
+
+  QVector<int> indices(16 * offsets[numFaces]);
+  int* table = indices.data();
+#pragma omp parallel for schedule(static)
+  for (int f = 0; f < numFaces; f++) {
+    if (offsets[f + 1] != offsets[f]) {
+      controlPointIndices(mesh, f, table + 16 * offsets[f]);
+    }
+  }
+  return indices;
+}
+
+/**
+ * @brief PatchTable::appendPatch Appends the patch of a regular face.
+ * @param mesh The mesh.
+ * @param f Index of a regular face, see isRegularFace.
+ * @param depth The subdivision level of the mesh.
+ */
+void PatchTable::appendPatch(const CompactMesh& mesh, int f, int depth) {
+  int indices[16];
+  controlPointIndices(mesh, f, indices);
+  for (int i = 0; i < 16; i++) {
+    controlPoints.append(mesh.position(indices[i]));
+  }
+  depths.append(depth);
+}
+
+/**
+ * @brief PatchTable::appendControlPoints Appends a patch given by its control
+ * points.
+ * @param points The 16 control points of the patch.
+ * @param depth The subdivision level the patch was extracted at.
+ */
+void PatchTable::appendControlPoints(const QVector3D* points, int depth) {
+  for (int i = 0; i < 16; i++) {
+    controlPoints.append(points[i]);
+  }
+  depths.append(depth);
+}
+
+/**
+ * @brief PatchTable::clear Removes all patches.
+ */
+void PatchTable::clear() {
+  controlPoints.clear();
+  depths.clear();
+}
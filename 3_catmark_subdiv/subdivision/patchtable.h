@@ -0,0 +1,44 @@
+#ifndef PATCH_TABLE_H
+#define PATCH_TABLE_H
+
+#include <QVector3D>
+#include <QVector>
+
+#include "mesh/compactmesh.h"
+
+/**
+ * @brief The PatchTable class holds bicubic B-spline patches, stored as 16
+ * control points per patch in the order patch.tese expects: row-major, rows
+ * along v and columns along u, with the corners of the patch face at grid
+ * positions (1,1), (1,2), (2,2) and (2,1).
+ *
+ * A quad face is regular, and then exactly represented by its patch, when its
+ * four vertices are interior, have valence 4, have no incident sharp edges and
+ * all faces around them are quads.
+ */
+class PatchTable {
+ public:
+  PatchTable();
+
+  static bool isRegularFace(const CompactMesh& mesh, int f);
+  static void controlPointIndices(const CompactMesh& mesh, int f,
+                                  int* indices);
+  static QVector<int> buildIndexTable(const CompactMesh& mesh);
+
+  void appendPatch(const CompactMesh& mesh, int f, int depth);
+  void appendControlPoints(const QVector3D* points, int depth);
+  void clear();
+
+  inline int numPatches() const { return depths.size(); }
+  inline const QVector<QVector3D>& getControlPoints() const {
+    return controlPoints;
+  }
+  inline const QVector<int>& getDepths() const { return depths; }
+
+ private:
+  QVector<QVector3D> controlPoints;
+  // Subdivision level each patch was extracted at
+  QVector<int> depths;
+};
+
+#endif  // PATCH_TABLE_H
@@ -0,0 +1,359 @@
+#include "stenciltable.h"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "compactsubdivider.h"
+
+/**
+ * @brief The LocalStencil struct holds the weights of a single new vertex over
+ * the vertices of the previous level. Indices may occur more than once; their
+ * weights are summed when the stencils are composed.
+ */
+struct LocalStencil {
+  QVector<int> indices;
+  QVector<float> weights;
+
+  inline void clear() {
+    indices.clear();
+    weights.clear();
+  }
+  inline void add(int v, float w) {
+    indices.append(v);
+    weights.append(w);
+  }
+};
+
+/**
+ * @brief addFacePoint Adds the stencil of a face point, scaled by a weight.
+ * @param mesh The mesh of the previous level.
+ * @param f Index of the face.
+ * @param w Weight of the face point.
+ * @param stencil The stencil to add to.
+ */
+static void addFacePoint(const CompactMesh& mesh, int f, float w,
+                         LocalStencil& stencil) {
+  const QVector<int>& origins = mesh.getOrigins();
+  int side = mesh.faceSide(f);
+  int valence = mesh.faceValence(f);
+  for (int i = 0; i < valence; i++) {
+    stencil.add(origins[side + i], w / valence);
+  }
+}
+
+/**
+ * @brief edgePointStencil Builds the stencil of an edge point. Mirrors the
+ * edge rules of CompactCatmullClarkSubdivider::edgePoints.
+ * @param mesh The mesh of the previous level.
+ * @param h The half-edge of the edge with the highest index.
+ * @param stencil The stencil to fill.
+ */
+static void edgePointStencil(const CompactMesh& mesh, int h,
+                             LocalStencil& stencil) {
+  const QVector<int>& origins = mesh.getOrigins();
+  int twin = mesh.getTwins()[h];
+  float s = mesh.getSharpness()[mesh.getEdges()[h]];
+  int v0 = origins[h];
+  int v1 = origins[mesh.next(h)];
+
+  float smoothWeight = 0.0f;
+  if (twin >= 0 && s != -1.0f) {
+    smoothWeight = s > 0.0f ? s - floorf(s) : 1.0f;
+  }
+  // Midpoint part of the sharp rule and of the smooth rule
+  float midWeight = 0.5f * (1.0f - smoothWeight) + 0.25f * smoothWeight;
+  stencil.add(v0, midWeight);
+  stencil.add(v1, midWeight);
+  if (smoothWeight > 0.0f) {
+    addFacePoint(mesh, mesh.face(h), 0.25f * smoothWeight, stencil);
+    addFacePoint(mesh, mesh.face(twin), 0.25f * smoothWeight, stencil);
+  }
+}
+
+/**
+ * @brief vertexPointStencil Builds the stencil of a vertex point. Mirrors the
+ * vertex rules of CompactCatmullClarkSubdivider::vertexPoint.
+ * @param mesh The mesh of the previous level.
+ * @param v Index of the vertex.
+ * @param stencil The stencil to fill.
+ */
+static void vertexPointStencil(const CompactMesh& mesh, int v,
+                               LocalStencil& stencil) {
+  const QVector<int>& origins = mesh.getOrigins();
+  const QVector<int>& twins = mesh.getTwins();
+  const int start = mesh.getVertexOut()[v];
+  if (start < 0) {
+    stencil.add(v, 1.0f);
+    return;
+  }
+
+  int creaseNeighbours[2] = {-1, -1};
+  float creaseSharpness[2] = {0.0f, 0.0f};
+  int numCreaseEdges = 0;
+  int n = 0;
+  int h = start;
+  int last = start;
+  do {
+    int e = mesh.getEdges()[h];
+    if (mesh.isSharpEdge(e)) {
+      if (numCreaseEdges < 2) {
+        creaseNeighbours[numCreaseEdges] = origins[mesh.next(h)];
+        creaseSharpness[numCreaseEdges] = mesh.getSharpness()[e];
+      }
+      numCreaseEdges++;
+    }
+    n++;
+    last = h;
+    h = twins[mesh.prev(h)];
+  } while (h >= 0 && h != start);
+
+  if (twins[start] < 0) {
+    // (2S + M1 + M2) / 4 with M the boundary edge midpoints
+    stencil.add(v, 0.75f);
+    stencil.add(origins[mesh.next(start)], 0.125f);
+    stencil.add(origins[mesh.prev(last)], 0.125f);
+    return;
+  }
+  if (numCreaseEdges >= 3) {
+    stencil.add(v, 1.0f);
+    return;
+  }
+
+  float smoothWeight = 1.0f;
+  if (numCreaseEdges == 2) {
+    float s1 = creaseSharpness[0];
+    float s2 = creaseSharpness[1];
+    smoothWeight = (s1 == -1.0f || s2 == -1.0f)
+                       ? 0.0f
+                       : ((s1 - floorf(s1)) + (s2 - floorf(s2))) / 2.0f;
+    // S/2 + (M1 + M2)/4 with M the crease edge midpoints
+    float creaseWeight = 1.0f - smoothWeight;
+    stencil.add(v, 0.75f * creaseWeight);
+    stencil.add(creaseNeighbours[0], 0.125f * creaseWeight);
+    stencil.add(creaseNeighbours[1], 0.125f * creaseWeight);
+  }
+  if (smoothWeight > 0.0f) {
+    // (Q + 2R + (n - 3)S) / n, with Q and R the averages of the face points and
+    // edge midpoints. The midpoints contribute S/n in total.
+    float inv = smoothWeight / float(n * n);
+    stencil.add(v, smoothWeight * float(n - 2) / float(n));
+    h = start;
+    do {
+      stencil.add(origins[mesh.next(h)], inv);
+      addFacePoint(mesh, mesh.face(h), inv, stencil);
+      h = twins[mesh.prev(h)];
+    } while (h != start);
+  }
+}
+
+/**
+ * @brief localStencil Builds the stencil of a vertex of the next level over the
+ * vertices of the given level, using the same ordering as the subdividers:
+ * vertex points, then face points, then edge points.
+ * @param mesh The mesh of the previous level.
+ * @param edgeHalfEdges For every edge, its half-edge with the highest index.
+ * @param i Index of the vertex in the next level.
+ * @param stencil The stencil to fill.
+ */
+static void localStencil(const CompactMesh& mesh,
+                         const QVector<int>& edgeHalfEdges, int i,
+                         LocalStencil& stencil) {
+  stencil.clear();
+  if (i < mesh.numVerts()) {
+    vertexPointStencil(mesh, i, stencil);
+  } else if (i < mesh.numVerts() + mesh.numFaces()) {
+    addFacePoint(mesh, i - mesh.numVerts(), 1.0f, stencil);
+  } else {
+    edgePointStencil(mesh,
+                     edgeHalfEdges[i - mesh.numVerts() - mesh.numFaces()],
+                     stencil);
+  }
+}
+
+/**
+ * @brief StencilTable::StencilTable Creates an empty stencil table.
+ */
+StencilTable::StencilTable() : controlVertexCount(0), levels(0) {
+  offsets.append(0);
+}
+
+/**
+ * @brief StencilTable::StencilTable Builds the stencil table of the given
+ * control mesh subdivided the given number of times. The table starts as the
+ * identity; every level, the local stencils of the new vertices over the
+ * previous level are composed with the table of that level.
+ * @param controlMesh The control mesh.
+ * @param levels The number of subdivision steps.
+ */
+StencilTable::StencilTable(Mesh& controlMesh, int levels)
+    : controlVertexCount(controlMesh.numVerts()), levels(levels) {
+  offsets.resize(controlVertexCount + 1);
+  indices.resize(controlVertexCount);
+  weights.resize(controlVertexCount);
+  for (int v = 0; v < controlVertexCount; v++) {
+    offsets[v] = v;
+    indices[v] = v;
+    weights[v] = 1.0f;
+  }
+  offsets[controlVertexCount] = controlVertexCount;
+
+  CompactCatmullClarkSubdivider subdivider;
+  CompactMesh mesh = CompactMesh::fromMesh(controlMesh);
+  for (int k = 0; k < levels; k++) {
+    composeLevel(mesh);
+    mesh = subdivider.subdivide(mesh);
+  }
+  refinedMesh = mesh;
+}
+
+/**
+ * @brief StencilTable::composeLevel Replaces the current table, which holds the
+ * stencils of the vertices of the given level, by the table of the next level.
+ * This is done in two passes over the new vertices: the first counts the
+ * number of distinct control vertices of every stencil, the second fills in
+ * the weights. The control vertices of each stencil are sorted.
+ * @param mesh The mesh of the level the current table belongs to.
+ */
+void StencilTable::composeLevel(const CompactMesh& mesh) {
+  const int numChildren = mesh.numVerts() + mesh.numFaces() + mesh.numEdges();
+  const int numHalfEdges = mesh.numHalfEdges();
+  const QVector<int>& twins = mesh.getTwins();
+  const QVector<int>& edges = mesh.getEdges();
+
+  QVector<int> edgeHalfEdges(mesh.numEdges());
+#pragma omp parallel for schedule(static)
+  for (int h = 0; h < numHalfEdges; h++) {
+    if (h > twins[h]) {
+      edgeHalfEdges[edges[h]] = h;
+    }
+  }
+
+  QVector<int> newOffsets(numChildren + 1);
+#pragma omp parallel
+  {
+    LocalStencil local;
+    QVector<int> marker(controlVertexCount, -1);
+#pragma omp for schedule(dynamic, 256)
+    for (int i = 0; i < numChildren; i++) {
+      localStencil(mesh, edgeHalfEdges, i, local);
+      int count = 0;
+      for (int j : local.indices) {
+        for (int k = offsets[j]; k < offsets[j + 1]; k++) {
+          if (marker[indices[k]] != i) {
+            marker[indices[k]] = i;
+            count++;
+          }
+        }
+      }
+      newOffsets[i + 1] = count;
+    }
+  }
+  newOffsets[0] = 0;
+  for (int i = 0; i < numChildren; i++) {
+    newOffsets[i + 1] += newOffsets[i];
+  }
+
+  QVector<int> newIndices(newOffsets[numChildren]);
+  QVector<float> newWeights(newOffsets[numChildren]);
+#pragma omp parallel
+  {
+    LocalStencil local;
+    QVector<int> marker(controlVertexCount, -1);
+    QVector<float> scratch(controlVertexCount, 0.0f);
+    QVector<int> touched;
+#pragma omp for schedule(dynamic, 256)
+    for (int i = 0; i < numChildren; i++) {
+      localStencil(mesh, edgeHalfEdges, i, local);
+      touched.clear();
+      for (int l = 0; l < local.indices.size(); l++) {
+        int j = local.indices[l];
+        float w = local.weights[l];
+        for (int k = offsets[j]; k < offsets[j + 1]; k++) {
+          int c = indices[k];
+          if (marker[c] != i) {
+            marker[c] = i;
+            touched.append(c);
+          }
+          scratch[c] += w * weights[k];
+        }
+      }
+      std::sort(touched.begin(), touched.end());
+      int o = newOffsets[i];
+      for (int c : touched) {
+        newIndices[o] = c;
+        newWeights[o] = scratch[c];
+        scratch[c] = 0.0f;
+        o++;
+      }
+    }
+  }
+
+  offsets.swap(newOffsets);
+  indices.swap(newIndices);
+  weights.swap(newWeights);
+}
+
+/**
+ * @brief StencilTable::apply Computes the refined vertex positions from the
+ * given control vertex positions.
+ * @param controlCoords Positions of the control vertices.
+ * @param refinedCoords Is resized to the number of refined vertices and filled
+ * with their positions.
+ */
+void StencilTable::apply(const QVector<QVector3D>& controlCoords,
+                         QVector<QVector3D>& refinedCoords) const {
+  assert(controlCoords.size() == controlVertexCount);
+  const int numRefined = numRefinedVertices();
+  refinedCoords.resize(numRefined);
+  const QVector3D* control = controlCoords.constData();
+  QVector3D* refined = refinedCoords.data();
+
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < numRefined; i++) {
+    float x = 0.0f, y = 0.0f, z = 0.0f;
+    for (int k = offsets[i]; k < offsets[i + 1]; k++) {
+      const QVector3D& p = control[indices[k]];
+      float w = weights[k];
+      x += w * p.x();
+      y += w * p.y();
+      z += w * p.z();
+    }
+    refined[i] = QVector3D(x, y, z);
+  }
+}
+
+/**
+ * @brief StencilTable::apply Updates the vertex coordinates of a refined mesh
+ * from the vertex coordinates of its control mesh. The refined mesh must have
+ * the topology of this table, e.g. the result of subdividing the control mesh
+ * getLevels() times, or of getRefinedMesh().toMesh().
+ * @param controlMesh The control mesh.
+ * @param refinedMesh The refined mesh whose vertex coordinates are updated.
+ */
+void StencilTable::apply(Mesh& controlMesh, Mesh& refinedMesh) const {
+  assert(refinedMesh.numVerts() == numRefinedVertices());
+  QVector<Vertex>& controlVertices = controlMesh.getVertices();
+  QVector<QVector3D> controlCoords(controlVertices.size());
+  for (int v = 0; v < controlVertices.size(); v++) {
+    controlCoords[v] = controlVertices[v].coords;
+  }
+  QVector<QVector3D> refinedCoords;
+  apply(controlCoords, refinedCoords);
+
+  QVector<Vertex>& refinedVertices = refinedMesh.getVertices();
+  for (int v = 0; v < refinedVertices.size(); v++) {
+    refinedVertices[v].coords = refinedCoords[v];
+  }
+}
+
+/**
+ * @brief StencilTable::memoryFootprint Calculates the number of bytes used by
+ * the stencils, excluding the refined topology.
+ * @return The size of the table in bytes.
+ */
+qint64 StencilTable::memoryFootprint() const {
+  return qint64(offsets.size() + indices.size()) * qint64(sizeof(int)) +
+         qint64(weights.size()) * qint64(sizeof(float));
+}
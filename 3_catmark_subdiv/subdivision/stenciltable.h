@@ -0,0 +1,53 @@
+#ifndef STENCIL_TABLE_H
+#define STENCIL_TABLE_H
+
+#include <QVector3D>
+#include <QVector>
+
+#include "mesh/compactmesh.h"
+#include "mesh/mesh.h"
+
+/**
+ * @brief The StencilTable class factors the vertices of a mesh that is
+ * subdivided a fixed number of times into sparse weights over the vertices of
+ * the control mesh. Catmull-Clark subdivision, including the boundary and
+ * (semi-)sharp crease rules, is linear in the vertex positions once the
+ * topology and sharpness are fixed, so every refined vertex is a weighted sum
+ * of control vertices. After building the table, new control point positions
+ * only need a single sparse matrix-vector product to obtain the refined
+ * positions; no topology work is done.
+ *
+ * The table has to be rebuilt when the topology or the sharpness of the control
+ * mesh changes.
+ */
+class StencilTable {
+ public:
+  StencilTable();
+  StencilTable(Mesh& controlMesh, int levels);
+
+  void apply(const QVector<QVector3D>& controlCoords,
+             QVector<QVector3D>& refinedCoords) const;
+  void apply(Mesh& controlMesh, Mesh& refinedMesh) const;
+
+  inline int getLevels() const { return levels; }
+  inline int numControlVertices() const { return controlVertexCount; }
+  inline int numRefinedVertices() const { return offsets.size() - 1; }
+  inline const CompactMesh& getRefinedMesh() const { return refinedMesh; }
+  qint64 memoryFootprint() const;
+
+ private:
+  void composeLevel(const CompactMesh& mesh);
+
+  int controlVertexCount;
+  int levels;
+
+  // Stencil of refined vertex i: indices / weights [offsets[i], offsets[i+1])
+  QVector<int> offsets;
+  QVector<int> indices;
+  QVector<float> weights;
+
+  // Topology of the finest level
+  CompactMesh refinedMesh;
+};
+
+#endif  // STENCIL_TABLE_H
@@ -0,0 +1,352 @@
+#include "streamingsubdivider.h"
+
+#include <limits.h>
+
+#include <QDebug>
+
+#include "util/profiler.h"
+
+/**
+ * @brief The StreamingSubdivider::Batch struct is a batch of control faces and
+ * its ring, refined to some level. Besides the mesh, it holds the index every
+ * element has in the whole level and the control faces that decide which
+ * batch writes a vertex.
+ */
+struct StreamingSubdivider::Batch {
+  CompactMesh mesh;
+  // Indices in the whole level
+  QVector<qint64> vertexIds;
+  QVector<qint64> halfEdgeIds;
+  QVector<qint64> edgeIds;
+  QVector<qint64> faceIds;
+  // The first control face touching the control element a vertex or edge
+  // descends from; the batch of that face writes the vertex
+  QVector<int> vertexOwners;
+  QVector<int> edgeOwners;
+  // The control face every face descends from
+  QVector<int> rootFaces;
+
+  // Kept between batches, so their storage is reused
+  Mesh limitMesh;
+  QVector<QVector3D> positions;
+  QVector<QVector3D> normals;
+  QVector<quint32> chunkIndices;
+  QVector<QVector3D> chunkPositions;
+  QVector<QVector3D> chunkNormals;
+  QVector<quint32> chunkQuads;
+};
+
+/**
+ * @brief StreamingSubdivider::StreamingSubdivider Creates a new streaming
+ * subdivider.
+ * @param level The number of subdivision steps. At least 1, so the written
+ * mesh always consists of quads.
+ * @param batchFaces The number of faces of the target level refined at once.
+ * A batch holds at least one control face, and additionally its ring.
+ */
+StreamingSubdivider::StreamingSubdivider(int level, int batchFaces)
+    : level(qMax(1, level)), batchFaces(qMax(1, batchFaces)) {}
+
+/**
+ * @brief StreamingSubdivider::subdivide Subdivides a mesh and writes the
+ * result, see subdivide below.
+ * @param controlMesh The control mesh.
+ * @param writer The writer of the output file.
+ * @param limitPositions Whether the limit positions of the vertices are
+ * written instead of their positions at the target level.
+ * @param normals Whether the limit normals are written as well. Only used with
+ * limit positions.
+ * @return False if the file could not be written.
+ */
+bool StreamingSubdivider::subdivide(Mesh& controlMesh, MeshStreamWriter& writer,
+                                    bool limitPositions, bool normals) const {
+  return subdivide(CompactMesh::fromMesh(controlMesh), writer, limitPositions,
+                   normals);
+}
+
+/**
+ * @brief StreamingSubdivider::subdivide Subdivides a mesh to the target level
+ * batch by batch and writes every batch as a chunk.
+ * @param controlMesh The control mesh.
+ * @param writer The writer of the output file. It is opened and closed here.
+ * @param limitPositions Whether the limit positions of the vertices are
+ * written instead of their positions at the target level, see
+ * Mesh::evaluateLimit.
+ * @param normals Whether the limit normals are written as well. Only used with
+ * limit positions.
+ * @return False if the file could not be written.
+ */
+bool StreamingSubdivider::subdivide(const CompactMesh& controlMesh,
+                                    MeshStreamWriter& writer,
+                                    bool limitPositions, bool normals) const {
+  ProfileScope scope("StreamingSubdivider::subdivide");
+  const QVector<int>& origins = controlMesh.getOrigins();
+  const QVector<int>& edges = controlMesh.getEdges();
+  const int numVerts = controlMesh.numVerts();
+  const int numFaces = controlMesh.numFaces();
+
+  // The faces around every vertex, and the first face around every vertex and
+  // edge
+  QVector<int> vertexFaceOffsets(numVerts + 1, 0);
+  QVector<int> vertexOwners(numVerts, INT_MAX);
+  QVector<int> edgeOwners(controlMesh.numEdges(), INT_MAX);
+  for (int f = 0; f < numFaces; f++) {
+    int side = controlMesh.faceSide(f);
+    for (int k = 0; k < controlMesh.faceValence(f); k++) {
+      int h = side + k;
+      vertexFaceOffsets[origins[h] + 1]++;
+      vertexOwners[origins[h]] = qMin(vertexOwners[origins[h]], f);
+      edgeOwners[edges[h]] = qMin(edgeOwners[edges[h]], f);
+    }
+  }
+  for (int v = 0; v < numVerts; v++) {
+    vertexFaceOffsets[v + 1] += vertexFaceOffsets[v];
+  }
+  QVector<int> vertexFaces(controlMesh.numHalfEdges());
+  QVector<int> cursor = vertexFaceOffsets;
+  for (int f = 0; f < numFaces; f++) {
+    int side = controlMesh.faceSide(f);
+    for (int k = 0; k < controlMesh.faceValence(f); k++) {
+      vertexFaces[cursor[origins[side + k]]++] = f;
+    }
+  }
+
+  // Sizes of every level of the whole mesh
+  QVector<qint64> levelVerts(level + 1);
+  QVector<qint64> levelFaces(level + 1);
+  QVector<qint64> levelEdges(level + 1);
+  qint64 numHalfEdges = controlMesh.numHalfEdges();
+  levelVerts[0] = numVerts;
+  levelFaces[0] = numFaces;
+  levelEdges[0] = controlMesh.numEdges();
+  for (int k = 0; k < level; k++) {
+    levelVerts[k + 1] = levelVerts[k] + levelFaces[k] + levelEdges[k];
+    levelFaces[k + 1] = numHalfEdges;
+    levelEdges[k + 1] = 2 * levelEdges[k] + numHalfEdges;
+    numHalfEdges *= 4;
+  }
+  if (!writer.open(level, levelVerts[level], levelFaces[level], limitPositions,
+                   limitPositions && normals)) {
+    qWarning() << ":: Could not open the output of streaming subdivision";
+    return false;
+  }
+
+  // Every control face becomes valence * 4^(level - 1) faces
+  const qint64 facesPerSide = qint64(1) << (2 * (level - 1));
+  // The limit normals of vertices that are not smooth are taken from the limit
+  // positions of their neighbours, which need a second ring
+  const int numRings = writer.hasNormals() ? 2 : 1;
+  QVector<int> faceStamps(numFaces, -1);
+  QVector<int> faces;
+  Batch batch;
+  int numBatches = 0;
+  for (int begin = 0, end = 0; begin < numFaces; begin = end) {
+    qint64 size = 0;
+    while (end < numFaces &&
+           (end == begin || size + controlMesh.faceValence(end) *
+                                       facesPerSide <= batchFaces)) {
+      size += controlMesh.faceValence(end) * facesPerSide;
+      end++;
+    }
+
+    // The batch, followed by the rings of faces around its vertices
+    faces.clear();
+    for (int f = begin; f < end; f++) {
+      faces.append(f);
+      faceStamps[f] = begin;
+    }
+    for (int ring = 0, first = 0; ring < numRings; ring++) {
+      const int last = faces.size();
+      for (int j = first; j < last; j++) {
+        int side = controlMesh.faceSide(faces[j]);
+        for (int k = 0; k < controlMesh.faceValence(faces[j]); k++) {
+          int v = origins[side + k];
+          for (int i = vertexFaceOffsets[v]; i < vertexFaceOffsets[v + 1];
+               i++) {
+            if (faceStamps[vertexFaces[i]] != begin) {
+              faceStamps[vertexFaces[i]] = begin;
+              faces.append(vertexFaces[i]);
+            }
+          }
+        }
+      }
+      first = last;
+    }
+
+    batch.mesh = controlMesh.extractSubmesh(faces);
+    const CompactMesh& submesh = batch.mesh;
+    batch.vertexIds.resize(submesh.numVerts());
+    batch.vertexOwners.resize(submesh.numVerts());
+    batch.halfEdgeIds.resize(submesh.numHalfEdges());
+    batch.edgeIds.resize(submesh.numEdges());
+    batch.edgeOwners.resize(submesh.numEdges());
+    batch.faceIds.resize(submesh.numFaces());
+    batch.rootFaces.resize(submesh.numFaces());
+    for (int i = 0; i < faces.size(); i++) {
+      int side = controlMesh.faceSide(faces[i]);
+      int subSide = submesh.faceSide(i);
+      for (int k = 0; k < controlMesh.faceValence(faces[i]); k++) {
+        int h = side + k;
+        int v = submesh.getOrigins()[subSide + k];
+        int e = submesh.getEdges()[subSide + k];
+        batch.vertexIds[v] = origins[h];
+        batch.vertexOwners[v] = vertexOwners[origins[h]];
+        batch.halfEdgeIds[subSide + k] = h;
+        batch.edgeIds[e] = edges[h];
+        batch.edgeOwners[e] = edgeOwners[edges[h]];
+      }
+      batch.faceIds[i] = faces[i];
+      batch.rootFaces[i] = faces[i];
+    }
+
+    for (int k = 0; k < level; k++) {
+      refine(batch, levelVerts[k], levelFaces[k], levelEdges[k]);
+    }
+    if (!write(batch, begin, end, writer, limitPositions)) {
+      qWarning() << ":: Could not write the output of streaming subdivision";
+      return false;
+    }
+    numBatches++;
+  }
+
+  qDebug() << ":: Streamed level" << level << "with" << levelFaces[level]
+           << "faces in" << numBatches << "batches";
+  return writer.close();
+}
+
+/**
+ * @brief StreamingSubdivider::refine Subdivides a batch once and derives the
+ * indices its new elements have in the whole level from the indices of their
+ * parents, using the indexing rules of CatmullClarkSubdivider. The rules that
+ * compare half-edge indices compare the indices in the whole level. Elements
+ * on the outer border of the batch may get wrong indices, since their twins
+ * are missing, but they are never written.
+ * @param batch The batch.
+ * @param numVerts Number of vertices of the whole level of the batch.
+ * @param numFaces Number of faces of the whole level.
+ * @param numEdges Number of edges of the whole level.
+ */
+void StreamingSubdivider::refine(Batch& batch, qint64 numVerts,
+                                 qint64 numFaces, qint64 numEdges) const {
+  const CompactMesh& mesh = batch.mesh;
+  CompactMesh newMesh = subdivider.subdivide(mesh);
+  const int subNumVerts = mesh.numVerts();
+  const int subNumFaces = mesh.numFaces();
+  const int subNumEdges = mesh.numEdges();
+  const int subNumHalfEdges = mesh.numHalfEdges();
+  const QVector<int>& twins = mesh.getTwins();
+  const QVector<int>& edges = mesh.getEdges();
+  const QVector<int>& newEdges = newMesh.getEdges();
+
+  // Vertex points, face points and edge points, in that order
+  QVector<qint64> vertexIds(newMesh.numVerts());
+  QVector<int> vertexOwners(newMesh.numVerts());
+#pragma omp parallel for schedule(static)
+  for (int v = 0; v < subNumVerts; v++) {
+    vertexIds[v] = batch.vertexIds[v];
+    vertexOwners[v] = batch.vertexOwners[v];
+  }
+#pragma omp parallel for schedule(static)
+  for (int f = 0; f < subNumFaces; f++) {
+    vertexIds[subNumVerts + f] = numVerts + batch.faceIds[f];
+    vertexOwners[subNumVerts + f] = batch.rootFaces[f];
+  }
+#pragma omp parallel for schedule(static)
+  for (int e = 0; e < subNumEdges; e++) {
+    vertexIds[subNumVerts + subNumFaces + e] =
+        numVerts + numFaces + batch.edgeIds[e];
+    vertexOwners[subNumVerts + subNumFaces + e] = batch.edgeOwners[e];
+  }
+
+  QVector<qint64> halfEdgeIds(newMesh.numHalfEdges());
+  QVector<qint64> edgeIds(newMesh.numEdges());
+  QVector<int> edgeOwners(newMesh.numEdges());
+  QVector<qint64> faceIds(newMesh.numFaces());
+  QVector<int> rootFaces(newMesh.numFaces());
+#pragma omp parallel for schedule(static)
+  for (int h = 0; h < subNumHalfEdges; h++) {
+    const qint64 id = batch.halfEdgeIds[h];
+    const int twin = twins[h];
+    const int e = edges[h];
+    const int root = batch.rootFaces[mesh.face(h)];
+    const int c = 4 * h;
+    for (int k = 0; k < 4; k++) {
+      halfEdgeIds[c + k] = 4 * id + k;
+    }
+    // The children of half-edge h form face h
+    faceIds[h] = id;
+    rootFaces[h] = root;
+
+    // Every half-edge writes the child edge along it and the edge to the face
+    // point, like the topology refinement
+    const bool first = twin < 0 || id > batch.halfEdgeIds[twin];
+    edgeIds[newEdges[c]] = 2 * batch.edgeIds[e] + (first ? 0 : 1);
+    edgeOwners[newEdges[c]] = batch.edgeOwners[e];
+    edgeIds[newEdges[c + 1]] = 2 * numEdges + id;
+    edgeOwners[newEdges[c + 1]] = root;
+    if (twin < 0) {
+      // No twin to write the other half of a boundary edge
+      edgeIds[2 * e + 1] = 2 * batch.edgeIds[e] + 1;
+      edgeOwners[2 * e + 1] = batch.edgeOwners[e];
+    }
+  }
+
+  batch.mesh = newMesh;
+  batch.vertexIds.swap(vertexIds);
+  batch.vertexOwners.swap(vertexOwners);
+  batch.halfEdgeIds.swap(halfEdgeIds);
+  batch.edgeIds.swap(edgeIds);
+  batch.edgeOwners.swap(edgeOwners);
+  batch.faceIds.swap(faceIds);
+  batch.rootFaces.swap(rootFaces);
+}
+
+/**
+ * @brief StreamingSubdivider::write Writes the vertices and faces a refined
+ * batch is responsible for as a chunk: the faces that descend from the batch
+ * and the vertices owned by it.
+ * @param batch The batch, refined to the target level.
+ * @param begin First control face of the batch.
+ * @param end One past the last control face of the batch.
+ * @param writer The writer of the output file.
+ * @param limitPositions Whether the limit positions are written.
+ * @return False if writing failed.
+ */
+bool StreamingSubdivider::write(Batch& batch, int begin, int end,
+                                MeshStreamWriter& writer,
+                                bool limitPositions) const {
+  const CompactMesh& mesh = batch.mesh;
+  if (limitPositions) {
+    mesh.toMesh(batch.limitMesh);
+    batch.limitMesh.evaluateLimit(
+        batch.positions, writer.hasNormals() ? &batch.normals : nullptr);
+  } else {
+    batch.positions = mesh.interleavedPositions();
+  }
+
+  batch.chunkIndices.clear();
+  batch.chunkPositions.clear();
+  batch.chunkNormals.clear();
+  batch.chunkQuads.clear();
+  for (int v = 0; v < mesh.numVerts(); v++) {
+    int owner = batch.vertexOwners[v];
+    if (owner >= begin && owner < end) {
+      batch.chunkIndices.append(quint32(batch.vertexIds[v]));
+      batch.chunkPositions.append(batch.positions[v]);
+      if (writer.hasNormals()) {
+        batch.chunkNormals.append(batch.normals[v]);
+      }
+    }
+  }
+  const QVector<int>& origins = mesh.getOrigins();
+  for (int f = 0; f < mesh.numFaces(); f++) {
+    int root = batch.rootFaces[f];
+    if (root >= begin && root < end) {
+      for (int k = 0; k < 4; k++) {
+        batch.chunkQuads.append(quint32(batch.vertexIds[origins[4 * f + k]]));
+      }
+    }
+  }
+  return writer.writeChunk(batch.chunkIndices, batch.chunkPositions,
+                           batch.chunkNormals, batch.chunkQuads);
+}
@@ -0,0 +1,55 @@
+#ifndef STREAMING_SUBDIVIDER_H
+#define STREAMING_SUBDIVIDER_H
+
+#include "initialization/meshstreamwriter.h"
+#include "mesh/compactmesh.h"
+#include "mesh/mesh.h"
+#include "subdivision/compactsubdivider.h"
+
+// Faces of the target level refined per batch
+#define STREAMING_DEFAULT_BATCH_FACES (1 << 20)
+
+/**
+ * @brief The StreamingSubdivider class subdivides a mesh to a level that does
+ * not fit in memory and writes the result to a MeshStreamWriter. The faces of
+ * the control mesh are processed in batches of consecutive faces. Each batch
+ * is extracted together with the ring of faces around its vertices, refined to
+ * the target level on its own and written out. As in AdaptiveSubdivider, the
+ * ring makes everything that descends from the batch identical to uniform
+ * subdivision, so peak memory is set by the batch size instead of by the size
+ * of the level. Limit normals take a second ring.
+ *
+ * The written mesh has the vertex indices uniform subdivision would give it.
+ * While a batch is refined, it tracks the index in the whole level of each of
+ * its vertices, half-edges, edges and faces, following the indexing rules of
+ * CatmullClarkSubdivider. A vertex on the border between batches is written by
+ * the batch of the first control face it descends from or touches, so every
+ * vertex is written exactly once.
+ */
+class StreamingSubdivider {
+ public:
+  StreamingSubdivider(int level,
+                      int batchFaces = STREAMING_DEFAULT_BATCH_FACES);
+
+  bool subdivide(Mesh& controlMesh, MeshStreamWriter& writer,
+                 bool limitPositions, bool normals = false) const;
+  bool subdivide(const CompactMesh& controlMesh, MeshStreamWriter& writer,
+                 bool limitPositions, bool normals = false) const;
+
+  inline int getLevel() const { return level; }
+  inline int getBatchFaces() const { return batchFaces; }
+
+ private:
+  struct Batch;
+
+  void refine(Batch& batch, qint64 numVerts, qint64 numFaces,
+              qint64 numEdges) const;
+  bool write(Batch& batch, int begin, int end, MeshStreamWriter& writer,
+             bool limitPositions) const;
+
+  int level;
+  int batchFaces;
+  CompactCatmullClarkSubdivider subdivider;
+};
+
+#endif  // STREAMING_SUBDIVIDER_H
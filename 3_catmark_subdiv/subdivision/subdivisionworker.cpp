@@ -0,0 +1,197 @@
+#include "subdivisionworker.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
+#include "util/profiler.h"
+
+/**
+ * @brief SubdivisionWorker::SubdivisionWorker Creates a worker for the levels
+ * of a cache. Jobs run one at a time on a thread of their own; the subdivision
+ * steps themselves still use all cores.
+ * @param levels The cache the finished levels are adopted by. Must outlive the
+ * worker.
+ * @param parent Qt parent object.
+ */
+SubdivisionWorker::SubdivisionWorker(LevelCache& levels, QObject* parent)
+    : QObject(parent),
+      levels(levels),
+      meshCache(levels.getMeshCache()),
+      generation(0) {
+  pool.setMaxThreadCount(1);
+}
+
+/**
+ * @brief SubdivisionWorker::~SubdivisionWorker Cancels all jobs and waits for
+ * them to stop.
+ */
+SubdivisionWorker::~SubdivisionWorker() { cancelAndWait(); }
+
+/**
+ * @brief SubdivisionWorker::start Cancels the current request and starts
+ * generating the levels up to the given level, from the finest resident level
+ * below it.
+ * @param targetLevel The requested subdivision level.
+ * @param limitPositions Whether the attributes of the new levels are extracted
+ * at their limit positions, see Mesh::extractAttributes.
+ * @return False if the level is already resident, in which case no job is
+ * started.
+ */
+bool SubdivisionWorker::start(int targetLevel, bool limitPositions) {
+  cancel();
+  const int ancestorLevel = levels.residentAncestor(targetLevel);
+  if (ancestorLevel == targetLevel) {
+    return false;
+  }
+  Mesh& ancestor = levels.level(ancestorLevel);
+  // Otherwise the job would classify it while the GUI may read it
+  if (!ancestor.isClassified()) {
+    ancestor.classifyVertices();
+  }
+
+  Request request;
+  request.generation = generation;
+  request.ancestor = &ancestor;
+  request.ancestorLevel = ancestorLevel;
+  request.ancestorKey = levels.key(ancestorLevel);
+  request.targetLevel = targetLevel;
+  request.limitPositions = limitPositions;
+  MeshPool::Sizes sizes = MeshPool::Sizes::of(ancestor);
+  for (int k = ancestorLevel + 1; k <= targetLevel; k++) {
+    sizes = sizes.subdivided();
+    request.storage.append(levels.acquire(sizes));
+  }
+
+  Job job;
+  job.parentLevel = ancestorLevel;
+  job.limitPositions = limitPositions;
+  job.unposted = request.storage;
+  levels.lock(ancestorLevel);
+  jobs.insert(request.generation, job);
+  pool.start([this, request]() { run(request); });
+  return true;
+}
+
+/**
+ * @brief SubdivisionWorker::cancel Cancels all jobs without waiting for them.
+ * Their levels are discarded as they come in.
+ */
+void SubdivisionWorker::cancel() { generation++; }
+
+/**
+ * @brief SubdivisionWorker::cancelAndWait Cancels all jobs and waits for them
+ * to stop, after which no level of the cache is used by the worker. Needed
+ * before levels are modified or deleted.
+ */
+void SubdivisionWorker::cancelAndWait() {
+  cancel();
+  pool.waitForDone();
+  collectResults();
+}
+
+/**
+ * @brief SubdivisionWorker::run Runs a job on the worker thread: generates
+ * every level from the ancestor up to the target level, one step at a time,
+ * loading levels from the MeshCache where possible, and posts each of them
+ * with its attributes extracted. Stops early once the job is cancelled; the
+ * storage of the levels it did not post is recycled by collectResults.
+ * @param request The request of the job.
+ */
+void SubdivisionWorker::run(const Request& request) {
+  Mesh* parent = request.ancestor;
+  QByteArray key = request.ancestorKey;
+  for (int k = request.ancestorLevel + 1;
+       k <= request.targetLevel && !isCancelled(request.generation); k++) {
+    Profiler::setLevel(k);
+    key = MeshCache::nextLevelKey(key, *parent);
+    Mesh* mesh = request.storage[k - request.ancestorLevel - 1];
+    if (meshCache.load(key, *mesh)) {
+      mesh->classifyVertices();
+    } else {
+      QElapsedTimer timer;
+      timer.start();
+      subdivider.subdivide(*parent, *mesh);
+      if (isCancelled(request.generation)) {
+        break;
+      }
+      if (MeshCache::isWorthStoring(timer.elapsed())) {
+        meshCache.store(key, *mesh);
+      }
+    }
+    mesh->extractAttributes(request.limitPositions);
+
+    Result result;
+    result.generation = request.generation;
+    result.level = k;
+    result.mesh = mesh;
+    result.key = key;
+    result.done = false;
+    post(result);
+    // From here on, the GUI thread may read the mesh as well, but both only
+    // read its topology and positions
+    parent = mesh;
+  }
+
+  Result done;
+  done.generation = request.generation;
+  done.level = -1;
+  done.mesh = nullptr;
+  done.done = true;
+  post(done);
+}
+
+/**
+ * @brief SubdivisionWorker::post Queues a result for the GUI thread. Called on
+ * the worker thread.
+ * @param result The result.
+ */
+void SubdivisionWorker::post(const Result& result) {
+  QMutexLocker locker(&mutex);
+  results.append(result);
+  if (results.size() == 1) {
+    QMetaObject::invokeMethod(this, &SubdivisionWorker::collectResults,
+                              Qt::QueuedConnection);
+  }
+}
+
+/**
+ * @brief SubdivisionWorker::collectResults Takes over the results posted by
+ * the jobs. Levels of the current request are adopted by the cache and locked
+ * for as long as the job subdivides them; others are kept until their job is
+ * done, since it may still read them, and then recycled.
+ */
+void SubdivisionWorker::collectResults() {
+  QVector<Result> collected;
+  {
+    QMutexLocker locker(&mutex);
+    collected.swap(results);
+  }
+  for (const Result& result : collected) {
+    Job& job = jobs[result.generation];
+    // The job no longer reads its previous level
+    if (job.parentLevel >= 0) {
+      levels.unlock(job.parentLevel);
+      job.parentLevel = -1;
+    }
+    if (result.done) {
+      for (Mesh* mesh : job.retired) {
+        levels.recycle(mesh);
+      }
+      for (Mesh* mesh : job.unposted) {
+        levels.recycle(mesh);
+      }
+      jobs.remove(result.generation);
+      continue;
+    }
+    job.unposted.removeAt(job.unposted.indexOf(result.mesh));
+    if (!isCancelled(result.generation) &&
+        levels.adopt(result.level, result.mesh, result.key)) {
+      levels.lock(result.level);
+      job.parentLevel = result.level;
+      emit levelFinished(result.level, job.limitPositions);
+    } else {
+      job.retired.append(result.mesh);
+    }
+  }
+}
@@ -0,0 +1,113 @@
+#ifndef SUBDIVISION_WORKER_H
+#define SUBDIVISION_WORKER_H
+
+#include <QByteArray>
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QThreadPool>
+#include <QVector>
+#include <atomic>
+
+#include "initialization/meshcache.h"
+#include "mesh/mesh.h"
+#include "subdivision/catmullclarksubdivider.h"
+#include "subdivision/levelcache.h"
+
+/**
+ * @brief The SubdivisionWorker class generates the levels of a LevelCache on a
+ * background thread, so the window stays responsive while deep levels are
+ * computed. Every finished level is handed back to the GUI thread, adopted by
+ * the cache and announced with levelFinished, so the levels can be shown as
+ * they complete. Starting a new request cancels the previous one: a cancelled
+ * job stops after the subdivision step it is working on and its levels are
+ * discarded.
+ *
+ * A job only reads the resident level it starts from and the levels it
+ * generated itself, which stay locked in the cache while the job uses them.
+ * Everything else a job needs, such as whether it extracts limit positions, is
+ * part of its request, so jobs share no state with the GUI or with each other.
+ * The attributes of every level are extracted on the worker thread; only the
+ * upload of the buffers is left to the GUI thread, which owns the OpenGL
+ * context. The storage of the levels is taken from the cache before the job
+ * starts, see LevelCache::acquire, so jobs do not allocate and levels that
+ * are not adopted are recycled.
+ *
+ * All functions must be called on the GUI thread.
+ */
+class SubdivisionWorker : public QObject {
+  Q_OBJECT
+
+ public:
+  explicit SubdivisionWorker(LevelCache& levels, QObject* parent = nullptr);
+  ~SubdivisionWorker() override;
+
+  bool start(int targetLevel, bool limitPositions);
+  void cancel();
+  void cancelAndWait();
+  inline bool isBusy() const { return !jobs.isEmpty(); }
+
+ signals:
+  // The level is resident in the cache and its attributes are extracted
+  void levelFinished(int level, bool limitPositions);
+
+ private:
+  /**
+   * @brief The Request struct is everything a job reads. The ancestor stays
+   * locked in the cache and unmodified until the job is done.
+   */
+  struct Request {
+    int generation;
+    Mesh* ancestor;
+    int ancestorLevel;
+    QByteArray ancestorKey;
+    int targetLevel;
+    bool limitPositions;
+    // Empty meshes the levels are written into, one per level from the first
+    // level after the ancestor
+    QVector<Mesh*> storage;
+  };
+
+  /**
+   * @brief The Result struct is a level finished by a job, or the end of the
+   * job if done is set.
+   */
+  struct Result {
+    int generation;
+    int level;
+    Mesh* mesh;
+    QByteArray key;
+    bool done;
+  };
+
+  /**
+   * @brief The Job struct is the bookkeeping of a job on the GUI thread.
+   */
+  struct Job {
+    // The locked level the job currently subdivides, or -1
+    int parentLevel = -1;
+    bool limitPositions = false;
+    // Levels that were not adopted and storage the job did not post, recycled
+    // once the job is done
+    QVector<Mesh*> retired;
+    QVector<Mesh*> unposted;
+  };
+
+  void run(const Request& request);
+  void post(const Result& result);
+  void collectResults();
+  inline bool isCancelled(int job) const { return job != generation; }
+
+  LevelCache& levels;
+  MeshCache meshCache;
+  CatmullClarkSubdivider subdivider;
+  QThreadPool pool;
+  // Generation of the current request; older jobs are cancelled
+  std::atomic<int> generation;
+  // Guards results, which the jobs append to
+  QMutex mutex;
+  QVector<Result> results;
+  QMap<int, Job> jobs;
+};
+
+#endif  // SUBDIVISION_WORKER_H
@@ -0,0 +1,288 @@
+#include "pointkernels.h"
+
+#include "simd.h"
+
+#if defined(SIMD_HAVE_SSE2)
+#include <emmintrin.h>
+#elif defined(SIMD_HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "pointkernelsimpl.h"
+
+#if defined(CATMARK_AVX2_KERNELS)
+// Defined in pointkernelsavx2.cpp, which is compiled for AVX2
+void quadFacePointsAvx2(const QuadMeshStreams& mesh, int begin, int end,
+                        PointStreams facePoints);
+void quadEdgePointsAvx2(const QuadMeshStreams& mesh,
+                        ConstPointStreams facePoints, int begin, int end,
+                        PointStreams edgePoints);
+void combineVertexPointsAvx2(const VertexPointTerms& terms, int count,
+                             PointStreams vertexPoints);
+void pointBoundsAvx2(const float* points, int count, float minimum[3],
+                     float maximum[3]);
+void scalePointsAvx2(float* points, int count, float scale);
+#endif
+
+namespace {
+
+#if defined(SIMD_HAVE_SSE2)
+/**
+ * @brief The Sse2Vector struct is the vector type of four lanes for SSE2. SSE2
+ * has no gather, so gathers load the lanes one by one.
+ */
+struct Sse2Vector {
+  typedef __m128 F;
+  typedef __m128i I;
+  typedef __m128 M;
+  static const int width = 4;
+
+  static inline F load(const float* p) { return _mm_loadu_ps(p); }
+  static inline void store(float* p, F v) { _mm_storeu_ps(p, v); }
+  static inline F set(float v) { return _mm_set1_ps(v); }
+  static inline F add(F a, F b) { return _mm_add_ps(a, b); }
+  static inline F sub(F a, F b) { return _mm_sub_ps(a, b); }
+  static inline F mul(F a, F b) { return _mm_mul_ps(a, b); }
+  static inline F div(F a, F b) { return _mm_div_ps(a, b); }
+  static inline F min(F a, F b) { return _mm_min_ps(a, b); }
+  static inline F max(F a, F b) { return _mm_max_ps(a, b); }
+  static inline F truncate(F v) {
+    return _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+  }
+  static inline F gather(const float* base, I index) {
+    alignas(16) int i[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(i), index);
+    return _mm_setr_ps(base[i[0]], base[i[1]], base[i[2]], base[i[3]]);
+  }
+
+  static inline I loadInt(const int* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  }
+  static inline void storeInt(int* p, I v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+  }
+  static inline I setInt(int v) { return _mm_set1_epi32(v); }
+  static inline I ramp(int first) {
+    return _mm_add_epi32(_mm_set1_epi32(first), _mm_setr_epi32(0, 1, 2, 3));
+  }
+  static inline I shiftRight2(I v) { return _mm_srai_epi32(v, 2); }
+  static inline void loadQuads(const int* p, I quads[4]) {
+    __m128 rows[4];
+    for (int k = 0; k < 4; k++) {
+      rows[k] = _mm_castsi128_ps(loadInt(p + 4 * k));
+    }
+    _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+    for (int k = 0; k < 4; k++) {
+      quads[k] = _mm_castps_si128(rows[k]);
+    }
+  }
+  static inline F nextInQuad(F values, const float*, const int*, int) {
+    return _mm_shuffle_ps(values, values, _MM_SHUFFLE(0, 3, 2, 1));
+  }
+  static inline F perFace(const float* facePoints, int h) {
+    return _mm_set1_ps(facePoints[h >> 2]);
+  }
+
+  static inline M lessInt(I a, I b) {
+    return _mm_castsi128_ps(_mm_cmplt_epi32(a, b));
+  }
+  static inline M equal(F a, F b) { return _mm_cmpeq_ps(a, b); }
+  static inline M greater(F a, F b) { return _mm_cmpgt_ps(a, b); }
+  static inline M orMask(M a, M b) { return _mm_or_ps(a, b); }
+  static inline int bits(M m) { return _mm_movemask_ps(m); }
+  static inline F select(M m, F a, F b) {
+    return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+  }
+  static inline I selectInt(M m, I a, I b) {
+    return _mm_castps_si128(
+        select(m, _mm_castsi128_ps(a), _mm_castsi128_ps(b)));
+  }
+};
+typedef Sse2Vector NativeVector;
+#elif defined(SIMD_HAVE_NEON)
+/**
+ * @brief The NeonVector struct is the vector type of four lanes for AArch64
+ * NEON. NEON has no gather, so gathers load the lanes one by one.
+ */
+struct NeonVector {
+  typedef float32x4_t F;
+  typedef int32x4_t I;
+  typedef uint32x4_t M;
+  static const int width = 4;
+
+  static inline F load(const float* p) { return vld1q_f32(p); }
+  static inline void store(float* p, F v) { vst1q_f32(p, v); }
+  static inline F set(float v) { return vdupq_n_f32(v); }
+  static inline F add(F a, F b) { return vaddq_f32(a, b); }
+  static inline F sub(F a, F b) { return vsubq_f32(a, b); }
+  static inline F mul(F a, F b) { return vmulq_f32(a, b); }
+  static inline F div(F a, F b) { return vdivq_f32(a, b); }
+  static inline F min(F a, F b) { return vminq_f32(a, b); }
+  static inline F max(F a, F b) { return vmaxq_f32(a, b); }
+  static inline F truncate(F v) { return vrndq_f32(v); }
+  static inline F gather(const float* base, I index) {
+    alignas(16) float lanes[4] = {
+        base[vgetq_lane_s32(index, 0)], base[vgetq_lane_s32(index, 1)],
+        base[vgetq_lane_s32(index, 2)], base[vgetq_lane_s32(index, 3)]};
+    return vld1q_f32(lanes);
+  }
+
+  static inline I loadInt(const int* p) { return vld1q_s32(p); }
+  static inline void storeInt(int* p, I v) { vst1q_s32(p, v); }
+  static inline I setInt(int v) { return vdupq_n_s32(v); }
+  static inline I ramp(int first) {
+    alignas(16) const int offsets[4] = {0, 1, 2, 3};
+    return vaddq_s32(vdupq_n_s32(first), vld1q_s32(offsets));
+  }
+  static inline I shiftRight2(I v) { return vshrq_n_s32(v, 2); }
+  static inline void loadQuads(const int* p, I quads[4]) {
+    int32x4x4_t rows = vld4q_s32(p);
+    for (int k = 0; k < 4; k++) {
+      quads[k] = rows.val[k];
+    }
+  }
+  static inline F nextInQuad(F values, const float*, const int*, int) {
+    return vextq_f32(values, values, 1);
+  }
+  static inline F perFace(const float* facePoints, int h) {
+    return vdupq_n_f32(facePoints[h >> 2]);
+  }
+
+  static inline M lessInt(I a, I b) { return vcltq_s32(a, b); }
+  static inline M equal(F a, F b) { return vceqq_f32(a, b); }
+  static inline M greater(F a, F b) { return vcgtq_f32(a, b); }
+  static inline M orMask(M a, M b) { return vorrq_u32(a, b); }
+  static inline int bits(M m) {
+    alignas(16) const uint32_t weights[4] = {1, 2, 4, 8};
+    return int(vaddvq_u32(vandq_u32(m, vld1q_u32(weights))));
+  }
+  static inline F select(M m, F a, F b) { return vbslq_f32(m, a, b); }
+  static inline I selectInt(M m, I a, I b) { return vbslq_s32(m, a, b); }
+};
+typedef NeonVector NativeVector;
+#else
+typedef ScalarVector NativeVector;
+#endif
+
+}  // namespace
+
+/**
+ * @brief quadFacePoints Computes the face points of a range of faces of a quad
+ * mesh: the average of the four corners.
+ * @param mesh The quad mesh.
+ * @param begin First face.
+ * @param end One past the last face.
+ * @param facePoints The face points, indexed by face.
+ */
+void quadFacePoints(const QuadMeshStreams& mesh, int begin, int end,
+                    PointStreams facePoints) {
+  switch (simdLevel()) {
+#if defined(CATMARK_AVX2_KERNELS)
+    case SIMD_AVX2:
+      quadFacePointsAvx2(mesh, begin, end, facePoints);
+      return;
+#endif
+    case SIMD_SCALAR:
+      quadFacePointsImpl<ScalarVector>(mesh, begin, end, facePoints);
+      return;
+    default:
+      quadFacePointsImpl<NativeVector>(mesh, begin, end, facePoints);
+  }
+}
+
+/**
+ * @brief quadEdgePoints Computes the edge points of the edges of a range of
+ * half-edges of a quad mesh, each by the half-edge of the edge with the larger
+ * index. Boundary and infinitely sharp edges use the midpoint M, smooth edges
+ * (M + F) / 2 with F the average of the adjacent face points, and semi-sharp
+ * edges blend both using the fractional sharpness.
+ * @param mesh The quad mesh.
+ * @param facePoints The face points of the mesh, indexed by face.
+ * @param begin First half-edge. Must be a multiple of 4.
+ * @param end One past the last half-edge. Must be a multiple of 4.
+ * @param edgePoints The edge points, indexed by edge.
+ */
+void quadEdgePoints(const QuadMeshStreams& mesh, ConstPointStreams facePoints,
+                    int begin, int end, PointStreams edgePoints) {
+  switch (simdLevel()) {
+#if defined(CATMARK_AVX2_KERNELS)
+    case SIMD_AVX2:
+      quadEdgePointsAvx2(mesh, facePoints, begin, end, edgePoints);
+      return;
+#endif
+    case SIMD_SCALAR:
+      quadEdgePointsImpl<ScalarVector>(mesh, facePoints, begin, end,
+                                       edgePoints);
+      return;
+    default:
+      quadEdgePointsImpl<NativeVector>(mesh, facePoints, begin, end,
+                                       edgePoints);
+  }
+}
+
+/**
+ * @brief combineVertexPoints Combines the terms gathered from the one-rings of
+ * a range of vertices into their vertex points, see VertexPointTerms.
+ * @param terms The terms, indexed from 0.
+ * @param count Number of vertices.
+ * @param vertexPoints The vertex points, indexed like the terms.
+ */
+void combineVertexPoints(const VertexPointTerms& terms, int count,
+                         PointStreams vertexPoints) {
+  switch (simdLevel()) {
+#if defined(CATMARK_AVX2_KERNELS)
+    case SIMD_AVX2:
+      combineVertexPointsAvx2(terms, count, vertexPoints);
+      return;
+#endif
+    case SIMD_SCALAR:
+      combineVertexPointsImpl<ScalarVector>(terms, 0, count, vertexPoints);
+      return;
+    default:
+      combineVertexPointsImpl<NativeVector>(terms, 0, count, vertexPoints);
+  }
+}
+
+/**
+ * @brief pointBounds Computes the bounding box of interleaved points.
+ * @param points The coordinates x, y, z of every point.
+ * @param count Number of points. Must be at least one.
+ * @param minimum Is set to the minimum coordinates.
+ * @param maximum Is set to the maximum coordinates.
+ */
+void pointBounds(const float* points, int count, float minimum[3],
+                 float maximum[3]) {
+  switch (simdLevel()) {
+#if defined(CATMARK_AVX2_KERNELS)
+    case SIMD_AVX2:
+      pointBoundsAvx2(points, count, minimum, maximum);
+      return;
+#endif
+    case SIMD_SCALAR:
+      pointBoundsImpl<ScalarVector>(points, count, minimum, maximum);
+      return;
+    default:
+      pointBoundsImpl<NativeVector>(points, count, minimum, maximum);
+  }
+}
+
+/**
+ * @brief scalePoints Scales interleaved points about the origin.
+ * @param points The coordinates x, y, z of every point.
+ * @param count Number of points.
+ * @param scale The scale factor.
+ */
+void scalePoints(float* points, int count, float scale) {
+  switch (simdLevel()) {
+#if defined(CATMARK_AVX2_KERNELS)
+    case SIMD_AVX2:
+      scalePointsAvx2(points, count, scale);
+      return;
+#endif
+    case SIMD_SCALAR:
+      scalePointsImpl<ScalarVector>(points, count, scale);
+      return;
+    default:
+      scalePointsImpl<NativeVector>(points, count, scale);
+  }
+}
@@ -0,0 +1,73 @@
+#ifndef POINT_KERNELS_H
+#define POINT_KERNELS_H
+
+/**
+ * The point kernels do the arithmetic of the subdivision rules and of the
+ * bounding box passes on packed float arrays, several points at a time. Each
+ * kernel is implemented once as a template over a vector type and compiled for
+ * every instruction set in simd.h; calls are dispatched to the active
+ * simdLevel. All instruction sets perform the same float operations in the
+ * same order as the scalar rules, so they produce the same points.
+ *
+ * The kernels are serial and work on a range of elements, so callers can split
+ * large arrays over threads.
+ */
+
+/**
+ * @brief The PointStreams struct refers to points stored as a structure of
+ * arrays, one float array per coordinate.
+ */
+struct PointStreams {
+  float* x;
+  float* y;
+  float* z;
+};
+
+/**
+ * @brief The ConstPointStreams struct is the read-only version of
+ * PointStreams.
+ */
+struct ConstPointStreams {
+  const float* x;
+  const float* y;
+  const float* z;
+};
+
+/**
+ * @brief The QuadMeshStreams struct refers to the arrays of a quad mesh in
+ * CompactMesh layout: the half-edges of face f are 4f to 4f + 3.
+ */
+struct QuadMeshStreams {
+  ConstPointStreams positions;
+  const int* origins;
+  const int* twins;  // -1 for boundary half-edges
+  const int* edges;
+  const float* sharpness;  // Per edge
+};
+
+/**
+ * @brief The VertexPointTerms struct holds the terms of the vertex points of a
+ * range of vertices, gathered from their one-rings. Each vertex point is
+ * (1 - blend) * C + blend * (Q / n + 2R / n + S(n - 3)) / n, where a blend of
+ * 0 gives C and a blend of 1 gives the smooth vertex point.
+ */
+struct VertexPointTerms {
+  ConstPointStreams S;  // Old positions
+  ConstPointStreams Q;  // Sums of the adjacent face points
+  ConstPointStreams R;  // Sums of the incident edge midpoints
+  ConstPointStreams C;  // Boundary, corner or crease points
+  const float* valence;
+  const float* blend;
+};
+
+void quadFacePoints(const QuadMeshStreams& mesh, int begin, int end,
+                    PointStreams facePoints);
+void quadEdgePoints(const QuadMeshStreams& mesh, ConstPointStreams facePoints,
+                    int begin, int end, PointStreams edgePoints);
+void combineVertexPoints(const VertexPointTerms& terms, int count,
+                         PointStreams vertexPoints);
+void pointBounds(const float* points, int count, float minimum[3],
+                 float maximum[3]);
+void scalePoints(float* points, int count, float scale);
+
+#endif  // POINT_KERNELS_H
@@ -0,0 +1,111 @@
+#include "pointkernels.h"
+
+// Compiled with AVX2 enabled when the compiler supports it; the kernels are
+// only called after simd.cpp detected AVX2 at runtime.
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+#include "pointkernelsimpl.h"
+
+namespace {
+
+/**
+ * @brief The Avx2Vector struct is the vector type of eight lanes for AVX2.
+ * Fused multiply-adds are not used, since they would round differently from
+ * the scalar rules.
+ */
+struct Avx2Vector {
+  typedef __m256 F;
+  typedef __m256i I;
+  typedef __m256 M;
+  static const int width = 8;
+
+  static inline F load(const float* p) { return _mm256_loadu_ps(p); }
+  static inline void store(float* p, F v) { _mm256_storeu_ps(p, v); }
+  static inline F set(float v) { return _mm256_set1_ps(v); }
+  static inline F add(F a, F b) { return _mm256_add_ps(a, b); }
+  static inline F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+  static inline F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+  static inline F div(F a, F b) { return _mm256_div_ps(a, b); }
+  static inline F min(F a, F b) { return _mm256_min_ps(a, b); }
+  static inline F max(F a, F b) { return _mm256_max_ps(a, b); }
+  static inline F truncate(F v) {
+    return _mm256_round_ps(v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+  }
+  static inline F gather(const float* base, I index) {
+    return _mm256_i32gather_ps(base, index, 4);
+  }
+
+  static inline I loadInt(const int* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  }
+  static inline void storeInt(int* p, I v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+  }
+  static inline I setInt(int v) { return _mm256_set1_epi32(v); }
+  static inline I ramp(int first) {
+    return _mm256_add_epi32(_mm256_set1_epi32(first),
+                            _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+  }
+  static inline I shiftRight2(I v) { return _mm256_srai_epi32(v, 2); }
+  static inline void loadQuads(const int* p, I quads[4]) {
+    const I stride = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+    for (int k = 0; k < 4; k++) {
+      quads[k] = _mm256_i32gather_epi32(p + k, stride, 4);
+    }
+  }
+  // Each 128-bit lane holds the half-edges of one face
+  static inline F nextInQuad(F values, const float*, const int*, int) {
+    return _mm256_permute_ps(values, _MM_SHUFFLE(0, 3, 2, 1));
+  }
+  static inline F perFace(const float* facePoints, int h) {
+    return _mm256_insertf128_ps(
+        _mm256_castps128_ps256(_mm_set1_ps(facePoints[h >> 2])),
+        _mm_set1_ps(facePoints[(h >> 2) + 1]), 1);
+  }
+
+  static inline M lessInt(I a, I b) {
+    return _mm256_castsi256_ps(_mm256_cmpgt_epi32(b, a));
+  }
+  static inline M equal(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+  static inline M greater(F a, F b) {
+    return _mm256_cmp_ps(a, b, _CMP_GT_OQ);
+  }
+  static inline M orMask(M a, M b) { return _mm256_or_ps(a, b); }
+  static inline int bits(M m) { return _mm256_movemask_ps(m); }
+  static inline F select(M m, F a, F b) { return _mm256_blendv_ps(b, a, m); }
+  static inline I selectInt(M m, I a, I b) {
+    return _mm256_castps_si256(_mm256_blendv_ps(
+        _mm256_castsi256_ps(b), _mm256_castsi256_ps(a), m));
+  }
+};
+
+}  // namespace
+
+void quadFacePointsAvx2(const QuadMeshStreams& mesh, int begin, int end,
+                        PointStreams facePoints) {
+  quadFacePointsImpl<Avx2Vector>(mesh, begin, end, facePoints);
+}
+
+void quadEdgePointsAvx2(const QuadMeshStreams& mesh,
+                        ConstPointStreams facePoints, int begin, int end,
+                        PointStreams edgePoints) {
+  quadEdgePointsImpl<Avx2Vector>(mesh, facePoints, begin, end, edgePoints);
+}
+
+void combineVertexPointsAvx2(const VertexPointTerms& terms, int count,
+                             PointStreams vertexPoints) {
+  combineVertexPointsImpl<Avx2Vector>(terms, 0, count, vertexPoints);
+}
+
+void pointBoundsAvx2(const float* points, int count, float minimum[3],
+                     float maximum[3]) {
+  pointBoundsImpl<Avx2Vector>(points, count, minimum, maximum);
+}
+
+void scalePointsAvx2(float* points, int count, float scale) {
+  scalePointsImpl<Avx2Vector>(points, count, scale);
+}
+
+#endif  // __AVX2__
@@ -0,0 +1,361 @@
+#ifndef POINT_KERNELS_IMPL_H
+#define POINT_KERNELS_IMPL_H
+
+#include "pointkernels.h"
+
+/**
+ * The templates of the point kernels, shared by pointkernels.cpp and the
+ * translation units compiled for wider instruction sets. Each of them includes
+ * this file once and instantiates the templates with its own vector types.
+ * Everything here lives in an anonymous namespace, so instantiations compiled
+ * with different instruction sets are never merged by the linker. For the same
+ * reason this file includes nothing but pointkernels.h.
+ *
+ * A vector type V has width lanes, where the width is 1 or a multiple of 4,
+ * and provides as static functions:
+ * - F, I and M: vectors of floats, of ints and a mask.
+ * - load, store, set, add, sub, mul, div, min, max and truncate on F.
+ * - gather(base, index), which loads base[index] into every lane.
+ * - loadInt, storeInt, setInt, ramp(first), giving first, first + 1, ..., and
+ *   shiftRight2 on I.
+ * - loadQuads(p, quads), which sets lane j of quads[k] to p[4j + k].
+ * - nextInQuad(values, base, origins, h): given values, the elements of base
+ *   at the origins of half-edges h to h + width - 1 of a quad mesh, gives the
+ *   elements at the origins of the half-edges that follow them. Here h is a
+ *   multiple of the width and of 4, so vectors can permute their lanes.
+ * - perFace(facePoints, h), which loads the face points of the faces of those
+ *   half-edges.
+ * - lessInt, equal, greater and orMask on M, bits, giving one bit per lane,
+ *   and select(mask, a, b) and selectInt, giving mask ? a : b per lane.
+ */
+
+namespace {
+
+/**
+ * @brief The ScalarVector struct is the vector type with a single lane. It is
+ * used on machines without SIMD and for the elements left over by the wider
+ * vector types.
+ */
+struct ScalarVector {
+  typedef float F;
+  typedef int I;
+  typedef bool M;
+  static const int width = 1;
+
+  static inline F load(const float* p) { return *p; }
+  static inline void store(float* p, F v) { *p = v; }
+  static inline F set(float v) { return v; }
+  static inline F add(F a, F b) { return a + b; }
+  static inline F sub(F a, F b) { return a - b; }
+  static inline F mul(F a, F b) { return a * b; }
+  static inline F div(F a, F b) { return a / b; }
+  static inline F min(F a, F b) { return a < b ? a : b; }
+  static inline F max(F a, F b) { return a > b ? a : b; }
+  static inline F truncate(F v) { return F(int(v)); }
+  static inline F gather(const float* base, I index) { return base[index]; }
+
+  static inline I loadInt(const int* p) { return *p; }
+  static inline void storeInt(int* p, I v) { *p = v; }
+  static inline I setInt(int v) { return v; }
+  static inline I ramp(int first) { return first; }
+  static inline I shiftRight2(I v) { return v >> 2; }
+  static inline void loadQuads(const int* p, I quads[4]) {
+    quads[0] = p[0];
+    quads[1] = p[1];
+    quads[2] = p[2];
+    quads[3] = p[3];
+  }
+  static inline F nextInQuad(F, const float* base, const int* origins, int h) {
+    // A single lane does not hold the rest of its face
+    return base[origins[h % 4 == 3 ? h - 3 : h + 1]];
+  }
+  static inline F perFace(const float* facePoints, int h) {
+    return facePoints[h >> 2];
+  }
+
+  static inline M lessInt(I a, I b) { return a < b; }
+  static inline M equal(F a, F b) { return a == b; }
+  static inline M greater(F a, F b) { return a > b; }
+  static inline M orMask(M a, M b) { return a || b; }
+  static inline int bits(M m) { return m ? 1 : 0; }
+  static inline F select(M m, F a, F b) { return m ? a : b; }
+  static inline I selectInt(M m, I a, I b) { return m ? a : b; }
+};
+
+/**
+ * @brief faceCoordinate Averages one coordinate of the corners of width
+ * faces.
+ * @param positions The coordinate of every vertex.
+ * @param corners The corners of the faces, see loadQuads.
+ * @return The coordinate of the face points.
+ */
+template <class V>
+inline typename V::F faceCoordinate(const float* positions,
+                                    const typename V::I corners[4]) {
+  typename V::F sum = V::add(V::gather(positions, corners[0]),
+                             V::gather(positions, corners[1]));
+  sum = V::add(sum, V::gather(positions, corners[2]));
+  sum = V::add(sum, V::gather(positions, corners[3]));
+  return V::mul(sum, V::set(0.25f));
+}
+
+/**
+ * @brief quadFacePointsImpl Computes the face points of faces begin to end of
+ * a quad mesh, see quadFacePoints.
+ */
+template <class V>
+void quadFacePointsImpl(const QuadMeshStreams& mesh, int begin, int end,
+                        PointStreams facePoints) {
+  int f = begin;
+  for (; f + V::width <= end; f += V::width) {
+    typename V::I corners[4];
+    V::loadQuads(mesh.origins + 4 * f, corners);
+    V::store(facePoints.x + f, faceCoordinate<V>(mesh.positions.x, corners));
+    V::store(facePoints.y + f, faceCoordinate<V>(mesh.positions.y, corners));
+    V::store(facePoints.z + f, faceCoordinate<V>(mesh.positions.z, corners));
+  }
+  if (V::width > 1 && f < end) {
+    quadFacePointsImpl<ScalarVector>(mesh, f, end, facePoints);
+  }
+}
+
+/**
+ * @brief The EdgeLanes struct holds what the edge points of width half-edges
+ * share between their coordinates.
+ */
+template <class V>
+struct EdgeLanes {
+  const int* originArray;
+  int h;
+  typename V::I origins;
+  typename V::I twinFaces;
+  typename V::F fractionalPart;
+  typename V::M sharp;
+  typename V::M semiSharp;
+};
+
+/**
+ * @brief edgeCoordinate Computes one coordinate of the edge points of width
+ * half-edges.
+ * @param lanes The half-edges.
+ * @param positions The coordinate of every vertex.
+ * @param facePoints The coordinate of every face point.
+ * @return The coordinate of the edge points.
+ */
+template <class V>
+inline typename V::F edgeCoordinate(const EdgeLanes<V>& lanes,
+                                    const float* positions,
+                                    const float* facePoints) {
+  typedef typename V::F F;
+  const F half = V::set(0.5f);
+  const F origin = V::gather(positions, lanes.origins);
+  const F next =
+      V::nextInQuad(origin, positions, lanes.originArray, lanes.h);
+  const F mid = V::mul(V::add(origin, next), half);
+  const F faceMid = V::mul(V::add(V::perFace(facePoints, lanes.h),
+                                  V::gather(facePoints, lanes.twinFaces)),
+                           half);
+  const F smooth = V::mul(V::add(mid, faceMid), half);
+  const F blended =
+      V::add(V::mul(V::sub(V::set(1.0f), lanes.fractionalPart), mid),
+             V::mul(lanes.fractionalPart, smooth));
+  return V::select(lanes.sharp, mid,
+                   V::select(lanes.semiSharp, blended, smooth));
+}
+
+/**
+ * @brief quadEdgePointsImpl Computes the edge points of the edges of
+ * half-edges begin to end of a quad mesh, see quadEdgePoints.
+ */
+template <class V>
+void quadEdgePointsImpl(const QuadMeshStreams& mesh,
+                        ConstPointStreams facePoints, int begin, int end,
+                        PointStreams edgePoints) {
+  typedef typename V::F F;
+  typedef typename V::I I;
+  typedef typename V::M M;
+  EdgeLanes<V> lanes;
+  lanes.originArray = mesh.origins;
+  int h = begin;
+  for (; h + V::width <= end; h += V::width) {
+    const I twins = V::loadInt(mesh.twins + h);
+    // Only once per undirected edge, by the half-edge with the larger index
+    const int owned = V::bits(V::lessInt(twins, V::ramp(h)));
+    if (owned == 0) {
+      continue;
+    }
+    const I edges = V::loadInt(mesh.edges + h);
+    const F s = V::gather(mesh.sharpness, edges);
+    const M boundary = V::lessInt(twins, V::setInt(0));
+    lanes.h = h;
+    lanes.origins = V::loadInt(mesh.origins + h);
+    // Boundary half-edges read their own face point, which is not used
+    lanes.twinFaces = V::selectInt(boundary, V::shiftRight2(V::ramp(h)),
+                                   V::shiftRight2(twins));
+    lanes.sharp = V::orMask(boundary, V::equal(s, V::set(-1.0f)));
+    lanes.semiSharp = V::greater(s, V::set(0.0f));
+    // Equal to the floor, since it is only used for positive sharpness
+    lanes.fractionalPart = V::sub(s, V::truncate(s));
+
+    alignas(32) float x[V::width];
+    alignas(32) float y[V::width];
+    alignas(32) float z[V::width];
+    alignas(32) int edgeIndices[V::width];
+    V::store(x, edgeCoordinate<V>(lanes, mesh.positions.x, facePoints.x));
+    V::store(y, edgeCoordinate<V>(lanes, mesh.positions.y, facePoints.y));
+    V::store(z, edgeCoordinate<V>(lanes, mesh.positions.z, facePoints.z));
+    V::storeInt(edgeIndices, edges);
+    // Edge points are scattered by edge index
+    for (int j = 0; j < V::width; j++) {
+      if (owned & (1 << j)) {
+        edgePoints.x[edgeIndices[j]] = x[j];
+        edgePoints.y[edgeIndices[j]] = y[j];
+        edgePoints.z[edgeIndices[j]] = z[j];
+      }
+    }
+  }
+  if (V::width > 1 && h < end) {
+    quadEdgePointsImpl<ScalarVector>(mesh, facePoints, h, end, edgePoints);
+  }
+}
+
+/**
+ * @brief vertexCoordinate Combines one coordinate of the terms of width
+ * vertices.
+ * @param S, Q, R, C The coordinate of the terms, see VertexPointTerms.
+ * @param n The valences.
+ * @param blend The weights of the smooth rule.
+ * @param fixed Lanes with a weight of 0.
+ * @param smoothOnly Lanes with a weight of 1.
+ * @return The coordinate of the vertex points.
+ */
+template <class V>
+inline typename V::F vertexCoordinate(typename V::F S, typename V::F Q,
+                                      typename V::F R, typename V::F C,
+                                      typename V::F n, typename V::F blend,
+                                      typename V::M fixed,
+                                      typename V::M smoothOnly) {
+  typedef typename V::F F;
+  // (Q / n + 2R / n + S(n - 3)) / n, in the order of the scalar rule
+  F smooth = V::add(V::div(Q, n), V::div(V::mul(V::set(2.0f), R), n));
+  smooth = V::div(V::add(smooth, V::mul(S, V::sub(n, V::set(3.0f)))), n);
+  const F blended = V::add(V::mul(V::sub(V::set(1.0f), blend), C),
+                           V::mul(blend, smooth));
+  return V::select(fixed, C, V::select(smoothOnly, smooth, blended));
+}
+
+/**
+ * @brief combineVertexPointsImpl Combines the terms of vertices begin to end
+ * into their vertex points, see combineVertexPoints.
+ */
+template <class V>
+void combineVertexPointsImpl(const VertexPointTerms& terms, int begin,
+                             int end, PointStreams vertexPoints) {
+  typedef typename V::F F;
+  typedef typename V::M M;
+  int v = begin;
+  for (; v + V::width <= end; v += V::width) {
+    const F n = V::load(terms.valence + v);
+    const F blend = V::load(terms.blend + v);
+    const M fixed = V::equal(blend, V::set(0.0f));
+    const M smoothOnly = V::equal(blend, V::set(1.0f));
+    V::store(vertexPoints.x + v,
+             vertexCoordinate<V>(V::load(terms.S.x + v),
+                                 V::load(terms.Q.x + v),
+                                 V::load(terms.R.x + v),
+                                 V::load(terms.C.x + v), n, blend, fixed,
+                                 smoothOnly));
+    V::store(vertexPoints.y + v,
+             vertexCoordinate<V>(V::load(terms.S.y + v),
+                                 V::load(terms.Q.y + v),
+                                 V::load(terms.R.y + v),
+                                 V::load(terms.C.y + v), n, blend, fixed,
+                                 smoothOnly));
+    V::store(vertexPoints.z + v,
+             vertexCoordinate<V>(V::load(terms.S.z + v),
+                                 V::load(terms.Q.z + v),
+                                 V::load(terms.R.z + v),
+                                 V::load(terms.C.z + v), n, blend, fixed,
+                                 smoothOnly));
+  }
+  if (V::width > 1 && v < end) {
+    combineVertexPointsImpl<ScalarVector>(terms, v, end, vertexPoints);
+  }
+}
+
+/**
+ * @brief pointBoundsImpl Computes the bounding box of interleaved points, see
+ * pointBounds.
+ */
+template <class V>
+void pointBoundsImpl(const float* points, int count, float minimum[3],
+                     float maximum[3]) {
+  typedef typename V::F F;
+  float low[3] = {points[0], points[1], points[2]};
+  float high[3] = {points[0], points[1], points[2]};
+  // Three vectors hold width points; coordinate c of point j is float 3j + c
+  const int stride = 3 * V::width;
+  int i = 0;
+  if (count >= V::width) {
+    F low0 = V::load(points);
+    F low1 = V::load(points + V::width);
+    F low2 = V::load(points + 2 * V::width);
+    F high0 = low0;
+    F high1 = low1;
+    F high2 = low2;
+    for (; i + V::width <= count; i += V::width) {
+      const float* p = points + 3 * i;
+      const F value0 = V::load(p);
+      const F value1 = V::load(p + V::width);
+      const F value2 = V::load(p + 2 * V::width);
+      low0 = V::min(value0, low0);
+      low1 = V::min(value1, low1);
+      low2 = V::min(value2, low2);
+      high0 = V::max(value0, high0);
+      high1 = V::max(value1, high1);
+      high2 = V::max(value2, high2);
+    }
+    alignas(32) float lows[stride];
+    alignas(32) float highs[stride];
+    V::store(lows, low0);
+    V::store(lows + V::width, low1);
+    V::store(lows + 2 * V::width, low2);
+    V::store(highs, high0);
+    V::store(highs + V::width, high1);
+    V::store(highs + 2 * V::width, high2);
+    for (int j = 0; j < stride; j++) {
+      low[j % 3] = ScalarVector::min(lows[j], low[j % 3]);
+      high[j % 3] = ScalarVector::max(highs[j], high[j % 3]);
+    }
+  }
+  for (; i < count; i++) {
+    for (int c = 0; c < 3; c++) {
+      low[c] = ScalarVector::min(points[3 * i + c], low[c]);
+      high[c] = ScalarVector::max(points[3 * i + c], high[c]);
+    }
+  }
+  for (int c = 0; c < 3; c++) {
+    minimum[c] = low[c];
+    maximum[c] = high[c];
+  }
+}
+
+/**
+ * @brief scalePointsImpl Scales interleaved points, see scalePoints.
+ */
+template <class V>
+void scalePointsImpl(float* points, int count, float scale) {
+  const typename V::F factor = V::set(scale);
+  const int floats = 3 * count;
+  int i = 0;
+  for (; i + V::width <= floats; i += V::width) {
+    V::store(points + i, V::mul(V::load(points + i), factor));
+  }
+  for (; i < floats; i++) {
+    points[i] *= scale;
+  }
+}
+
+}  // namespace
+
+#endif  // POINT_KERNELS_IMPL_H
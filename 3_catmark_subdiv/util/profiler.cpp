@@ -0,0 +1,305 @@
+#include "profiler.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+#include <atomic>
+
+namespace {
+
+// Thread number of the events measured on the GPU in the trace
+const int GPU_THREAD = 0;
+
+struct ProfileEvent {
+  const char* name;
+  int model;
+  int level;
+  int thread;
+  qint64 start;
+  qint64 duration;
+};
+
+struct ProfileKey {
+  int model;
+  int level;
+  QString name;
+
+  bool operator<(const ProfileKey& other) const {
+    if (model != other.model) {
+      return model < other.model;
+    }
+    if (level != other.level) {
+      return level < other.level;
+    }
+    return name < other.name;
+  }
+};
+
+struct ProfileStats {
+  int count = 0;
+  qint64 total = 0;
+  qint64 max = 0;
+};
+
+std::atomic<bool> recording(false);
+QMutex mutex;
+QVector<QString> models;
+int currentModel = -1;
+// Per thread, so a background job does not move the GUI events to its level
+thread_local int currentLevel = 0;
+QHash<quintptr, int> threads;
+QVector<ProfileEvent> events;
+qint64 droppedEvents = 0;
+QMap<ProfileKey, ProfileStats> stats;
+
+/**
+ * @brief profilerClock Gives the clock of the profiler, starting it on first
+ * use.
+ * @return The clock.
+ */
+const QElapsedTimer& profilerClock() {
+  static QElapsedTimer clock = [] {
+    QElapsedTimer timer;
+    timer.start();
+    return timer;
+  }();
+  return clock;
+}
+
+/**
+ * @brief threadNumber Gives a small number for the calling thread, for the
+ * trace. Must be called with the mutex locked.
+ * @return The number of the calling thread, starting at 1.
+ */
+int threadNumber() {
+  quintptr id = quintptr(QThread::currentThreadId());
+  if (threads.contains(id)) {
+    return threads.value(id);
+  }
+  int number = threads.size() + 1;
+  threads.insert(id, number);
+  return number;
+}
+
+/**
+ * @brief jsonString Quotes and escapes a string for a JSON document.
+ * @param string The string.
+ * @return The JSON string literal.
+ */
+QString jsonString(const QString& string) {
+  QString quoted = "\"";
+  for (QChar c : string) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+      quoted += c;
+    } else if (c.unicode() < 0x20) {
+      quoted += QString("\\u%1").arg(int(c.unicode()), 4, 16, QChar('0'));
+    } else {
+      quoted += c;
+    }
+  }
+  return quoted + "\"";
+}
+
+/**
+ * @brief milliseconds Formats a duration for the summary.
+ * @param nanoseconds The duration in nanoseconds.
+ * @return The duration in milliseconds.
+ */
+QString milliseconds(qint64 nanoseconds) {
+  return QString::number(nanoseconds / 1e6, 'f', 3);
+}
+
+}  // namespace
+
+/**
+ * @brief Profiler::setEnabled Starts or stops recording events. The events
+ * recorded so far are kept.
+ * @param enabled Whether to record events.
+ */
+void Profiler::setEnabled(bool enabled) {
+  profilerClock();
+  recording = enabled;
+}
+
+/**
+ * @brief Profiler::isEnabled Checks whether events are recorded.
+ * @return True if events are recorded.
+ */
+bool Profiler::isEnabled() { return recording; }
+
+/**
+ * @brief Profiler::setModel Sets the model the following events belong to and
+ * resets the level of the calling thread to the control mesh.
+ * @param model The name of the model, such as its file name.
+ */
+void Profiler::setModel(const QString& model) {
+  QMutexLocker locker(&mutex);
+  currentModel = models.indexOf(model);
+  if (currentModel < 0) {
+    currentModel = models.size();
+    models.append(model);
+  }
+  currentLevel = 0;
+}
+
+/**
+ * @brief Profiler::setLevel Sets the subdivision level the following events of
+ * the calling thread belong to. Every thread has its own level, so the
+ * SubdivisionWorker can tag its events while the GUI thread keeps tagging the
+ * upload and paint events with the level on screen.
+ * @param level The subdivision level. Level 0 is the control mesh.
+ */
+void Profiler::setLevel(int level) { currentLevel = level; }
+
+/**
+ * @brief Profiler::getLevel Gives the subdivision level new events of the
+ * calling thread belong to.
+ * @return The current subdivision level of the calling thread.
+ */
+int Profiler::getLevel() { return currentLevel; }
+
+/**
+ * @brief Profiler::now Gives the time on the clock of the profiler.
+ * @return The time in nanoseconds since the clock was first used.
+ */
+qint64 Profiler::now() { return profilerClock().nsecsElapsed(); }
+
+/**
+ * @brief Profiler::record Records an event, if recording is enabled.
+ * @param name The name of the stage. Must outlive the profiler.
+ * @param start The start of the event, see now.
+ * @param duration The duration of the event in nanoseconds.
+ * @param gpu Whether the duration was measured on the GPU. GPU events get their
+ * own track in the trace.
+ */
+void Profiler::record(const char* name, qint64 start, qint64 duration,
+                      bool gpu) {
+  if (!recording) {
+    return;
+  }
+  QMutexLocker locker(&mutex);
+  ProfileEvent event;
+  event.name = name;
+  event.model = currentModel;
+  event.level = currentLevel;
+  event.thread = gpu ? GPU_THREAD : threadNumber();
+  event.start = start;
+  event.duration = duration;
+  if (events.size() < PROFILER_MAX_EVENTS) {
+    events.append(event);
+  } else {
+    droppedEvents++;
+  }
+
+  ProfileStats& entry = stats[{currentModel, currentLevel, QString(name)}];
+  entry.count++;
+  entry.total += duration;
+  entry.max = qMax(entry.max, duration);
+}
+
+/**
+ * @brief Profiler::clear Discards all events and statistics.
+ */
+void Profiler::clear() {
+  QMutexLocker locker(&mutex);
+  events.clear();
+  droppedEvents = 0;
+  stats.clear();
+}
+
+/**
+ * @brief Profiler::summary Summarizes the statistics of the current model, per
+ * subdivision level and stage.
+ * @return A table with one line per level and stage, for a monospace font.
+ */
+QString Profiler::summary() {
+  QMutexLocker locker(&mutex);
+  QString text;
+  text += QString("%1\n").arg(
+      currentModel < 0 ? QString("no model") : models[currentModel]);
+  text += QString("%1 %2 %3 %4 %5\n")
+              .arg(QString("lvl"), 3)
+              .arg(QString("stage"), -44)
+              .arg(QString("calls"), 6)
+              .arg(QString("avg ms"), 9)
+              .arg(QString("max ms"), 9);
+  const QList<ProfileKey> keys = stats.keys();
+  for (const ProfileKey& key : keys) {
+    if (key.model != currentModel) {
+      continue;
+    }
+    const ProfileStats entry = stats.value(key);
+    text += QString("%1 %2 %3 %4 %5\n")
+                .arg(key.level, 3)
+                .arg(key.name, -44)
+                .arg(entry.count, 6)
+                .arg(milliseconds(entry.total / entry.count), 9)
+                .arg(milliseconds(entry.max), 9);
+  }
+  if (droppedEvents > 0) {
+    text += QString("%1 events not kept for the trace\n").arg(droppedEvents);
+  }
+  return text;
+}
+
+/**
+ * @brief Profiler::exportChromeTrace Writes the recorded events as a trace in
+ * the Chrome trace event format. Every event is a complete event with the
+ * model and level as its arguments.
+ * @param fileName The file to write.
+ * @return True if the trace was written.
+ */
+bool Profiler::exportChromeTrace(const QString& fileName) {
+  QMutexLocker locker(&mutex);
+  QFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate |
+                 QIODevice::Text)) {
+    qDebug() << ":: Could not write the trace to" << fileName;
+    return false;
+  }
+  QTextStream out(&file);
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+      << GPU_THREAD << ",\"args\":{\"name\":\"GPU\"}}";
+  for (const ProfileEvent& event : events) {
+    QString model =
+        event.model < 0 ? QString("no model") : models[event.model];
+    // The trace expects microseconds
+    out << ",\n{\"name\":" << jsonString(event.name)
+        << ",\"cat\":" << (event.thread == GPU_THREAD ? "\"gpu\"" : "\"cpu\"")
+        << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+        << ",\"ts\":" << QString::number(event.start / 1e3, 'f', 3)
+        << ",\"dur\":" << QString::number(event.duration / 1e3, 'f', 3)
+        << ",\"args\":{\"model\":" << jsonString(model)
+        << ",\"level\":" << event.level << "}}";
+  }
+  out << "\n]}\n";
+  out.flush();
+  qDebug() << ":: Wrote" << events.size() << "events to" << fileName;
+  return true;
+}
+
+/**
+ * @brief ProfileScope::ProfileScope Starts timing a stage.
+ * @param name The name of the stage. Must outlive the profiler.
+ */
+ProfileScope::ProfileScope(const char* name)
+    : name(name), start(Profiler::isEnabled() ? Profiler::now() : -1) {}
+
+/**
+ * @brief ProfileScope::~ProfileScope Records the stage, if the profiler was
+ * enabled when the scope started.
+ */
+ProfileScope::~ProfileScope() {
+  if (start >= 0) {
+    Profiler::record(name, start, Profiler::now() - start);
+  }
+}
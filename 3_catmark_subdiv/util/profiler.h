@@ -0,0 +1,56 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QString>
+#include <QtGlobal>
+
+// Maximum number of events kept for the trace; the statistics keep counting
+#define PROFILER_MAX_EVENTS 200000
+
+/**
+ * @brief The Profiler class records how long the stages of the pipeline take,
+ * from parsing an OBJ file to drawing a frame. Stages are timed with a
+ * ProfileScope, or recorded directly for durations measured elsewhere, such as
+ * GPU timer queries. Every event is attributed to the current model and the
+ * subdivision level of the thread that records it, and aggregated into a count, total and maximum per model,
+ * level and stage. The events themselves are kept as well, so they can be
+ * exported as a Chrome trace and inspected in chrome://tracing or Perfetto.
+ *
+ * Recording is disabled by default; a disabled ProfileScope only reads a flag.
+ * All functions are thread-safe.
+ */
+class Profiler {
+ public:
+  static void setEnabled(bool enabled);
+  static bool isEnabled();
+
+  static void setModel(const QString& model);
+  static void setLevel(int level);
+  static int getLevel();
+
+  static qint64 now();
+  static void record(const char* name, qint64 start, qint64 duration,
+                     bool gpu = false);
+  static void clear();
+
+  static QString summary();
+  static bool exportChromeTrace(const QString& fileName);
+};
+
+/**
+ * @brief The ProfileScope class records the wall time from its construction to
+ * its destruction as an event of the Profiler. The name must outlive the
+ * profiler, so it is typically a string literal.
+ */
+class ProfileScope {
+ public:
+  explicit ProfileScope(const char* name);
+  ~ProfileScope();
+
+ private:
+  const char* name;
+  // -1 if the profiler was disabled on construction
+  qint64 start;
+};
+
+#endif  // PROFILER_H
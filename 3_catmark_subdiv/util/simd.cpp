@@ -0,0 +1,140 @@
+#include "simd.h"
+
+#include <atomic>
+#include <cstring>
+
+#if defined(CATMARK_AVX2_KERNELS) && defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace {
+
+#if defined(CATMARK_AVX2_KERNELS)
+/**
+ * @brief cpuSupportsAvx2 Checks whether the processor and the operating system
+ * support AVX2.
+ * @return True if AVX2 instructions can be executed.
+ */
+bool cpuSupportsAvx2() {
+#if defined(_MSC_VER) && defined(SIMD_HAVE_SSE2)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+  __cpuid(info, 1);
+  // OSXSAVE and AVX, after which the OS must save the YMM registers
+  const int osxsaveAvx = (1 << 27) | (1 << 28);
+  if ((info[2] & osxsaveAvx) != osxsaveAvx || (_xgetbv(0) & 0x6) != 0x6) {
+    return false;
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#elif defined(SIMD_HAVE_SSE2) && defined(__GNUC__)
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+#endif
+
+/**
+ * @brief detectSimdLevel Determines the most capable instruction set the point
+ * kernels can use on this machine. AVX2 additionally requires the kernels to
+ * have been compiled for it, see CMakeLists.txt.
+ * @return The supported level.
+ */
+SimdLevel detectSimdLevel() {
+#if defined(CATMARK_AVX2_KERNELS)
+  if (cpuSupportsAvx2()) {
+    return SIMD_AVX2;
+  }
+#endif
+#if defined(SIMD_HAVE_SSE2)
+  return SIMD_SSE2;
+#elif defined(SIMD_HAVE_NEON)
+  return SIMD_NEON;
+#else
+  return SIMD_SCALAR;
+#endif
+}
+
+std::atomic<int> activeLevel(-1);
+
+}  // namespace
+
+/**
+ * @brief supportedSimdLevel Gives the most capable instruction set the point
+ * kernels can use on this machine. Detected on first use.
+ * @return The supported level.
+ */
+SimdLevel supportedSimdLevel() {
+  static const SimdLevel supported = detectSimdLevel();
+  return supported;
+}
+
+/**
+ * @brief simdLevel Gives the instruction set the point kernels currently use.
+ * This is the supported level, unless lowered with setSimdLevel.
+ * @return The active level.
+ */
+SimdLevel simdLevel() {
+  int level = activeLevel;
+  return level < 0 ? supportedSimdLevel() : SimdLevel(level);
+}
+
+/**
+ * @brief setSimdLevel Selects the instruction set of the point kernels, for
+ * instance to compare them against the scalar kernels. All levels produce the
+ * same points.
+ * @param level The level to use. Must be the scalar level, the supported level
+ * or, on machines with AVX2, SSE2.
+ * @return False if the level is not supported, in which case the active level
+ * is unchanged.
+ */
+bool setSimdLevel(SimdLevel level) {
+  const SimdLevel supported = supportedSimdLevel();
+  if (level != SIMD_SCALAR && level != supported &&
+      !(level == SIMD_SSE2 && supported == SIMD_AVX2)) {
+    return false;
+  }
+  activeLevel = level;
+  return true;
+}
+
+/**
+ * @brief simdLevelName Gives the name of an instruction set.
+ * @param level The level.
+ * @return The lower case name, as accepted by parseSimdLevel.
+ */
+const char* simdLevelName(SimdLevel level) {
+  switch (level) {
+    case SIMD_SSE2:
+      return "sse2";
+    case SIMD_NEON:
+      return "neon";
+    case SIMD_AVX2:
+      return "avx2";
+    default:
+      return "scalar";
+  }
+}
+
+/**
+ * @brief parseSimdLevel Looks up an instruction set by name.
+ * @param name The lower case name, see simdLevelName.
+ * @param level Is set to the level if the name is known.
+ * @return False if the name is unknown.
+ */
+bool parseSimdLevel(const char* name, SimdLevel& level) {
+  const SimdLevel levels[] = {SIMD_SCALAR, SIMD_SSE2, SIMD_NEON, SIMD_AVX2};
+  for (SimdLevel candidate : levels) {
+    if (strcmp(name, simdLevelName(candidate)) == 0) {
+      level = candidate;
+      return true;
+    }
+  }
+  return false;
+}
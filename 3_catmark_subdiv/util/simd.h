@@ -0,0 +1,26 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_HAVE_SSE2
+#endif
+// The NEON kernels need the vector division of AArch64
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define SIMD_HAVE_NEON
+#endif
+
+/**
+ * @brief The SimdLevel enum lists the instruction sets the point kernels in
+ * pointkernels.h are implemented for. The level is detected at runtime, so a
+ * single build runs the widest kernels the machine supports.
+ */
+enum SimdLevel { SIMD_SCALAR, SIMD_SSE2, SIMD_NEON, SIMD_AVX2 };
+
+SimdLevel supportedSimdLevel();
+SimdLevel simdLevel();
+bool setSimdLevel(SimdLevel level);
+const char* simdLevelName(SimdLevel level);
+bool parseSimdLevel(const char* name, SimdLevel& level);
+
+#endif  // SIMD_H
@@ -1,6 +1,13 @@
 #include "util.h"
 
 #include <QDebug>
+#include <algorithm>
+
+#include "pointkernels.h"
+
+// The kernels read the coordinates as one packed float array
+static_assert(sizeof(QVector3D) == 3 * sizeof(float),
+              "QVector3D must be three packed floats");
 
 /**
  * @brief calcBoundingBoxScale Calculates the scale with which to scale the
@@ -12,20 +19,22 @@
  * @return The scale with which to transform the coordinates to fit in the
  * bounding box.
  */
-float calcBoundingBoxScale(const QVector<QVector3D> coords,
+float calcBoundingBoxScale(const QVector<QVector3D>& coords,
                            const float desiredScale) {
-  QVector3D minCoord = coords[0];
-  QVector3D maxCoord = coords[0];
-  for (int i = 0; i < coords.size(); ++i) {
-    QVector3D coord = coords[i];
-    minCoord.setX(std::min(coord.x(), minCoord.x()));
-    minCoord.setY(std::min(coord.y(), minCoord.y()));
-    minCoord.setZ(std::min(coord.z(), minCoord.z()));
-
-    maxCoord.setX(std::max(coord.x(), maxCoord.x()));
-    maxCoord.setY(std::max(coord.y(), maxCoord.y()));
-    maxCoord.setZ(std::max(coord.z(), maxCoord.z()));
-  }
-  QVector3D dims = maxCoord - minCoord;
+  float minCoord[3];
+  float maxCoord[3];
+  pointBounds(reinterpret_cast<const float*>(coords.constData()),
+              coords.size(), minCoord, maxCoord);
+  QVector3D dims = QVector3D(maxCoord[0], maxCoord[1], maxCoord[2]) -
+                   QVector3D(minCoord[0], minCoord[1], minCoord[2]);
   return desiredScale / std::min(dims.x(), dims.y());
 }
+
+/**
+ * @brief scaleCoords Scales the provided coordinates about the origin.
+ * @param coords The coordinates to scale.
+ * @param scale The scale factor.
+ */
+void scaleCoords(QVector<QVector3D>& coords, float scale) {
+  scalePoints(reinterpret_cast<float*>(coords.data()), coords.size(), scale);
+}
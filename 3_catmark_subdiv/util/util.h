@@ -4,7 +4,8 @@
 #include <QVector3D>
 #include <QVector>
 
-float calcBoundingBoxScale(const QVector<QVector3D> coords,
+float calcBoundingBoxScale(const QVector<QVector3D>& coords,
                            const float desiredScale = 1.0f);
+void scaleCoords(QVector<QVector3D>& coords, float scale);
 
 #endif  // UTIL_H